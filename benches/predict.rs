@@ -0,0 +1,29 @@
+/// Throughput/latency benchmark sweeping inference modes, batch sizes, channel capacities and
+/// devices, as configured by the `[bench]` table of a TOML config.
+///
+/// Usage: `cargo bench --bench predict [-- path/to/config.toml]`
+/// (defaults to `assets/configs/bench.toml`)
+use std::path::PathBuf;
+
+use anyhow::{Context, Result};
+use yolo_inference::{bench_from_toml, init_logger, records_to_csv};
+
+fn main() -> Result<()> {
+    init_logger();
+
+    let project_root = PathBuf::from(env!("CARGO_MANIFEST_DIR"));
+
+    // cargo passes `--bench` to harness-less benches; skip flags
+    let config_toml = std::env::args()
+        .skip(1)
+        .find(|arg| !arg.starts_with("--"))
+        .map(PathBuf::from)
+        .unwrap_or_else(|| project_root.join("assets/configs/bench.toml"));
+
+    let records = bench_from_toml(&config_toml, &project_root)
+        .with_context(|| format!("Failed to run benchmark: {:?}", config_toml))?;
+
+    println!("{}", records_to_csv(&records));
+
+    Ok(())
+}
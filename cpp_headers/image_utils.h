@@ -1,11 +1,83 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <thread>
 #include <vector>
 
 using namespace std;
 
+/// Bytes copied per worker thread before a row copy or flip is split across threads: smaller
+/// images are handled on the calling thread, where spawning threads would cost more than the copy
+constexpr size_t PARALLEL_COPY_BLOCK_BYTES = 4 << 20;
+
+/// Run `fn(begin, end)` over `[0, count)` split into contiguous blocks, on up to `workers`
+/// threads (0: one per hardware thread). The calling thread processes the first block.
+template <typename F>
+inline void parallel_for_blocks(size_t count, size_t workers, F&& fn) {
+    if (workers == 0) {
+        workers = max(1u, thread::hardware_concurrency());
+    }
+    workers = min(workers, count);
+    if (workers <= 1) {
+        if (count > 0) {
+            fn(size_t{0}, count);
+        }
+        return;
+    }
+
+    const size_t block = (count + workers - 1) / workers;
+    vector<thread> threads;
+    for (size_t begin = block; begin < count; begin += block) {
+        const size_t end = min(count, begin + block);
+        threads.emplace_back([&fn, begin, end]() { fn(begin, end); });
+    }
+    fn(size_t{0}, block);
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+/// Worker threads for moving `bytes` bytes of pixel data (see `PARALLEL_COPY_BLOCK_BYTES`)
+inline size_t copy_workers(size_t bytes) {
+    const size_t hardware = max(1u, thread::hardware_concurrency());
+    return max<size_t>(1, min(hardware, bytes / PARALLEL_COPY_BLOCK_BYTES));
+}
+
+/// Copy `height` rows of `row_size` bytes from `src` to `dst` in a single pass, reversing their
+/// order if `flip` (e.g. between VTK's bottom-left origin and a top-left one). Large images are
+/// copied by row blocks in parallel.
+/// @param dst destination buffer, `dst_stride` bytes between row starts
+/// @param src source buffer, `src_stride` bytes between row starts
+/// @param workers worker threads (0: chosen from the image size, 1: calling thread only)
+inline void copy_rows(uint8_t* dst, size_t dst_stride, const uint8_t* src, size_t src_stride,
+                      size_t row_size, int height, bool flip, size_t workers = 0) {
+    if (height <= 0 || row_size == 0) {
+        return;
+    }
+    const size_t rows = static_cast<size_t>(height);
+    if (workers == 0) {
+        workers = copy_workers(rows * row_size);
+    }
+
+    // contiguous and unflipped: one memcpy per block
+    if (!flip && dst_stride == row_size && src_stride == row_size) {
+        parallel_for_blocks(rows, workers, [&](size_t begin, size_t end) {
+            memcpy(dst + begin * row_size, src + begin * row_size, (end - begin) * row_size);
+        });
+        return;
+    }
+
+    parallel_for_blocks(rows, workers, [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; ++y) {
+            const size_t src_row = flip ? rows - 1 - y : y;
+            memcpy(dst + y * dst_stride, src + src_row * src_stride, row_size);
+        }
+    });
+}
+
 /// Flip image data vertically (along Y axis) - out of place version
 /// @param dst destination buffer
 /// @param src source buffer
@@ -13,26 +85,30 @@ using namespace std;
 /// @param height image height in pixels
 /// @param channels number of channels per pixel
 inline void flip_vertical(uint8_t* dst, const uint8_t* src, int width, int height, int channels) {
-    size_t row_size = width * channels;
-    for (int y = 0; y < height; ++y) {
-        int src_row = height - 1 - y;  // read from bottom to top
-        memcpy(dst + y * row_size, src + src_row * row_size, row_size);
-    }
+    size_t row_size = static_cast<size_t>(width) * channels;
+    copy_rows(dst, row_size, src, row_size, row_size, height, true);
 }
 
-/// Flip image data vertically (along Y axis) - in-place version
+/// Flip image data vertically (along Y axis) - in-place version.
+/// Row pairs are swapped directly (vectorized `swap_ranges`, no temporary row), by row blocks in
+/// parallel for large images.
 /// @param image image buffer to flip in place
 /// @param width image width in pixels
 /// @param height image height in pixels
 /// @param channels number of channels per pixel
 inline void flip_vertical_inplace(uint8_t* image, int width, int height, int channels) {
-    size_t row_size = width * channels;
-    vector<uint8_t> temp(row_size);
-    for (int top = 0, bottom = height - 1; top < bottom; ++top, --bottom) {
-        uint8_t* row_top = image + top * row_size;
-        uint8_t* row_bottom = image + bottom * row_size;
-        memcpy(temp.data(), row_top, row_size);
-        memcpy(row_top, row_bottom, row_size);
-        memcpy(row_bottom, temp.data(), row_size);
+    if (height <= 1) {
+        return;
     }
+    const size_t row_size = static_cast<size_t>(width) * channels;
+    const size_t rows = static_cast<size_t>(height);
+    const size_t pairs = rows / 2;
+
+    parallel_for_blocks(pairs, copy_workers(rows * row_size), [&](size_t begin, size_t end) {
+        for (size_t top = begin; top < end; ++top) {
+            uint8_t* row_top = image + top * row_size;
+            uint8_t* row_bottom = image + (rows - 1 - top) * row_size;
+            swap_ranges(row_top, row_top + row_size, row_bottom);
+        }
+    });
 }
@@ -1,4 +1,3 @@
-#include <algorithm>
 #include <cctype>
 #include <filesystem>
 #include <iostream>
@@ -15,33 +14,46 @@ inline bool assert_path_exists(const path& p) {
     return true;
 }
 
-inline vector<path> list_image_paths(const path& image_dir) {
-    assert_path_exists(image_dir);
+// Case-insensitive check of a file extension (with leading dot) against the supported image
+// formats, without allocating
+inline bool is_image_extension(const string& ext) {
+    static constexpr const char* image_extensions[] = {".jpg", ".jpeg", ".png",  ".bmp",
+                                                       ".gif", ".webp", ".tiff", ".tif"};
+    // the longest extension is 5 characters with the dot
+    if (ext.size() < 4 || ext.size() > 5) {
+        return false;
+    }
+    for (const char* known : image_extensions) {
+        size_t i = 0;
+        while (i < ext.size() && known[i] != '\0' &&
+               tolower(static_cast<unsigned char>(ext[i])) == known[i]) {
+            ++i;
+        }
+        if (i == ext.size() && known[i] == '\0') {
+            return true;
+        }
+    }
+    return false;
+}
 
-    vector<path> image_paths;
-    const vector<string> image_extensions = {"jpg", "jpeg", "png",  "bmp",
-                                             "gif", "webp", "tiff", "tif"};
+// Stream the image files of a directory to `callback` as they are listed, so that processing
+// can start before the whole directory has been read
+template <typename F>
+inline void for_each_image_path(const path& image_dir, F&& callback) {
+    assert_path_exists(image_dir);
 
     for (const auto& entry : directory_iterator(image_dir)) {
-        if (entry.is_regular_file()) {
-            path file_path = entry.path();
-            string ext = file_path.extension().string();
-
-            // Remove leading dot and convert to lowercase for comparison
-            if (!ext.empty() && ext[0] == '.') {
-                ext = ext.substr(1);
-            }
-            for (char& c : ext) {
-                c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
-            }
-
-            if (find(image_extensions.begin(), image_extensions.end(), ext) !=
-                image_extensions.end()) {
-                image_paths.push_back(file_path);
-            }
+        // check the extension first: the file type may need a stat
+        const path& file_path = entry.path();
+        if (is_image_extension(file_path.extension().string()) && entry.is_regular_file()) {
+            callback(file_path);
         }
     }
+}
 
+inline vector<path> list_image_paths(const path& image_dir) {
+    vector<path> image_paths;
+    for_each_image_path(image_dir, [&](const path& p) { image_paths.push_back(p); });
     return image_paths;
 }
 
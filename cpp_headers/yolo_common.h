@@ -4,8 +4,16 @@
 
 using rust::Box;
 using rust::Vec;
+using yolo_inference::Detection;
 using yolo_inference::ImageInfo;
+using yolo_inference::ImageView;
+using yolo_inference::PixelLayout;
+using yolo_inference::RowOrder;
 using yolo_inference::RustImage;
+using yolo_inference::StageStatsInfo;
+using yolo_inference::StreamPipeline;
 using yolo_inference::InferResult;
+using yolo_inference::Keypoint;
+using yolo_inference::Predictor;
 
 
@@ -0,0 +1,301 @@
+#pragma once
+
+// Header-only client of the shared-memory inference server (`infer_server`, see
+// src/ffi/ipc_server.rs). Linux only; does not link against the Rust library.
+//
+// Frames are written straight into a server-owned slot, then batched with the frames of every
+// other client:
+//
+//     yolo_ipc::Client client;                       // maps "/yolo_inference"
+//     yolo_ipc::FrameSlot slot = client.acquire();   // blocks until a slot is free
+//     memcpy(slot.data, pixels, stride * height);    // or decode into slot.data directly
+//     client.submit(slot, width, height, channels, stride, tag);
+//     yolo_ipc::FrameResult result = client.wait(slot);  // status, tag, detections
+//
+// `acquire` and `wait` stop blocking once the server process is gone; slots held by a client
+// process that exited are taken back by the server.
+
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace yolo_ipc {
+
+// -- Shared layout (keep in sync with src/ffi/ipc_server.rs) -----------
+
+constexpr uint32_t IPC_MAGIC = 0x594f4c4f;
+constexpr uint32_t IPC_VERSION = 2;
+
+constexpr uint32_t SLOT_FREE = 0;
+constexpr uint32_t SLOT_WRITING = 1;
+constexpr uint32_t SLOT_READY = 2;
+constexpr uint32_t SLOT_BUSY = 3;
+constexpr uint32_t SLOT_DONE = 4;
+
+constexpr int32_t STATUS_OK = 0;
+constexpr int32_t STATUS_INVALID_FRAME = -1;
+constexpr int32_t STATUS_INFER_FAILED = -2;
+constexpr int32_t STATUS_SHUTDOWN = -3;
+
+constexpr size_t IPC_ALIGN = 64;
+
+struct SegmentHeader {
+    std::atomic<uint32_t> magic;
+    std::atomic<uint32_t> version;
+    std::atomic<uint32_t> slot_count;
+    std::atomic<uint32_t> max_detections;
+    std::atomic<uint64_t> slot_bytes;
+    std::atomic<uint64_t> slot_stride;
+    std::atomic<uint32_t> doorbell;
+    std::atomic<uint32_t> running;
+    std::atomic<uint32_t> released;
+    std::atomic<uint32_t> server_pid;
+    uint32_t reserved[4];
+};
+
+struct SlotHeader {
+    std::atomic<uint32_t> state;
+    std::atomic<uint32_t> width;
+    std::atomic<uint32_t> height;
+    std::atomic<uint32_t> channels;
+    std::atomic<uint32_t> stride;
+    std::atomic<int32_t> status;
+    std::atomic<uint32_t> detection_count;
+    std::atomic<uint32_t> owner_pid;
+    std::atomic<uint64_t> tag;
+    uint64_t reserved1[3];
+};
+
+/// Detection box in frame coordinates; `cls` is the class id stored as float
+struct Detection {
+    float x1, y1, x2, y2, conf, cls;
+};
+
+static_assert(sizeof(SegmentHeader) == IPC_ALIGN, "SegmentHeader layout");
+static_assert(sizeof(SlotHeader) == IPC_ALIGN, "SlotHeader layout");
+static_assert(sizeof(Detection) == 24, "Detection layout");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "futex words must be lock-free");
+
+// -- Futex helpers -----------------------------------------------------
+
+/// Whether process `pid` still exists (a process of another user counts as alive)
+inline bool process_alive(uint32_t pid) {
+    return kill(static_cast<pid_t>(pid), 0) == 0 || errno != ESRCH;
+}
+
+/// Wait until `word` no longer holds `expected`, at most `timeout_ms` (spurious wakeups possible)
+inline void futex_wait(std::atomic<uint32_t>& word, uint32_t expected, long timeout_ms) {
+    timespec ts{timeout_ms / 1000, (timeout_ms % 1000) * 1000000};
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+
+/// Wake every waiter on `word`
+inline void futex_wake(std::atomic<uint32_t>& word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT32_MAX, nullptr,
+            nullptr, 0);
+}
+
+// -- Client ------------------------------------------------------------
+
+/// Claimed frame slot: write the frame into `data` (up to `capacity` bytes), then `submit` it
+struct FrameSlot {
+    uint32_t index = 0;
+    uint8_t* data = nullptr;
+    size_t capacity = 0;
+};
+
+/// Result of one frame
+struct FrameResult {
+    int32_t status = STATUS_OK;
+    uint64_t tag = 0;
+    std::vector<Detection> detections;
+};
+
+/// Connection to the server; may be shared by several threads of a process
+class Client {
+   public:
+    /// Map the segment of a running server; throws `std::runtime_error` if there is none
+    explicit Client(const std::string& shm_name = "/yolo_inference") {
+        int fd = shm_open(shm_name.c_str(), O_RDWR, 0);
+        if (fd < 0) {
+            throw std::runtime_error("No inference server at " + shm_name + ": " +
+                                     std::strerror(errno));
+        }
+        struct stat st {};
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SegmentHeader)) {
+            close(fd);
+            throw std::runtime_error("Invalid inference server segment " + shm_name);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        void* ptr = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (ptr == MAP_FAILED) {
+            throw std::runtime_error("Failed to map " + shm_name + ": " + std::strerror(errno));
+        }
+        base_ = static_cast<uint8_t*>(ptr);
+
+        SegmentHeader& h = header();
+        if (h.magic.load(std::memory_order_acquire) != IPC_MAGIC ||
+            h.version.load(std::memory_order_relaxed) != IPC_VERSION) {
+            munmap(base_, size_);
+            throw std::runtime_error("Inference server segment " + shm_name +
+                                     " is not ready or has another version");
+        }
+        slot_count_ = h.slot_count.load(std::memory_order_relaxed);
+        max_detections_ = h.max_detections.load(std::memory_order_relaxed);
+        slot_bytes_ = h.slot_bytes.load(std::memory_order_relaxed);
+        slot_stride_ = h.slot_stride.load(std::memory_order_relaxed);
+        const size_t results_end = sizeof(SlotHeader) + max_detections_ * sizeof(Detection);
+        frame_offset_ = (results_end + IPC_ALIGN - 1) / IPC_ALIGN * IPC_ALIGN;
+    }
+
+    ~Client() {
+        if (base_) {
+            munmap(base_, size_);
+        }
+    }
+
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    /// Frame capacity of a slot, in bytes
+    size_t slot_bytes() const { return slot_bytes_; }
+
+    /// Whether the server is still running (and its process has not died)
+    bool server_running() {
+        SegmentHeader& h = header();
+        return h.running.load(std::memory_order_acquire) == 1 &&
+               process_alive(h.server_pid.load(std::memory_order_relaxed));
+    }
+
+    /// Claim a free slot, blocking until one is released; throws if the server stopped
+    FrameSlot acquire() {
+        SegmentHeader& h = header();
+        for (;;) {
+            if (!server_running()) {
+                throw std::runtime_error("Inference server stopped");
+            }
+            uint32_t released = h.released.load(std::memory_order_acquire);
+            for (uint32_t n = 0; n < slot_count_; ++n) {
+                uint32_t index = (next_slot_.load(std::memory_order_relaxed) + n) % slot_count_;
+                uint32_t expected = SLOT_FREE;
+                if (slot(index).state.compare_exchange_strong(expected, SLOT_WRITING,
+                                                              std::memory_order_acquire)) {
+                    slot(index).owner_pid.store(static_cast<uint32_t>(getpid()),
+                                                std::memory_order_relaxed);
+                    next_slot_.store((index + 1) % slot_count_, std::memory_order_relaxed);
+                    return FrameSlot{index, slot_ptr(index) + frame_offset_, slot_bytes_};
+                }
+            }
+            futex_wait(h.released, released, 100);
+        }
+    }
+
+    /// Hand a written slot to the server. `stride` is the number of bytes between row starts
+    /// (0: tightly packed); `channels` is 1 (gray), 3 (RGB) or 4 (RGBA).
+    void submit(const FrameSlot& frame, uint32_t width, uint32_t height, uint32_t channels,
+                uint32_t stride = 0, uint64_t tag = 0) {
+        SlotHeader& s = slot(frame.index);
+        s.width.store(width, std::memory_order_relaxed);
+        s.height.store(height, std::memory_order_relaxed);
+        s.channels.store(channels, std::memory_order_relaxed);
+        s.stride.store(stride ? stride : width * channels, std::memory_order_relaxed);
+        s.tag.store(tag, std::memory_order_relaxed);
+        s.state.store(SLOT_READY, std::memory_order_release);
+
+        SegmentHeader& h = header();
+        h.doorbell.fetch_add(1, std::memory_order_release);
+        futex_wake(h.doorbell);
+    }
+
+    /// Wait for the result of a submitted slot, then release the slot; returns
+    /// `STATUS_SHUTDOWN` if the server stopped or died before completing it
+    FrameResult wait(const FrameSlot& frame) {
+        SlotHeader& s = slot(frame.index);
+        SegmentHeader& h = header();
+        for (;;) {
+            uint32_t state = s.state.load(std::memory_order_acquire);
+            if (state == SLOT_DONE) {
+                break;
+            }
+            // a stopping server still completes the frames it is inferring, a dead one never will
+            const bool stopped = h.running.load(std::memory_order_acquire) != 1;
+            const bool died = !process_alive(h.server_pid.load(std::memory_order_relaxed));
+            if (died || (stopped && state != SLOT_BUSY)) {
+                release(frame.index);
+                return FrameResult{STATUS_SHUTDOWN, s.tag.load(std::memory_order_relaxed), {}};
+            }
+            futex_wait(s.state, state, 100);
+        }
+
+        FrameResult result;
+        result.status = s.status.load(std::memory_order_relaxed);
+        result.tag = s.tag.load(std::memory_order_relaxed);
+        uint32_t count = s.detection_count.load(std::memory_order_relaxed);
+        const auto* dets = reinterpret_cast<const Detection*>(slot_ptr(frame.index) +
+                                                              sizeof(SlotHeader));
+        result.detections.assign(dets, dets + count);
+        release(frame.index);
+        return result;
+    }
+
+    /// Copy a frame into a slot, submit it and wait for its result
+    FrameResult infer(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels,
+                      uint32_t stride = 0, uint64_t tag = 0) {
+        const size_t row_size = static_cast<size_t>(width) * channels;
+        if (stride == 0) {
+            stride = static_cast<uint32_t>(row_size);
+        }
+        if (row_size * height > slot_bytes_) {
+            return FrameResult{STATUS_INVALID_FRAME, tag, {}};
+        }
+        FrameSlot frame = acquire();
+        for (uint32_t y = 0; y < height; ++y) {
+            std::memcpy(frame.data + y * row_size, pixels + static_cast<size_t>(y) * stride,
+                        row_size);
+        }
+        submit(frame, width, height, channels, 0, tag);
+        return wait(frame);
+    }
+
+   private:
+    SegmentHeader& header() { return *reinterpret_cast<SegmentHeader*>(base_); }
+
+    uint8_t* slot_ptr(uint32_t index) {
+        return base_ + sizeof(SegmentHeader) + static_cast<size_t>(index) * slot_stride_;
+    }
+
+    SlotHeader& slot(uint32_t index) { return *reinterpret_cast<SlotHeader*>(slot_ptr(index)); }
+
+    void release(uint32_t index) {
+        slot(index).owner_pid.store(0, std::memory_order_relaxed);
+        slot(index).state.store(SLOT_FREE, std::memory_order_release);
+        SegmentHeader& h = header();
+        h.released.fetch_add(1, std::memory_order_release);
+        futex_wake(h.released);
+    }
+
+    uint8_t* base_ = nullptr;
+    size_t size_ = 0;
+    uint32_t slot_count_ = 0;
+    uint32_t max_detections_ = 0;
+    size_t slot_bytes_ = 0;
+    size_t slot_stride_ = 0;
+    size_t frame_offset_ = 0;
+    std::atomic<uint32_t> next_slot_{0};
+};
+
+}  // namespace yolo_ipc
@@ -0,0 +1,289 @@
+#pragma once
+
+// Header-only reader of the binary result files written with `result_file` (see
+// src/result_sink.rs for the layout). POSIX only; does not link against the Rust library.
+//
+// The file is memory-mapped and records are decoded in place, so scanning a run of millions of
+// frames neither parses text nor holds the results in memory:
+//
+//     yolo_results::ResultFile file("results/detections.bin");
+//     for (const yolo_results::Record& record : file) {
+//         for (const yolo_results::Box& box : record.boxes()) { ... }
+//         record.for_each_mask([&](uint32_t i, const uint32_t* runs, uint32_t run_count) { ... });
+//     }
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace yolo_results {
+
+// -- Layout (keep in sync with src/result_sink.rs) ---------------------
+
+constexpr uint32_t RESULT_FILE_MAGIC = 0x524c4f59;  // "YOLR"
+constexpr uint32_t RESULT_FILE_VERSION = 1;
+constexpr size_t FILE_HEADER_BYTES = 16;
+
+struct RecordHeader {
+    uint32_t size;
+    uint32_t path_len;
+    uint64_t frame_idx;
+    uint64_t tag;
+    int64_t timestamp_us;
+    uint32_t num_boxes;
+    uint32_t num_obb;
+    uint32_t num_poses;
+    uint32_t kpts_per_pose;
+    uint32_t num_masks;
+    uint32_t mask_height;
+    uint32_t mask_width;
+    uint32_t num_classes;
+};
+
+/// Detection box; `cls` is the class id stored as float
+struct Box {
+    float x1, y1, x2, y2, conf, cls;
+};
+
+/// Oriented box: corners `(x, y)` in order
+struct OrientedBox {
+    float corners[4][2];
+    float conf, cls;
+};
+
+struct Keypoint {
+    float x, y, conf;
+};
+
+/// Top classification score
+struct ClassScore {
+    uint32_t cls;
+    float score;
+};
+
+static_assert(sizeof(RecordHeader) == 64, "RecordHeader layout");
+static_assert(sizeof(Box) == 24, "Box layout");
+static_assert(sizeof(OrientedBox) == 40, "OrientedBox layout");
+static_assert(sizeof(ClassScore) == 8, "ClassScore layout");
+
+/// Contiguous array view of a record section
+template <typename T>
+struct Span {
+    const T* ptr = nullptr;
+    size_t count = 0;
+
+    const T* begin() const { return ptr; }
+    const T* end() const { return ptr + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T& operator[](size_t i) const { return ptr[i]; }
+};
+
+// -- Record ------------------------------------------------------------
+
+/// Results of one frame, pointing into the mapped file
+class Record {
+   public:
+    explicit Record(const uint8_t* data) : data_(data) {}
+
+    const RecordHeader& header() const { return *reinterpret_cast<const RecordHeader*>(data_); }
+
+    uint64_t frame_idx() const { return header().frame_idx; }
+    uint64_t tag() const { return header().tag; }
+    /// Presentation time of video frames in microseconds, -1 if none
+    int64_t timestamp_us() const { return header().timestamp_us; }
+
+    /// Source path, empty for in-memory images and video frames
+    std::string_view path() const {
+        return {reinterpret_cast<const char*>(data_ + sizeof(RecordHeader)), header().path_len};
+    }
+
+    Span<Box> boxes() const { return {section<Box>(boxes_offset()), header().num_boxes}; }
+
+    Span<OrientedBox> oriented_boxes() const {
+        return {section<OrientedBox>(obb_offset()), header().num_obb};
+    }
+
+    /// Keypoints of all poses, `kpts_per_pose()` per pose
+    Span<Keypoint> keypoints() const {
+        const RecordHeader& h = header();
+        return {section<Keypoint>(keypoints_offset()),
+                static_cast<size_t>(h.num_poses) * h.kpts_per_pose};
+    }
+
+    uint32_t kpts_per_pose() const { return header().kpts_per_pose; }
+
+    /// Top classification scores, best first
+    Span<ClassScore> classes() const {
+        return {section<ClassScore>(classes_offset()), header().num_classes};
+    }
+
+    uint32_t num_masks() const { return header().num_masks; }
+    uint32_t mask_height() const { return header().mask_height; }
+    uint32_t mask_width() const { return header().mask_width; }
+
+    /// Call `fn(index, runs, run_count)` for each mask. Runs are row-major and alternate
+    /// background and foreground, starting with background.
+    template <typename F>
+    void for_each_mask(F&& fn) const {
+        const uint32_t* runs = section<uint32_t>(masks_offset());
+        for (uint32_t i = 0; i < header().num_masks; ++i) {
+            const uint32_t run_count = runs[0];
+            fn(i, runs + 1, run_count);
+            runs += 1 + run_count;
+        }
+    }
+
+    /// Decode mask `index` into `out` (`mask_height() * mask_width()` bytes, 1 = foreground);
+    /// returns false if there is no such mask
+    bool decode_mask(uint32_t index, uint8_t* out) const {
+        bool found = false;
+        const size_t len = static_cast<size_t>(mask_height()) * mask_width();
+        for_each_mask([&](uint32_t i, const uint32_t* runs, uint32_t run_count) {
+            if (i != index) {
+                return;
+            }
+            size_t pos = 0;
+            for (uint32_t r = 0; r < run_count && pos < len; ++r) {
+                const size_t run = std::min<size_t>(runs[r], len - pos);
+                std::memset(out + pos, r % 2, run);
+                pos += run;
+            }
+            std::memset(out + pos, 0, len - pos);
+            found = true;
+        });
+        return found;
+    }
+
+    /// Size of the record in the file, in bytes
+    size_t size() const { return header().size; }
+
+   private:
+    template <typename T>
+    const T* section(size_t offset) const {
+        return reinterpret_cast<const T*>(data_ + offset);
+    }
+
+    size_t boxes_offset() const {
+        return sizeof(RecordHeader) + (header().path_len + 3) / 4 * 4;
+    }
+    size_t obb_offset() const { return boxes_offset() + header().num_boxes * sizeof(Box); }
+    size_t keypoints_offset() const {
+        return obb_offset() + header().num_obb * sizeof(OrientedBox);
+    }
+    size_t classes_offset() const {
+        return keypoints_offset() + keypoints().size() * sizeof(Keypoint);
+    }
+    size_t masks_offset() const {
+        return classes_offset() + header().num_classes * sizeof(ClassScore);
+    }
+
+    const uint8_t* data_;
+};
+
+// -- File --------------------------------------------------------------
+
+/// Memory-mapped result file, iterable over its records
+class ResultFile {
+   public:
+    /// Map `path`; throws `std::runtime_error` if it is not a result file
+    explicit ResultFile(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open " + path + ": " + std::strerror(errno));
+        }
+        struct stat st {};
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < FILE_HEADER_BYTES) {
+            close(fd);
+            throw std::runtime_error("Not a result file: " + path);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        void* ptr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (ptr == MAP_FAILED) {
+            throw std::runtime_error("Failed to map " + path + ": " + std::strerror(errno));
+        }
+        base_ = static_cast<const uint8_t*>(ptr);
+        madvise(ptr, size_, MADV_SEQUENTIAL);
+
+        uint32_t magic = 0, version = 0;
+        std::memcpy(&magic, base_, 4);
+        std::memcpy(&version, base_ + 4, 4);
+        if (magic != RESULT_FILE_MAGIC || version != RESULT_FILE_VERSION) {
+            munmap(const_cast<uint8_t*>(base_), size_);
+            base_ = nullptr;
+            throw std::runtime_error("Not a result file or another version: " + path);
+        }
+    }
+
+    ~ResultFile() {
+        if (base_) {
+            munmap(const_cast<uint8_t*>(base_), size_);
+        }
+    }
+
+    ResultFile(const ResultFile&) = delete;
+    ResultFile& operator=(const ResultFile&) = delete;
+
+    /// Forward iterator over the records; stops at a truncated trailing record (e.g. of a run
+    /// that is still writing)
+    class Iterator {
+       public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Record;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Record*;
+        using reference = const Record&;
+
+        Iterator(const uint8_t* pos, const uint8_t* end) : pos_(pos), end_(end), record_(pos) {
+            check();
+        }
+
+        reference operator*() const { return record_; }
+        pointer operator->() const { return &record_; }
+
+        Iterator& operator++() {
+            pos_ += record_.size();
+            record_ = Record(pos_);
+            check();
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const { return pos_ == other.pos_; }
+        bool operator!=(const Iterator& other) const { return pos_ != other.pos_; }
+
+       private:
+        /// Move to the end unless a whole record starts at `pos_`
+        void check() {
+            const size_t left = static_cast<size_t>(end_ - pos_);
+            if (left < sizeof(RecordHeader) || record_.size() < sizeof(RecordHeader) ||
+                record_.size() > left) {
+                pos_ = end_;
+            }
+        }
+
+        const uint8_t* pos_;
+        const uint8_t* end_;
+        Record record_;
+    };
+
+    Iterator begin() const { return {base_ + FILE_HEADER_BYTES, base_ + size_}; }
+    Iterator end() const { return {base_ + size_, base_ + size_}; }
+
+   private:
+    const uint8_t* base_ = nullptr;
+    size_t size_ = 0;
+};
+
+}  // namespace yolo_results
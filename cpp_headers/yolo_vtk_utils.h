@@ -28,58 +28,137 @@ inline Box<RustImage> vtk2rust(vtkImageData* vtk_image) {
 
     const uint8_t* bytes = static_cast<const uint8_t*>(vtk_image->GetScalarPointer());
 
-    // Copy to buffer and flip vertically to match Rust image coordinate system (top-left origin)
-    size_t total_size = width * height * channels;
-    vector<uint8_t> buffer(bytes, bytes + total_size);
-    flip_vertical_inplace(buffer.data(), width, height, channels);
-
-    return yolo_inference::image_from_bytes(buffer.data(), static_cast<uint32_t>(width),
-                                            static_cast<uint32_t>(height),
-                                            static_cast<uint32_t>(channels));
+    // Borrow VTK scalars directly: rows are flipped (bottom-left origin -> top-left origin) while
+    // Rust copies them into its own image, so no intermediate buffer is needed
+    uint32_t stride = static_cast<uint32_t>(width * channels);
+    return yolo_inference::image_from_view(
+        bytes, static_cast<uint32_t>(width), static_cast<uint32_t>(height),
+        static_cast<uint32_t>(channels), stride, yolo_inference::RowOrder::BottomUp);
 }
 
 /// Convert `RustImage` to `vtkImageData`
 inline Ptr<vtkImageData> rust2vtk(const RustImage& rs_image) {
-    ImageInfo info = yolo_inference::get_image_info(rs_image);
-    Vec<uint8_t> bytes = yolo_inference::image_to_bytes(rs_image);
-
     // Return nullptr if no image data
-    if (bytes.empty()) {
+    if (yolo_inference::is_image_empty(rs_image)) {
         return nullptr;
     }
 
-    // Flip bytes to match VTK coordinate system (bottom-left origin)
-    flip_vertical_inplace(bytes.data(), info.width, info.height, info.channels);
+    ImageInfo info = yolo_inference::get_image_info(rs_image);
+    uint32_t channels = info.channels;
+    size_t row_size = static_cast<size_t>(info.width) * channels;
+
+    // Borrow the Rust pixels; only images that are not 8-bit gray/RGB/RGBA are converted first,
+    // and `image_to_bytes` converts those to 8-bit RGB
+    rust::Slice<const uint8_t> view = yolo_inference::image_as_bytes(rs_image);
+    Vec<uint8_t> converted;
+    const uint8_t* bytes = view.data();
+    if (view.size() != row_size * info.height) {
+        converted = yolo_inference::image_to_bytes(rs_image);
+        bytes = converted.data();
+        channels = 3;
+        row_size = static_cast<size_t>(info.width) * channels;
+    }
 
     auto vtk_image = Ptr<vtkImageData>::New();
     vtk_image->SetDimensions(static_cast<int>(info.width), static_cast<int>(info.height), 1);
-    vtk_image->AllocateScalars(VTK_UNSIGNED_CHAR, static_cast<int>(info.channels));
+    vtk_image->AllocateScalars(VTK_UNSIGNED_CHAR, static_cast<int>(channels));
 
-    std::memcpy(vtk_image->GetScalarPointer(), bytes.data(), bytes.size());
+    // Single pass: rows go straight into the VTK scalars, flipped to match the VTK coordinate
+    // system (bottom-left origin)
+    copy_rows(static_cast<uint8_t*>(vtk_image->GetScalarPointer()), row_size, bytes, row_size,
+              row_size, static_cast<int>(info.height), true);
     return vtk_image;
 }
 
-/// Convert multiple `vtkImageData` to `RustImage`
+/// Convert multiple `vtkImageData` to `RustImage` in one bridge call; the slices are converted
+/// in parallel on the Rust side. Null images become empty `RustImage`s, so the output keeps one
+/// image per input.
 inline Vec<Box<RustImage>> multi_vtk2rust(const vector<Ptr<vtkImageData>>& vtk_images) {
-    Vec<Box<RustImage>> rs_images;
+    vector<ImageView> views;
+    views.reserve(vtk_images.size());
     for (const auto& vtk_img : vtk_images) {
-        rs_images.push_back(vtk2rust(vtk_img));
+        if (!vtk_img) {
+            cerr << "Warning: vtk_image is null, returning empty RustImage" << endl;
+            views.push_back(ImageView{nullptr, 0, 0, 0, 0, RowOrder::BottomUp});
+            continue;
+        }
+        int* dims = vtk_img->GetDimensions();
+        uint32_t width = static_cast<uint32_t>(dims[0]);
+        uint32_t channels = static_cast<uint32_t>(vtk_img->GetNumberOfScalarComponents());
+        views.push_back(ImageView{static_cast<const uint8_t*>(vtk_img->GetScalarPointer()), width,
+                                  static_cast<uint32_t>(dims[1]), channels, width * channels,
+                                  RowOrder::BottomUp});
     }
-    return rs_images;
+
+    return yolo_inference::images_from_views(
+        rust::Slice<const ImageView>(views.data(), views.size()));
 }
 
 // -- Prediction results utilities -------------------------------------
 
+/// `PixelLayout` of VTK scalars with `channels` components
+inline PixelLayout vtk_pixel_layout(uint32_t channels) {
+    switch (channels) {
+        case 1:
+            return PixelLayout::Gray;
+        case 4:
+            return PixelLayout::Rgba;
+        default:
+            return PixelLayout::Rgb;
+    }
+}
+
+/// Allocate the `vtkImageData` for the annotated image of `result` (nullptr if there is none)
+inline Ptr<vtkImageData> alloc_annotated(const InferResult& result) {
+    ImageInfo info = yolo_inference::result_annotated_info(result);
+    if (info.width == 0 || info.height == 0) {
+        return nullptr;
+    }
+    auto vtk_image = Ptr<vtkImageData>::New();
+    vtk_image->SetDimensions(static_cast<int>(info.width), static_cast<int>(info.height), 1);
+    vtk_image->AllocateScalars(VTK_UNSIGNED_CHAR, static_cast<int>(info.channels));
+    return vtk_image;
+}
+
+/// Write the annotated image of `result` into the scalars of `vtk_image` (see `alloc_annotated`)
+inline void fill_annotated(const InferResult& result, vtkImageData* vtk_image) {
+    int* dims = vtk_image->GetDimensions();
+    uint32_t channels = static_cast<uint32_t>(vtk_image->GetNumberOfScalarComponents());
+    // Rows are flipped to match the VTK coordinate system (bottom-left origin) while copying
+    yolo_inference::copy_result_annotated_into(
+        result, static_cast<uint8_t*>(vtk_image->GetScalarPointer()),
+        static_cast<uint32_t>(dims[0]) * channels, vtk_pixel_layout(channels),
+        RowOrder::BottomUp);
+}
+
+/// Annotated image of `result` as `vtkImageData` (nullptr if there is none), written by Rust
+/// straight into the VTK scalars
 inline Ptr<vtkImageData> get_annotated(const Box<InferResult>& result) {
-    Box<RustImage> annotated = yolo_inference::get_result_annotated(*result);
-    return rust2vtk(*annotated);
+    Ptr<vtkImageData> vtk_image = alloc_annotated(*result);
+    if (vtk_image) {
+        fill_annotated(*result, vtk_image);
+    }
+    return vtk_image;
 }
 
-inline vector<Ptr<vtkImageData>> get_batch_annotated(const Vec<Box<InferResult>>& results) {
-    vector<Ptr<vtkImageData>> annotated_images;
-    for (const auto& res : results) {
-        annotated_images.push_back(get_annotated(res));
+/// Annotated images of a batch of results as `vtkImageData` (nullptr where there is none).
+/// The VTK images are allocated up front, then filled in parallel (up to `workers` threads,
+/// 0: one per hardware thread) straight from the Rust pixels, flipped in the same pass.
+inline vector<Ptr<vtkImageData>> get_batch_annotated(const Vec<Box<InferResult>>& results,
+                                                     size_t workers = 0) {
+    const size_t count = results.size();
+    vector<Ptr<vtkImageData>> annotated_images(count);
+    for (size_t i = 0; i < count; ++i) {
+        annotated_images[i] = alloc_annotated(*results[i]);
     }
+
+    parallel_for_blocks(count, workers, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            if (annotated_images[i]) {
+                fill_annotated(*results[i], annotated_images[i]);
+            }
+        }
+    });
     return annotated_images;
 }
 
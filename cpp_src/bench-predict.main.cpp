@@ -0,0 +1,26 @@
+#include <filesystem>
+#include <iostream>
+
+#include "path_utils.h"
+#include "yolo-inference/src/ffi/cpp_ffi.rs.h"
+
+using namespace std;
+using namespace filesystem;
+
+/// Benchmark all inference modes as configured by the `[bench]` table of a TOML config.
+///
+/// Usage: bench-predict [config.toml]   (defaults to assets/configs/bench.toml)
+int main(int argc, char** argv) {
+    path project_root = PROJECT_ROOT;
+    path config_toml = argc > 1 ? path(argv[1]) : project_root / "assets/configs/bench.toml";
+    assert_path_exists(config_toml);
+
+    cout << "Using config: " << config_toml << endl;
+
+    // JSON report (also written to `bench.output` if configured)
+    rust::String report =
+        yolo_inference::bench_predict_from_toml(config_toml.string(), project_root.string());
+    cout << report << endl;
+
+    return 0;
+}
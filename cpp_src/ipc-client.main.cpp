@@ -0,0 +1,67 @@
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "path_utils.h"
+#include "stb_image.h"
+#include "yolo_ipc_client.h"
+
+using namespace std;
+using namespace filesystem;
+
+/// Decode an image straight into a claimed slot and submit it; returns false if it was skipped
+bool submit_image(yolo_ipc::Client& client, const path& img_path, uint64_t tag,
+                  yolo_ipc::FrameSlot* out) {
+    int width, height, channels;
+    unsigned char* bytes = stbi_load(img_path.c_str(), &width, &height, &channels, 0);
+    if (!bytes) {
+        cerr << "  Failed to load image: " << img_path << endl;
+        return false;
+    }
+    const size_t size = static_cast<size_t>(width) * height * channels;
+    if ((channels != 1 && channels != 3 && channels != 4) || size > client.slot_bytes()) {
+        cerr << "  Skipped: unsupported channel count or larger than a slot: " << img_path << endl;
+        stbi_image_free(bytes);
+        return false;
+    }
+
+    *out = client.acquire();
+    memcpy(out->data, bytes, size);
+    stbi_image_free(bytes);
+    client.submit(*out, width, height, channels, 0, tag);
+    return true;
+}
+
+int main() {
+    path project_root = PROJECT_ROOT;
+    path image_dir = project_root / "assets/images/small-batch";
+    assert_path_exists(image_dir);
+
+    // Requires a running server: cargo run --release --bin infer_server --features ipc
+    yolo_ipc::Client client("/yolo_inference");
+
+    auto image_paths = list_image_paths(image_dir);
+    cout << "Found " << image_paths.size() << " images." << endl;
+
+    // Submit every frame first so the server can batch them, then collect the results
+    vector<yolo_ipc::FrameSlot> slots;
+    for (size_t i = 0; i < image_paths.size(); i++) {
+        yolo_ipc::FrameSlot slot;
+        if (submit_image(client, image_paths[i], static_cast<uint64_t>(i), &slot)) {
+            slots.push_back(slot);
+        }
+    }
+
+    for (const auto& slot : slots) {
+        yolo_ipc::FrameResult result = client.wait(slot);
+        cout << "Frame " << result.tag << " (" << image_paths[result.tag].filename()
+             << "): status=" << result.status << ", " << result.detections.size()
+             << " detections" << endl;
+        for (const auto& det : result.detections) {
+            cout << "  cls=" << det.cls << " conf=" << det.conf << " box=(" << det.x1 << ", "
+                 << det.y1 << ", " << det.x2 << ", " << det.y2 << ")" << endl;
+        }
+    }
+    return 0;
+}
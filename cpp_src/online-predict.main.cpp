@@ -10,11 +10,14 @@
 using namespace std;
 using namespace filesystem;
 
+using yolo_inference::Detection;
 using yolo_inference::ImageInfo;
 using yolo_inference::InferResult;
+using yolo_inference::Predictor;
 using yolo_inference::RustImage;
 
 using rust::Box;
+using rust::Slice;
 using rust::Vec;
 
 Vec<Box<RustImage>> gather_rust_images(const vector<path>& image_paths) {
@@ -76,6 +79,35 @@ void test_get_annotated(const Vec<Box<InferResult>>& results) {
     }
 }
 
+void test_result_boxes(const Vec<Box<InferResult>>& results) {
+    cout << "\nTesting result_boxes (zero-copy structured results):" << endl;
+    for (size_t i = 0; i < results.size(); i++) {
+        Slice<const Detection> boxes = yolo_inference::result_boxes(*results[i]);
+        auto mask_info = yolo_inference::result_mask_info(*results[i]);
+        cout << "  Result[" << i << "]: " << boxes.size() << " boxes, " << mask_info.count
+             << " masks (" << mask_info.width << "x" << mask_info.height
+             << (mask_info.compact ? ", run-length encoded" : "") << ")" << endl;
+
+        for (const Detection& det : boxes) {
+            auto cls = static_cast<uint32_t>(det.cls);
+            string name = string(yolo_inference::result_class_name(*results[i], cls));
+            cout << "    " << name << " " << det.conf << " [" << det.x1 << ", " << det.y1 << ", "
+                 << det.x2 << ", " << det.y2 << "]" << endl;
+        }
+
+        // binarized masks decode the same way, compact or dense
+        vector<uint8_t> mask(static_cast<size_t>(mask_info.width) * mask_info.height);
+        for (uint32_t m = 0; m < mask_info.count; m++) {
+            Slice<uint8_t> out(mask.data(), mask.size());
+            if (yolo_inference::result_decode_mask(*results[i], m, out)) {
+                size_t area = 0;
+                for (uint8_t px : mask) area += px;
+                cout << "    mask " << m << ": " << area << " px" << endl;
+            }
+        }
+    }
+}
+
 void test_take_annotated(Vec<Box<InferResult>> results) {
     cout << "\nTesting get_result_annotated (take version):" << endl;
     for (size_t i = 0; i < results.size(); i++) {
@@ -107,15 +139,19 @@ int main() {
     // Gather RustImages
     auto images = gather_rust_images(image_paths);
 
+    // Load model once, then reuse it for every batch
+    Box<Predictor> predictor =
+        yolo_inference::create_predictor(config_toml.string(), project_root.string());
+
     // Run online inference via Rust FFI
-    Vec<Box<InferResult>> results = yolo_inference::online_predict_from_toml(
-        std::move(images), config_toml.string(), project_root.string());
+    Vec<Box<InferResult>> results = predictor->predict(std::move(images));
 
     cout << "\n--------------------------------\n"
          << "Prediction completed. Results count: " << results.size() << endl;
 
     // Get annotated results
     test_get_annotated(results);
+    test_result_boxes(results);
     test_take_annotated(std::move(results));
 
     return 0;
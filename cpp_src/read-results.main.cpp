@@ -0,0 +1,43 @@
+#include <iostream>
+#include <map>
+
+#include "path_utils.h"
+#include "yolo_results_reader.h"
+
+using namespace std;
+using namespace filesystem;
+
+int main(int argc, char** argv) {
+    path project_root = PROJECT_ROOT;
+    path result_file = argc > 1 ? path(argv[1]) : project_root / "results/demo/results.bin";
+    assert_path_exists(result_file);
+
+    yolo_results::ResultFile file(result_file.string());
+
+    // scan every record: frames, boxes per class and total mask area
+    size_t frames = 0, boxes = 0, masks = 0, mask_pixels = 0;
+    map<int, size_t> class_counts;
+    for (const yolo_results::Record& record : file) {
+        ++frames;
+        boxes += record.boxes().size();
+        for (const yolo_results::Box& box : record.boxes()) {
+            ++class_counts[static_cast<int>(box.cls)];
+        }
+        record.for_each_mask([&](uint32_t, const uint32_t* runs, uint32_t run_count) {
+            ++masks;
+            for (uint32_t r = 1; r < run_count; r += 2) {
+                mask_pixels += runs[r];
+            }
+        });
+    }
+
+    cout << "Result file: " << result_file << endl;
+    cout << "  frames: " << frames << ", boxes: " << boxes << ", masks: " << masks << endl;
+    if (masks > 0) {
+        cout << "  mean mask area: " << mask_pixels / masks << " px" << endl;
+    }
+    for (const auto& [cls, count] : class_counts) {
+        cout << "  class " << cls << ": " << count << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "path_utils.h"
+#include "stb_image.h"
+#include "yolo-inference/src/ffi/cpp_ffi.rs.h"
+
+using namespace std;
+using namespace filesystem;
+
+using yolo_inference::InferResult;
+using yolo_inference::ResultMeta;
+using yolo_inference::RustImage;
+using yolo_inference::StageStatsInfo;
+using yolo_inference::StreamPipeline;
+
+using rust::Box;
+using rust::Vec;
+
+/// Load one image as `RustImage` using stb_image
+bool load_rust_image(const path& img_path, Box<RustImage>* out) {
+    int width, height, channels;
+    unsigned char* bytes = stbi_load(img_path.c_str(), &width, &height, &channels, 0);
+    if (!bytes) {
+        cerr << "  Failed to load image: " << img_path << endl;
+        return false;
+    }
+    if (channels != 1 && channels != 3 && channels != 4) {
+        cerr << "  Skipped: unsupported channel count " << channels << endl;
+        stbi_image_free(bytes);
+        return false;
+    }
+
+    *out = yolo_inference::image_from_bytes(bytes, width, height, channels);
+    stbi_image_free(bytes);
+    return true;
+}
+
+int main() {
+    path project_root = PROJECT_ROOT;
+    path config_toml = project_root / "assets/configs/online-predict.toml";
+    path image_dir = project_root / "assets/images/small-batch";
+
+    assert_path_exists(config_toml);
+    assert_path_exists(image_dir);
+
+    cout << "Using config: " << config_toml << endl;
+    cout << "Using image directory: " << image_dir << endl;
+
+    auto image_paths = list_image_paths(image_dir);
+    cout << "Found " << image_paths.size() << " images." << endl;
+
+    // Model and stage threads are created once and kept alive
+    Box<StreamPipeline> pipeline =
+        yolo_inference::create_stream_pipeline(config_toml.string(), project_root.string());
+
+    // Simulate a continuous source: submit frames as they arrive, tagged with their index
+    vector<uint64_t> tickets;
+    for (size_t i = 0; i < image_paths.size(); i++) {
+        Box<RustImage> image = yolo_inference::image_from_bytes(nullptr, 0, 0, 0);
+        if (!load_rust_image(image_paths[i], &image)) {
+            continue;
+        }
+        tickets.push_back(pipeline->submit(std::move(image), static_cast<uint64_t>(i)));
+    }
+    cout << "Submitted " << tickets.size() << " frames." << endl;
+
+    // Wait for each ticket in submission order
+    for (uint64_t ticket : tickets) {
+        try {
+            Box<InferResult> result = pipeline->wait(ticket);
+            ResultMeta meta = yolo_inference::get_result_meta(*result);
+            size_t num_boxes = yolo_inference::result_boxes(*result).size();
+            cout << "  Ticket " << ticket << " (tag " << meta.tag << "): " << num_boxes
+                 << " boxes" << endl;
+        } catch (const std::exception& e) {
+            cerr << "  Ticket " << ticket << " failed: " << e.what() << endl;
+        }
+    }
+
+    // Per-stage counters: a stage that is busy while its neighbours block is the bottleneck
+    cout << "Pipeline stats:" << endl;
+    for (const StageStatsInfo& stage : pipeline->stats()) {
+        cout << "  " << stage.name << ": " << stage.items_in << " in, busy " << stage.busy_ms
+             << " ms, send-blocked " << stage.send_blocked_ms << " ms, recv-blocked "
+             << stage.recv_blocked_ms << " ms, max queue " << stage.queue_max_depth << "/"
+             << stage.queue_capacity << endl;
+    }
+
+    return 0;
+}
@@ -67,9 +67,12 @@ void run_batch_prediction(const path& image_dir, const path& config_toml,
     // Optionally save annotated images
     if (!save_dir.empty()) {
         cout << "\nSaving annotated images to: " << save_dir << endl;
+        vector<path> save_paths;
         for (size_t i = 0; i < annotateds.size() && i < image_paths.size(); ++i) {
-            path save_path = save_dir / (image_paths[i].stem().string() + ".png");
-            save_vtk_image(annotateds[i], save_path);
+            save_paths.push_back(save_dir / (image_paths[i].stem().string() + ".png"));
+        }
+        save_vtk_images(annotateds, save_paths);
+        for (const auto& save_path : save_paths) {
             cout << "  Saved: " << save_path.filename() << endl;
         }
     }
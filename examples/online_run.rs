@@ -2,8 +2,7 @@
 use std::path::PathBuf;
 
 use anyhow::{Context, Result};
-use ultralytics_inference as ul;
-use yolo_inference::{collect_images_from_dir, init_logger, parse_toml, run_online_prediction};
+use yolo_inference::{Predictor, collect_images_from_dir, init_logger};
 
 fn main() -> Result<()> {
     init_logger();
@@ -13,18 +12,12 @@ fn main() -> Result<()> {
     let config_toml = config_dir.join("online-predict.toml");
     let image_dir = project_root.join("assets/images/small-batch/");
 
-    // Parse config (without source field)
-    let args = parse_toml(&config_toml, &project_root)
-        .with_context(|| format!("Failed to parse TOML config: {:?}", config_toml))?;
-    tracing::info!("Config loaded, source: {:?}", args.source);
-
-    // Load model once using TryFrom trait
-    let config: ul::InferenceConfig = (&args).try_into()?;
-    let mut model = ul::YOLOModel::load_with_config(&args.model, config)
-        .map_err(|e| anyhow::anyhow!("Failed to load model: {}", e))?;
+    // Parse config (without source field) and load model once
+    let mut predictor = Predictor::from_toml(&config_toml, &project_root)
+        .with_context(|| format!("Failed to create predictor: {:?}", config_toml))?;
 
     tracing::info!("Model loaded successfully");
-    tracing::info!("Using infer_fn: {:?}", args.infer_fn);
+    tracing::info!("Using infer_fn: {:?}", predictor.args().infer_fn);
 
     // Read images from small-batch directory
     let image_paths = collect_images_from_dir(&image_dir)?;
@@ -35,7 +28,7 @@ fn main() -> Result<()> {
         let image = image::open(path)?;
         let source = yolo_inference::Source::Image(image);
 
-        let results = run_online_prediction(&mut model, &source, &args)?;
+        let results = predictor.predict(source)?;
 
         if let Some(ref res) = results {
             tracing::info!("Image {}: processed {} results", idx, res.len());
@@ -8,15 +8,17 @@ mod obb;
 mod pose;
 
 use classification::draw_classification;
-use detection::draw_detection;
+use detection::{draw_boxes_and_labels, draw_detection};
 use font::{is_ascii, load_font};
 use obb::draw_obb;
 use pose::draw_pose;
 use serde::Deserialize;
 
 // -- external imports
+use crate::buffer_pool::frame_pool;
 use crate::error::Result;
-use ab_glyph::FontRef;
+use crate::infer_fn::Prediction;
+use crate::masks::RleMasks;
 use image::{DynamicImage, GenericImageView, RgbImage};
 use ultralytics_inference as ul;
 
@@ -56,24 +58,105 @@ pub fn annotate_image(
     result: &ul::Results,
     configs: &AnnotateConfigs,
 ) -> Result<DynamicImage> {
-    let on_blank = configs.on_blank;
-    let show_box = configs.show_box;
-    let show_label = configs.show_label && show_box;
-    let top_k = configs.top_k;
+    annotate(img, result, None, configs)
+}
 
-    let have_obb = result.obb.is_some();
-    let have_probs = result.probs.is_some();
+/// Annotate the prediction of a pipeline stage, drawing compacted masks if it has them
+pub fn annotate_prediction(
+    img: &DynamicImage,
+    prediction: &Prediction,
+    configs: &AnnotateConfigs,
+) -> Result<DynamicImage> {
+    annotate(img, &prediction.result, prediction.masks.as_ref(), configs)
+}
 
-    // Prepare result image
-    let mut annotated = if on_blank {
+/// Annotate the prediction of a pipeline stage on its own frame, which is consumed.
+///
+/// RGB frames are drawn on in place, without a copy; other frames are converted into a pooled
+/// buffer as with [`annotate_prediction`] and given back to the pool.
+pub fn annotate_frame(
+    img: DynamicImage,
+    prediction: &Prediction,
+    configs: &AnnotateConfigs,
+) -> Result<DynamicImage> {
+    match img {
+        DynamicImage::ImageRgb8(mut frame) if !configs.on_blank => {
+            draw(
+                &mut frame,
+                &prediction.result,
+                prediction.masks.as_ref(),
+                configs,
+            );
+            Ok(DynamicImage::ImageRgb8(frame))
+        }
+        img => {
+            let annotated = annotate(&img, &prediction.result, prediction.masks.as_ref(), configs);
+            frame_pool().recycle(img);
+            annotated
+        }
+    }
+}
+
+/// Annotate `result` on a copy of `img`; `masks` replace its dense masks when set
+fn annotate(
+    img: &DynamicImage,
+    result: &ul::Results,
+    masks: Option<&RleMasks>,
+    configs: &AnnotateConfigs,
+) -> Result<DynamicImage> {
+    // Prepare result image (in a recycled frame buffer)
+    let mut annotated = if configs.on_blank {
         let (w, h) = img.dimensions();
-        RgbImage::new(w, h)
+        frame_pool().blank_rgb8(w, h)
     } else {
-        img.to_rgb8()
+        frame_pool().to_rgb8(img)
     };
+    draw(&mut annotated, result, masks, configs);
+    Ok(DynamicImage::ImageRgb8(annotated))
+}
+
+/// Overlay of a result, set by the task of the model that produced it
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum Overlay {
+    Classify,
+    Obb,
+    Pose,
+    Segment,
+    Detect,
+    Nothing,
+}
+
+impl Overlay {
+    fn of(result: &ul::Results, masks: Option<&RleMasks>) -> Self {
+        if result.probs.is_some() {
+            Self::Classify
+        } else if result.obb.is_some() {
+            Self::Obb
+        } else if result.keypoints.is_some() {
+            Self::Pose
+        } else if masks.is_some() || result.masks.is_some() {
+            Self::Segment
+        } else if result.boxes.is_some() {
+            Self::Detect
+        } else {
+            Self::Nothing
+        }
+    }
+}
 
-    // Prepare font if needed
-    let font_data = if show_label || have_obb || have_probs {
+/// Draw the overlay of `result` on `img`
+fn draw(
+    img: &mut RgbImage,
+    result: &ul::Results,
+    masks: Option<&RleMasks>,
+    configs: &AnnotateConfigs,
+) {
+    let show_box = configs.show_box;
+    let show_label = configs.show_label && show_box;
+    let overlay = Overlay::of(result, masks);
+
+    // Prepare font if needed (cached process-wide)
+    let font = if show_label || matches!(overlay, Overlay::Obb | Overlay::Classify) {
         let mut use_unicode_font = false;
         if result.boxes.is_some() {
             for name in result.names.values() {
@@ -89,22 +172,21 @@ pub fn annotate_image(
             "Arial.ttf"
         };
 
-        let font_data = load_font(font_name);
-        font_data
+        load_font(font_name)
     } else {
         None
     };
 
-    let font = match font_data {
-        Some(ref data) => FontRef::try_from_slice(data).ok(),
-        None => None,
-    };
-
-    // Draw annotations
-    draw_detection(&mut annotated, result, configs, font.as_ref());
-    draw_pose(&mut annotated, result, None, None, None);
-    draw_obb(&mut annotated, result, configs, font.as_ref());
-    draw_classification(&mut annotated, result, font.as_ref(), top_k.unwrap_or(5));
-
-    Ok(DynamicImage::ImageRgb8(annotated))
+    // Draw annotations; box-only detections skip every other drawer
+    match overlay {
+        Overlay::Detect => draw_boxes_and_labels(img, result, configs, font),
+        Overlay::Segment => draw_detection(img, result, masks, configs, font),
+        Overlay::Pose => {
+            draw_detection(img, result, masks, configs, font);
+            draw_pose(img, result, None, None, None);
+        }
+        Overlay::Obb => draw_obb(img, result, configs, font),
+        Overlay::Classify => draw_classification(img, result, font, configs.top_k.unwrap_or(5)),
+        Overlay::Nothing => {}
+    }
 }
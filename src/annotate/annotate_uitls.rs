@@ -84,6 +84,126 @@ pub fn draw_filled_circle(img: &mut RgbImage, cx: i32, cy: i32, radius: i32, col
     }
 }
 
+/// Convert an alpha value in `[0, 1]` to 8-bit fixed point (`256` = opaque)
+pub fn alpha_to_fixed(alpha: f32) -> u16 {
+    (alpha.max(0.0).min(1.0) * 256.0).round() as u16
+}
+
+/// Fixed-point alpha blend of a single channel: `(src * a + dst * (256 - a) + 128) >> 8`
+#[inline(always)]
+fn blend_u8(dst: u8, src: u16, alpha: u16) -> u8 {
+    ((src * alpha + u16::from(dst) * (256 - alpha) + 128) >> 8) as u8
+}
+
+/// Blend a solid color into a contiguous row of RGB pixels
+pub fn blend_row_solid(row: &mut [u8], color: Rgb<u8>, alpha: u16) {
+    let [r, g, b] = color.0.map(u16::from);
+    for px in row.chunks_exact_mut(3) {
+        px[0] = blend_u8(px[0], r, alpha);
+        px[1] = blend_u8(px[1], g, alpha);
+        px[2] = blend_u8(px[2], b, alpha);
+    }
+}
+
+/// Blend a contiguous row of RGB pixels with per-pixel colors.
+///
+/// `labels[j]` selects the `[r, g, b, alpha]` entry of `lut` used for pixel `j`; entries with
+/// alpha `0` (such as the background label `0`) leave the pixel unchanged. The loop is
+/// branch-free so it can be auto-vectorized.
+pub fn blend_row_labeled(row: &mut [u8], labels: &[u16], lut: &[[u16; 4]]) {
+    for (px, &label) in row.chunks_exact_mut(3).zip(labels) {
+        let [r, g, b, a] = lut[label as usize];
+        px[0] = blend_u8(px[0], r, a);
+        px[1] = blend_u8(px[1], g, a);
+        px[2] = blend_u8(px[2], b, a);
+    }
+}
+
+/// Blend a solid color into a contiguous row of RGB pixels with per-pixel 8-bit coverage
+/// (e.g. a row of a rasterized glyph)
+pub fn blend_row_coverage(row: &mut [u8], coverage: &[u8], color: Rgb<u8>) {
+    let [r, g, b] = color.0.map(u16::from);
+    for (px, &c) in row.chunks_exact_mut(3).zip(coverage) {
+        // map 0..=255 to 0..=256 so full coverage is opaque
+        let alpha = u16::from(c) + u16::from(c >> 7);
+        px[0] = blend_u8(px[0], r, alpha);
+        px[1] = blend_u8(px[1], g, alpha);
+        px[2] = blend_u8(px[2], b, alpha);
+    }
+}
+
+/// Clip the `[x1, x2) x [y1, y2)` rectangle to a `width x height` image
+fn clip_rect(
+    width: u32,
+    height: u32,
+    x1: i32,
+    y1: i32,
+    x2: i32,
+    y2: i32,
+) -> (usize, usize, usize, usize) {
+    let clip_x = |x: i32| x.max(0).min(width as i32) as usize;
+    let clip_y = |y: i32| y.max(0).min(height as i32) as usize;
+    (clip_x(x1), clip_y(y1), clip_x(x2), clip_y(y2))
+}
+
+/// Fill the `[x1, x2) x [y1, y2)` rectangle with a solid color, one row span at a time
+pub fn fill_rect(img: &mut RgbImage, x1: i32, y1: i32, x2: i32, y2: i32, color: Rgb<u8>) {
+    let (width, height) = img.dimensions();
+    let (x1, y1, x2, y2) = clip_rect(width, height, x1, y1, x2, y2);
+    if x2 <= x1 || y2 <= y1 {
+        return;
+    }
+
+    let stride = width as usize * 3;
+    for row in img.chunks_exact_mut(stride).take(y2).skip(y1) {
+        fill_row(&mut row[x1 * 3..x2 * 3], color);
+    }
+}
+
+/// Fill the background of a label, same as `imageproc`'s `draw_filled_rect_mut`
+pub fn fill_label_rect(img: &mut RgbImage, rect: Rect, color: Rgb<u8>) {
+    fill_rect(
+        img,
+        rect.left(),
+        rect.top(),
+        rect.right() + 1,
+        rect.bottom() + 1,
+        color,
+    );
+}
+
+/// Draw the outline of the `[x1, x2) x [y1, y2)` rectangle, `thickness` pixels wide inwards.
+///
+/// Same pixels as nested `imageproc` hollow rectangles, but written as row spans: the top and
+/// bottom bands are filled across, the rows between only get their left and right bands.
+pub fn draw_box_outline(
+    img: &mut RgbImage,
+    x1: i32,
+    y1: i32,
+    x2: i32,
+    y2: i32,
+    thickness: i32,
+    color: Rgb<u8>,
+) {
+    if x2 <= x1 || y2 <= y1 || thickness <= 0 {
+        return;
+    }
+    let t = thickness;
+    fill_rect(img, x1, y1, x2, (y1 + t).min(y2), color);
+    fill_rect(img, x1, (y2 - t).max(y1 + t), x2, y2, color);
+    if y2 - y1 > 2 * t {
+        fill_rect(img, x1, y1 + t, (x1 + t).min(x2), y2 - t, color);
+        fill_rect(img, (x2 - t).max(x1 + t), y1 + t, x2, y2 - t, color);
+    }
+}
+
+/// Fill a contiguous row of RGB pixels with a solid color
+fn fill_row(row: &mut [u8], color: Rgb<u8>) {
+    for px in row.chunks_exact_mut(3) {
+        px.copy_from_slice(&color.0);
+    }
+}
+
 /// Draw a transparent rectangle on an image
 pub fn draw_transparent_rect(
     img: &mut RgbImage,
@@ -95,33 +215,51 @@ pub fn draw_transparent_rect(
     alpha: f32,
 ) {
     let (width, height) = img.dimensions();
-    let alpha = alpha.max(0.0).min(1.0);
-    let inv_alpha = 1.0 - alpha;
+    let alpha = alpha_to_fixed(alpha);
 
-    let r = f32::from(color[0]);
-    let g = f32::from(color[1]);
-    let b = f32::from(color[2]);
+    // clip rectangle to image
+    let (x1, y1, x2, y2) = clip_rect(width, height, x, y, x + w as i32, y + h as i32);
+    if x2 <= x1 || y2 <= y1 {
+        return;
+    }
 
-    for dy in 0..h {
-        let py = y + dy as i32;
-        if py < 0 || py >= height as i32 {
-            continue;
-        }
+    let stride = width as usize * 3;
+    for row in img.chunks_exact_mut(stride).take(y2).skip(y1) {
+        blend_row_solid(&mut row[x1 * 3..x2 * 3], color, alpha);
+    }
+}
 
-        for dx in 0..w {
-            let px = x + dx as i32;
-            if px < 0 || px >= width as i32 {
-                continue;
-            }
+#[cfg(test)]
+mod tests {
+    use super::*;
 
-            let pixel = img.get_pixel_mut(px as u32, py as u32);
-            let current = pixel.0;
+    #[test]
+    fn test_blend_row_labeled() {
+        let mut row = vec![100u8, 100, 100, 100, 100, 100];
+        let lut = [[0, 0, 0, 0], [255, 0, 0, alpha_to_fixed(0.5)]];
+        blend_row_labeled(&mut row, &[0, 1], &lut);
 
-            let new_r = f32::from(current[0]).mul_add(inv_alpha, r * alpha) as u8;
-            let new_g = f32::from(current[1]).mul_add(inv_alpha, g * alpha) as u8;
-            let new_b = f32::from(current[2]).mul_add(inv_alpha, b * alpha) as u8;
+        // background pixel untouched, labeled pixel blended half-way
+        assert_eq!(&row[..3], &[100, 100, 100]);
+        assert_eq!(&row[3..], &[178, 50, 50]);
+    }
 
-            *pixel = Rgb([new_r, new_g, new_b]);
-        }
+    #[test]
+    fn test_draw_box_outline() {
+        let color = Rgb([255, 0, 0]);
+        let mut img = RgbImage::new(8, 8);
+        draw_box_outline(&mut img, 1, 1, 7, 7, 2, color);
+
+        let drawn = |x: u32, y: u32| img.get_pixel(x, y) == &color;
+        // 2 px bands inside [1, 7), hollow center, nothing outside
+        assert!(drawn(1, 1) && drawn(6, 6) && drawn(2, 4) && drawn(5, 3));
+        assert!(!drawn(3, 3) && !drawn(4, 4));
+        assert!(!drawn(0, 0) && !drawn(7, 7) && !drawn(7, 3));
+        assert_eq!(img.pixels().filter(|&p| p == &color).count(), 36 - 4);
+
+        // bands partly outside the image are clipped
+        let mut img = RgbImage::new(8, 8);
+        draw_box_outline(&mut img, -1, -1, 3, 3, 2, color);
+        assert_eq!(img.pixels().filter(|&p| p == &color).count(), 9);
     }
 }
@@ -1,15 +1,15 @@
 use ab_glyph::{FontRef, PxScale};
 use image::{Rgb, RgbImage};
-use imageproc::drawing::draw_text_mut;
 use ultralytics_inference as ul;
 
 use super::annotate_uitls::draw_transparent_rect;
+use super::font::draw_label_text;
 
 /// Draw classification results
 pub fn draw_classification(
     img: &mut RgbImage,
     result: &ul::Results,
-    font: Option<&FontRef>,
+    font: Option<&'static FontRef<'static>>,
     top_k: usize,
 ) {
     let probs = match &result.probs {
@@ -76,7 +76,7 @@ pub fn draw_classification(
 
     for label in entries {
         // Draw text (white)
-        draw_text_mut(img, Rgb([255, 255, 255]), x_pos, y_pos, scale, font, &label);
+        draw_label_text(img, Rgb([255, 255, 255]), x_pos, y_pos, scale, font, &label);
 
         y_pos += line_height;
     }
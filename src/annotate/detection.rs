@@ -1,99 +1,176 @@
 use ab_glyph::{Font, FontRef, PxScale, ScaleFont};
 use image::RgbImage;
-use imageproc::drawing::{draw_filled_rect_mut, draw_hollow_rect_mut, draw_text_mut};
 use imageproc::rect::Rect;
+use std::cell::Cell;
 use ultralytics_inference as ul;
 
+use crate::masks::{MASK_THRESHOLD, RleMasks};
+
 use super::AnnotateConfigs;
-use super::annotate_uitls::rect_intersect;
+use super::annotate_uitls::{alpha_to_fixed, blend_row_labeled, draw_box_outline, fill_label_rect,
+                            rect_intersect};
 use super::color::{get_class_color, get_text_color};
+use super::font::draw_label_text;
 
-/// Draw object detection results (boxes and masks)
+/// Draw object detection results (boxes and masks); `masks` replace the dense masks of `result`
 pub fn draw_detection(
     img: &mut RgbImage,
     result: &ul::Results,
+    masks: Option<&RleMasks>,
     configs: &AnnotateConfigs,
-    font: Option<&FontRef>,
+    font: Option<&'static FontRef<'static>>,
 ) {
-    draw_masks(img, result);
+    draw_masks(img, result, masks);
     draw_boxes_and_labels(img, result, configs, font);
 }
 
-fn draw_masks(img: &mut RgbImage, result: &ul::Results) {
-    // Get boxes
-    let boxes = match result.boxes.as_ref() {
-        Some(b) => b,
-        None => return, // No boxes to draw masks for
+/// Mask overlay opacity
+const MASK_ALPHA: f32 = 0.3;
+
+thread_local! {
+    /// Label and row span buffers of `draw_masks`, reused across the frames of a thread
+    static MASK_SCRATCH: Cell<(Vec<u16>, Vec<(usize, usize)>)> = const {
+        Cell::new((Vec::new(), Vec::new()))
+    };
+}
+
+/// Instance masks to draw
+#[derive(Clone, Copy)]
+enum MaskSource<'a> {
+    /// Dense `[n, h, w]` probabilities in standard layout
+    Dense(&'a [f32]),
+    Rle(&'a RleMasks),
+}
+
+fn draw_masks(img: &mut RgbImage, result: &ul::Results, rle: Option<&RleMasks>) {
+    // Get boxes and masks
+    let Some(boxes) = result.boxes.as_ref() else {
+        return; // No masks to draw
+    };
+    let dense = match (rle, result.masks.as_ref()) {
+        (Some(_), _) => None,
+        (None, Some(masks)) => Some(masks.data.as_standard_layout()),
+        (None, None) => return,
+    };
+    let (source, (mask_n, mask_h, mask_w)) = match (rle, &dense) {
+        (Some(rle), _) => (MaskSource::Rle(rle), (rle.len(), rle.height(), rle.width())),
+        (None, Some(data)) => (
+            MaskSource::Dense(
+                data.as_slice()
+                    .expect("Standard layout array is contiguous"),
+            ),
+            data.dim(),
+        ),
+        (None, None) => return,
     };
 
     let (width, height) = img.dimensions();
     let xyxy = boxes.xyxy();
     let cls = boxes.cls();
 
-    // Create an overlay image for masks to handle overlaps correctly
-    let mut overlay = img.clone();
-    let mut mask_present = false;
-
-    // Draw masks onto the overlay
-    if let Some(masks) = result.masks.as_ref() {
-        let (mask_n, _mask_h, _mask_w) = masks.data.dim();
+    // only touch pixels covered by both the image and the masks
+    let area_w = (width as usize).min(mask_w);
+    let area_h = (height as usize).min(mask_h);
+    let num_masks = boxes.len().min(mask_n).min(u16::MAX as usize);
+
+    // Clip mask bounding boxes and compute their union
+    let mut rects = Vec::with_capacity(num_masks);
+    let (mut ux1, mut uy1, mut ux2, mut uy2) = (area_w, area_h, 0, 0);
+    for i in 0..num_masks {
+        let x1 = xyxy[[i, 0]].max(0.0).min(area_w as f32) as usize;
+        let y1 = xyxy[[i, 1]].max(0.0).min(area_h as f32) as usize;
+        let x2 = xyxy[[i, 2]].max(0.0).min(area_w as f32) as usize;
+        let y2 = xyxy[[i, 3]].max(0.0).min(area_h as f32) as usize;
+        if x2 <= x1 || y2 <= y1 {
+            continue;
+        }
+        ux1 = ux1.min(x1);
+        uy1 = uy1.min(y1);
+        ux2 = ux2.max(x2);
+        uy2 = uy2.max(y2);
+        rects.push((i, x1, y1, x2, y2));
+    }
+    if rects.is_empty() {
+        return;
+    }
 
-        for i in 0..boxes.len() {
-            if i >= mask_n {
-                break;
+    // Label buffer over the union of boxes: 0 = background, i + 1 = mask i.
+    // Later masks overwrite earlier ones, as with a single overlay.
+    let union_w = ux2 - ux1;
+    let (mut labels, mut row_spans) = MASK_SCRATCH.take();
+    labels.clear();
+    labels.resize(union_w * (uy2 - uy1), 0);
+    // Per-row horizontal span covered by any box, relative to the union
+    row_spans.clear();
+    row_spans.resize(uy2 - uy1, (union_w, 0));
+
+    for &(i, x1, y1, x2, y2) in &rects {
+        let label = (i + 1) as u16;
+        match source {
+            MaskSource::Dense(mask_data) => {
+                for y in y1..y2 {
+                    let mask_row = &mask_data[(i * mask_h + y) * mask_w..][x1..x2];
+                    let label_row = &mut labels[(y - uy1) * union_w..][x1 - ux1..x2 - ux1];
+                    for (l, &m) in label_row.iter_mut().zip(mask_row) {
+                        *l = if m > MASK_THRESHOLD { label } else { *l };
+                    }
+                }
             }
-
-            let class_id = cls[i] as usize;
-            let color = get_class_color(class_id);
-            let (r, g, b) = (color.0[0], color.0[1], color.0[2]);
-
-            mask_present = true;
-
-            let x1 = xyxy[[i, 0]].max(0.0).min(width as f32) as u32;
-            let y1 = xyxy[[i, 1]].max(0.0).min(height as f32) as u32;
-            let x2 = xyxy[[i, 2]].max(0.0).min(width as f32) as u32;
-            let y2 = xyxy[[i, 3]].max(0.0).min(height as f32) as u32;
-
-            for y in y1..y2 {
-                for x in x1..x2 {
-                    if masks.data[[i, y as usize, x as usize]] > 0.5 {
-                        let pixel = overlay.get_pixel_mut(x, y);
-                        pixel.0[0] = r;
-                        pixel.0[1] = g;
-                        pixel.0[2] = b;
+            MaskSource::Rle(rle) => {
+                // split foreground runs into rows, clipped to the box
+                for (mut offset, mut len) in rle.foreground(i) {
+                    while len > 0 {
+                        let (y, x) = (offset / mask_w, offset % mask_w);
+                        if y >= y2 {
+                            break;
+                        }
+                        let n = len.min(mask_w - x);
+                        let (start, end) = (x.max(x1), (x + n).min(x2));
+                        if y >= y1 && start < end {
+                            let row = (y - uy1) * union_w;
+                            labels[row + start - ux1..row + end - ux1].fill(label);
+                        }
+                        offset += n;
+                        len -= n;
                     }
                 }
             }
         }
+
+        for span in &mut row_spans[y1 - uy1..y2 - uy1] {
+            span.0 = span.0.min(x1 - ux1);
+            span.1 = span.1.max(x2 - ux1);
+        }
     }
 
-    // Blend overlay with original image
-    if mask_present {
-        let alpha = 0.3;
-        for y in 0..height {
-            for x in 0..width {
-                let p_img = img.get_pixel_mut(x, y);
-                let p_overlay = overlay.get_pixel(x, y);
-
-                p_img.0[0] = f32::from(p_overlay.0[0])
-                    .mul_add(alpha, f32::from(p_img.0[0]) * (1.0 - alpha))
-                    as u8;
-                p_img.0[1] = f32::from(p_overlay.0[1])
-                    .mul_add(alpha, f32::from(p_img.0[1]) * (1.0 - alpha))
-                    as u8;
-                p_img.0[2] = f32::from(p_overlay.0[2])
-                    .mul_add(alpha, f32::from(p_img.0[2]) * (1.0 - alpha))
-                    as u8;
-            }
+    // Color lookup table indexed by label: [r, g, b, alpha]
+    let alpha = alpha_to_fixed(MASK_ALPHA);
+    let mut lut = vec![[0u16; 4]; num_masks + 1];
+    for i in 0..num_masks {
+        let [r, g, b] = get_class_color(cls[i] as usize).0.map(u16::from);
+        lut[i + 1] = [r, g, b, alpha];
+    }
+
+    // Blend labeled pixels row by row
+    let stride = width as usize * 3;
+    for (row_idx, row) in img.chunks_exact_mut(stride).enumerate().take(uy2).skip(uy1) {
+        let (start, end) = row_spans[row_idx - uy1];
+        if end <= start {
+            continue;
         }
+        let label_row = &labels[(row_idx - uy1) * union_w..][start..end];
+        let row = &mut row[(ux1 + start) * 3..(ux1 + end) * 3];
+        blend_row_labeled(row, label_row, &lut);
     }
+    MASK_SCRATCH.set((labels, row_spans));
 }
 
-fn draw_boxes_and_labels(
+/// Draw boxes and their labels only
+pub fn draw_boxes_and_labels(
     img: &mut RgbImage,
     result: &ul::Results,
     configs: &AnnotateConfigs,
-    font: Option<&FontRef>,
+    font: Option<&'static FontRef<'static>>,
 ) {
     let show_box = configs.show_box;
     let show_label = configs.show_label && show_box;
@@ -156,16 +233,7 @@ fn draw_boxes_and_labels(
         let color = get_class_color(class_id);
 
         // Draw box
-        for t in 0..thickness {
-            let tx1 = (x1 + t).min(x2);
-            let ty1 = (y1 + t).min(y2);
-            let tx2 = (x2 - t).max(tx1);
-            let ty2 = (y2 - t).max(ty1);
-            if tx2 > tx1 && ty2 > ty1 {
-                let rect = Rect::at(tx1, ty1).of_size((tx2 - tx1) as u32, (ty2 - ty1) as u32);
-                draw_hollow_rect_mut(img, rect, color);
-            }
-        }
+        draw_box_outline(img, x1, y1, x2, y2, thickness, color);
 
         // Draw label and confidence
         if !show_label {
@@ -265,9 +333,9 @@ fn draw_boxes_and_labels(
                 && text_x + text_w < width as i32
                 && text_y + text_h < height as i32
             {
-                draw_filled_rect_mut(img, current_rect, color);
+                fill_label_rect(img, current_rect, color);
                 let text_color = get_text_color(color);
-                draw_text_mut(img, text_color, text_x, text_y, scale, f, &label);
+                draw_label_text(img, text_color, text_x, text_y, scale, f, &label);
             }
         }
     }
@@ -1,13 +1,22 @@
+use ab_glyph::{Font, FontRef, GlyphId, PxScale, ScaleFont, point};
+use image::{Rgb, RgbImage};
+use std::cell::RefCell;
+use std::collections::HashMap;
 use std::fs::File;
 use std::io::Read;
+use std::rc::Rc;
+use std::sync::{Mutex, OnceLock};
 use ultralytics_inference as ul;
 
+use super::annotate_uitls::blend_row_coverage;
+
 /// Helper to check if a string contains non-ASCII characters
 pub const fn is_ascii(s: &str) -> bool {
     s.is_ascii()
 }
 
-pub fn load_font(font_name: &str) -> Option<Vec<u8>> {
+/// Read font file data, downloading the font first if needed
+fn read_font_file(font_name: &str) -> Option<Vec<u8>> {
     let font_path = ul::annotate::check_font(font_name);
     let font_data = font_path.and_then(|path| {
         let mut file = File::open(path).ok()?;
@@ -17,3 +26,173 @@ pub fn load_font(font_name: &str) -> Option<Vec<u8>> {
     });
     font_data
 }
+
+/// Process-wide cache of loaded fonts, keyed by font name
+static FONTS: OnceLock<Mutex<HashMap<String, &'static FontRef<'static>>>> = OnceLock::new();
+
+/// Load a font by name.
+///
+/// Fonts are read and parsed once per process and live until it exits, so repeated calls (one
+/// per annotated frame) are a hash lookup. The file is read without holding the cache lock, and
+/// failed loads are not cached, so a font that shows up later (e.g. after a download) is used.
+pub fn load_font(font_name: &str) -> Option<&'static FontRef<'static>> {
+    let fonts = FONTS.get_or_init(Default::default);
+    if let Some(&font) = fonts
+        .lock()
+        .expect("Font cache lock poisoned")
+        .get(font_name)
+    {
+        return Some(font);
+    }
+
+    let data = read_font_file(font_name)?;
+    if let Err(e) = FontRef::try_from_slice(&data) {
+        tracing::error!("Failed to parse font {}: {}", font_name, e);
+        return None;
+    }
+
+    // another thread may have loaded the font meanwhile; only the first copy is kept
+    let mut fonts = fonts.lock().expect("Font cache lock poisoned");
+    let font = fonts.entry(font_name.to_string()).or_insert_with(|| {
+        let data: &'static [u8] = data.leak();
+        let font = FontRef::try_from_slice(data).expect("Font parsed above");
+        &*Box::leak(Box::new(font))
+    });
+    Some(*font)
+}
+
+/// Pre-rasterized glyph coverage bitmap
+#[derive(Debug)]
+struct GlyphBitmap {
+    glyph_id: GlyphId,
+    /// Horizontal advance in pixels
+    h_advance: f32,
+    /// Offset of the bitmap from the pen position (x) and text top (y)
+    left: i32,
+    top: i32,
+    width: usize,
+    height: usize,
+    /// Row-major coverage, `0..=255`
+    coverage: Vec<u8>,
+}
+
+/// (font address, char, scale x bits, scale y bits)
+type GlyphKey = (usize, char, u32, u32);
+
+/// Glyphs cached per thread; a full cache is cleared, e.g. by labels in scripts with many
+/// distinct characters
+const GLYPH_CACHE_CAPACITY: usize = 4096;
+
+thread_local! {
+    /// Glyph cache of each annotation thread, so label drawing takes no lock
+    static GLYPHS: RefCell<HashMap<GlyphKey, Rc<GlyphBitmap>>> = RefCell::new(HashMap::new());
+}
+
+fn rasterize_glyph(font: &FontRef<'static>, c: char, scale: PxScale) -> GlyphBitmap {
+    let scaled_font = font.as_scaled(scale);
+    let glyph_id = scaled_font.glyph_id(c);
+    let h_advance = scaled_font.h_advance(glyph_id);
+    let glyph = glyph_id.with_scale_and_position(scale, point(0.0, scaled_font.ascent()));
+
+    let Some(outlined) = font.outline_glyph(glyph) else {
+        // e.g. whitespace
+        return GlyphBitmap {
+            glyph_id,
+            h_advance,
+            left: 0,
+            top: 0,
+            width: 0,
+            height: 0,
+            coverage: Vec::new(),
+        };
+    };
+
+    let bounds = outlined.px_bounds();
+    let width = bounds.width() as usize;
+    let height = bounds.height() as usize;
+    let mut coverage = vec![0u8; width * height];
+    outlined.draw(|x, y, v| {
+        let (x, y) = (x as usize, y as usize);
+        if x < width && y < height {
+            coverage[y * width + x] = (v.clamp(0.0, 1.0) * 255.0).round() as u8;
+        }
+    });
+
+    GlyphBitmap {
+        glyph_id,
+        h_advance,
+        left: bounds.min.x.round() as i32,
+        top: bounds.min.y.round() as i32,
+        width,
+        height,
+        coverage,
+    }
+}
+
+/// Draw label text with top-left corner at (`x`, `y`), blitting cached glyph bitmaps.
+///
+/// Drop-in replacement for `imageproc::drawing::draw_text_mut`; glyphs are rasterized once per
+/// (font, char, scale) and thread, and reused for every later label.
+pub fn draw_label_text(
+    img: &mut RgbImage,
+    color: Rgb<u8>,
+    x: i32,
+    y: i32,
+    scale: PxScale,
+    font: &'static FontRef<'static>,
+    text: &str,
+) {
+    let font_key = std::ptr::from_ref(font) as usize;
+    let glyphs: Vec<Rc<GlyphBitmap>> = GLYPHS.with_borrow_mut(|cache| {
+        if cache.len() + text.len() > GLYPH_CACHE_CAPACITY {
+            cache.clear();
+        }
+        text.chars()
+            .map(|c| {
+                let key = (font_key, c, scale.x.to_bits(), scale.y.to_bits());
+                cache
+                    .entry(key)
+                    .or_insert_with(|| Rc::new(rasterize_glyph(font, c, scale)))
+                    .clone()
+            })
+            .collect()
+    });
+
+    let (img_w, img_h) = (img.width() as i32, img.height() as i32);
+    let stride = img_w as usize * 3;
+    let scaled_font = font.as_scaled(scale);
+
+    let mut pen_x = 0.0f32;
+    let mut prev: Option<GlyphId> = None;
+    for glyph in &glyphs {
+        if let Some(prev) = prev {
+            pen_x += scaled_font.kern(prev, glyph.glyph_id);
+        }
+        let gx = x + pen_x.round() as i32 + glyph.left;
+        let gy = y + glyph.top;
+        pen_x += glyph.h_advance;
+        prev = Some(glyph.glyph_id);
+
+        // clip the glyph bitmap against the image
+        let col_start = (-gx).max(0) as usize;
+        let col_end = (img_w - gx).clamp(0, glyph.width as i32) as usize;
+        if col_end <= col_start {
+            continue;
+        }
+
+        for row in 0..glyph.height {
+            let py = gy + row as i32;
+            if py < 0 || py >= img_h {
+                continue;
+            }
+            let coverage = &glyph.coverage[row * glyph.width..][col_start..col_end];
+            let px = (gx + col_start as i32) as usize;
+            let offset = py as usize * stride + px * 3;
+            blend_row_coverage(
+                &mut img[offset..offset + coverage.len() * 3],
+                coverage,
+                color,
+            );
+        }
+    }
+}
@@ -1,19 +1,19 @@
 use ab_glyph::{Font, FontRef, PxScale, ScaleFont};
 use image::RgbImage;
-use imageproc::drawing::{draw_filled_rect_mut, draw_text_mut};
 use imageproc::rect::Rect;
 use ultralytics_inference as ul;
 
 use super::AnnotateConfigs;
-use super::annotate_uitls::{draw_line_segment, rect_intersect};
+use super::annotate_uitls::{draw_line_segment, fill_label_rect, rect_intersect};
 use super::color::{get_class_color, get_text_color};
+use super::font::draw_label_text;
 
 /// Draw oriented bounding boxes (OBB)
 pub fn draw_obb(
     img: &mut RgbImage,
     result: &ul::Results,
     configs: &AnnotateConfigs,
-    font: Option<&FontRef>,
+    font: Option<&'static FontRef<'static>>,
 ) {
     let show_conf = configs.show_conf;
 
@@ -134,9 +134,9 @@ pub fn draw_obb(
                 && text_x + text_w < width as i32
                 && text_y + text_h < height as i32
             {
-                draw_filled_rect_mut(img, current_rect, color);
+                fill_label_rect(img, current_rect, color);
                 let text_color = get_text_color(color);
-                draw_text_mut(img, text_color, text_x, text_y, scale, f, &label);
+                draw_label_text(img, text_color, text_x, text_y, scale, f, &label);
             }
         }
     }
@@ -0,0 +1,497 @@
+// -- imports
+use serde::{Deserialize, Serialize};
+use std::fmt::Write as _;
+use std::path::{Path, PathBuf};
+use std::str::FromStr;
+use std::time::{Duration, Instant};
+use strum::VariantNames;
+
+use crate::error::{AppError, Result};
+use crate::infer_fn::{InferFn, InferResult, auto_infer};
+use crate::predict::{PredictArgs, load_models};
+use crate::source::FrameTimings;
+use crate::stats::PipelineStats;
+use crate::thread_budget::ThreadBudget;
+use crate::toml_utils::parse_toml;
+
+// -- config
+
+/// Benchmark sweep configuration (`[bench]` table of a TOML config).
+///
+/// Every combination of `infer_fns` × `batches` × `channel_capacities` × `devices` is run over
+/// the `[predict]` source; an empty list means the value from `[predict]`.
+#[derive(Debug, Clone, Deserialize)]
+#[serde(default)]
+pub struct BenchConfig {
+    /// Inference functions to compare
+    #[serde(deserialize_with = "deserialize_infer_fns")]
+    pub infer_fns: Vec<InferFn>,
+
+    /// Batch sizes to compare
+    pub batches: Vec<usize>,
+
+    /// Channel capacities to compare
+    pub channel_capacities: Vec<usize>,
+
+    /// Devices to compare (each entry may itself be a comma-separated device list)
+    pub devices: Vec<String>,
+
+    /// Untimed runs before measuring each combination
+    pub warmup: usize,
+
+    /// Timed runs per combination
+    pub iters: usize,
+
+    /// Report file; `.csv` writes CSV, anything else JSON
+    pub output: Option<PathBuf>,
+}
+
+impl Default for BenchConfig {
+    fn default() -> Self {
+        Self {
+            infer_fns: Vec::new(),
+            batches: Vec::new(),
+            channel_capacities: Vec::new(),
+            devices: Vec::new(),
+            warmup: 1,
+            iters: 3,
+            output: None,
+        }
+    }
+}
+
+/// Custom deserializer for a list of inference functions
+fn deserialize_infer_fns<'de, D>(deserializer: D) -> Result<Vec<InferFn>, D::Error>
+where
+    D: serde::Deserializer<'de>,
+{
+    Vec::<String>::deserialize(deserializer)?
+        .iter()
+        .map(|value| {
+            InferFn::from_str(value).map_err(|_| {
+                serde::de::Error::invalid_value(
+                    serde::de::Unexpected::Str(value),
+                    &format!("one of {}", InferFn::VARIANTS.join(", ")).as_str(),
+                )
+            })
+        })
+        .collect()
+}
+
+#[derive(Debug, Deserialize, Default)]
+#[serde(default)]
+struct BenchToml {
+    bench: BenchConfig,
+}
+
+// -- report
+
+/// Benchmark result of a single sweep combination.
+///
+/// Stage times are per-frame means of the time between the previous stage finishing and this
+/// stage finishing, so they include time spent queued between stages.
+#[derive(Debug, Clone, Serialize)]
+pub struct BenchRecord {
+    pub infer_fn: String,
+    pub batch: usize,
+    pub channel_capacity: usize,
+    pub device: String,
+    /// Frames per timed run
+    pub frames: usize,
+    pub iters: usize,
+    /// Model loading time (all replicas)
+    pub model_load_secs: f64,
+    /// Mean wall time of a timed run
+    pub mean_run_secs: f64,
+    /// Frames per second over all timed runs
+    pub fps: f64,
+    /// Per-frame end-to-end latency percentiles
+    pub latency_p50_ms: f64,
+    pub latency_p95_ms: f64,
+    pub latency_p99_ms: f64,
+    /// Mean per-frame stage times
+    pub load_ms: f64,
+    pub infer_ms: f64,
+    pub annotate_ms: f64,
+    pub save_ms: f64,
+    pub collect_ms: f64,
+    /// Bottleneck stage of the last timed run, see [`PipelineStats::bottleneck`]
+    pub bottleneck: String,
+}
+
+/// Column names of the CSV report, in field order
+const CSV_HEADER: &str = "infer_fn,batch,channel_capacity,device,frames,iters,model_load_secs,\
+mean_run_secs,fps,latency_p50_ms,latency_p95_ms,latency_p99_ms,load_ms,infer_ms,annotate_ms,\
+save_ms,collect_ms,bottleneck";
+
+impl BenchRecord {
+    fn csv_row(&self) -> String {
+        format!(
+            "{},{},{},\"{}\",{},{},{:.6},{:.6},{:.3},{:.3},{:.3},{:.3},{:.3},{:.3},{:.3},{:.3},{:.3},{}",
+            self.infer_fn,
+            self.batch,
+            self.channel_capacity,
+            self.device,
+            self.frames,
+            self.iters,
+            self.model_load_secs,
+            self.mean_run_secs,
+            self.fps,
+            self.latency_p50_ms,
+            self.latency_p95_ms,
+            self.latency_p99_ms,
+            self.load_ms,
+            self.infer_ms,
+            self.annotate_ms,
+            self.save_ms,
+            self.collect_ms,
+            self.bottleneck,
+        )
+    }
+}
+
+/// Render records as CSV (with header)
+pub fn records_to_csv(records: &[BenchRecord]) -> String {
+    let mut csv = String::from(CSV_HEADER);
+    csv.push('\n');
+    for record in records {
+        let _ = writeln!(csv, "{}", record.csv_row());
+    }
+    csv
+}
+
+/// Render records as a pretty-printed JSON array
+pub fn records_to_json(records: &[BenchRecord]) -> String {
+    serde_json::to_string_pretty(records).expect("Benchmark records are serializable")
+}
+
+/// Write records to `path`, as CSV for `.csv` files and JSON otherwise
+pub fn write_report(records: &[BenchRecord], path: &Path) -> Result<()> {
+    let is_csv = path
+        .extension()
+        .is_some_and(|ext| ext.eq_ignore_ascii_case("csv"));
+    let content = if is_csv {
+        records_to_csv(records)
+    } else {
+        records_to_json(records)
+    };
+
+    if let Some(parent) = path.parent() {
+        std::fs::create_dir_all(parent)?;
+    }
+    std::fs::write(path, content)?;
+    Ok(())
+}
+
+// -- statistics
+
+/// Nearest-rank percentile of sorted `values` (`p` in `[0, 100]`)
+fn percentile(sorted: &[f64], p: f64) -> f64 {
+    if sorted.is_empty() {
+        return 0.0;
+    }
+    let rank = (p / 100.0 * sorted.len() as f64).ceil() as usize;
+    sorted[rank.clamp(1, sorted.len()) - 1]
+}
+
+/// Accumulates per-frame timings over the timed runs of one combination
+#[derive(Debug, Default)]
+struct FrameStats {
+    latencies_ms: Vec<f64>,
+    stage_sums_ms: [f64; 5],
+    stage_counts: [usize; 5],
+}
+
+impl FrameStats {
+    fn record(&mut self, timings: &FrameTimings) {
+        if let Some(latency) = timings.latency() {
+            self.latencies_ms.push(ms(latency));
+        }
+
+        let stamps = [
+            timings.started,
+            timings.loaded,
+            timings.inferred,
+            timings.annotated,
+            timings.saved,
+            timings.collected,
+        ];
+        for (stage, pair) in stamps.windows(2).enumerate() {
+            if let (Some(begin), Some(end)) = (pair[0], pair[1]) {
+                self.stage_sums_ms[stage] += ms(end.duration_since(begin));
+                self.stage_counts[stage] += 1;
+            }
+        }
+    }
+
+    fn stage_mean_ms(&self, stage: usize) -> f64 {
+        match self.stage_counts[stage] {
+            0 => 0.0,
+            n => self.stage_sums_ms[stage] / n as f64,
+        }
+    }
+}
+
+fn ms(duration: Duration) -> f64 {
+    duration.as_secs_f64() * 1e3
+}
+
+// -- public API
+
+/// Run the benchmark sweep described by `bench` over `base` prediction arguments.
+///
+/// Models are loaded once per (device, batch) pair and reused for all inference functions and
+/// channel capacities of that pair.
+pub fn run_benchmark(base: &PredictArgs, bench: &BenchConfig) -> Result<Vec<BenchRecord>> {
+    let iters = bench.iters.max(1);
+
+    let infer_fns = if bench.infer_fns.is_empty() {
+        vec![base.infer_fn.clone()]
+    } else {
+        bench.infer_fns.clone()
+    };
+    let batches = if bench.batches.is_empty() {
+        vec![base.batch.unwrap_or(1)]
+    } else {
+        bench.batches.clone()
+    };
+    let capacities = if bench.channel_capacities.is_empty() {
+        vec![base.channel_capacity.unwrap_or(8)]
+    } else {
+        bench.channel_capacities.clone()
+    };
+    let devices: Vec<Option<String>> = if bench.devices.is_empty() {
+        vec![base.device.clone()]
+    } else {
+        bench.devices.iter().cloned().map(Some).collect()
+    };
+
+    let mut records = Vec::new();
+    for device in &devices {
+        for &batch in &batches {
+            let mut args = base.clone();
+            args.device = device.clone();
+            args.batch = Some(batch);
+
+            // all replicas if any swept inference function runs them
+            if infer_fns
+                .iter()
+                .any(|f| matches!(f, InferFn::BatchChannelPipeline))
+            {
+                args.infer_fn = InferFn::BatchChannelPipeline;
+            }
+            let load_start = Instant::now();
+            let mut models = load_models(&args, &ThreadBudget::from_args(&args))?;
+            let model_load_secs = load_start.elapsed().as_secs_f64();
+
+            for &capacity in &capacities {
+                for infer_fn in &infer_fns {
+                    args.channel_capacity = Some(capacity);
+                    args.infer_fn = infer_fn.clone();
+                    // shared by the warmup and measured runs of this configuration
+                    let budget = ThreadBudget::from_args(&args);
+
+                    tracing::info!(
+                        "[Bench] {} | batch {} | capacity {} | device {}",
+                        infer_fn,
+                        batch,
+                        capacity,
+                        device.as_deref().unwrap_or("default")
+                    );
+
+                    for _ in 0..bench.warmup {
+                        auto_infer(
+                            &mut models,
+                            &args.source,
+                            infer_fn,
+                            &args,
+                            &budget,
+                            &mut None,
+                        )?;
+                    }
+
+                    let mut stats = FrameStats::default();
+                    let mut frames = 0;
+                    let mut total = Duration::ZERO;
+                    let mut pipeline_stats = PipelineStats::default();
+                    for _ in 0..iters {
+                        let mut results: Option<Vec<InferResult>> = Some(Vec::new());
+                        let start = Instant::now();
+                        pipeline_stats = auto_infer(
+                            &mut models,
+                            &args.source,
+                            infer_fn,
+                            &args,
+                            &budget,
+                            &mut results,
+                        )?;
+                        total += start.elapsed();
+
+                        let results = results.unwrap_or_default();
+                        frames = results.len();
+                        for r in &results {
+                            stats.record(&r.meta.timings);
+                        }
+                    }
+
+                    stats.latencies_ms.sort_by(f64::total_cmp);
+                    let total_secs = total.as_secs_f64();
+                    records.push(BenchRecord {
+                        infer_fn: infer_fn.to_string(),
+                        batch,
+                        channel_capacity: capacity,
+                        device: device.clone().unwrap_or_default(),
+                        frames,
+                        iters,
+                        model_load_secs,
+                        mean_run_secs: total_secs / iters as f64,
+                        fps: if total_secs > 0.0 {
+                            (frames * iters) as f64 / total_secs
+                        } else {
+                            0.0
+                        },
+                        latency_p50_ms: percentile(&stats.latencies_ms, 50.0),
+                        latency_p95_ms: percentile(&stats.latencies_ms, 95.0),
+                        latency_p99_ms: percentile(&stats.latencies_ms, 99.0),
+                        load_ms: stats.stage_mean_ms(0),
+                        infer_ms: stats.stage_mean_ms(1),
+                        annotate_ms: stats.stage_mean_ms(2),
+                        save_ms: stats.stage_mean_ms(3),
+                        collect_ms: stats.stage_mean_ms(4),
+                        bottleneck: pipeline_stats
+                            .bottleneck()
+                            .map(|s| s.name.clone())
+                            .unwrap_or_default(),
+                    });
+                }
+            }
+        }
+    }
+
+    for r in &records {
+        tracing::info!(
+            "[Bench] {:<20} batch {:>3} cap {:>3} {:<10} | {:>8.2} fps | p50 {:>8.2} ms | p95 {:>8.2} ms | p99 {:>8.2} ms",
+            r.infer_fn,
+            r.batch,
+            r.channel_capacity,
+            r.device,
+            r.fps,
+            r.latency_p50_ms,
+            r.latency_p95_ms,
+            r.latency_p99_ms,
+        );
+    }
+
+    Ok(records)
+}
+
+/// Run the benchmark described by a TOML config (`[predict]` + `[bench]` tables) and write the
+/// report to `bench.output` if set (relative paths resolve against `project_root`).
+pub fn bench_from_toml(toml_path: &Path, project_root: &Path) -> Result<Vec<BenchRecord>> {
+    let args = parse_toml(toml_path, project_root)?;
+    if matches!(args.source, crate::Source::None) {
+        return Err(AppError::Config(
+            "Benchmark requires a [predict] source".to_string(),
+        ));
+    }
+
+    let content = std::fs::read_to_string(toml_path)?;
+    let BenchToml { bench } = toml::from_str(&content)?;
+
+    let records = run_benchmark(&args, &bench)?;
+
+    if let Some(output) = &bench.output {
+        let output = if output.is_absolute() {
+            output.clone()
+        } else {
+            project_root.join(output)
+        };
+        write_report(&records, &output)?;
+        tracing::info!("Benchmark report saved to: {:?}", output);
+    }
+
+    Ok(records)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_percentile_nearest_rank() {
+        let values: Vec<f64> = (1..=100).map(f64::from).collect();
+        assert_eq!(percentile(&values, 50.0), 50.0);
+        assert_eq!(percentile(&values, 95.0), 95.0);
+        assert_eq!(percentile(&values, 99.0), 99.0);
+        assert_eq!(percentile(&values, 0.0), 1.0);
+        assert_eq!(percentile(&[], 50.0), 0.0);
+    }
+
+    #[test]
+    fn test_parse_bench_table() {
+        let content = r#"
+[predict]
+model = "test.onnx"
+
+[bench]
+infer_fns = ["Sequential", "BatchChannelPipeline"]
+batches = [1, 8]
+iters = 5
+output = "results/bench.csv"
+"#;
+        let BenchToml { bench } = toml::from_str(content).unwrap();
+
+        assert_eq!(bench.infer_fns.len(), 2);
+        assert!(matches!(bench.infer_fns[1], InferFn::BatchChannelPipeline));
+        assert_eq!(bench.batches, vec![1, 8]);
+        assert!(bench.channel_capacities.is_empty());
+        assert_eq!(bench.warmup, 1);
+        assert_eq!(bench.iters, 5);
+        assert_eq!(bench.output, Some(PathBuf::from("results/bench.csv")));
+    }
+
+    #[test]
+    fn test_parse_bench_invalid_infer_fn() {
+        let content = r#"
+[bench]
+infer_fns = ["Nope"]
+"#;
+        assert!(toml::from_str::<BenchToml>(content).is_err());
+    }
+
+    #[test]
+    fn test_records_to_csv() {
+        let record = BenchRecord {
+            infer_fn: "Sequential".to_string(),
+            batch: 1,
+            channel_capacity: 8,
+            device: "cuda:0,cuda:1".to_string(),
+            frames: 10,
+            iters: 2,
+            model_load_secs: 1.0,
+            mean_run_secs: 0.5,
+            fps: 20.0,
+            latency_p50_ms: 1.0,
+            latency_p95_ms: 2.0,
+            latency_p99_ms: 3.0,
+            load_ms: 0.1,
+            infer_ms: 0.2,
+            annotate_ms: 0.3,
+            save_ms: 0.4,
+            collect_ms: 0.5,
+            bottleneck: "infer".to_string(),
+        };
+        let csv = records_to_csv(&[record]);
+        let lines: Vec<&str> = csv.lines().collect();
+
+        assert_eq!(lines.len(), 2);
+        assert_eq!(
+            lines[0].split(',').count(),
+            lines[1]
+                .replace("cuda:0,cuda:1", "devices")
+                .split(',')
+                .count()
+        );
+        assert!(lines[1].starts_with("Sequential,1,8,\"cuda:0,cuda:1\",10,2,"));
+    }
+}
@@ -0,0 +1,214 @@
+// -- imports
+use image::{DynamicImage, GrayAlphaImage, GrayImage, RgbImage, RgbaImage};
+use std::sync::Mutex;
+
+/// Idle buffers kept by [`frame_pool`]: enough for the frames in flight in the default pipelines
+const FRAME_POOL_BUFFERS: usize = 32;
+
+static FRAME_POOL: BufferPool = BufferPool::new(FRAME_POOL_BUFFERS);
+
+/// Process-wide pool of frame pixel buffers, shared by decoding, annotation, saving and the
+/// C++ bridge
+pub fn frame_pool() -> &'static BufferPool {
+    &FRAME_POOL
+}
+
+/// Pool of recycled byte buffers.
+///
+/// Frame buffers are taken when a frame is decoded, annotated or copied for saving, and given
+/// back when the frame leaves the pipeline, so a steady stream of same-sized frames keeps reusing
+/// the same allocations.
+#[derive(Debug)]
+pub struct BufferPool {
+    buffers: Mutex<Vec<Vec<u8>>>,
+    max_buffers: usize,
+}
+
+impl BufferPool {
+    /// Create a pool keeping at most `max_buffers` idle buffers
+    pub const fn new(max_buffers: usize) -> Self {
+        Self {
+            buffers: Mutex::new(Vec::new()),
+            max_buffers,
+        }
+    }
+
+    /// Take an empty buffer with a capacity of at least `len` bytes.
+    ///
+    /// The smallest idle buffer that fits is reused; otherwise the largest one is grown, or a
+    /// new one is allocated if the pool is empty.
+    pub fn take(&self, len: usize) -> Vec<u8> {
+        let reused = {
+            let mut buffers = self.buffers.lock().expect("Buffer pool lock poisoned");
+            let fitting = buffers
+                .iter()
+                .enumerate()
+                .filter(|(_, b)| b.capacity() >= len)
+                .min_by_key(|(_, b)| b.capacity());
+            let idx = fitting
+                .or_else(|| buffers.iter().enumerate().max_by_key(|(_, b)| b.capacity()))
+                .map(|(i, _)| i);
+            idx.map(|i| buffers.swap_remove(i))
+        };
+
+        match reused {
+            Some(mut buffer) => {
+                buffer.clear();
+                buffer.reserve(len);
+                buffer
+            }
+            None => Vec::with_capacity(len),
+        }
+    }
+
+    /// Give a buffer back to the pool; it is dropped if the pool is full
+    pub fn give(&self, buffer: Vec<u8>) {
+        if buffer.capacity() == 0 {
+            return;
+        }
+        let mut buffers = self.buffers.lock().expect("Buffer pool lock poisoned");
+        if buffers.len() < self.max_buffers {
+            buffers.push(buffer);
+        }
+    }
+
+    /// Number of idle buffers
+    pub fn len(&self) -> usize {
+        self.buffers
+            .lock()
+            .expect("Buffer pool lock poisoned")
+            .len()
+    }
+
+    /// Give back the pixel buffer of an 8-bit image; other images are dropped
+    pub fn recycle(&self, image: DynamicImage) {
+        match image {
+            DynamicImage::ImageLuma8(img) => self.give(img.into_raw()),
+            DynamicImage::ImageLumaA8(img) => self.give(img.into_raw()),
+            DynamicImage::ImageRgb8(img) => self.give(img.into_raw()),
+            DynamicImage::ImageRgba8(img) => self.give(img.into_raw()),
+            _ => {}
+        }
+    }
+
+    /// Copy of `image` in a pooled buffer (8-bit images; others are cloned)
+    pub fn copy(&self, image: &DynamicImage) -> DynamicImage {
+        let (w, h) = (image.width(), image.height());
+        let copy_raw = |raw: &[u8]| {
+            let mut buffer = self.take(raw.len());
+            buffer.extend_from_slice(raw);
+            buffer
+        };
+        let invalid = "Copied buffer has the size of its source";
+        match image {
+            DynamicImage::ImageLuma8(img) => DynamicImage::ImageLuma8(
+                GrayImage::from_raw(w, h, copy_raw(img.as_raw())).expect(invalid),
+            ),
+            DynamicImage::ImageLumaA8(img) => DynamicImage::ImageLumaA8(
+                GrayAlphaImage::from_raw(w, h, copy_raw(img.as_raw())).expect(invalid),
+            ),
+            DynamicImage::ImageRgb8(img) => DynamicImage::ImageRgb8(
+                RgbImage::from_raw(w, h, copy_raw(img.as_raw())).expect(invalid),
+            ),
+            DynamicImage::ImageRgba8(img) => DynamicImage::ImageRgba8(
+                RgbaImage::from_raw(w, h, copy_raw(img.as_raw())).expect(invalid),
+            ),
+            _ => image.clone(),
+        }
+    }
+
+    /// RGB conversion of `image` in a pooled buffer, same as [`DynamicImage::to_rgb8`]
+    /// (8-bit images; others are converted into a fresh buffer)
+    pub fn to_rgb8(&self, image: &DynamicImage) -> RgbImage {
+        let (w, h) = (image.width(), image.height());
+        let mut buffer = self.take(w as usize * h as usize * 3);
+        match image {
+            DynamicImage::ImageRgb8(img) => buffer.extend_from_slice(img.as_raw()),
+            DynamicImage::ImageRgba8(img) => {
+                for px in img.as_raw().chunks_exact(4) {
+                    buffer.extend_from_slice(&px[..3]);
+                }
+            }
+            DynamicImage::ImageLuma8(img) => {
+                for &l in img.as_raw() {
+                    buffer.extend_from_slice(&[l, l, l]);
+                }
+            }
+            DynamicImage::ImageLumaA8(img) => {
+                for px in img.as_raw().chunks_exact(2) {
+                    buffer.extend_from_slice(&[px[0], px[0], px[0]]);
+                }
+            }
+            _ => {
+                self.give(buffer);
+                return image.to_rgb8();
+            }
+        }
+        RgbImage::from_raw(w, h, buffer).expect("Converted buffer holds w * h RGB pixels")
+    }
+
+    /// RGB copy of the `width x height` region of `image` at `(x, y)` in a pooled buffer
+    /// (RGB images; others are converted into a fresh buffer). The region must lie in `image`.
+    pub fn crop_rgb8(
+        &self,
+        image: &DynamicImage,
+        x: u32,
+        y: u32,
+        width: u32,
+        height: u32,
+    ) -> RgbImage {
+        let DynamicImage::ImageRgb8(img) = image else {
+            return image.crop_imm(x, y, width, height).to_rgb8();
+        };
+        let stride = img.width() as usize * 3;
+        let (start, len) = (x as usize * 3, width as usize * 3);
+        let mut buffer = self.take(len * height as usize);
+        for row in img
+            .as_raw()
+            .chunks_exact(stride)
+            .skip(y as usize)
+            .take(height as usize)
+        {
+            buffer.extend_from_slice(&row[start..start + len]);
+        }
+        RgbImage::from_raw(width, height, buffer).expect("Cropped buffer holds w * h RGB pixels")
+    }
+
+    /// Black RGB image in a pooled buffer
+    pub fn blank_rgb8(&self, width: u32, height: u32) -> RgbImage {
+        let len = width as usize * height as usize * 3;
+        let mut buffer = self.take(len);
+        buffer.resize(len, 0);
+        RgbImage::from_raw(width, height, buffer).expect("Buffer holds w * h RGB pixels")
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use image::Rgba;
+
+    #[test]
+    fn test_recycled_buffers_are_reused() {
+        let pool = BufferPool::new(2);
+        let image = DynamicImage::ImageRgba8(RgbaImage::from_pixel(4, 2, Rgba([1, 2, 3, 4])));
+
+        let rgb = pool.to_rgb8(&image);
+        assert_eq!(rgb.as_raw(), &[1u8, 2, 3].repeat(8));
+        let ptr = rgb.as_raw().as_ptr();
+        pool.recycle(DynamicImage::ImageRgb8(rgb));
+        assert_eq!(pool.len(), 1);
+
+        // same-sized frames reuse the same allocation
+        let blank = pool.blank_rgb8(4, 2);
+        assert_eq!(blank.as_raw().as_ptr(), ptr);
+        assert!(blank.as_raw().iter().all(|&v| v == 0));
+        assert_eq!(pool.len(), 0);
+
+        // a full pool drops extra buffers
+        for _ in 0..3 {
+            pool.give(vec![0; 16]);
+        }
+        assert_eq!(pool.len(), 2);
+    }
+}
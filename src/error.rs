@@ -18,6 +18,9 @@ pub enum AppError {
     #[error("Image loading failed: {0}")]
     ImageLoad(String),
 
+    #[error("Image saving failed: {0}")]
+    ImageSave(String),
+
     #[error("Image collection failed: {0}")]
     ImageCollection(String),
 
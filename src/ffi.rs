@@ -4,7 +4,13 @@ pub mod cpp_ffi;
 #[cfg(feature = "python")]
 pub mod python_ffi;
 
+#[cfg(all(feature = "ipc", target_os = "linux"))]
+pub mod ipc_server;
+
 // -- export public API
 
 #[cfg(feature = "python")]
 pub use python_ffi::*;
+
+#[cfg(all(feature = "ipc", target_os = "linux"))]
+pub use ipc_server::{IpcConfig, IpcDetection, IpcServer};
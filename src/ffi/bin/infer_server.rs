@@ -0,0 +1,41 @@
+/// Shared-memory inference server: owns the model and batches the frames of every client
+/// process (see `cpp_headers/yolo_ipc_client.h`).
+///
+/// Usage: `infer_server [config.toml]` (default `assets/configs/ipc-server.toml`); the
+/// `[server]` section configures the shared-memory segment. Stops on SIGINT / SIGTERM.
+use std::path::PathBuf;
+use std::sync::atomic::{AtomicBool, Ordering};
+
+use anyhow::{Context, Result};
+use yolo_inference::{IpcConfig, IpcServer, init_logger, parse_toml};
+
+static STOP: AtomicBool = AtomicBool::new(false);
+
+extern "C" fn request_stop(_: libc::c_int) {
+    STOP.store(true, Ordering::Relaxed);
+}
+
+fn main() -> Result<()> {
+    init_logger();
+
+    let project_root = PathBuf::from(env!("CARGO_MANIFEST_DIR"));
+    let config_toml = std::env::args()
+        .nth(1)
+        .map(PathBuf::from)
+        .unwrap_or_else(|| project_root.join("assets/configs/ipc-server.toml"));
+
+    let args = parse_toml(&config_toml, &project_root)
+        .with_context(|| format!("Failed to parse TOML config: {:?}", config_toml))?;
+    let config = IpcConfig::from_toml(&config_toml)
+        .with_context(|| format!("Failed to parse [server] config: {:?}", config_toml))?;
+
+    // SAFETY: the handler only stores to an atomic
+    unsafe {
+        libc::signal(libc::SIGINT, request_stop as libc::sighandler_t);
+        libc::signal(libc::SIGTERM, request_stop as libc::sighandler_t);
+    }
+
+    let mut server = IpcServer::new(args, &config).context("Failed to start IPC server")?;
+    server.run(&STOP).context("IPC server failed")?;
+    Ok(())
+}
@@ -2,11 +2,14 @@
 
 use cxx::CxxString;
 use image::{DynamicImage, GenericImageView};
+use rayon::prelude::*;
 use std::path::PathBuf;
-use ultralytics_inference as ul;
 
+use crate::buffer_pool::frame_pool;
 use crate::infer_fn::InferResult;
-use crate::{Source, init_logger, parse_toml, run_online_prediction, run_prediction};
+use crate::masks::MASK_THRESHOLD;
+use crate::stats::PipelineStats;
+use crate::{Predictor, Source, StreamPipeline, init_logger, parse_toml, run_prediction};
 
 //================================================================================
 // FFI Bridge
@@ -20,9 +23,104 @@ pub mod ffi {
         channels: u32,
     }
 
+    /// Detection box in original image coordinates.
+    /// Layout matches one row of `ul::Boxes::data`, so `cls` is the class id stored as float.
+    #[derive(Debug, Clone, Copy)]
+    pub struct Detection {
+        x1: f32,
+        y1: f32,
+        x2: f32,
+        y2: f32,
+        conf: f32,
+        cls: f32,
+    }
+
+    /// Pose keypoint in original image coordinates
+    #[derive(Debug, Clone, Copy)]
+    pub struct Keypoint {
+        x: f32,
+        y: f32,
+        conf: f32,
+    }
+
+    /// Shape of the mask tensor `[count, height, width]`
+    pub struct MaskInfo {
+        count: u32,
+        height: u32,
+        width: u32,
+        /// Masks are run-length encoded (`compact_masks`): read them with `result_mask_runs`
+        /// or `result_decode_mask`, `result_masks` is empty
+        compact: bool,
+    }
+
+    /// Shape of the keypoint tensor `[count, num_kpts]`
+    pub struct KeypointInfo {
+        count: u32,
+        num_kpts: u32,
+    }
+
+    /// Source meta information of a result
+    pub struct ResultMeta {
+        frame_idx: usize,
+        total_frames: usize,
+        /// Caller-provided tag (0 if none)
+        tag: u64,
+        /// Presentation time of video and stream frames in milliseconds (-1 if none)
+        timestamp_ms: f64,
+    }
+
+    /// Counters of one pipeline stage, see `PipelineStats`.
+    /// Times are summed over all threads of the stage; queue fields describe its input queue.
+    #[derive(Debug, Clone)]
+    pub struct StageStatsInfo {
+        name: String,
+        threads: u32,
+        items_in: u64,
+        items_out: u64,
+        busy_ms: f64,
+        send_blocked_ms: f64,
+        recv_blocked_ms: f64,
+        queue_capacity: u64,
+        queue_depth: u64,
+        queue_max_depth: u64,
+        queue_mean_depth: f64,
+        cache_hits: u64,
+        cache_misses: u64,
+        failed: u64,
+    }
+
+    /// Row order of a borrowed pixel buffer
+    pub enum RowOrder {
+        /// First row is the top of the image (stb, OpenCV, Rust)
+        TopDown,
+        /// First row is the bottom of the image (VTK, BMP)
+        BottomUp,
+    }
+
+    /// Channel layout of a caller-provided destination buffer (8 bits per channel)
+    pub enum PixelLayout {
+        Gray,
+        Rgb,
+        Bgr,
+        Rgba,
+        Bgra,
+    }
+
+    /// Borrowed, possibly strided pixel buffer, see `image_from_view`
+    pub struct ImageView {
+        bytes: *const u8,
+        width: u32,
+        height: u32,
+        channels: u32,
+        stride: u32,
+        row_order: RowOrder,
+    }
+
     extern "Rust" {
         type RustImage;
         type InferResult;
+        type Predictor;
+        type StreamPipeline;
 
         // Image operations
         unsafe fn image_from_bytes(
@@ -31,25 +129,89 @@ pub mod ffi {
             height: u32,
             channels: u32,
         ) -> Box<RustImage>;
+        unsafe fn image_from_view(
+            bytes: *const u8,
+            width: u32,
+            height: u32,
+            channels: u32,
+            stride: u32,
+            row_order: RowOrder,
+        ) -> Box<RustImage>;
+        unsafe fn images_from_views(views: &[ImageView]) -> Vec<Box<RustImage>>;
         fn image_to_bytes(image: &RustImage) -> Vec<u8>;
+        unsafe fn copy_image_into(
+            image: &RustImage,
+            dst: *mut u8,
+            dst_stride: u32,
+            layout: PixelLayout,
+            row_order: RowOrder,
+        );
+        fn image_as_bytes(image: &RustImage) -> &[u8];
         fn get_image_info(image: &RustImage) -> ImageInfo;
         fn is_image_empty(image: &RustImage) -> bool;
 
         // Prediction operations
         fn predict_from_toml(config_toml: &CxxString, project_root: &CxxString);
+        fn bench_predict_from_toml(config_toml: &CxxString, project_root: &CxxString) -> String;
         fn online_predict_from_toml(
             images: Vec<Box<RustImage>>,
             config_toml: &CxxString,
             project_root: &CxxString,
         ) -> Vec<Box<InferResult>>;
 
+        // Persistent predictor operations
+        fn create_predictor(config_toml: &CxxString, project_root: &CxxString) -> Box<Predictor>;
+        #[cxx_name = "predict"]
+        fn predict_images(
+            self: &mut Predictor,
+            images: Vec<Box<RustImage>>,
+        ) -> Vec<Box<InferResult>>;
+        /// Per-stage stats of the last `predict` call (empty before the first one)
+        #[cxx_name = "last_stats"]
+        fn last_stage_stats(self: &Predictor) -> Vec<StageStatsInfo>;
+
+        // Stream pipeline operations
+        fn create_stream_pipeline(
+            config_toml: &CxxString,
+            project_root: &CxxString,
+        ) -> Box<StreamPipeline>;
+        #[cxx_name = "submit"]
+        fn submit_image(self: &StreamPipeline, image: Box<RustImage>, tag: u64) -> Result<u64>;
+        #[cxx_name = "poll"]
+        fn poll_results(self: &StreamPipeline) -> Vec<Box<InferResult>>;
+        fn poll_failed(self: &StreamPipeline) -> Vec<u64>;
+        #[cxx_name = "wait"]
+        fn wait_result(self: &StreamPipeline, ticket: u64) -> Result<Box<InferResult>>;
+        /// Live per-stage stats since the pipeline was started
+        #[cxx_name = "stats"]
+        fn stage_stats(self: &StreamPipeline) -> Vec<StageStatsInfo>;
+
         // InferResult accessors
         fn get_result_annotated(result: &InferResult) -> Box<RustImage>;
         fn take_result_annotated(result: &mut InferResult) -> Box<RustImage>;
+        fn result_annotated_info(result: &InferResult) -> ImageInfo;
+        fn result_annotated_bytes(result: &InferResult) -> &[u8];
+        unsafe fn copy_result_annotated_into(
+            result: &InferResult,
+            dst: *mut u8,
+            dst_stride: u32,
+            layout: PixelLayout,
+            row_order: RowOrder,
+        ) -> bool;
+        fn get_result_meta(result: &InferResult) -> ResultMeta;
+        fn result_boxes(result: &InferResult) -> &[Detection];
+        fn result_masks(result: &InferResult) -> &[f32];
+        fn result_mask_info(result: &InferResult) -> MaskInfo;
+        fn result_mask_runs(result: &InferResult, index: u32) -> &[u32];
+        fn result_decode_mask(result: &InferResult, index: u32, out: &mut [u8]) -> bool;
+        fn result_keypoints(result: &InferResult) -> &[Keypoint];
+        fn result_keypoint_info(result: &InferResult) -> KeypointInfo;
+        fn result_class_name(result: &InferResult, cls: u32) -> String;
     }
 }
 
-pub use ffi::ImageInfo;
+pub use ffi::{Detection, ImageInfo, ImageView, Keypoint, KeypointInfo, MaskInfo, PixelLayout,
+              ResultMeta, RowOrder, StageStatsInfo};
 
 //================================================================================
 // Types
@@ -64,6 +226,11 @@ impl RustImage {
         Self { inner }
     }
 
+    /// Move the image out of the wrapper (its buffer is then not recycled on drop)
+    pub fn into_inner(mut self) -> DynamicImage {
+        std::mem::replace(&mut self.inner, DynamicImage::new_rgba8(0, 0))
+    }
+
     /// Get image dimensions
     fn dimensions(&self) -> (u32, u32) {
         self.inner.dimensions()
@@ -85,10 +252,21 @@ impl RustImage {
     }
 }
 
+/// Images dropped by C++ give their pixel buffer back to the frame pool
+impl Drop for RustImage {
+    fn drop(&mut self) {
+        let image = std::mem::replace(&mut self.inner, DynamicImage::new_rgba8(0, 0));
+        frame_pool().recycle(image);
+    }
+}
+
 //================================================================================
 // Image Operations
 //================================================================================
 
+/// Images of at least this many bytes are copied by row blocks in parallel
+const PARALLEL_COPY_MIN_BYTES: usize = 8 << 20;
+
 /// Create a RustImage from raw pixel buffer.
 /// `pixels` must be valid for `width * height * channels` bytes.
 /// Supports 1 (grayscale), 3 (RGB), or 4 (RGBA) channels.
@@ -97,25 +275,89 @@ pub unsafe fn image_from_bytes(
     width: u32,
     height: u32,
     channels: u32,
+) -> Box<RustImage> {
+    unsafe {
+        image_from_view(
+            bytes,
+            width,
+            height,
+            channels,
+            width * channels,
+            RowOrder::TopDown,
+        )
+    }
+}
+
+/// Create a RustImage from a borrowed, possibly strided pixel buffer.
+///
+/// - `bytes` must be valid for `(height - 1) * stride + width * channels` bytes.
+/// - `stride` is the distance in bytes between the starts of two consecutive rows.
+/// - `row_order` tells whether the first row is the top (`TopDown`) or the bottom (`BottomUp`) of
+///   the image. Bottom-up buffers (e.g. `vtkImageData`) are flipped while copying.
+///
+/// The caller's memory is read exactly once: rows are copied straight into the Rust-owned image,
+/// so no intermediate C++ buffer or separate flip pass is needed.
+/// Supports 1 (grayscale), 3 (RGB), or 4 (RGBA) channels.
+pub unsafe fn image_from_view(
+    bytes: *const u8,
+    width: u32,
+    height: u32,
+    channels: u32,
+    stride: u32,
+    row_order: RowOrder,
 ) -> Box<RustImage> {
     // Allow zero-size images as empty placeholders
     if width == 0 || height == 0 {
         return Box::new(RustImage::new(image::DynamicImage::new_rgba8(0, 0)));
     }
     assert!(!bytes.is_null(), "bytes pointer is null");
-    assert!(width > 0 && height > 0, "Invalid image dimensions");
 
-    let data_len = (width * height * channels) as usize;
-    let pixel_data = unsafe { std::slice::from_raw_parts(bytes, data_len) };
+    let row_len = width as usize * channels as usize;
+    let stride = stride as usize;
+    let rows = height as usize;
+    assert!(
+        stride >= row_len,
+        "Row stride {} is smaller than row size {}",
+        stride,
+        row_len
+    );
+
+    let view_len = (rows - 1) * stride + row_len;
+    let view = unsafe { std::slice::from_raw_parts(bytes, view_len) };
+
+    let src_row = |y: usize| {
+        let row = if row_order == RowOrder::BottomUp {
+            rows - 1 - y
+        } else {
+            y
+        };
+        &view[row * stride..][..row_len]
+    };
+
+    // Single pass: gather rows (flipped if bottom-up) into the owned pixel buffer, by row blocks
+    // in parallel for large images (e.g. medical volume slices)
+    let len = rows * row_len;
+    let mut pixel_data = frame_pool().take(len);
+    if len >= PARALLEL_COPY_MIN_BYTES {
+        pixel_data.resize(len, 0);
+        pixel_data
+            .par_chunks_mut(row_len)
+            .enumerate()
+            .for_each(|(y, dst)| dst.copy_from_slice(src_row(y)));
+    } else {
+        for y in 0..rows {
+            pixel_data.extend_from_slice(src_row(y));
+        }
+    }
 
     let dynamic_image = match channels {
-        1 => image::GrayImage::from_raw(width, height, pixel_data.to_vec())
+        1 => image::GrayImage::from_raw(width, height, pixel_data)
             .map(DynamicImage::ImageLuma8)
             .expect("Failed to create grayscale image"),
-        3 => image::RgbImage::from_raw(width, height, pixel_data.to_vec())
+        3 => image::RgbImage::from_raw(width, height, pixel_data)
             .map(DynamicImage::ImageRgb8)
             .expect("Failed to create RGB image"),
-        4 => image::RgbaImage::from_raw(width, height, pixel_data.to_vec())
+        4 => image::RgbaImage::from_raw(width, height, pixel_data)
             .map(DynamicImage::ImageRgba8)
             .expect("Failed to create RGBA image"),
         _ => panic!("Unsupported channel count: {}", channels),
@@ -124,6 +366,38 @@ pub unsafe fn image_from_bytes(
     Box::new(RustImage::new(dynamic_image))
 }
 
+/// Views shared across the conversion threads
+struct SharedViews<'a>(&'a [ImageView]);
+
+// SAFETY: the viewed buffers are only read, and the caller of `images_from_views` keeps them valid
+// and unmodified for the duration of the call
+unsafe impl Sync for SharedViews<'_> {}
+
+/// Create one RustImage per view (see `image_from_view`), converting the views in parallel.
+/// Null or zero-size views give empty images, so the output has one image per view, in order.
+pub unsafe fn images_from_views(views: &[ImageView]) -> Vec<Box<RustImage>> {
+    let shared = SharedViews(views);
+    (0..views.len())
+        .into_par_iter()
+        .map(|i| {
+            let view = &shared.0[i];
+            if view.bytes.is_null() {
+                return Box::new(RustImage::new(DynamicImage::new_rgba8(0, 0)));
+            }
+            unsafe {
+                image_from_view(
+                    view.bytes,
+                    view.width,
+                    view.height,
+                    view.channels,
+                    view.stride,
+                    view.row_order,
+                )
+            }
+        })
+        .collect()
+}
+
 /// Extract raw pixel data as byte vector
 pub fn image_to_bytes(image: &RustImage) -> Vec<u8> {
     // Return empty vec for empty image
@@ -134,7 +408,138 @@ pub fn image_to_bytes(image: &RustImage) -> Vec<u8> {
         DynamicImage::ImageLuma8(img) => img.as_raw().clone(),
         DynamicImage::ImageRgb8(img) => img.as_raw().clone(),
         DynamicImage::ImageRgba8(img) => img.as_raw().clone(),
-        _ => image.inner.to_rgb8().as_raw().clone(),
+        _ => image.inner.to_rgb8().into_raw(),
+    }
+}
+
+impl PixelLayout {
+    /// Bytes per pixel
+    const fn channels(self) -> usize {
+        match self {
+            PixelLayout::Gray => 1,
+            PixelLayout::Rgb | PixelLayout::Bgr => 3,
+            PixelLayout::Rgba | PixelLayout::Bgra => 4,
+            _ => unreachable!(),
+        }
+    }
+}
+
+/// Convert one row of `src_channels`-channel pixels (gray, RGB or RGBA) into `layout`.
+/// Alpha is 255 when the source has none; gray uses the Rec. 709 luma weights, as `image` does.
+fn convert_row(src: &[u8], src_channels: usize, dst: &mut [u8], layout: PixelLayout) {
+    let same_layout = matches!(
+        (src_channels, layout),
+        (1, PixelLayout::Gray) | (3, PixelLayout::Rgb) | (4, PixelLayout::Rgba)
+    );
+    if same_layout {
+        dst.copy_from_slice(src);
+        return;
+    }
+
+    let rgba = |px: &[u8]| match src_channels {
+        1 => [px[0], px[0], px[0], 255],
+        3 => [px[0], px[1], px[2], 255],
+        _ => [px[0], px[1], px[2], px[3]],
+    };
+    let src_pixels = src.chunks_exact(src_channels);
+    let dst_pixels = dst.chunks_exact_mut(layout.channels());
+    for (s, d) in src_pixels.zip(dst_pixels) {
+        let [r, g, b, a] = rgba(s);
+        match layout {
+            PixelLayout::Gray => {
+                let luma = (2126 * r as u32 + 7152 * g as u32 + 722 * b as u32) / 10000;
+                d[0] = luma as u8;
+            }
+            PixelLayout::Rgb => d.copy_from_slice(&[r, g, b]),
+            PixelLayout::Bgr => d.copy_from_slice(&[b, g, r]),
+            PixelLayout::Rgba => d.copy_from_slice(&[r, g, b, a]),
+            _ => d.copy_from_slice(&[b, g, r, a]),
+        }
+    }
+}
+
+/// Write `image` into a caller-owned buffer of `dst_stride` bytes per row, converting to
+/// `layout` and flipping rows for `RowOrder::BottomUp` in the same pass (by row blocks in
+/// parallel for large images).
+///
+/// `dst` must be valid for `(height - 1) * dst_stride + width * channels(layout)` bytes.
+unsafe fn write_image_into(
+    image: &DynamicImage,
+    dst: *mut u8,
+    dst_stride: usize,
+    layout: PixelLayout,
+    row_order: RowOrder,
+) {
+    let (width, height) = (image.width() as usize, image.height() as usize);
+    if width == 0 || height == 0 {
+        return;
+    }
+    assert!(!dst.is_null(), "dst pointer is null");
+
+    // read 8-bit gray / RGB / RGBA pixels in place, convert anything else once
+    let converted;
+    let (src, src_channels): (&[u8], usize) = match image {
+        DynamicImage::ImageLuma8(img) => (img.as_raw(), 1),
+        DynamicImage::ImageRgb8(img) => (img.as_raw(), 3),
+        DynamicImage::ImageRgba8(img) => (img.as_raw(), 4),
+        _ => {
+            converted = image.to_rgba8();
+            (converted.as_raw(), 4)
+        }
+    };
+
+    let src_row_len = width * src_channels;
+    let dst_row_len = width * layout.channels();
+    assert!(
+        dst_stride >= dst_row_len,
+        "Row stride {} is smaller than row size {}",
+        dst_stride,
+        dst_row_len
+    );
+    let dst_len = (height - 1) * dst_stride + dst_row_len;
+    let dst = unsafe { std::slice::from_raw_parts_mut(dst, dst_len) };
+
+    let write_row = |y: usize, dst_row: &mut [u8]| {
+        let src_y = if row_order == RowOrder::BottomUp {
+            height - 1 - y
+        } else {
+            y
+        };
+        let src_row = &src[src_y * src_row_len..][..src_row_len];
+        convert_row(src_row, src_channels, &mut dst_row[..dst_row_len], layout);
+    };
+    if dst_len >= PARALLEL_COPY_MIN_BYTES {
+        dst.par_chunks_mut(dst_stride)
+            .enumerate()
+            .for_each(|(y, row)| write_row(y, row));
+    } else {
+        dst.chunks_mut(dst_stride)
+            .enumerate()
+            .for_each(|(y, row)| write_row(y, row));
+    }
+}
+
+/// Write the pixels of `image` straight into caller-owned memory (VTK scalars, a mapped staging
+/// buffer, shared memory), see `copy_result_annotated_into`.
+pub unsafe fn copy_image_into(
+    image: &RustImage,
+    dst: *mut u8,
+    dst_stride: u32,
+    layout: PixelLayout,
+    row_order: RowOrder,
+) {
+    unsafe { write_image_into(&image.inner, dst, dst_stride as usize, layout, row_order) }
+}
+
+/// Borrow raw pixel data without copying.
+/// Empty for empty images and for images that are not 8-bit gray, RGB or RGBA (use
+/// `image_to_bytes` for those).
+pub fn image_as_bytes(image: &RustImage) -> &[u8] {
+    match &image.inner {
+        DynamicImage::ImageLuma8(img) => img.as_raw(),
+        DynamicImage::ImageRgb8(img) => img.as_raw(),
+        DynamicImage::ImageRgba8(img) => img.as_raw(),
+        _ => &[],
     }
 }
 
@@ -169,38 +574,131 @@ pub fn predict_from_toml(config_toml: &CxxString, project_root: &CxxString) {
     run_prediction(&args).expect("Prediction failed");
 }
 
+/// Run the benchmark sweep of a TOML config (`[predict]` + `[bench]` tables).
+/// Returns the report as a JSON string; it is also written to `bench.output` if set.
+pub fn bench_predict_from_toml(config_toml: &CxxString, project_root: &CxxString) -> String {
+    init_logger();
+    let records = crate::bench_from_toml(
+        &PathBuf::from(config_toml.to_string()),
+        &PathBuf::from(project_root.to_string()),
+    )
+    .expect("Benchmark failed");
+    crate::records_to_json(&records)
+}
+
 /// Run online prediction with in-memory images.
 /// Takes images, TOML config and project root, returns inference results.
+///
+/// NOTE: the model is reloaded on every call. Use `create_predictor` to load it once.
 pub fn online_predict_from_toml(
     images: Vec<Box<RustImage>>,
     config_toml: &CxxString,
     project_root: &CxxString,
 ) -> Vec<Box<InferResult>> {
-    init_logger();
+    create_predictor(config_toml, project_root).predict_images(images)
+}
 
-    let args = parse_toml(
+//================================================================================
+// Predictor Operations
+//================================================================================
+
+/// Create a persistent predictor from TOML config file path.
+/// The model is loaded once here and reused by every `predict` call.
+pub fn create_predictor(config_toml: &CxxString, project_root: &CxxString) -> Box<Predictor> {
+    init_logger();
+    let predictor = Predictor::from_toml(
         &PathBuf::from(config_toml.to_string()),
         &PathBuf::from(project_root.to_string()),
     )
-    .expect("Failed to parse TOML config");
-
-    let config: ul::InferenceConfig = (&args).try_into().expect("Invalid inference config");
-    let mut model =
-        ul::YOLOModel::load_with_config(&args.model, config).expect("Failed to load model");
+    .expect("Failed to create predictor");
+    Box::new(predictor)
+}
 
-    let dynamic_images: Vec<DynamicImage> =
-        images.into_iter().map(|wrapper| wrapper.inner).collect();
+impl Predictor {
+    /// Run online prediction with in-memory images using the loaded model.
+    pub fn predict_images(&mut self, images: Vec<Box<RustImage>>) -> Vec<Box<InferResult>> {
+        let dynamic_images: Vec<DynamicImage> = images
+            .into_iter()
+            .map(|wrapper| wrapper.into_inner())
+            .collect();
+
+        // moved into the pipeline: the images are not copied again on the Rust side
+        let results = self
+            .predict(Source::ImageVec(dynamic_images))
+            .expect("Prediction failed");
+
+        results
+            .unwrap_or_default()
+            .into_iter()
+            .map(Box::new)
+            .collect()
+    }
 
-    let source = Source::ImageVec(dynamic_images);
-    let results = run_online_prediction(&mut model, &source, &args).expect("Prediction failed");
+    /// Per-stage stats of the last `predict` call.
+    pub fn last_stage_stats(&self) -> Vec<StageStatsInfo> {
+        self.last_stats().map(stage_stats_info).unwrap_or_default()
+    }
+}
 
-    results
-        .unwrap_or_default()
-        .into_iter()
-        .map(Box::new)
+/// Flatten pipeline stats into bridge structs (one per stage)
+fn stage_stats_info(stats: &PipelineStats) -> Vec<StageStatsInfo> {
+    stats
+        .stages
+        .iter()
+        .map(|s| StageStatsInfo {
+            name: s.name.clone(),
+            threads: s.threads as u32,
+            items_in: s.items_in,
+            items_out: s.items_out,
+            busy_ms: s.busy_ms,
+            send_blocked_ms: s.send_blocked_ms,
+            recv_blocked_ms: s.recv_blocked_ms,
+            queue_capacity: s.queue_capacity as u64,
+            queue_depth: s.queue_depth as u64,
+            queue_max_depth: s.queue_max_depth as u64,
+            queue_mean_depth: s.queue_mean_depth,
+            cache_hits: s.cache_hits,
+            cache_misses: s.cache_misses,
+            failed: s.failed,
+        })
         .collect()
 }
 
+//================================================================================
+// Stream Pipeline Operations
+//================================================================================
+
+/// Create a long-lived stream pipeline from TOML config file path.
+/// The model is loaded once and stage threads keep running until the pipeline is dropped.
+pub fn create_stream_pipeline(
+    config_toml: &CxxString,
+    project_root: &CxxString,
+) -> Box<StreamPipeline> {
+    Box::new(create_predictor(config_toml, project_root).into_stream())
+}
+
+impl StreamPipeline {
+    /// Submit an image with a caller-provided tag, returns its ticket.
+    pub fn submit_image(&self, image: Box<RustImage>, tag: u64) -> crate::Result<u64> {
+        self.submit(image.into_inner(), tag)
+    }
+
+    /// Take all finished results without blocking.
+    pub fn poll_results(&self) -> Vec<Box<InferResult>> {
+        self.poll().into_iter().map(Box::new).collect()
+    }
+
+    /// Block until the result of `ticket` is ready and take it.
+    pub fn wait_result(&self, ticket: u64) -> crate::Result<Box<InferResult>> {
+        self.wait(ticket).map(Box::new)
+    }
+
+    /// Live per-stage stats since the pipeline was started.
+    pub fn stage_stats(&self) -> Vec<StageStatsInfo> {
+        stage_stats_info(&self.stats())
+    }
+}
+
 //================================================================================
 // InferResult Operations
 //================================================================================
@@ -212,7 +710,7 @@ pub fn get_result_annotated(result: &InferResult) -> Box<RustImage> {
     let img = result
         .annotated
         .as_ref()
-        .cloned()
+        .map(|img| frame_pool().copy(img))
         .unwrap_or_else(|| image::DynamicImage::new_rgba8(0, 0));
     Box::new(RustImage::new(img))
 }
@@ -227,3 +725,199 @@ pub fn take_result_annotated(result: &mut InferResult) -> Box<RustImage> {
         .unwrap_or_else(|| image::DynamicImage::new_rgba8(0, 0));
     Box::new(RustImage::new(img))
 }
+
+/// Write the annotated image of InferResult straight into caller-owned memory, without an
+/// intermediate copy.
+///
+/// - `dst` must be valid for `(height - 1) * dst_stride + width * channels(layout)` bytes, with the
+///   size given by `result_annotated_info`.
+/// - `layout` is the caller's channel layout (e.g. RGBA or BGR); pixels are converted while
+///   copying.
+/// - `RowOrder::BottomUp` writes the rows flipped (e.g. for `vtkImageData`).
+///
+/// Returns false (and writes nothing) if the result has no annotated image.
+pub unsafe fn copy_result_annotated_into(
+    result: &InferResult,
+    dst: *mut u8,
+    dst_stride: u32,
+    layout: PixelLayout,
+    row_order: RowOrder,
+) -> bool {
+    match &result.annotated {
+        Some(img) => {
+            unsafe { write_image_into(img, dst, dst_stride as usize, layout, row_order) };
+            true
+        }
+        None => false,
+    }
+}
+
+/// Dimensions of the annotated image of InferResult (all zero if there is none).
+pub fn result_annotated_info(result: &InferResult) -> ImageInfo {
+    match &result.annotated {
+        Some(img) => {
+            let (width, height) = img.dimensions();
+            ImageInfo {
+                width,
+                height,
+                channels: img.color().channel_count() as u32,
+            }
+        }
+        None => ImageInfo {
+            width: 0,
+            height: 0,
+            channels: 0,
+        },
+    }
+}
+
+/// Borrow the pixels of the annotated image of InferResult without copying.
+/// Empty if there is none or if it is not 8-bit (annotated images are RGB).
+pub fn result_annotated_bytes(result: &InferResult) -> &[u8] {
+    match &result.annotated {
+        Some(DynamicImage::ImageLuma8(img)) => img.as_raw(),
+        Some(DynamicImage::ImageRgb8(img)) => img.as_raw(),
+        Some(DynamicImage::ImageRgba8(img)) => img.as_raw(),
+        _ => &[],
+    }
+}
+
+/// Get source meta information (frame index, total frames, tag, timestamp) of InferResult.
+pub fn get_result_meta(result: &InferResult) -> ResultMeta {
+    ResultMeta {
+        frame_idx: result.meta.frame_idx,
+        total_frames: result.meta.total_frames,
+        tag: result.meta.tag.unwrap_or_default(),
+        timestamp_ms: result
+            .meta
+            .timestamp
+            .map_or(-1.0, |t| t.as_secs_f64() * 1000.0),
+    }
+}
+
+/// Reinterpret a contiguous f32 buffer as a slice of `#[repr(C)]` records made of `N` f32 fields.
+fn cast_f32_records<T, const N: usize>(data: Option<&[f32]>) -> &[T] {
+    debug_assert_eq!(std::mem::size_of::<T>(), N * std::mem::size_of::<f32>());
+    debug_assert_eq!(std::mem::align_of::<T>(), std::mem::align_of::<f32>());
+    match data {
+        // SAFETY: `T` is a `#[repr(C)]` struct of exactly `N` f32 fields, so it has the size and
+        // alignment of `[f32; N]` and every bit pattern is valid.
+        Some(data) => unsafe {
+            std::slice::from_raw_parts(data.as_ptr().cast::<T>(), data.len() / N)
+        },
+        None => {
+            tracing::warn!("Result tensor is not in standard layout, returning empty slice");
+            &[]
+        }
+    }
+}
+
+/// Borrow detection boxes of InferResult without copying.
+/// Returns an empty slice if the result has no boxes.
+pub fn result_boxes(result: &InferResult) -> &[Detection] {
+    match result.result.boxes.as_ref() {
+        Some(boxes) if boxes.data.ncols() == 6 => {
+            cast_f32_records::<Detection, 6>(boxes.data.as_slice())
+        }
+        _ => &[],
+    }
+}
+
+/// Borrow dense mask data of InferResult without copying.
+/// The slice is laid out as `[count, height, width]` (see `result_mask_info`), values in `[0, 1]`.
+/// Returns an empty slice if the result has no masks.
+pub fn result_masks(result: &InferResult) -> &[f32] {
+    match result.result.masks.as_ref() {
+        Some(masks) => masks.data.as_slice().unwrap_or(&[]),
+        None => &[],
+    }
+}
+
+/// Get the shape of the mask data of InferResult. All zeros if there are no masks.
+pub fn result_mask_info(result: &InferResult) -> MaskInfo {
+    if let Some(masks) = result.masks.as_ref() {
+        return MaskInfo {
+            count: masks.len() as u32,
+            height: masks.height() as u32,
+            width: masks.width() as u32,
+            compact: true,
+        };
+    }
+    let (count, height, width) = result
+        .result
+        .masks
+        .as_ref()
+        .map_or((0, 0, 0), |masks| masks.data.dim());
+    MaskInfo {
+        count: count as u32,
+        height: height as u32,
+        width: width as u32,
+        compact: false,
+    }
+}
+
+/// Borrow the run lengths of compact mask `index` (row-major, alternating background and
+/// foreground, starting with background). Empty if masks are not compact or out of range.
+pub fn result_mask_runs(result: &InferResult, index: u32) -> &[u32] {
+    result
+        .masks
+        .as_ref()
+        .map_or(&[], |masks| masks.runs(index as usize))
+}
+
+/// Binarize mask `index` into `out` (`height * width` bytes, 1 for foreground), from compact or
+/// dense masks. Returns false if there is no such mask or `out` has another size.
+pub fn result_decode_mask(result: &InferResult, index: u32, out: &mut [u8]) -> bool {
+    if let Some(masks) = result.masks.as_ref() {
+        return masks.decode_into(index as usize, out);
+    }
+    let Some(masks) = result.result.masks.as_ref() else {
+        return false;
+    };
+    let (_, height, width) = masks.data.dim();
+    let Some(mask) = masks.data.outer_iter().nth(index as usize) else {
+        return false;
+    };
+    if out.len() != height * width {
+        return false;
+    }
+    for (o, &value) in out.iter_mut().zip(mask.iter()) {
+        *o = u8::from(value > MASK_THRESHOLD);
+    }
+    true
+}
+
+/// Borrow pose keypoints of InferResult without copying.
+/// The slice is laid out as `[count, num_kpts]` (see `result_keypoint_info`).
+/// Returns an empty slice if the result has no keypoints.
+pub fn result_keypoints(result: &InferResult) -> &[Keypoint] {
+    match result.result.keypoints.as_ref() {
+        Some(kpts) if kpts.data.shape()[2] == 3 => {
+            cast_f32_records::<Keypoint, 3>(kpts.data.as_slice())
+        }
+        _ => &[],
+    }
+}
+
+/// Get the shape of the keypoint data of InferResult. All zeros if there are no keypoints.
+pub fn result_keypoint_info(result: &InferResult) -> KeypointInfo {
+    let (count, num_kpts) = result
+        .result
+        .keypoints
+        .as_ref()
+        .map_or((0, 0), |kpts| (kpts.data.shape()[0], kpts.data.shape()[1]));
+    KeypointInfo {
+        count: count as u32,
+        num_kpts: num_kpts as u32,
+    }
+}
+
+/// Get the class name of a class id. Returns an empty string for unknown ids.
+pub fn result_class_name(result: &InferResult, cls: u32) -> String {
+    result
+        .result
+        .names
+        .get(&(cls as usize))
+        .cloned()
+        .unwrap_or_default()
+}
@@ -0,0 +1,752 @@
+//! Shared-memory IPC inference server - serves C++ client processes (see
+//! `cpp_headers/yolo_ipc_client.h`) from one model and one batching loop
+//!
+//! The server creates a POSIX shared-memory segment holding a header and a ring of fixed-size
+//! frame slots. A client claims a free slot, writes its frame straight into the slot memory,
+//! marks it ready and rings the doorbell; the server batches ready slots of all clients
+//! together (up to `batch` frames or `max_wait_us`), writes the detections back into each slot
+//! and wakes its client. Waiting on both sides uses futexes on the shared words.
+//!
+//! Both sides record their pid in the segment: clients stop waiting once the server process is
+//! gone, and the server takes back the slots of clients that exited while holding one.
+
+use image::{DynamicImage, GrayImage, RgbImage, RgbaImage};
+use serde::Deserialize;
+use std::ffi::CString;
+use std::path::Path;
+use std::ptr::NonNull;
+use std::sync::atomic::{AtomicBool, AtomicU32, AtomicU64, Ordering};
+use std::time::{Duration, Instant};
+use ultralytics_inference as ul;
+
+use crate::buffer_pool::frame_pool;
+use crate::error::{AppError, Result};
+use crate::infer_fn::AdaptiveBatch;
+use crate::predict::{PredictArgs, load_model};
+use crate::source::{FrameTimings, SourceMeta};
+use crate::thread_budget::ThreadBudget;
+
+//================================================================================
+// Shared layout (keep in sync with cpp_headers/yolo_ipc_client.h)
+//================================================================================
+
+/// `"YOLO"`, written last when the segment is ready
+pub const IPC_MAGIC: u32 = 0x594f_4c4f;
+pub const IPC_VERSION: u32 = 2;
+
+/// Slot states
+pub const SLOT_FREE: u32 = 0;
+pub const SLOT_WRITING: u32 = 1;
+pub const SLOT_READY: u32 = 2;
+pub const SLOT_BUSY: u32 = 3;
+pub const SLOT_DONE: u32 = 4;
+
+/// Slot result status
+pub const STATUS_OK: i32 = 0;
+pub const STATUS_INVALID_FRAME: i32 = -1;
+pub const STATUS_INFER_FAILED: i32 = -2;
+pub const STATUS_SHUTDOWN: i32 = -3;
+
+/// Alignment of the header, slots and frame data
+const IPC_ALIGN: usize = 64;
+
+/// How long the idle server sleeps before checking for shutdown
+const IDLE_WAIT: Duration = Duration::from_millis(100);
+
+/// How often the server looks for slots held by exited clients
+const RECLAIM_INTERVAL: Duration = Duration::from_secs(1);
+
+/// Segment header, at offset 0
+#[repr(C)]
+struct SegmentHeader {
+    magic: AtomicU32,
+    version: AtomicU32,
+    slot_count: AtomicU32,
+    max_detections: AtomicU32,
+    /// Frame capacity of a slot, in bytes
+    slot_bytes: AtomicU64,
+    /// Bytes between slot starts
+    slot_stride: AtomicU64,
+    /// Bumped by clients when they submit a frame; the server waits on it
+    doorbell: AtomicU32,
+    /// 1 while the server runs, 0 once it stopped
+    running: AtomicU32,
+    /// Bumped by clients when they release a slot; clients wait on it for a free slot
+    released: AtomicU32,
+    /// Pid of the server process, set before the magic
+    server_pid: AtomicU32,
+    _reserved: [u32; 4],
+}
+
+/// Slot header, at the start of every slot; followed by `max_detections` [`IpcDetection`]s and
+/// the frame data (at [`Segment::frame_offset`])
+#[repr(C)]
+struct SlotHeader {
+    state: AtomicU32,
+    width: AtomicU32,
+    height: AtomicU32,
+    channels: AtomicU32,
+    /// Bytes between frame row starts
+    stride: AtomicU32,
+    status: AtomicU32,
+    detection_count: AtomicU32,
+    /// Pid of the client holding the slot (0 while free or not yet recorded)
+    owner_pid: AtomicU32,
+    /// Caller-provided tag, returned untouched
+    tag: AtomicU64,
+    _reserved1: [u64; 3],
+}
+
+/// Detection box in frame coordinates, same layout as the C++ bridge `Detection`
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq)]
+pub struct IpcDetection {
+    pub x1: f32,
+    pub y1: f32,
+    pub x2: f32,
+    pub y2: f32,
+    pub conf: f32,
+    pub cls: f32,
+}
+
+const _: () = assert!(size_of::<SegmentHeader>() == IPC_ALIGN);
+const _: () = assert!(size_of::<SlotHeader>() == IPC_ALIGN);
+const _: () = assert!(size_of::<IpcDetection>() == 24);
+
+const fn align_up(n: usize) -> usize {
+    n.div_ceil(IPC_ALIGN) * IPC_ALIGN
+}
+
+//================================================================================
+// Config
+//================================================================================
+
+/// `[server]` section of the server TOML config
+#[derive(Debug, Clone, Deserialize)]
+#[serde(default)]
+pub struct IpcConfig {
+    /// Name of the shared-memory segment (`shm_open`, starts with `/`)
+    pub shm_name: String,
+    /// Number of frame slots shared by all clients
+    pub slots: usize,
+    /// Frame capacity of a slot in bytes (largest `stride * height` accepted)
+    pub slot_bytes: usize,
+    /// Maximum detections returned per frame
+    pub max_detections: usize,
+}
+
+impl Default for IpcConfig {
+    fn default() -> Self {
+        Self {
+            shm_name: "/yolo_inference".to_string(),
+            slots: 16,
+            slot_bytes: 1920 * 1080 * 4,
+            max_detections: 300,
+        }
+    }
+}
+
+impl IpcConfig {
+    /// Read the `[server]` section of a TOML config (defaults if it is missing)
+    pub fn from_toml(toml_path: &Path) -> Result<Self> {
+        #[derive(Deserialize, Default)]
+        #[serde(default)]
+        struct ServerToml {
+            server: IpcConfig,
+        }
+
+        let content = std::fs::read_to_string(toml_path)?;
+        let config: ServerToml = toml::from_str(&content)?;
+        Ok(config.server)
+    }
+}
+
+//================================================================================
+// Shared memory
+//================================================================================
+
+fn last_os_error(context: &str) -> AppError {
+    let e = std::io::Error::last_os_error();
+    AppError::Io(std::io::Error::new(e.kind(), format!("{}: {}", context, e)))
+}
+
+/// Whether process `pid` still exists (`kill(pid, 0)`; a process of another user counts as alive)
+fn process_alive(pid: u32) -> bool {
+    // SAFETY: signal 0 only checks for the existence of the process
+    unsafe {
+        libc::kill(pid as libc::pid_t, 0) == 0
+            || std::io::Error::last_os_error().raw_os_error() != Some(libc::ESRCH)
+    }
+}
+
+/// Pid of the server recorded in an existing segment, if it is initialized
+fn segment_owner(name: &CString) -> Option<u32> {
+    // SAFETY: read-only mapping of the header, bounds checked against the segment size
+    unsafe {
+        let fd = libc::shm_open(name.as_ptr(), libc::O_RDONLY, 0);
+        if fd < 0 {
+            return None;
+        }
+        let mut st: libc::stat = std::mem::zeroed();
+        let len = size_of::<SegmentHeader>();
+        if libc::fstat(fd, &mut st) != 0 || (st.st_size as usize) < len {
+            libc::close(fd);
+            return None;
+        }
+        let ptr = libc::mmap(
+            std::ptr::null_mut(),
+            len,
+            libc::PROT_READ,
+            libc::MAP_SHARED,
+            fd,
+            0,
+        );
+        libc::close(fd);
+        if ptr == libc::MAP_FAILED {
+            return None;
+        }
+        let header = &*ptr.cast::<SegmentHeader>();
+        let owner = (header.magic.load(Ordering::Acquire) == IPC_MAGIC)
+            .then(|| header.server_pid.load(Ordering::Relaxed))
+            .filter(|&pid| pid != 0);
+        libc::munmap(ptr, len);
+        owner
+    }
+}
+
+/// Wait until `word` no longer holds `expected`, at most `timeout` (spurious wakeups possible)
+fn futex_wait(word: &AtomicU32, expected: u32, timeout: Duration) {
+    let ts = libc::timespec {
+        tv_sec: timeout.as_secs() as libc::time_t,
+        tv_nsec: timeout.subsec_nanos() as libc::c_long,
+    };
+    // SAFETY: `word` is a valid, aligned u32 for the duration of the call; not FUTEX_PRIVATE,
+    // since the word lives in memory shared with other processes
+    unsafe {
+        libc::syscall(
+            libc::SYS_futex,
+            word.as_ptr(),
+            libc::FUTEX_WAIT,
+            expected,
+            &ts as *const libc::timespec,
+        );
+    }
+}
+
+/// Wake every waiter on `word`
+fn futex_wake(word: &AtomicU32) {
+    // SAFETY: see `futex_wait`
+    unsafe {
+        libc::syscall(libc::SYS_futex, word.as_ptr(), libc::FUTEX_WAKE, i32::MAX);
+    }
+}
+
+/// Mapped shared-memory segment, unlinked when dropped
+struct SharedMemory {
+    name: CString,
+    ptr: NonNull<u8>,
+    len: usize,
+}
+
+// SAFETY: the mapping is only accessed through atomics or slot memory owned by the protocol
+unsafe impl Send for SharedMemory {}
+
+impl SharedMemory {
+    /// Create a zero-filled segment of `len` bytes, replacing a stale one whose server exited.
+    ///
+    /// # Errors
+    ///
+    /// Fails if the segment exists and its server is still running.
+    fn create(name: &str, len: usize) -> Result<Self> {
+        let cname = CString::new(name)
+            .map_err(|_| AppError::Config(format!("Invalid shared memory name: {:?}", name)))?;
+        let flags = libc::O_CREAT | libc::O_EXCL | libc::O_RDWR;
+        // SAFETY: plain libc calls on a NUL-terminated name; results are checked
+        unsafe {
+            let mut fd = libc::shm_open(cname.as_ptr(), flags, 0o600);
+            if fd < 0 && std::io::Error::last_os_error().raw_os_error() == Some(libc::EEXIST) {
+                if let Some(pid) = segment_owner(&cname).filter(|&pid| process_alive(pid)) {
+                    return Err(AppError::Config(format!(
+                        "Shared memory segment {} is in use by server process {}",
+                        name, pid
+                    )));
+                }
+                tracing::warn!("Replacing stale shared memory segment {}", name);
+                libc::shm_unlink(cname.as_ptr());
+                fd = libc::shm_open(cname.as_ptr(), flags, 0o600);
+            }
+            if fd < 0 {
+                return Err(last_os_error("shm_open failed"));
+            }
+            if libc::ftruncate(fd, len as libc::off_t) != 0 {
+                let e = last_os_error("ftruncate failed");
+                libc::close(fd);
+                libc::shm_unlink(cname.as_ptr());
+                return Err(e);
+            }
+            let ptr = libc::mmap(
+                std::ptr::null_mut(),
+                len,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_SHARED,
+                fd,
+                0,
+            );
+            libc::close(fd);
+            if ptr == libc::MAP_FAILED {
+                libc::shm_unlink(cname.as_ptr());
+                return Err(last_os_error("mmap failed"));
+            }
+            Ok(Self {
+                name: cname,
+                ptr: NonNull::new_unchecked(ptr.cast()),
+                len,
+            })
+        }
+    }
+}
+
+impl Drop for SharedMemory {
+    fn drop(&mut self) {
+        // SAFETY: unmapping our own mapping; clients keep theirs until they close
+        unsafe {
+            libc::munmap(self.ptr.as_ptr().cast(), self.len);
+            libc::shm_unlink(self.name.as_ptr());
+        }
+    }
+}
+
+/// Typed view of the segment layout
+struct Segment {
+    shm: SharedMemory,
+    slot_count: usize,
+    max_detections: usize,
+    slot_bytes: usize,
+    slot_stride: usize,
+}
+
+impl Segment {
+    /// Offset of the frame data within a slot
+    const fn frame_offset(max_detections: usize) -> usize {
+        align_up(size_of::<SlotHeader>() + max_detections * size_of::<IpcDetection>())
+    }
+
+    fn create(config: &IpcConfig) -> Result<Self> {
+        if config.slots == 0 || config.slot_bytes == 0 {
+            return Err(AppError::Config(
+                "IPC server needs at least one slot of non-zero size".to_string(),
+            ));
+        }
+        let slot_stride = align_up(Self::frame_offset(config.max_detections) + config.slot_bytes);
+        let len = size_of::<SegmentHeader>() + config.slots * slot_stride;
+        let segment = Self {
+            shm: SharedMemory::create(&config.shm_name, len)?,
+            slot_count: config.slots,
+            max_detections: config.max_detections,
+            slot_bytes: config.slot_bytes,
+            slot_stride,
+        };
+
+        let header = segment.header();
+        header.version.store(IPC_VERSION, Ordering::Relaxed);
+        header
+            .slot_count
+            .store(config.slots as u32, Ordering::Relaxed);
+        header
+            .max_detections
+            .store(config.max_detections as u32, Ordering::Relaxed);
+        header
+            .slot_bytes
+            .store(config.slot_bytes as u64, Ordering::Relaxed);
+        header
+            .slot_stride
+            .store(slot_stride as u64, Ordering::Relaxed);
+        header.running.store(1, Ordering::Relaxed);
+        header
+            .server_pid
+            .store(std::process::id(), Ordering::Relaxed);
+        // clients wait for the magic before reading the layout
+        header.magic.store(IPC_MAGIC, Ordering::Release);
+        Ok(segment)
+    }
+
+    fn header(&self) -> &SegmentHeader {
+        // SAFETY: the segment starts with a zero-initialized SegmentHeader of atomics
+        unsafe { &*self.shm.ptr.as_ptr().cast::<SegmentHeader>() }
+    }
+
+    fn slot_ptr(&self, slot: usize) -> *mut u8 {
+        debug_assert!(slot < self.slot_count);
+        // SAFETY: in bounds of the mapping for every slot index
+        unsafe {
+            self.shm
+                .ptr
+                .as_ptr()
+                .add(size_of::<SegmentHeader>() + slot * self.slot_stride)
+        }
+    }
+
+    fn slot(&self, slot: usize) -> &SlotHeader {
+        // SAFETY: every slot starts with an aligned SlotHeader of atomics
+        unsafe { &*self.slot_ptr(slot).cast::<SlotHeader>() }
+    }
+
+    /// Claim up to `n` ready slots (READY → BUSY), scanning round-robin from `next`
+    fn claim_ready(&self, n: usize, next: &mut usize, claimed: &mut Vec<usize>) {
+        for _ in 0..self.slot_count {
+            if claimed.len() >= n {
+                break;
+            }
+            let slot = *next;
+            *next = (*next + 1) % self.slot_count;
+            let ready = self.slot(slot).state.compare_exchange(
+                SLOT_READY,
+                SLOT_BUSY,
+                Ordering::Acquire,
+                Ordering::Relaxed,
+            );
+            if ready.is_ok() {
+                claimed.push(slot);
+            }
+        }
+    }
+
+    /// Free the slots held by clients that exited (claimed, ready or done but never released);
+    /// returns how many were taken back
+    fn reclaim_orphaned(&self) -> usize {
+        let mut reclaimed = 0;
+        for slot in 0..self.slot_count {
+            let header = self.slot(slot);
+            let state = header.state.load(Ordering::Acquire);
+            if !matches!(state, SLOT_WRITING | SLOT_READY | SLOT_DONE) {
+                continue;
+            }
+            // 0: the client claimed the slot but did not record its pid yet
+            let owner = header.owner_pid.load(Ordering::Relaxed);
+            if owner == 0 || process_alive(owner) {
+                continue;
+            }
+            let freed = header
+                .state
+                .compare_exchange(state, SLOT_FREE, Ordering::AcqRel, Ordering::Relaxed)
+                .is_ok();
+            if freed {
+                header.owner_pid.store(0, Ordering::Relaxed);
+                reclaimed += 1;
+            }
+        }
+        if reclaimed > 0 {
+            let released = &self.header().released;
+            released.fetch_add(1, Ordering::Release);
+            futex_wake(released);
+        }
+        reclaimed
+    }
+
+    /// Copy the frame of a busy slot into a pooled image (`None` if its description is invalid)
+    fn read_frame(&self, slot: usize) -> Option<DynamicImage> {
+        let header = self.slot(slot);
+        let (width, height) = (
+            header.width.load(Ordering::Relaxed),
+            header.height.load(Ordering::Relaxed),
+        );
+        let channels = header.channels.load(Ordering::Relaxed) as usize;
+        let stride = header.stride.load(Ordering::Relaxed) as usize;
+        let row_size = width as usize * channels;
+        if width == 0
+            || height == 0
+            || !matches!(channels, 1 | 3 | 4)
+            || stride < row_size
+            || stride * (height as usize - 1) + row_size > self.slot_bytes
+        {
+            return None;
+        }
+
+        // SAFETY: the client handed the slot over (READY → BUSY, acquire); the frame region
+        // holds at least `stride * (height - 1) + row_size` bytes, checked above
+        let frame = unsafe {
+            std::slice::from_raw_parts(
+                self.slot_ptr(slot)
+                    .add(Self::frame_offset(self.max_detections)),
+                stride * (height as usize - 1) + row_size,
+            )
+        };
+        let mut buffer = frame_pool().take(row_size * height as usize);
+        for row in frame.chunks(stride) {
+            buffer.extend_from_slice(&row[..row_size]);
+        }
+        match channels {
+            1 => GrayImage::from_raw(width, height, buffer).map(DynamicImage::ImageLuma8),
+            3 => RgbImage::from_raw(width, height, buffer).map(DynamicImage::ImageRgb8),
+            _ => RgbaImage::from_raw(width, height, buffer).map(DynamicImage::ImageRgba8),
+        }
+    }
+
+    /// Write the detections of `result` and `status` into a busy slot, then hand it back
+    fn complete(&self, slot: usize, result: Option<&ul::Results>, status: i32) {
+        let header = self.slot(slot);
+        let rows = result
+            .and_then(|r| r.boxes.as_ref())
+            .filter(|boxes| boxes.data.ncols() == 6)
+            .and_then(|boxes| boxes.data.as_slice())
+            .unwrap_or(&[]);
+
+        // SAFETY: the detection array follows the slot header, `max_detections` entries long
+        let detections = unsafe {
+            std::slice::from_raw_parts_mut(
+                self.slot_ptr(slot)
+                    .add(size_of::<SlotHeader>())
+                    .cast::<IpcDetection>(),
+                self.max_detections,
+            )
+        };
+        let mut count = 0;
+        for (dst, row) in detections.iter_mut().zip(rows.chunks_exact(6)) {
+            *dst = IpcDetection {
+                x1: row[0],
+                y1: row[1],
+                x2: row[2],
+                y2: row[3],
+                conf: row[4],
+                cls: row[5],
+            };
+            count += 1;
+        }
+
+        header
+            .detection_count
+            .store(count as u32, Ordering::Relaxed);
+        header.status.store(status as u32, Ordering::Relaxed);
+        header.state.store(SLOT_DONE, Ordering::Release);
+        futex_wake(&header.state);
+    }
+}
+
+//================================================================================
+// Server
+//================================================================================
+
+/// Inference server owning the model and the shared-memory segment of its clients
+pub struct IpcServer {
+    segment: Segment,
+    model: ul::YOLOModel,
+    args: PredictArgs,
+}
+
+impl IpcServer {
+    /// Load the model of `args` (warmed up, see [`load_model`]) and create the segment
+    pub fn new(args: PredictArgs, config: &IpcConfig) -> Result<Self> {
+        if args.devices().len() > 1 {
+            tracing::warn!("IPC server runs a single model replica, extra devices are ignored");
+        }
+        let model = load_model(&args, &ThreadBudget::from_args(&args))?;
+        let segment = Segment::create(config)?;
+        tracing::info!(
+            "IPC server listening on {} ({} slots of {} bytes)",
+            config.shm_name,
+            config.slots,
+            config.slot_bytes
+        );
+        Ok(Self {
+            segment,
+            model,
+            args,
+        })
+    }
+
+    /// Serve frames until `stop` is set.
+    ///
+    /// Ready frames of all clients are batched together: the first one opens a batch, which is
+    /// inferred once it holds `batch` frames or `max_wait_us` has passed.
+    pub fn run(&mut self, stop: &AtomicBool) -> Result<()> {
+        let batch_size = self.args.batch.unwrap_or(1).max(1);
+        let max_wait = Duration::from_micros(self.args.max_wait_us.unwrap_or(1000));
+        let mut batcher = AdaptiveBatch::from_args(&self.args);
+        let (mut next_slot, mut frame_idx) = (0, 0);
+        let mut batch = Vec::with_capacity(batch_size);
+        let mut last_reclaim = Instant::now();
+
+        while !stop.load(Ordering::Relaxed) {
+            if last_reclaim.elapsed() >= RECLAIM_INTERVAL {
+                let reclaimed = self.segment.reclaim_orphaned();
+                if reclaimed > 0 {
+                    tracing::warn!("Reclaimed {} IPC slots of exited clients", reclaimed);
+                }
+                last_reclaim = Instant::now();
+            }
+
+            let doorbell = &self.segment.header().doorbell;
+            let rung = doorbell.load(Ordering::Acquire);
+            self.segment
+                .claim_ready(batch_size, &mut next_slot, &mut batch);
+            if batch.is_empty() {
+                futex_wait(doorbell, rung, IDLE_WAIT);
+                continue;
+            }
+
+            // keep filling the batch until it is full or the deadline passes
+            let deadline = Instant::now() + max_wait;
+            while batch.len() < batch_size {
+                let now = Instant::now();
+                if now >= deadline {
+                    break;
+                }
+                let rung = doorbell.load(Ordering::Acquire);
+                let before = batch.len();
+                self.segment
+                    .claim_ready(batch_size, &mut next_slot, &mut batch);
+                if batch.len() == before {
+                    futex_wait(doorbell, rung, deadline - now);
+                }
+            }
+
+            self.infer_slots(&mut batcher, &batch, &mut frame_idx);
+            batch.clear();
+        }
+
+        self.shutdown();
+        Ok(())
+    }
+
+    /// Infer the frames of claimed slots as one batch and complete them
+    fn infer_slots(&mut self, batcher: &mut AdaptiveBatch, slots: &[usize], frame_idx: &mut usize) {
+        let mut valid = Vec::with_capacity(slots.len());
+        let mut images = Vec::with_capacity(slots.len());
+        let mut metas = Vec::with_capacity(slots.len());
+        for &slot in slots {
+            let Some(image) = self.segment.read_frame(slot) else {
+                tracing::error!("Invalid frame in IPC slot {}, skipping", slot);
+                self.segment.complete(slot, None, STATUS_INVALID_FRAME);
+                continue;
+            };
+            valid.push(slot);
+            images.push(image);
+            metas.push(SourceMeta {
+                frame_idx: *frame_idx,
+                total_frames: 0,
+                source_path: None,
+                tag: Some(self.segment.slot(slot).tag.load(Ordering::Relaxed)),
+                timestamp: None,
+                timings: FrameTimings::start(),
+            });
+            *frame_idx += 1;
+        }
+        if valid.is_empty() {
+            return;
+        }
+
+        let results = batcher.infer(&mut self.model, &images, &metas, None, self.args.verbose);
+        for (&slot, result) in valid.iter().zip(&results) {
+            let status = if result.is_some() {
+                STATUS_OK
+            } else {
+                STATUS_INFER_FAILED
+            };
+            self.segment
+                .complete(slot, result.as_ref().map(|p| &p.result), status);
+        }
+        for image in images {
+            frame_pool().recycle(image);
+        }
+    }
+
+    /// Fail pending frames and tell clients the server is gone
+    fn shutdown(&self) {
+        let header = self.segment.header();
+        header.running.store(0, Ordering::Release);
+        for slot in 0..self.segment.slot_count {
+            let state = &self.segment.slot(slot).state;
+            let pending = state
+                .compare_exchange(SLOT_READY, SLOT_BUSY, Ordering::Acquire, Ordering::Relaxed)
+                .is_ok();
+            if pending {
+                self.segment.complete(slot, None, STATUS_SHUTDOWN);
+            } else {
+                futex_wake(state);
+            }
+        }
+        futex_wake(&header.released);
+        tracing::info!("IPC server stopped");
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_segment_slot_round_trip() {
+        let config = IpcConfig {
+            shm_name: format!("/yolo_inference_test_{}", std::process::id()),
+            slots: 2,
+            slot_bytes: 64,
+            max_detections: 4,
+        };
+        let segment = Segment::create(&config).unwrap();
+        assert_eq!(segment.header().magic.load(Ordering::Acquire), IPC_MAGIC);
+
+        // client side: a 4x2 RGB frame with padded rows in slot 1
+        let slot = segment.slot(1);
+        slot.width.store(4, Ordering::Relaxed);
+        slot.height.store(2, Ordering::Relaxed);
+        slot.channels.store(3, Ordering::Relaxed);
+        slot.stride.store(16, Ordering::Relaxed);
+        let frame_offset = Segment::frame_offset(config.max_detections);
+        unsafe {
+            let frame = segment.slot_ptr(1).add(frame_offset);
+            std::ptr::write_bytes(frame, 7, 12);
+            std::ptr::write_bytes(frame.add(16), 9, 12);
+        }
+        slot.state.store(SLOT_READY, Ordering::Release);
+
+        let (mut next, mut claimed) = (0, Vec::new());
+        segment.claim_ready(4, &mut next, &mut claimed);
+        assert_eq!(claimed, vec![1]);
+        assert_eq!(slot.state.load(Ordering::Relaxed), SLOT_BUSY);
+
+        let image = segment.read_frame(1).unwrap();
+        assert_eq!((image.width(), image.height()), (4, 2));
+        assert_eq!(image.as_bytes(), [[7u8; 12], [9u8; 12]].concat());
+
+        segment.complete(1, None, STATUS_OK);
+        assert_eq!(slot.state.load(Ordering::Acquire), SLOT_DONE);
+        assert_eq!(slot.detection_count.load(Ordering::Relaxed), 0);
+
+        // frames larger than the slot are rejected
+        slot.height.store(8, Ordering::Relaxed);
+        assert!(segment.read_frame(1).is_none());
+
+        // the segment of a running server is not replaced
+        assert!(Segment::create(&config).is_err());
+    }
+
+    #[test]
+    fn test_reclaim_slots_of_exited_clients() {
+        let config = IpcConfig {
+            shm_name: format!("/yolo_inference_reclaim_test_{}", std::process::id()),
+            slots: 3,
+            slot_bytes: 64,
+            max_detections: 0,
+        };
+        let segment = Segment::create(&config).unwrap();
+        // pid of a reaped child, no longer alive
+        let mut child = std::process::Command::new("true").spawn().unwrap();
+        child.wait().unwrap();
+        let exited = child.id();
+
+        let holders = [
+            (SLOT_DONE, exited),
+            (SLOT_WRITING, 0),
+            (SLOT_READY, std::process::id()),
+        ];
+        for (slot, &(state, pid)) in holders.iter().enumerate() {
+            segment.slot(slot).owner_pid.store(pid, Ordering::Relaxed);
+            segment.slot(slot).state.store(state, Ordering::Release);
+        }
+
+        assert_eq!(segment.reclaim_orphaned(), 1);
+        assert_eq!(segment.slot(0).state.load(Ordering::Acquire), SLOT_FREE);
+        assert_eq!(segment.slot(1).state.load(Ordering::Acquire), SLOT_WRITING);
+        assert_eq!(segment.slot(2).state.load(Ordering::Acquire), SLOT_READY);
+    }
+}
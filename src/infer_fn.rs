@@ -3,23 +3,36 @@ mod batch_channel_ppl;
 mod batch_sequential;
 mod batch_utils;
 mod channel_ppl;
+mod dynamic_batch_ppl;
 mod sequential;
+mod stream_ppl;
+mod tiling;
 
 pub use batch_channel_ppl::batch_channel_pipeline_infer;
 pub use batch_sequential::batch_sequential_infer;
 pub use channel_ppl::channel_pipeline_infer;
+pub use dynamic_batch_ppl::dynamic_batch_pipeline_infer;
 pub use sequential::sequential_infer;
+pub use stream_ppl::StreamPipeline;
+pub use tiling::{TileRect, Tiling};
+
+#[allow(unused_imports)]
+pub(crate) use batch_utils::AdaptiveBatch;
 
 // -- external imports
 use image::DynamicImage;
 use serde::Deserialize;
+use std::borrow::Cow;
 use std::str::FromStr;
 use strum::{Display, EnumString, VariantNames};
 use ultralytics_inference as ul;
 
-use crate::error::Result;
+use crate::error::{AppError, Result};
+use crate::masks::RleMasks;
 use crate::predict::PredictArgs;
 use crate::source::{Source, SourceMeta};
+use crate::stats::PipelineStats;
+use crate::thread_budget::ThreadBudget;
 
 // -- enums
 
@@ -38,6 +51,9 @@ pub enum InferFn {
 
     #[strum(serialize = "BatchChannelPipeline")]
     BatchChannelPipeline,
+
+    #[strum(serialize = "DynamicBatchPipeline")]
+    DynamicBatchPipeline,
 }
 
 impl Default for InferFn {
@@ -63,12 +79,40 @@ where
 
 // -- structs
 
+/// Model output of one frame, as passed between pipeline stages
+#[derive(Debug, Clone)]
+pub struct Prediction {
+    /// Raw inference results from yolo model, without dense masks if they were compacted
+    pub result: ul::Results,
+
+    /// Run-length encoded masks, see [`PredictArgs::compact_masks`]
+    pub masks: Option<RleMasks>,
+}
+
+impl Prediction {
+    /// Results of a frame; with `compact_masks`, dense masks are binarized, run-length encoded
+    /// and dropped right away
+    pub fn new(mut result: ul::Results, compact_masks: bool) -> Self {
+        let masks = if compact_masks {
+            let masks = RleMasks::from_results(&result);
+            result.masks = None;
+            masks
+        } else {
+            None
+        };
+        Self { result, masks }
+    }
+}
+
 /// Inference result for a single image/frame
 #[derive(Debug)]
 pub struct InferResult {
     /// Raw inference results from yolo model
     pub result: ul::Results,
 
+    /// Run-length encoded masks, replacing `result.masks` if `compact_masks` is set
+    pub masks: Option<RleMasks>,
+
     /// Annotated image after inference
     pub annotated: Option<DynamicImage>,
 
@@ -76,27 +120,67 @@ pub struct InferResult {
     pub meta: SourceMeta,
 }
 
+impl InferResult {
+    pub fn new(prediction: Prediction, annotated: Option<DynamicImage>, meta: SourceMeta) -> Self {
+        Self {
+            result: prediction.result,
+            masks: prediction.masks,
+            annotated,
+            meta,
+        }
+    }
+}
+
 // -- public API
 
 /// Perform model inference.
 ///
 /// - You can choose inference functions via `infer_fn`.
+/// - `models` holds one or more model replicas; only `BatchChannelPipeline` uses more than the
+///   first one.
 /// - To avoid huge memory consumption, results are returned via `return_results` argument if
 ///   provided.
-pub fn auto_infer(
-    model: &mut ul::YOLOModel,
-    source: &Source,
+/// - `source` is borrowed (`&Source`) or owned (`Source`); in-memory images of an owned source are
+///   moved through the pipeline instead of copied.
+/// - `budget` is the CPU budget of the run (see [`ThreadBudget::from_args`]), shared by all its
+///   stages.
+/// - Returns per-stage stats of the pipeline run.
+pub fn auto_infer<'s>(
+    models: &mut [ul::YOLOModel],
+    source: impl Into<Cow<'s, Source>>,
     infer_fn: &InferFn,
     args: &PredictArgs,
+    budget: &ThreadBudget,
     return_results: &mut Option<Vec<InferResult>>,
-) -> Result<()> {
+) -> Result<PipelineStats> {
+    if models.is_empty() {
+        return Err(AppError::ModelLoad("No model loaded".to_string()));
+    }
+    let source = source.into();
+    if (args.tiling().is_some() || args.caches_results())
+        && matches!(infer_fn, InferFn::Sequential | InferFn::ChannelPipeline)
+    {
+        tracing::warn!(
+            "tile_size and the result cache are ignored by {}, use a batch inference function",
+            infer_fn
+        );
+    }
+
     match infer_fn {
-        InferFn::Sequential => sequential_infer(model, source, args, return_results)?,
-        InferFn::BatchSequential => batch_sequential_infer(model, source, args, return_results)?,
-        InferFn::ChannelPipeline => channel_pipeline_infer(model, source, args, return_results)?,
+        InferFn::Sequential => {
+            sequential_infer(&mut models[0], source, args, budget, return_results)
+        }
+        InferFn::BatchSequential => {
+            batch_sequential_infer(&mut models[0], source, args, budget, return_results)
+        }
+        InferFn::ChannelPipeline => {
+            channel_pipeline_infer(&mut models[0], source, args, budget, return_results)
+        }
         InferFn::BatchChannelPipeline => {
-            batch_channel_pipeline_infer(model, source, args, return_results)?
+            batch_channel_pipeline_infer(models, source, args, budget, return_results)
+        }
+        InferFn::DynamicBatchPipeline => {
+            dynamic_batch_pipeline_infer(&mut models[0], source, args, budget, return_results)
         }
     }
-    Ok(())
 }
@@ -1,39 +1,55 @@
 use image::DynamicImage;
-use indicatif::{ProgressBar, ProgressFinish};
-use std::sync::mpsc;
+use indicatif::ProgressFinish;
+use std::borrow::Cow;
+use std::sync::Arc;
+use std::sync::atomic::AtomicBool;
 use std::thread;
+use std::time::Instant;
 use ultralytics_inference as ul;
 
-use crate::annotate::annotate_image;
+use crate::annotate::annotate_frame;
+use crate::buffer_pool::frame_pool;
 use crate::error::Result;
 use crate::predict::PredictArgs;
-use crate::progress_bar::progress_bar_style;
+use crate::progress_bar::progress_bar;
+use crate::result_sink::ResultSink;
 use crate::source::{BatchSourceLoader, Source, SourceMeta};
+use crate::stats::{DoneOnDrop, PipelineRecorder, PipelineStats, SharedReceiver, spawn_exporter,
+                   timed_channel};
+use crate::thread_budget::{Stage, ThreadBudget};
+use crate::writer::ImageWriter;
 
-use super::InferResult;
-use super::batch_utils::{batch_infer_fallback, get_batch_frame_names};
+use super::batch_utils::{AdaptiveBatch, ReorderBuffer, get_batch_frame_names};
+use super::{InferResult, Prediction};
 
 /// Channel-based concurrent pipeline for batch inference
 ///
+/// - One inference worker is spawned per model replica in `models`; idle workers pull the next
+///   batch from a shared queue, and batches are put back into input order before annotation.
 /// - To avoid huge memory consumption, results are returned via `return_results` argument if
 ///   provided.
+/// - The annotation stage runs `annotate_workers` threads; annotated frames are put back into input
+///   order before saving as well.
+/// - The reorder step is reported as its own `reorder` stage in the returned stats.
 pub fn batch_channel_pipeline_infer(
-    model: &mut ul::YOLOModel,
-    source: &Source,
+    models: &mut [ul::YOLOModel],
+    source: Cow<'_, Source>,
     args: &PredictArgs,
+    budget: &ThreadBudget,
     return_results: &mut Option<Vec<InferResult>>,
-) -> Result<()> {
+) -> Result<PipelineStats> {
     let annotate = args.annotate;
     let annotate_cfg = &args.annotate_cfg;
     let save_dir = &args.save_dir;
     let channel_capacity = args.channel_capacity.unwrap_or(8);
     let batch_size = args.batch.unwrap_or(1);
+    let annotate_workers = args.annotate_workers(budget);
     let verbose = args.verbose;
     let save = annotate && save_dir.is_some();
 
     tracing::info!("Running channel-based batch pipeline inference...");
     tracing::info!("[Source]: {:?}", source);
-    tracing::info!("Batch Size: {}", batch_size);
+    tracing::info!("Batch Size: {}, Replicas: {}", batch_size, models.len());
 
     if let Some(dir) = save_dir {
         if dir.is_dir() {
@@ -42,47 +58,76 @@ pub fn batch_channel_pipeline_infer(
         }
         std::fs::create_dir_all(dir).expect("Failed to create save directory");
     }
+    let writer = ImageWriter::from_args(args, budget)?;
+    let mut sink = ResultSink::from_args(args)?;
 
-    let loader = BatchSourceLoader::new(source, Some(batch_size))?;
+    let loader = BatchSourceLoader::new(source, Some(batch_size))?
+        .with_decode_threads(args.decode_workers(budget), budget.pinned(Stage::Decode))?
+        .with_video_options(args.video_options());
     let total_batches = loader.len();
     let total_frames = loader.total_frames();
-    tracing::info!("Total batches to process: {}", total_batches);
-    tracing::info!("Total frames to process: {}", total_frames);
+    if let Some(total) = total_batches {
+        tracing::info!("Total batches to process: {}", total);
+    }
+    match total_frames {
+        Some(total) => tracing::info!("Total frames to process: {}", total),
+        None => tracing::info!("Total frames to process: unknown (streamed source)"),
+    }
     tracing::info!("-----------------------------------------");
 
     // preserve space in return_results if provided
     if let Some(vec) = return_results.as_mut() {
         vec.clear();
-        vec.reserve(total_frames);
+        vec.reserve(total_frames.unwrap_or(0));
     }
 
-    let pseudo_paths = vec!["".to_string(); batch_size];
-
-    // Define data types for each pipeline stage
+    // Define data types for each pipeline stage. Reordered frames carry a sequence number (before
+    // the batch index) for the reorder buffer in front of the saving stage; frames dropped by an
+    // annotation worker are sent as `None` so that it never waits for a missing number.
     type LoadStage = (usize, Vec<DynamicImage>, Vec<SourceMeta>);
-    type InferStage = (usize, DynamicImage, ul::Results, SourceMeta);
-    type AnnotateStage = (usize, Option<DynamicImage>, ul::Results, SourceMeta);
-    type SaveStage = (usize, Option<DynamicImage>, ul::Results, SourceMeta);
+    type ReorderStage = (usize, Vec<(DynamicImage, Prediction, SourceMeta)>);
+    type InferStage = (usize, usize, DynamicImage, Prediction, SourceMeta);
+    type AnnotateStage = (
+        usize,
+        Option<(usize, Option<DynamicImage>, Prediction, SourceMeta)>,
+    );
+    type SaveStage = (usize, Option<DynamicImage>, Prediction, SourceMeta);
 
-    // Create channels for each stage with bounded capacity
-    let (load_tx, load_rx) = mpsc::sync_channel::<LoadStage>(channel_capacity);
-    let (infer_tx, infer_rx) = mpsc::sync_channel::<InferStage>(channel_capacity);
-    let (annotate_tx, annotate_rx) = mpsc::sync_channel::<AnnotateStage>(channel_capacity);
-    let (save_tx, save_rx) = mpsc::sync_channel::<SaveStage>(channel_capacity);
+    // Create instrumented channels for each stage with bounded capacity (load stage: prefetch
+    // depth)
+    let recorder = Arc::new(PipelineRecorder::new(&[
+        "load", "infer", "reorder", "annotate", "save", "collect",
+    ]));
+    let (load_tx, load_rx) =
+        timed_channel::<LoadStage>(args.prefetch_depth(), &recorder, "load", "infer");
+    let (reorder_tx, reorder_rx) =
+        timed_channel::<ReorderStage>(channel_capacity, &recorder, "infer", "reorder");
+    let (infer_tx, infer_rx) =
+        timed_channel::<InferStage>(channel_capacity, &recorder, "reorder", "annotate");
+    let (annotate_tx, annotate_rx) =
+        timed_channel::<AnnotateStage>(channel_capacity, &recorder, "annotate", "save");
+    let (save_tx, save_rx) =
+        timed_channel::<SaveStage>(channel_capacity, &recorder, "save", "collect");
 
     // initialize progress bar
-    let pb = ProgressBar::new(total_frames as u64)
-        .with_style(progress_bar_style())
-        .with_message("Running inference")
-        .with_finish(ProgressFinish::WithMessage("Finished".into()));
+    let pb = progress_bar(total_frames).with_finish(ProgressFinish::WithMessage("Finished".into()));
 
-    // record if batch inference has failed before
-    let mut infer_failed = false;
+    // shared work queues for all inference / annotation workers
+    let load_rx = SharedReceiver::new(load_rx);
+    let load_rx = &load_rx;
+    let infer_rx = SharedReceiver::new(infer_rx);
+    let infer_rx = &infer_rx;
+    let rec = &*recorder;
+    let done = AtomicBool::new(false);
 
-    // Use scoped threads to allow borrowing model
+    // Use scoped threads to allow borrowing models
     thread::scope(|s| {
+        let exporter = spawn_exporter(s, args.stats_export(), rec, &done);
+
         // Stage 1: Image Loading thread
         let load_handle = s.spawn(move || {
+            let _stage = rec.stage("load").enter();
+            budget.pin(Stage::Control);
             for (batch_idx, (batch_images, batch_metas)) in loader.enumerate() {
                 if verbose {
                     let batch_frame_names = get_batch_frame_names(&batch_metas);
@@ -99,145 +144,230 @@ pub fn batch_channel_pipeline_infer(
             }
         });
 
-        // Stage 2: Model Inference thread
-        let infer_handler = s.spawn(move || {
-            while let Ok((batch_idx, batch_images, batch_metas)) = load_rx.recv() {
-                if verbose {
-                    let batch_frame_names = get_batch_frame_names(&batch_metas);
-                    tracing::debug!("[Inferring] batch {}: {:?}", batch_idx, batch_frame_names);
-                }
+        // Stage 2: Model Inference threads, one per model replica
+        let infer_handlers: Vec<_> = models
+            .iter_mut()
+            .enumerate()
+            .map(|(replica_idx, model)| {
+                let reorder_tx = reorder_tx.clone();
+                s.spawn(move || {
+                    let _stage = rec.stage("infer").enter();
+                    budget.pin(Stage::Infer(replica_idx));
+                    // batch size adapted to failed batches
+                    let mut batcher = AdaptiveBatch::from_args(args);
 
-                let batch_results: Vec<Option<ul::Results>> = if !infer_failed {
-                    match model
-                        .predict_batch(&batch_images, &pseudo_paths)
-                    {
-                        Ok(vec) => {
-                            // try to extract first element from each
-                            vec.into_iter().map(|mut v| Some(v.remove(0))).collect()
-                        }
-                        Err(e) => {
-                            // Failed first time, falling back to sequential per-image inference stage
-                            tracing::warn!(
-                                "Batch inference failed for batch {}, falling back to sequential per-image inference stage.",
+                    loop {
+                        let Ok((batch_idx, batch_images, batch_metas)) = load_rx.recv() else {
+                            break;
+                        };
+
+                        if verbose {
+                            let batch_frame_names = get_batch_frame_names(&batch_metas);
+                            tracing::debug!(
+                                "[Inferring] replica {} batch {}: {:?}",
+                                replica_idx,
                                 batch_idx,
+                                batch_frame_names
                             );
-                            tracing::error!("> Error details: {:?}", e);
-                            infer_failed = true;
-                            batch_infer_fallback(model, &batch_images, &batch_metas, verbose)
+                        }
+
+                        let batch_results: Vec<Option<Prediction>> = batcher.infer(
+                            model,
+                            &batch_images,
+                            &batch_metas,
+                            Some(rec.stage("infer")),
+                            verbose,
+                        );
+
+                        // Keep valid inference results only. The batch is always sent, even if
+                        // empty, so that the reorder stage never waits for a missing index.
+                        let inferred = Some(Instant::now());
+                        let batch_outputs = batch_images
+                            .into_iter()
+                            .zip(batch_results.into_iter())
+                            .zip(batch_metas.into_iter())
+                            .filter_map(|((image, result), mut meta)| {
+                                meta.timings.inferred = inferred;
+                                result.map(|r| (image, r, meta))
+                            })
+                            .collect();
+
+                        if reorder_tx.send((batch_idx, batch_outputs)).is_err() {
+                            break;
                         }
                     }
-                } else {
-                    // Fallback to sequential per-image inference stage
-                    batch_infer_fallback(model, &batch_images, &batch_metas, verbose)
-                };
-
-                // Send each valid inference result to next stage
-                for ((image, result), meta) in batch_images
-                    .into_iter()
-                    .zip(batch_results.into_iter())
-                    .zip(batch_metas.into_iter())
-                {
-                    if let Some(r) = result {
+                })
+            })
+            .collect();
+        drop(reorder_tx);
+
+        // Stage 2.5: Reorder thread - restores input order of batches across replicas
+        let reorder_handler = s.spawn(move || {
+            let _stage = rec.stage("reorder").enter();
+            budget.pin(Stage::Control);
+            let mut reorder = ReorderBuffer::default();
+            let mut seq = 0;
+            while let Ok((batch_idx, batch_outputs)) = reorder_rx.recv() {
+                reorder.push(batch_idx, batch_outputs);
+
+                while let Some((batch_idx, batch_outputs)) = reorder.pop_ready() {
+                    for (image, r, meta) in batch_outputs {
                         // Send inference results to next stage
-                        if infer_tx.send((batch_idx, image, r, meta)).is_err() {
-                            break;
+                        if infer_tx.send((seq, batch_idx, image, r, meta)).is_err() {
+                            return;
                         }
+                        seq += 1;
                     }
                 }
-
             }
         });
 
-        // Stage 3: Annotation thread
-        let annotate_handler = s.spawn(move || {
-            while let Ok((batch_idx, image, results, meta)) = infer_rx.recv() {
-                // draw annotations
-                let annotated_img = if annotate {
-                    if verbose {
-                        tracing::debug!("[Annotating] batch {}: {}", batch_idx, &meta.frame_name());
-                    }
+        // Stage 3: Annotation threads
+        let annotate_handlers: Vec<_> = (0..annotate_workers)
+            .map(|_| {
+                let annotate_tx = annotate_tx.clone();
+                s.spawn(move || {
+                    let _stage = rec.stage("annotate").enter();
+                    budget.pin(Stage::Annotate);
+                    while let Ok((seq, batch_idx, image, results, mut meta)) = infer_rx.recv() {
+                        // draw annotations
+                        let annotated_img = if annotate {
+                            if verbose {
+                                tracing::debug!(
+                                    "[Annotating] batch {}: {}",
+                                    batch_idx,
+                                    &meta.frame_name()
+                                );
+                            }
 
-                    match annotate_image(&image, &results, annotate_cfg) {
-                        Ok(img) => Some(img),
-                        Err(e) => {
-                            tracing::error!(
-                                "Annotation failed for image: {:?}, skipping. Error: {}",
-                                &meta.source_path,
-                                e
-                            );
-                            continue;
+                            match annotate_frame(image, &results, annotate_cfg) {
+                                Ok(img) => Some(img),
+                                Err(e) => {
+                                    tracing::error!(
+                                        "Annotation failed for image: {:?}, skipping. Error: {}",
+                                        &meta.source_path,
+                                        e
+                                    );
+                                    if annotate_tx.send((seq, None)).is_err() {
+                                        break;
+                                    }
+                                    continue;
+                                }
+                            }
+                        } else {
+                            // the input frame is no longer needed
+                            frame_pool().recycle(image);
+                            None
+                        };
+                        // Send annotated image to saving stage
+                        meta.timings.annotated = Some(Instant::now());
+                        if annotate_tx
+                            .send((seq, Some((batch_idx, annotated_img, results, meta))))
+                            .is_err()
+                        {
+                            break;
                         }
                     }
-                } else {
-                    None
-                };
-                // Send annotated image to saving stage
-                if annotate_tx
-                    .send((batch_idx, annotated_img, results, meta))
-                    .is_err()
-                {
-                    break;
-                }
-            }
-        });
+                })
+            })
+            .collect();
+        drop(annotate_tx);
 
-        // Stage 4: Saving thread
+        // Stage 4: Saving thread - restores input order of annotated frames first
         let save_handler = s.spawn(move || {
-            while let Ok((batch_idx, annotated_img, results, meta)) = annotate_rx.recv() {
-                if let Some(dir) = save_dir
-                    && let Some(annotated_img) = &annotated_img
-                {
-                    if verbose {
-                        tracing::debug!("[Saving] batch {}: {}", batch_idx, &meta.frame_name());
-                    }
+            let _stage = rec.stage("save").enter();
+            budget.pin(Stage::Control);
+            let mut reorder = ReorderBuffer::default();
+            while let Ok((seq, annotated)) = annotate_rx.recv() {
+                reorder.push(seq, annotated);
 
-                    let frame_stem = meta.frame_stem();
-                    let save_path = dir.join(format!("{}.png", frame_stem));
-                    if annotated_img.save(&save_path).is_err() {
-                        tracing::error!(
-                            "Failed to save annotated image to {:?}. skipping.",
-                            save_path
-                        );
+                while let Some((_, annotated)) = reorder.pop_ready() {
+                    // dropped by an annotation worker
+                    let Some((batch_idx, annotated_img, results, mut meta)) = annotated else {
                         continue;
+                    };
+
+                    if let Some(dir) = save_dir
+                        && let Some(annotated_img) = &annotated_img
+                    {
+                        if verbose {
+                            tracing::debug!("[Saving] batch {}: {}", batch_idx, &meta.frame_name());
+                        }
+
+                        let save_path = writer.save_path(dir, &meta.frame_stem());
+                        if writer.save(annotated_img, &save_path).is_err() {
+                            tracing::error!(
+                                "Failed to save annotated image to {:?}. skipping.",
+                                save_path
+                            );
+                            rec.stage("save").count_failed(1);
+                            continue;
+                        }
+                    }
+                    // Send to collection stage
+                    meta.timings.saved = Some(Instant::now());
+                    if save_tx
+                        .send((batch_idx, annotated_img, results, meta))
+                        .is_err()
+                    {
+                        return;
                     }
-                }
-                // Send to collection stage
-                if save_tx
-                    .send((batch_idx, annotated_img, results, meta))
-                    .is_err()
-                {
-                    break;
                 }
             }
+            // queued writes report their failures once done
+            rec.stage("save").count_failed(writer.flush().len() as u64);
         });
 
         // Stage 5: Collect results thread
         let collect_handler = s.spawn(move || {
-            while let Ok((batch_idx, annotated_img, results, meta)) = save_rx.recv() {
+            let _stage = rec.stage("collect").enter();
+            budget.pin(Stage::Control);
+            while let Ok((batch_idx, annotated_img, results, mut meta)) = save_rx.recv() {
+                meta.timings.collected = Some(Instant::now());
+                // Append to the result file if configured
+                if let Some(sink) = sink.as_mut()
+                    && let Err(e) = sink.write(&results, &meta)
+                {
+                    tracing::error!("Failed to write results of {}: {}", meta.frame_name(), e);
+                }
                 // Update return results vector if provided
                 if let Some(vec) = return_results {
                     if verbose {
                         tracing::debug!("[Collecting] batch {}: {}", batch_idx, &meta.frame_name());
                     }
 
-                    vec.push(InferResult {
-                        result: results,
-                        annotated: annotated_img,
-                        meta: meta.clone(),
-                    });
+                    vec.push(InferResult::new(results, annotated_img, meta.clone()));
+                } else if let Some(annotated_img) = annotated_img {
+                    frame_pool().recycle(annotated_img);
                 }
 
                 // Update progress bar
                 pb.inc(1);
             }
+            if let Some(sink) = sink
+                && let Err(e) = sink.finish()
+            {
+                tracing::error!("Failed to write result file: {}", e);
+            }
         });
 
-        // Wait for pipeline threads to finish
+        // Wait for pipeline threads to finish; the exporter stops even if one of them panicked
+        let stop_exporter = DoneOnDrop(&done);
         load_handle.join().expect("Loading thread panicked");
-        infer_handler.join().expect("Inference thread panicked");
-        annotate_handler.join().expect("Annotation thread panicked");
+        for handler in infer_handlers {
+            handler.join().expect("Inference thread panicked");
+        }
+        reorder_handler.join().expect("Reorder thread panicked");
+        for handler in annotate_handlers {
+            handler.join().expect("Annotation thread panicked");
+        }
         save_handler.join().expect("Saving thread panicked");
         collect_handler.join().expect("Collect thread panicked");
+
+        drop(stop_exporter);
+        if let Some(exporter) = exporter {
+            exporter.join().expect("Stats exporter thread panicked");
+        }
     });
 
     if save {
@@ -246,5 +376,5 @@ pub fn batch_channel_pipeline_infer(
             save_dir.as_ref().unwrap()
         );
     }
-    Ok(())
+    Ok(recorder.snapshot())
 }
@@ -1,14 +1,21 @@
-use indicatif::{ProgressBar, ProgressFinish};
+use indicatif::ProgressFinish;
+use std::borrow::Cow;
+use std::time::Instant;
 use ultralytics_inference as ul;
 
-use crate::annotate::annotate_image;
+use crate::annotate::annotate_frame;
+use crate::buffer_pool::frame_pool;
 use crate::error::Result;
 use crate::predict::PredictArgs;
-use crate::progress_bar::progress_bar_style;
+use crate::progress_bar::progress_bar;
+use crate::result_sink::ResultSink;
 use crate::source::{BatchSourceLoader, Source};
+use crate::stats::{PIPELINE_STAGES, PipelineRecorder, PipelineStats};
+use crate::thread_budget::{Stage, ThreadBudget};
+use crate::writer::ImageWriter;
 
-use super::InferResult;
-use super::batch_utils::{batch_infer_fallback, get_batch_frame_names};
+use super::batch_utils::{AdaptiveBatch, get_batch_frame_names};
+use super::{InferResult, Prediction};
 
 /// Sequential batch inference.
 ///
@@ -16,10 +23,11 @@ use super::batch_utils::{batch_infer_fallback, get_batch_frame_names};
 ///  provided.
 pub fn batch_sequential_infer(
     model: &mut ul::YOLOModel,
-    source: &Source,
+    source: Cow<'_, Source>,
     args: &PredictArgs,
+    budget: &ThreadBudget,
     return_results: &mut Option<Vec<InferResult>>,
-) -> Result<()> {
+) -> Result<PipelineStats> {
     let annotate = args.annotate;
     let annotate_cfg = &args.annotate_cfg;
     let save_dir = &args.save_dir;
@@ -38,32 +46,44 @@ pub fn batch_sequential_infer(
         }
         std::fs::create_dir_all(dir).expect("Failed to create save directory");
     }
+    let writer = ImageWriter::from_args(args, budget)?;
+    let mut sink = ResultSink::from_args(args)?;
 
-    let loader = BatchSourceLoader::new(source, Some(batch_size))?;
+    let loader = BatchSourceLoader::new(source, Some(batch_size))?
+        .with_decode_threads(args.decode_workers(budget), budget.pinned(Stage::Decode))?
+        .with_video_options(args.video_options());
     let total_batches = loader.len();
     let total_frames = loader.total_frames();
-    tracing::info!("Total batches to process: {}", total_batches);
-    tracing::info!("Total frames to process: {}", total_frames);
+    if let Some(total) = total_batches {
+        tracing::info!("Total batches to process: {}", total);
+    }
+    match total_frames {
+        Some(total) => tracing::info!("Total frames to process: {}", total),
+        None => tracing::info!("Total frames to process: unknown (streamed source)"),
+    }
     tracing::info!("-----------------------------------------");
 
     // preserve space in return_results if provided
     if let Some(vec) = return_results.as_mut() {
         vec.clear();
-        vec.reserve(total_frames);
+        vec.reserve(total_frames.unwrap_or(0));
     }
 
-    let pseudo_paths = vec!["".to_string(); batch_size];
-
     // initialize progress bar
-    let pb = ProgressBar::new(total_frames as u64)
-        .with_style(progress_bar_style())
-        .with_message("Running inference")
-        .with_finish(ProgressFinish::WithMessage("Finished".into()));
+    let pb = progress_bar(total_frames).with_finish(ProgressFinish::WithMessage("Finished".into()));
+
+    // batch size adapted to failed batches
+    let mut batcher = AdaptiveBatch::from_args(args);
+
+    // stages run inline, so only busy time and item counts are recorded
+    let recorder = PipelineRecorder::new(&PIPELINE_STAGES);
+    let (infer_stage, annotate_stage) = (recorder.stage("infer"), recorder.stage("annotate"));
+    let (save_stage, collect_stage) = (recorder.stage("save"), recorder.stage("collect"));
+    let loop_start = Instant::now();
 
-    // record if batch inference has failed before
-    let mut infer_failed = false;
+    for (batch_idx, (batch_images, mut batch_metas)) in loader.enumerate() {
+        recorder.stage("load").count(batch_images.len() as u64);
 
-    for (batch_idx, (batch_images, batch_metas)) in loader.enumerate() {
         if verbose {
             let frame_names = get_batch_frame_names(&batch_metas);
             tracing::debug!("Processing batch {}: {:?}", batch_idx, frame_names);
@@ -71,39 +91,30 @@ pub fn batch_sequential_infer(
 
         // Try to predict batch,
         // if fails, try to predict images one by one
-        let batch_results: Vec<Option<ul::Results>> = if !infer_failed {
-            match model.predict_batch(&batch_images, &pseudo_paths) {
-                Ok(vec) => {
-                    // try to extract first element from each
-                    vec.into_iter().map(|mut v| Some(v.remove(0))).collect()
-                }
-                Err(e) => {
-                    // Fallback to one by one inference
-                    tracing::warn!(
-                        "Batch inference failed for batch {}, falling back to one-by-one inference.",
-                        batch_idx,
-                    );
-                    tracing::error!("> Error details: {:?}", e);
-                    infer_failed = true;
-                    batch_infer_fallback(model, &batch_images, &batch_metas, verbose)
-                }
-            }
-        } else {
-            // Fallback to one by one inference
-            batch_infer_fallback(model, &batch_images, &batch_metas, verbose)
-        };
-
-        for (i, results) in batch_results.into_iter().enumerate() {
+        let batch_results: Vec<Option<Prediction>> = infer_stage.time(|| {
+            batcher.infer(
+                model,
+                &batch_images,
+                &batch_metas,
+                Some(infer_stage),
+                verbose,
+            )
+        });
+        infer_stage.count(batch_images.len() as u64);
+
+        let inferred = Some(Instant::now());
+        let frames = batch_images.into_iter().zip(batch_metas.iter_mut());
+        for (results, (image, meta)) in batch_results.into_iter().zip(frames) {
             // skip invalid results
             let results = match results {
                 Some(r) => r,
                 None => {
+                    frame_pool().recycle(image);
                     continue;
                 }
             };
 
-            let image = &batch_images[i];
-            let meta = &batch_metas[i];
+            meta.timings.inferred = inferred;
 
             // draw annotations
             let annotated_img = if annotate {
@@ -111,7 +122,7 @@ pub fn batch_sequential_infer(
                     tracing::debug!("[Annotating]: {}", &meta.frame_name());
                 }
 
-                match annotate_image(&image, &results, annotate_cfg) {
+                match annotate_stage.time(|| annotate_frame(image, &results, annotate_cfg)) {
                     Ok(img) => Some(img),
                     Err(e) => {
                         tracing::error!(
@@ -123,9 +134,14 @@ pub fn batch_sequential_infer(
                     }
                 }
             } else {
+                // the input frame is no longer needed
+                frame_pool().recycle(image);
                 None
             };
 
+            meta.timings.annotated = Some(Instant::now());
+            annotate_stage.count(1);
+
             // Save annotated image if required
             if let Some(dir) = save_dir
                 && let Some(annotated_img) = &annotated_img
@@ -134,34 +150,49 @@ pub fn batch_sequential_infer(
                     tracing::debug!("[Saving]: {}", &meta.frame_name());
                 }
 
-                let frame_stem = meta.frame_stem();
-                let save_path = dir.join(format!("{}.png", frame_stem));
-                if annotated_img.save(&save_path).is_err() {
+                let save_path = writer.save_path(dir, &meta.frame_stem());
+                if save_stage
+                    .time(|| writer.save(annotated_img, &save_path))
+                    .is_err()
+                {
                     tracing::error!(
                         "Failed to save annotated image to {:?}. skipping.",
                         save_path
                     );
+                    save_stage.count_failed(1);
                     continue;
                 }
             }
 
+            meta.timings.saved = Some(Instant::now());
+            save_stage.count(1);
+
+            // Append to the result file if configured
+            if let Some(sink) = sink.as_mut()
+                && let Err(e) = sink.write(&results, &meta)
+            {
+                tracing::error!("Failed to write results of {}: {}", meta.frame_name(), e);
+            }
+
             // Store results if required
             if let Some(vec) = return_results.as_mut() {
+                meta.timings.collected = Some(Instant::now());
                 if verbose {
                     tracing::debug!("[Collecting] results for: {}", &meta.frame_name());
                 }
 
-                vec.push(InferResult {
-                    result: results,
-                    annotated: annotated_img,
-                    meta: meta.clone(),
-                });
+                vec.push(InferResult::new(results, annotated_img, meta.clone()));
+            } else if let Some(annotated_img) = annotated_img {
+                frame_pool().recycle(annotated_img);
             }
 
+            collect_stage.count(1);
+
             // update progress bar
             pb.inc(1);
         }
     }
+    recorder.add_remainder("load", loop_start.elapsed());
 
     if save {
         tracing::info!(
@@ -170,5 +201,12 @@ pub fn batch_sequential_infer(
         );
     }
 
-    Ok(())
+    if let Some(sink) = sink {
+        sink.finish()?;
+    }
+    // queued writes report their failures once done
+    let save_stage = recorder.stage("save");
+    let failed = save_stage.time(|| writer.flush());
+    save_stage.count_failed(failed.len() as u64);
+    Ok(recorder.snapshot())
 }
@@ -1,7 +1,19 @@
-use image::DynamicImage;
+use image::{DynamicImage, GenericImageView};
+use std::collections::BTreeMap;
+use std::path::Path;
+use std::sync::mpsc::{Receiver, RecvTimeoutError};
+use std::time::{Duration, Instant};
 use ultralytics_inference as ul;
 
+use crate::buffer_pool::frame_pool;
+use crate::predict::PredictArgs;
+use crate::result_cache::{ResultCache, blank_results};
 use crate::source::SourceMeta;
+use crate::stats::{StageRecorder, TimedReceiver};
+use crate::warmup::{max_batch_size, start_batch_size};
+
+use super::Prediction;
+use super::tiling::Tiling;
 
 /// Get frame names for a batch of source metas
 pub fn get_batch_frame_names(batch_metas: &Vec<SourceMeta>) -> Vec<String> {
@@ -62,3 +74,486 @@ pub fn batch_infer_fallback(
 
     batch_results
 }
+
+/// Successful batches after which a reduced batch size is probed upwards again
+const ADAPTIVE_PROBE_INTERVAL: usize = 8;
+
+/// Upper bound of the probe interval, reached after repeated failed probes
+const ADAPTIVE_MAX_PROBE_INTERVAL: usize = 1024;
+
+/// Adaptive batch size of an inference stage.
+///
+/// A failed `predict_batch` (e.g. a transient out-of-memory error) halves the batch size and
+/// retries the frames in smaller chunks, down to per-image inference. After a run of successful
+/// chunks the size is doubled again, up to the configured `batch`; every failed probe doubles
+/// the run needed before the next one, so a size the model never accepts is only retried
+/// rarely. Models with a static batch dimension are capped by it up front (see
+/// [`max_batch_size`]); models whose warmup batch failed start from the size that passed (see
+/// [`start_batch_size`]).
+///
+/// With [`Tiling`], frames are cut into tiles first and the batch size counts tiles. With a
+/// [`ResultCache`], only frames missing from it are inferred.
+#[derive(Debug)]
+pub struct AdaptiveBatch {
+    max: usize,
+    limit: usize,
+    successes: usize,
+    probe_interval: usize,
+    probing: bool,
+    pseudo_paths: Vec<String>,
+    tiling: Option<Tiling>,
+    compact_masks: bool,
+    cache: Option<ResultCache>,
+    /// Results of a blank frame, for tiled frames without tiles
+    blank: Option<ul::Results>,
+}
+
+impl AdaptiveBatch {
+    /// Adaptive batch size for `model`, starting at `batch_size`
+    pub fn new(model: &Path, batch_size: usize) -> Self {
+        let max = max_batch_size(model, batch_size.max(1));
+        Self {
+            limit: start_batch_size(model, max),
+            ..Self::with_max(max)
+        }
+    }
+
+    /// Inference stage batching of `args`: `batch`, tiling, `compact_masks` and result cache
+    pub fn from_args(args: &PredictArgs) -> Self {
+        Self {
+            compact_masks: args.compact_masks,
+            cache: ResultCache::from_args(args),
+            ..Self::new(&args.model, args.batch.unwrap_or(1)).with_tiling(args.tiling())
+        }
+    }
+
+    fn with_max(max: usize) -> Self {
+        Self {
+            max,
+            limit: max,
+            successes: 0,
+            probe_interval: ADAPTIVE_PROBE_INTERVAL,
+            probing: false,
+            pseudo_paths: vec!["".to_string(); max],
+            tiling: None,
+            compact_masks: false,
+            cache: None,
+            blank: None,
+        }
+    }
+
+    /// Run tiled inference if `tiling` is set
+    pub fn with_tiling(mut self, tiling: Option<Tiling>) -> Self {
+        self.tiling = tiling;
+        self
+    }
+
+    /// Results without detections of a blank frame, inferred once
+    pub(super) fn blank_results(&mut self, model: &mut ul::YOLOModel) -> Option<ul::Results> {
+        if self.blank.is_none() {
+            self.blank = blank_results(model, "infer a frame without tiles");
+        }
+        self.blank.clone()
+    }
+
+    /// Configured batch size
+    pub const fn max(&self) -> usize {
+        self.max
+    }
+
+    /// Current batch size
+    pub const fn limit(&self) -> usize {
+        self.limit
+    }
+
+    /// Record a successful chunk, growing the batch size after a long enough run
+    fn succeeded(&mut self) {
+        if self.probing {
+            self.probing = false;
+            self.probe_interval = ADAPTIVE_PROBE_INTERVAL;
+        }
+        self.successes += 1;
+        if self.limit < self.max && self.successes >= self.probe_interval {
+            self.limit = (self.limit * 2).min(self.max);
+            self.successes = 0;
+            self.probing = true;
+        }
+    }
+
+    /// Record a failed chunk of `len` frames, halving the batch size
+    fn failed(&mut self, len: usize) {
+        if self.probing {
+            self.probing = false;
+            self.probe_interval = (self.probe_interval * 2).min(ADAPTIVE_MAX_PROBE_INTERVAL);
+        }
+        self.limit = (len / 2).max(1);
+        self.successes = 0;
+    }
+
+    /// Predictions of `images`, from the result cache or inferred; cache hits and misses are
+    /// counted on `stage`
+    pub fn infer(
+        &mut self,
+        model: &mut ul::YOLOModel,
+        images: &[DynamicImage],
+        metas: &[SourceMeta],
+        stage: Option<&StageRecorder>,
+        verbose: bool,
+    ) -> Vec<Option<Prediction>> {
+        let Some(mut cache) = self.cache.take() else {
+            return self.predict(model, images, metas, verbose);
+        };
+
+        let keys: Vec<u64> = images
+            .iter()
+            .zip(metas)
+            .map(|(image, meta)| cache.key(image, meta))
+            .collect();
+        let mut predictions: Vec<Option<Prediction>> = keys
+            .iter()
+            .zip(images)
+            .map(|(&key, image)| cache.get(key, image.dimensions(), model))
+            .collect();
+        let misses: Vec<usize> = (0..images.len())
+            .filter(|&i| predictions[i].is_none())
+            .collect();
+        if let Some(stage) = stage {
+            let misses = misses.len() as u64;
+            stage.count_cache(images.len() as u64 - misses, misses);
+        }
+
+        let inferred = if misses.len() == images.len() {
+            self.predict(model, images, metas, verbose)
+        } else if misses.is_empty() {
+            Vec::new()
+        } else {
+            // copy the missed frames into a contiguous batch
+            let miss_images: Vec<DynamicImage> = misses
+                .iter()
+                .map(|&i| frame_pool().copy(&images[i]))
+                .collect();
+            let miss_metas: Vec<SourceMeta> = misses.iter().map(|&i| metas[i].clone()).collect();
+            let inferred = self.predict(model, &miss_images, &miss_metas, verbose);
+            miss_images
+                .into_iter()
+                .for_each(|image| frame_pool().recycle(image));
+            inferred
+        };
+        for (&i, prediction) in misses.iter().zip(inferred) {
+            if let Some(prediction) = &prediction {
+                cache.put(keys[i], prediction);
+            }
+            predictions[i] = prediction;
+        }
+
+        self.cache = Some(cache);
+        predictions
+    }
+
+    /// Run inference on `images`, tiled if configured (see [`Tiling`])
+    fn predict(
+        &mut self,
+        model: &mut ul::YOLOModel,
+        images: &[DynamicImage],
+        metas: &[SourceMeta],
+        verbose: bool,
+    ) -> Vec<Option<Prediction>> {
+        let results = match self.tiling.take() {
+            Some(tiling) => {
+                let results = tiling.infer(self, model, images, metas, verbose);
+                self.tiling = Some(tiling);
+                results
+            }
+            None => self.infer_frames(model, images, metas, verbose),
+        };
+        let compact_masks = self.compact_masks;
+        results
+            .into_iter()
+            .map(|r| r.map(|r| Prediction::new(r, compact_masks)))
+            .collect()
+    }
+
+    /// Run inference on `images` in chunks of the current batch size, adapting it to failures.
+    /// Frames inferred one by one fall back to [`batch_infer_fallback`].
+    pub(super) fn infer_frames(
+        &mut self,
+        model: &mut ul::YOLOModel,
+        images: &[DynamicImage],
+        metas: &[SourceMeta],
+        verbose: bool,
+    ) -> Vec<Option<ul::Results>> {
+        let mut results = Vec::with_capacity(images.len());
+        let mut start = 0;
+        while start < images.len() {
+            let end = images.len().min(start + self.limit);
+            let chunk = &images[start..end];
+            if self.limit == 1 {
+                results.extend(batch_infer_fallback(
+                    model,
+                    chunk,
+                    &metas[start..end],
+                    verbose,
+                ));
+                self.succeeded();
+                start = end;
+                continue;
+            }
+
+            match model.predict_batch(chunk, &self.pseudo_paths[..chunk.len()]) {
+                Ok(vec) => {
+                    // try to extract first element from each
+                    results.extend(vec.into_iter().map(|mut v| Some(v.remove(0))));
+                    self.succeeded();
+                    start = end;
+                }
+                Err(e) => {
+                    // retry the same frames in smaller chunks
+                    self.failed(chunk.len());
+                    tracing::warn!(
+                        "Batch inference of {} frames failed, retrying with batch size {}.",
+                        chunk.len(),
+                        self.limit
+                    );
+                    tracing::error!("> Error details: {:?}", e);
+                }
+            }
+        }
+        results
+    }
+}
+
+/// Receiving end of a channel, plain or instrumented
+pub trait BatchReceiver<T> {
+    fn recv_item(&self) -> Option<T>;
+    fn recv_item_timeout(&self, timeout: Duration) -> std::result::Result<T, RecvTimeoutError>;
+}
+
+impl<T> BatchReceiver<T> for Receiver<T> {
+    fn recv_item(&self) -> Option<T> {
+        self.recv().ok()
+    }
+
+    fn recv_item_timeout(&self, timeout: Duration) -> std::result::Result<T, RecvTimeoutError> {
+        self.recv_timeout(timeout)
+    }
+}
+
+impl<T> BatchReceiver<T> for TimedReceiver<T> {
+    fn recv_item(&self) -> Option<T> {
+        self.recv().ok()
+    }
+
+    fn recv_item_timeout(&self, timeout: Duration) -> std::result::Result<T, RecvTimeoutError> {
+        self.recv_timeout(timeout)
+    }
+}
+
+/// Receive a micro-batch from `rx`: block for the first item, then keep filling the batch until it
+/// holds `batch_size` items or `max_wait` has passed since the first item arrived, whichever comes
+/// first.
+///
+/// Returns `None` once the channel is disconnected and drained.
+pub fn recv_micro_batch<T>(
+    rx: &impl BatchReceiver<T>,
+    batch_size: usize,
+    max_wait: Duration,
+) -> Option<Vec<T>> {
+    let first = rx.recv_item()?;
+    let mut batch = Vec::with_capacity(batch_size);
+    batch.push(first);
+
+    let deadline = Instant::now() + max_wait;
+    while batch.len() < batch_size {
+        let timeout = deadline.saturating_duration_since(Instant::now());
+        match rx.recv_item_timeout(timeout) {
+            Ok(item) => batch.push(item),
+            // Deadline passed or no more items: ship what we have
+            Err(RecvTimeoutError::Timeout) | Err(RecvTimeoutError::Disconnected) => break,
+        }
+    }
+    Some(batch)
+}
+
+/// Histogram of achieved batch sizes (index = batch size)
+#[derive(Debug, Clone, Default)]
+pub struct BatchSizeHistogram {
+    counts: Vec<usize>,
+}
+
+impl BatchSizeHistogram {
+    /// Record one batch of `size` frames
+    pub fn record(&mut self, size: usize) {
+        if self.counts.len() <= size {
+            self.counts.resize(size + 1, 0);
+        }
+        self.counts[size] += 1;
+    }
+
+    /// Number of batches with exactly `size` frames
+    pub fn count(&self, size: usize) -> usize {
+        self.counts.get(size).copied().unwrap_or(0)
+    }
+
+    /// Total number of recorded batches
+    pub fn total_batches(&self) -> usize {
+        self.counts.iter().sum()
+    }
+
+    /// Mean batch size (0 if nothing was recorded)
+    pub fn mean(&self) -> f64 {
+        let total = self.total_batches();
+        if total == 0 {
+            return 0.0;
+        }
+        let frames: usize = self
+            .counts
+            .iter()
+            .enumerate()
+            .map(|(size, n)| size * n)
+            .sum();
+        frames as f64 / total as f64
+    }
+
+    /// Log the histogram, one line per non-empty bucket
+    pub fn log(&self) {
+        tracing::info!(
+            "Batch size histogram: {} batches, mean size {:.2}",
+            self.total_batches(),
+            self.mean()
+        );
+        for (size, &n) in self.counts.iter().enumerate() {
+            if n > 0 {
+                tracing::info!("  batch size {:>3}: {}", size, n);
+            }
+        }
+    }
+}
+
+/// Reorder buffer restoring sequence order of items produced out of order (e.g. by parallel
+/// workers). Sequence numbers must be contiguous and start at 0.
+#[derive(Debug)]
+pub struct ReorderBuffer<T> {
+    next_seq: usize,
+    pending: BTreeMap<usize, T>,
+}
+
+impl<T> Default for ReorderBuffer<T> {
+    fn default() -> Self {
+        Self {
+            next_seq: 0,
+            pending: BTreeMap::new(),
+        }
+    }
+}
+
+impl<T> ReorderBuffer<T> {
+    /// Insert an item with its sequence number
+    pub fn push(&mut self, seq: usize, item: T) {
+        self.pending.insert(seq, item);
+    }
+
+    /// Pop the next in-order item, if it has arrived
+    pub fn pop_ready(&mut self) -> Option<(usize, T)> {
+        let item = self.pending.remove(&self.next_seq)?;
+        let seq = self.next_seq;
+        self.next_seq += 1;
+        Some((seq, item))
+    }
+
+    /// Number of items waiting for an earlier sequence number
+    pub fn len(&self) -> usize {
+        self.pending.len()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::mpsc;
+
+    #[test]
+    fn test_recv_micro_batch_fills_up_to_batch_size() {
+        let (tx, rx) = mpsc::channel();
+        for i in 0..5 {
+            tx.send(i).unwrap();
+        }
+        let batch = recv_micro_batch(&rx, 4, Duration::from_secs(1)).unwrap();
+        assert_eq!(batch, vec![0, 1, 2, 3]);
+    }
+
+    #[test]
+    fn test_recv_micro_batch_ships_partial_batch_after_deadline() {
+        let (tx, rx) = mpsc::channel();
+        tx.send(0).unwrap();
+        tx.send(1).unwrap();
+        let start = Instant::now();
+        let batch = recv_micro_batch(&rx, 8, Duration::from_millis(20)).unwrap();
+        assert_eq!(batch, vec![0, 1]);
+        assert!(start.elapsed() >= Duration::from_millis(20));
+        drop(tx);
+        assert!(recv_micro_batch(&rx, 8, Duration::from_millis(20)).is_none());
+    }
+
+    #[test]
+    fn test_reorder_buffer_restores_order() {
+        let mut reorder = ReorderBuffer::default();
+        let mut out = Vec::new();
+        for seq in [2, 0, 3, 1, 4] {
+            reorder.push(seq, seq * 10);
+            while let Some((s, item)) = reorder.pop_ready() {
+                assert_eq!(item, s * 10);
+                out.push(s);
+            }
+        }
+        assert_eq!(out, vec![0, 1, 2, 3, 4]);
+        assert_eq!(reorder.len(), 0);
+    }
+
+    #[test]
+    fn test_adaptive_batch_halves_and_probes_back_up() {
+        let mut batch = AdaptiveBatch::with_max(16);
+        batch.failed(16);
+        assert_eq!(batch.limit(), 8);
+        batch.failed(8);
+        assert_eq!(batch.limit(), 4);
+
+        // a run of successes probes the next size up
+        for _ in 0..ADAPTIVE_PROBE_INTERVAL {
+            batch.succeeded();
+        }
+        assert_eq!(batch.limit(), 8);
+
+        // a failed probe falls back and waits twice as long for the next one
+        batch.failed(8);
+        assert_eq!(batch.limit(), 4);
+        for _ in 0..ADAPTIVE_PROBE_INTERVAL {
+            batch.succeeded();
+        }
+        assert_eq!(batch.limit(), 4);
+        for _ in 0..ADAPTIVE_PROBE_INTERVAL {
+            batch.succeeded();
+        }
+        assert_eq!(batch.limit(), 8);
+
+        // a successful probe keeps growing up to the configured batch
+        for _ in 0..2 * ADAPTIVE_PROBE_INTERVAL {
+            batch.succeeded();
+        }
+        assert_eq!(batch.limit(), 16);
+        batch.succeeded();
+        assert_eq!(batch.limit(), 16);
+    }
+
+    #[test]
+    fn test_batch_size_histogram() {
+        let mut hist = BatchSizeHistogram::default();
+        hist.record(8);
+        hist.record(8);
+        hist.record(2);
+        assert_eq!(hist.count(8), 2);
+        assert_eq!(hist.count(2), 1);
+        assert_eq!(hist.count(5), 0);
+        assert_eq!(hist.total_batches(), 3);
+        assert!((hist.mean() - 6.0).abs() < 1e-9);
+    }
+}
@@ -1,31 +1,46 @@
 use image::DynamicImage;
-use indicatif::{ProgressBar, ProgressFinish};
-use std::sync::mpsc;
+use indicatif::ProgressFinish;
+use std::borrow::Cow;
+use std::sync::Arc;
+use std::sync::atomic::AtomicBool;
 use std::thread;
+use std::time::Instant;
 use ultralytics_inference as ul;
 
-use crate::annotate::annotate_image;
+use crate::annotate::annotate_frame;
+use crate::buffer_pool::frame_pool;
 use crate::error::Result;
 use crate::predict::PredictArgs;
-use crate::progress_bar::progress_bar_style;
+use crate::progress_bar::progress_bar;
+use crate::result_sink::ResultSink;
 use crate::source::{Source, SourceLoader, SourceMeta};
+use crate::stats::{DoneOnDrop, PIPELINE_STAGES, PipelineRecorder, PipelineStats, SharedReceiver,
+                   spawn_exporter, timed_channel};
+use crate::thread_budget::{Stage, ThreadBudget};
+use crate::writer::ImageWriter;
 
-use super::InferResult;
+use super::batch_utils::ReorderBuffer;
+use super::{InferResult, Prediction};
 
 /// Channel-based concurrent pipeline inference
 ///
+/// - The annotation stage runs `annotate_workers` threads; results are put back into input order
+///   before saving, so `return_results` order does not depend on the worker count.
 /// - To avoid huge memory consumption, results are returned via `return_results` argument if
 ///   provided.
 pub fn channel_pipeline_infer(
     model: &mut ul::YOLOModel,
-    source: &Source,
+    source: Cow<'_, Source>,
     args: &PredictArgs,
+    budget: &ThreadBudget,
     return_results: &mut Option<Vec<InferResult>>,
-) -> Result<()> {
+) -> Result<PipelineStats> {
     let annotate = args.annotate;
     let annotate_cfg = &args.annotate_cfg;
+    let compact_masks = args.compact_masks;
     let save_dir = &args.save_dir;
     let channel_capacity = args.channel_capacity.unwrap_or(8);
+    let annotate_workers = args.annotate_workers(budget);
     let verbose = args.verbose;
     let save = annotate && save_dir.is_some();
 
@@ -40,40 +55,66 @@ pub fn channel_pipeline_infer(
         }
         std::fs::create_dir_all(dir).expect("Failed to create save directory");
     }
+    let writer = ImageWriter::from_args(args, budget)?;
+    let mut sink = ResultSink::from_args(args)?;
     // Initialize source loader
-    let loader = SourceLoader::new(source)?;
+    let loader = SourceLoader::new(source)?
+        .with_decode_threads(args.decode_workers(budget), budget.pinned(Stage::Decode))?
+        .with_video_options(args.video_options());
     let total_frames = loader.len();
-    tracing::info!("Total frames to process: {}", total_frames);
+    match total_frames {
+        Some(total) => tracing::info!("Total frames to process: {}", total),
+        None => tracing::info!("Total frames to process: unknown (streamed source)"),
+    }
     tracing::info!("-----------------------------------------");
 
     // preserve space in return_results if provided
     if let Some(vec) = return_results.as_mut() {
         vec.clear();
-        vec.reserve(total_frames);
+        vec.reserve(total_frames.unwrap_or(0));
     }
 
-    // Define data types for each pipeline stage
+    // Define data types for each pipeline stage. Inferred frames carry a sequence number for the
+    // reorder buffer in front of the saving stage; frames dropped by an annotation worker are sent
+    // as `None` so that it never waits for a missing number.
     type LoadStage = (DynamicImage, SourceMeta);
-    type InferStage = (DynamicImage, ul::Results, SourceMeta);
-    type AnnotateStage = (Option<DynamicImage>, ul::Results, SourceMeta);
-    type SaveStage = (Option<DynamicImage>, ul::Results, SourceMeta);
+    type InferStage = (usize, DynamicImage, Prediction, SourceMeta);
+    type AnnotateStage = (
+        usize,
+        Option<(Option<DynamicImage>, Prediction, SourceMeta)>,
+    );
+    type SaveStage = (Option<DynamicImage>, Prediction, SourceMeta);
+
+    // Create instrumented channels for pipeline stages with bounded capacity (load stage:
+    // prefetch depth)
+    let recorder = Arc::new(PipelineRecorder::new(&PIPELINE_STAGES));
+    let (load_tx, load_rx) =
+        timed_channel::<LoadStage>(args.prefetch_depth(), &recorder, "load", "infer");
+    let (infer_tx, infer_rx) =
+        timed_channel::<InferStage>(channel_capacity, &recorder, "infer", "annotate");
+    let (annotate_tx, annotate_rx) =
+        timed_channel::<AnnotateStage>(channel_capacity, &recorder, "annotate", "save");
+    let (save_tx, save_rx) =
+        timed_channel::<SaveStage>(channel_capacity, &recorder, "save", "collect");
 
-    // Create channels for pipeline stages with bounded capacity
-    let (load_tx, load_rx) = mpsc::sync_channel::<LoadStage>(channel_capacity);
-    let (infer_tx, infer_rx) = mpsc::sync_channel::<InferStage>(channel_capacity);
-    let (annotate_tx, annotate_rx) = mpsc::sync_channel::<AnnotateStage>(channel_capacity);
-    let (save_tx, save_rx) = mpsc::sync_channel::<SaveStage>(channel_capacity);
+    // shared work queue for all annotation workers
+    let infer_rx = SharedReceiver::new(infer_rx);
+    let infer_rx = &infer_rx;
 
     // initialize progress bar
-    let pb = ProgressBar::new(total_frames as u64)
-        .with_style(progress_bar_style())
-        .with_message("Running inference")
-        .with_finish(ProgressFinish::WithMessage("Finished".into()));
+    let pb = progress_bar(total_frames).with_finish(ProgressFinish::WithMessage("Finished".into()));
+
+    let rec = &*recorder;
+    let done = AtomicBool::new(false);
 
     // Use scoped threads to allow borrowing model
     thread::scope(|s| {
+        let exporter = spawn_exporter(s, args.stats_export(), rec, &done);
+
         // Stage 1: Image Loading thread
         let load_handler = s.spawn(move || {
+            let _stage = rec.stage("load").enter();
+            budget.pin(Stage::Control);
             for (image, meta) in loader {
                 if verbose {
                     tracing::debug!("[Loading]: {}", &meta.frame_name());
@@ -88,7 +129,10 @@ pub fn channel_pipeline_infer(
 
         // Stage 2: Model inference thread
         let infer_handler = s.spawn(move || {
-            while let Ok((image, meta)) = load_rx.recv() {
+            let _stage = rec.stage("infer").enter();
+            budget.pin(Stage::Infer(0));
+            let mut seq = 0;
+            while let Ok((image, mut meta)) = load_rx.recv() {
                 if verbose {
                     tracing::debug!("[Inferring]: {}", &meta.frame_name());
                 }
@@ -105,7 +149,7 @@ pub fn channel_pipeline_infer(
                 };
                 // One image at a time
                 let results = match results_vec.into_iter().next() {
-                    Some(r) => r,
+                    Some(r) => Prediction::new(r, compact_masks),
                     None => {
                         tracing::error!(
                             "No results returned for image: {:?}, skipping.",
@@ -114,97 +158,152 @@ pub fn channel_pipeline_infer(
                         continue;
                     }
                 };
+                meta.timings.inferred = Some(Instant::now());
+
                 // Send inference results to annotation stage
-                if infer_tx.send((image, results, meta)).is_err() {
+                if infer_tx.send((seq, image, results, meta)).is_err() {
                     break;
                 }
+                seq += 1;
             }
         });
 
-        // Stage 3: Draw annotation thread
-        let annotate_handler = s.spawn(move || {
-            while let Ok((image, results, meta)) = infer_rx.recv() {
-                // draw annotations
-                let annotated_img = if annotate {
-                    if verbose {
-                        tracing::debug!("[Annotating]: {}", &meta.frame_name());
-                    }
+        // Stage 3: Draw annotation threads
+        let annotate_handlers: Vec<_> = (0..annotate_workers)
+            .map(|_| {
+                let annotate_tx = annotate_tx.clone();
+                s.spawn(move || {
+                    let _stage = rec.stage("annotate").enter();
+                    budget.pin(Stage::Annotate);
+                    while let Ok((seq, image, results, mut meta)) = infer_rx.recv() {
+                        // draw annotations
+                        let annotated_img = if annotate {
+                            if verbose {
+                                tracing::debug!("[Annotating]: {}", &meta.frame_name());
+                            }
 
-                    match annotate_image(&image, &results, annotate_cfg) {
-                        Ok(img) => Some(img),
-                        Err(e) => {
-                            tracing::error!(
-                                "Annotation failed for image: {:?}, skipping. Error: {}",
-                                &meta.source_path,
-                                e
-                            );
-                            continue;
+                            match annotate_frame(image, &results, annotate_cfg) {
+                                Ok(img) => Some(img),
+                                Err(e) => {
+                                    tracing::error!(
+                                        "Annotation failed for image: {:?}, skipping. Error: {}",
+                                        &meta.source_path,
+                                        e
+                                    );
+                                    if annotate_tx.send((seq, None)).is_err() {
+                                        break;
+                                    }
+                                    continue;
+                                }
+                            }
+                        } else {
+                            // the input frame is no longer needed
+                            frame_pool().recycle(image);
+                            None
+                        };
+                        // Send annotated image to saving stage
+                        meta.timings.annotated = Some(Instant::now());
+                        if annotate_tx
+                            .send((seq, Some((annotated_img, results, meta))))
+                            .is_err()
+                        {
+                            break;
                         }
                     }
-                } else {
-                    None
-                };
-                // Send annotated image to saving stage
-                if annotate_tx.send((annotated_img, results, meta)).is_err() {
-                    break;
-                }
-            }
-        });
+                })
+            })
+            .collect();
+        drop(annotate_tx);
 
-        // Stage 4: Saving thread
+        // Stage 4: Saving thread - restores input order of annotated frames first
         let save_handler = s.spawn(move || {
-            while let Ok((annotated_img, results, meta)) = annotate_rx.recv() {
-                if let Some(dir) = save_dir
-                    && let Some(annotated_img) = &annotated_img
-                {
-                    if verbose {
-                        tracing::debug!("[Saving]: {}", &meta.frame_name());
-                    }
+            let _stage = rec.stage("save").enter();
+            budget.pin(Stage::Control);
+            let mut reorder = ReorderBuffer::default();
+            while let Ok((seq, annotated)) = annotate_rx.recv() {
+                reorder.push(seq, annotated);
 
-                    let frame_stem = meta.frame_stem();
-                    let save_path = dir.join(format!("{}.png", frame_stem));
-                    if annotated_img.save(&save_path).is_err() {
-                        tracing::error!(
-                            "Failed to save annotated image to {:?}. skipping.",
-                            save_path
-                        );
+                while let Some((_, annotated)) = reorder.pop_ready() {
+                    // dropped by an annotation worker
+                    let Some((annotated_img, results, mut meta)) = annotated else {
                         continue;
+                    };
+
+                    if let Some(dir) = save_dir
+                        && let Some(annotated_img) = &annotated_img
+                    {
+                        if verbose {
+                            tracing::debug!("[Saving]: {}", &meta.frame_name());
+                        }
+
+                        let save_path = writer.save_path(dir, &meta.frame_stem());
+                        if writer.save(annotated_img, &save_path).is_err() {
+                            tracing::error!(
+                                "Failed to save annotated image to {:?}. skipping.",
+                                save_path
+                            );
+                            rec.stage("save").count_failed(1);
+                            continue;
+                        }
                     }
-                }
 
-                if save_tx.send((annotated_img, results, meta)).is_err() {
-                    break;
+                    meta.timings.saved = Some(Instant::now());
+                    if save_tx.send((annotated_img, results, meta)).is_err() {
+                        return;
+                    }
                 }
             }
+            // queued writes report their failures once done
+            rec.stage("save").count_failed(writer.flush().len() as u64);
         });
 
         // Stage 5: Collect results thread
         let collect_handler = s.spawn(move || {
-            while let Ok((annotated_img, results, meta)) = save_rx.recv() {
+            let _stage = rec.stage("collect").enter();
+            budget.pin(Stage::Control);
+            while let Ok((annotated_img, results, mut meta)) = save_rx.recv() {
+                meta.timings.collected = Some(Instant::now());
+                // Append to the result file if configured
+                if let Some(sink) = sink.as_mut()
+                    && let Err(e) = sink.write(&results, &meta)
+                {
+                    tracing::error!("Failed to write results of {}: {}", meta.frame_name(), e);
+                }
                 // Update return results vector if provided
                 if let Some(vec) = return_results {
                     if verbose {
                         tracing::debug!("[Collecting] result for: {}", &meta.frame_name());
                     }
 
-                    vec.push(InferResult {
-                        result: results,
-                        annotated: annotated_img,
-                        meta,
-                    });
+                    vec.push(InferResult::new(results, annotated_img, meta));
+                } else if let Some(annotated_img) = annotated_img {
+                    frame_pool().recycle(annotated_img);
                 }
 
                 // Update progress bar
                 pb.inc(1);
             }
+            if let Some(sink) = sink
+                && let Err(e) = sink.finish()
+            {
+                tracing::error!("Failed to write result file: {}", e);
+            }
         });
 
-        // Wait for pipeline threads to finish
+        // Wait for pipeline threads to finish; the exporter stops even if one of them panicked
+        let stop_exporter = DoneOnDrop(&done);
         load_handler.join().expect("Loading thread panicked");
         infer_handler.join().expect("Inference thread panicked");
-        annotate_handler.join().expect("Annotation thread panicked");
+        for handler in annotate_handlers {
+            handler.join().expect("Annotation thread panicked");
+        }
         save_handler.join().expect("Saving thread panicked");
         collect_handler.join().expect("Collect thread panicked");
+
+        drop(stop_exporter);
+        if let Some(exporter) = exporter {
+            exporter.join().expect("Stats exporter thread panicked");
+        }
     });
 
     if save {
@@ -213,5 +312,5 @@ pub fn channel_pipeline_infer(
             save_dir.as_ref().unwrap()
         );
     }
-    Ok(())
+    Ok(recorder.snapshot())
 }
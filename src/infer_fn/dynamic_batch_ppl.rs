@@ -0,0 +1,296 @@
+use image::DynamicImage;
+use indicatif::ProgressFinish;
+use std::borrow::Cow;
+use std::sync::Arc;
+use std::sync::atomic::AtomicBool;
+use std::thread;
+use std::time::{Duration, Instant};
+use ultralytics_inference as ul;
+
+use crate::annotate::annotate_frame;
+use crate::buffer_pool::frame_pool;
+use crate::error::Result;
+use crate::predict::PredictArgs;
+use crate::progress_bar::progress_bar;
+use crate::result_sink::ResultSink;
+use crate::source::{Source, SourceLoader, SourceMeta};
+use crate::stats::{DoneOnDrop, PIPELINE_STAGES, PipelineRecorder, PipelineStats, spawn_exporter,
+                   timed_channel};
+use crate::thread_budget::{Stage, ThreadBudget};
+use crate::writer::ImageWriter;
+
+use super::batch_utils::{AdaptiveBatch, BatchSizeHistogram, get_batch_frame_names,
+                         recv_micro_batch};
+use super::{InferResult, Prediction};
+
+/// Channel-based pipeline with dynamic micro-batching
+///
+/// Frames are loaded one by one; the inference stage fills a batch up to `batch` frames or until
+/// `max_wait_us` has passed since the first frame of the batch arrived, whichever comes first.
+///
+/// - To avoid huge memory consumption, results are returned via `return_results` argument if
+///   provided.
+pub fn dynamic_batch_pipeline_infer(
+    model: &mut ul::YOLOModel,
+    source: Cow<'_, Source>,
+    args: &PredictArgs,
+    budget: &ThreadBudget,
+    return_results: &mut Option<Vec<InferResult>>,
+) -> Result<PipelineStats> {
+    let annotate = args.annotate;
+    let annotate_cfg = &args.annotate_cfg;
+    let save_dir = &args.save_dir;
+    let channel_capacity = args.channel_capacity.unwrap_or(8);
+    let batch_size = args.batch.unwrap_or(1).max(1);
+    let max_wait = Duration::from_micros(args.max_wait_us.unwrap_or(1000));
+    let verbose = args.verbose;
+    let save = annotate && save_dir.is_some();
+
+    tracing::info!("Running channel-based dynamic batch pipeline inference...");
+    tracing::info!("[Source]: {:?}", source);
+    tracing::info!("Max Batch Size: {}, Max Wait: {:?}", batch_size, max_wait);
+
+    if let Some(dir) = save_dir {
+        if dir.is_dir() {
+            tracing::warn!("Clearing existing save directory: {:?}", dir);
+            std::fs::remove_dir_all(dir).expect("Failed to clear existing save directory");
+        }
+        std::fs::create_dir_all(dir).expect("Failed to create save directory");
+    }
+    let writer = ImageWriter::from_args(args, budget)?;
+    let mut sink = ResultSink::from_args(args)?;
+
+    let loader = SourceLoader::new(source)?
+        .with_decode_threads(args.decode_workers(budget), budget.pinned(Stage::Decode))?
+        .with_video_options(args.video_options());
+    let total_frames = loader.len();
+    match total_frames {
+        Some(total) => tracing::info!("Total frames to process: {}", total),
+        None => tracing::info!("Total frames to process: unknown (streamed source)"),
+    }
+    tracing::info!("-----------------------------------------");
+
+    // preserve space in return_results if provided
+    if let Some(vec) = return_results.as_mut() {
+        vec.clear();
+        vec.reserve(total_frames.unwrap_or(0));
+    }
+
+    // Define data types for each pipeline stage
+    type LoadStage = (DynamicImage, SourceMeta);
+    type InferStage = (usize, DynamicImage, Prediction, SourceMeta);
+    type AnnotateStage = (usize, Option<DynamicImage>, Prediction, SourceMeta);
+    type SaveStage = (usize, Option<DynamicImage>, Prediction, SourceMeta);
+
+    // Create instrumented channels for each stage with bounded capacity (load stage: prefetch
+    // depth). The load channel must hold at least one full batch for batches to fill up.
+    let recorder = Arc::new(PipelineRecorder::new(&PIPELINE_STAGES));
+    let load_capacity = args.prefetch_depth().max(batch_size);
+    let (load_tx, load_rx) = timed_channel::<LoadStage>(load_capacity, &recorder, "load", "infer");
+    let (infer_tx, infer_rx) =
+        timed_channel::<InferStage>(channel_capacity, &recorder, "infer", "annotate");
+    let (annotate_tx, annotate_rx) =
+        timed_channel::<AnnotateStage>(channel_capacity, &recorder, "annotate", "save");
+    let (save_tx, save_rx) =
+        timed_channel::<SaveStage>(channel_capacity, &recorder, "save", "collect");
+
+    // initialize progress bar
+    let pb = progress_bar(total_frames).with_finish(ProgressFinish::WithMessage("Finished".into()));
+
+    // record achieved batch sizes
+    let mut histogram = BatchSizeHistogram::default();
+
+    let rec = &*recorder;
+    let done = AtomicBool::new(false);
+
+    // Use scoped threads to allow borrowing model
+    thread::scope(|s| {
+        let exporter = spawn_exporter(s, args.stats_export(), rec, &done);
+
+        // Stage 1: Image Loading thread
+        let load_handle = s.spawn(move || {
+            let _stage = rec.stage("load").enter();
+            budget.pin(Stage::Control);
+            for (image, meta) in loader {
+                if verbose {
+                    tracing::debug!("[Loading]: {}", &meta.frame_name());
+                }
+
+                if load_tx.send((image, meta)).is_err() {
+                    break;
+                }
+            }
+        });
+
+        // Stage 2: Micro-batching + Model Inference thread
+        let histogram = &mut histogram;
+        let infer_handler = s.spawn(move || {
+            let _stage = rec.stage("infer").enter();
+            budget.pin(Stage::Infer(0));
+            // batch size adapted to failed batches
+            let mut batcher = AdaptiveBatch::from_args(args);
+            let mut batch_idx = 0;
+
+            while let Some(batch) = recv_micro_batch(&load_rx, batch_size, max_wait) {
+                let (batch_images, batch_metas): (Vec<DynamicImage>, Vec<SourceMeta>) =
+                    batch.into_iter().unzip();
+                histogram.record(batch_images.len());
+
+                if verbose {
+                    let batch_frame_names = get_batch_frame_names(&batch_metas);
+                    tracing::debug!("[Inferring] batch {}: {:?}", batch_idx, batch_frame_names);
+                }
+
+                let batch_results: Vec<Option<Prediction>> = batcher.infer(
+                    model,
+                    &batch_images,
+                    &batch_metas,
+                    Some(rec.stage("infer")),
+                    verbose,
+                );
+
+                // Send each valid inference result to next stage
+                let inferred = Some(Instant::now());
+                for ((image, result), mut meta) in batch_images
+                    .into_iter()
+                    .zip(batch_results.into_iter())
+                    .zip(batch_metas.into_iter())
+                {
+                    meta.timings.inferred = inferred;
+                    if let Some(r) = result {
+                        if infer_tx.send((batch_idx, image, r, meta)).is_err() {
+                            return;
+                        }
+                    }
+                }
+                batch_idx += 1;
+            }
+        });
+
+        // Stage 3: Annotation thread
+        let annotate_handler = s.spawn(move || {
+            let _stage = rec.stage("annotate").enter();
+            budget.pin(Stage::Annotate);
+            while let Ok((batch_idx, image, results, mut meta)) = infer_rx.recv() {
+                let annotated_img = if annotate {
+                    if verbose {
+                        tracing::debug!("[Annotating] batch {}: {}", batch_idx, &meta.frame_name());
+                    }
+
+                    match annotate_frame(image, &results, annotate_cfg) {
+                        Ok(img) => Some(img),
+                        Err(e) => {
+                            tracing::error!(
+                                "Annotation failed for image: {:?}, skipping. Error: {}",
+                                &meta.source_path,
+                                e
+                            );
+                            continue;
+                        }
+                    }
+                } else {
+                    // the input frame is no longer needed
+                    frame_pool().recycle(image);
+                    None
+                };
+
+                meta.timings.annotated = Some(Instant::now());
+                if annotate_tx
+                    .send((batch_idx, annotated_img, results, meta))
+                    .is_err()
+                {
+                    break;
+                }
+            }
+        });
+
+        // Stage 4: Saving thread
+        let save_handler = s.spawn(move || {
+            let _stage = rec.stage("save").enter();
+            budget.pin(Stage::Control);
+            while let Ok((batch_idx, annotated_img, results, mut meta)) = annotate_rx.recv() {
+                if let Some(dir) = save_dir
+                    && let Some(annotated_img) = &annotated_img
+                {
+                    if verbose {
+                        tracing::debug!("[Saving] batch {}: {}", batch_idx, &meta.frame_name());
+                    }
+
+                    let save_path = writer.save_path(dir, &meta.frame_stem());
+                    if writer.save(annotated_img, &save_path).is_err() {
+                        tracing::error!(
+                            "Failed to save annotated image to {:?}. skipping.",
+                            save_path
+                        );
+                        rec.stage("save").count_failed(1);
+                        continue;
+                    }
+                }
+
+                meta.timings.saved = Some(Instant::now());
+                if save_tx
+                    .send((batch_idx, annotated_img, results, meta))
+                    .is_err()
+                {
+                    break;
+                }
+            }
+            // queued writes report their failures once done
+            rec.stage("save").count_failed(writer.flush().len() as u64);
+        });
+
+        // Stage 5: Collect results thread
+        let collect_handler = s.spawn(move || {
+            let _stage = rec.stage("collect").enter();
+            budget.pin(Stage::Control);
+            while let Ok((batch_idx, annotated_img, results, mut meta)) = save_rx.recv() {
+                meta.timings.collected = Some(Instant::now());
+                // Append to the result file if configured
+                if let Some(sink) = sink.as_mut()
+                    && let Err(e) = sink.write(&results, &meta)
+                {
+                    tracing::error!("Failed to write results of {}: {}", meta.frame_name(), e);
+                }
+                if let Some(vec) = return_results {
+                    if verbose {
+                        tracing::debug!("[Collecting] batch {}: {}", batch_idx, &meta.frame_name());
+                    }
+
+                    vec.push(InferResult::new(results, annotated_img, meta));
+                } else if let Some(annotated_img) = annotated_img {
+                    frame_pool().recycle(annotated_img);
+                }
+
+                pb.inc(1);
+            }
+            if let Some(sink) = sink
+                && let Err(e) = sink.finish()
+            {
+                tracing::error!("Failed to write result file: {}", e);
+            }
+        });
+
+        // Wait for pipeline threads to finish; the exporter stops even if one of them panicked
+        let stop_exporter = DoneOnDrop(&done);
+        load_handle.join().expect("Loading thread panicked");
+        infer_handler.join().expect("Inference thread panicked");
+        annotate_handler.join().expect("Annotation thread panicked");
+        save_handler.join().expect("Saving thread panicked");
+        collect_handler.join().expect("Collect thread panicked");
+
+        drop(stop_exporter);
+        if let Some(exporter) = exporter {
+            exporter.join().expect("Stats exporter thread panicked");
+        }
+    });
+
+    histogram.log();
+
+    if save {
+        tracing::info!(
+            "Results saved to directory: {:?}",
+            save_dir.as_ref().unwrap()
+        );
+    }
+    Ok(recorder.snapshot())
+}
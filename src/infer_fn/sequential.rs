@@ -1,13 +1,20 @@
 use indicatif::{ProgressFinish, ProgressIterator};
+use std::borrow::Cow;
+use std::time::Instant;
 use ultralytics_inference as ul;
 
-use crate::annotate::annotate_image;
+use crate::annotate::annotate_frame;
+use crate::buffer_pool::frame_pool;
 use crate::error::Result;
 use crate::predict::PredictArgs;
-use crate::progress_bar::progress_bar_style;
+use crate::progress_bar::progress_bar;
+use crate::result_sink::ResultSink;
 use crate::source::{Source, SourceLoader};
+use crate::stats::{PIPELINE_STAGES, PipelineRecorder, PipelineStats};
+use crate::thread_budget::{Stage, ThreadBudget};
+use crate::writer::ImageWriter;
 
-use super::InferResult;
+use super::{InferResult, Prediction};
 
 /// Naive sequential inference: process images one by one
 ///
@@ -15,12 +22,14 @@ use super::InferResult;
 ///   provided.
 pub fn sequential_infer(
     model: &mut ul::YOLOModel,
-    source: &Source,
+    source: Cow<'_, Source>,
     args: &PredictArgs,
+    budget: &ThreadBudget,
     return_results: &mut Option<Vec<InferResult>>,
-) -> Result<()> {
+) -> Result<PipelineStats> {
     let annotate = args.annotate;
     let annotate_cfg = &args.annotate_cfg;
+    let compact_masks = args.compact_masks;
     let save_dir = &args.save_dir;
     let verbose = args.verbose;
     let save = annotate && save_dir.is_some();
@@ -35,22 +44,32 @@ pub fn sequential_infer(
         }
         std::fs::create_dir_all(dir).expect("Failed to create save directory");
     }
+    let writer = ImageWriter::from_args(args, budget)?;
+    let mut sink = ResultSink::from_args(args)?;
 
-    let loader = SourceLoader::new(source)?;
+    let loader = SourceLoader::new(source)?
+        .with_decode_threads(args.decode_workers(budget), budget.pinned(Stage::Decode))?
+        .with_video_options(args.video_options());
     let total_frames = loader.len();
-    tracing::info!("Total frames to process: {}", total_frames);
+    match total_frames {
+        Some(total) => tracing::info!("Total frames to process: {}", total),
+        None => tracing::info!("Total frames to process: unknown (streamed source)"),
+    }
     tracing::info!("-----------------------------------------");
 
     // preserve space in return_results if provided
     if let Some(vec) = return_results.as_mut() {
         vec.clear();
-        vec.reserve(total_frames);
+        vec.reserve(total_frames.unwrap_or(0));
     }
 
-    for (idx, (image, meta)) in loader
+    // stages run inline, so only busy time and item counts are recorded
+    let recorder = PipelineRecorder::new(&PIPELINE_STAGES);
+    let loop_start = Instant::now();
+
+    for (idx, (image, mut meta)) in loader
         .enumerate()
-        .progress_with_style(progress_bar_style())
-        .with_message("Running inference")
+        .progress_with(progress_bar(total_frames))
         .with_finish(ProgressFinish::WithMessage("Finished".into()))
     {
         if verbose {
@@ -62,7 +81,10 @@ pub fn sequential_infer(
             }
         }
 
-        let results_vec = match model.predict_image(&image, "".to_string()) {
+        recorder.stage("load").count(1);
+
+        let infer_stage = recorder.stage("infer");
+        let results_vec = match infer_stage.time(|| model.predict_image(&image, "".to_string())) {
             Ok(res) => res,
             Err(e) => {
                 tracing::error!(
@@ -76,7 +98,7 @@ pub fn sequential_infer(
 
         // One image at a time
         let results = match results_vec.into_iter().next() {
-            Some(r) => r,
+            Some(r) => Prediction::new(r, compact_masks),
             None => {
                 tracing::error!(
                     "No results returned for image: {:?}, skipping.",
@@ -86,9 +108,13 @@ pub fn sequential_infer(
             }
         };
 
+        meta.timings.inferred = Some(Instant::now());
+        infer_stage.count(1);
+
         // draw annotations
+        let annotate_stage = recorder.stage("annotate");
         let annotated_img = if annotate {
-            match annotate_image(&image, &results, annotate_cfg) {
+            match annotate_stage.time(|| annotate_frame(image, &results, annotate_cfg)) {
                 Ok(img) => Some(img),
                 Err(e) => {
                     tracing::error!(
@@ -100,33 +126,53 @@ pub fn sequential_infer(
                 }
             }
         } else {
+            // the input frame is no longer needed
+            frame_pool().recycle(image);
             None
         };
 
+        meta.timings.annotated = Some(Instant::now());
+        annotate_stage.count(1);
+
         // Save results if save_dir is specified
+        let save_stage = recorder.stage("save");
         if let Some(dir) = save_dir
             && let Some(annotated_img) = &annotated_img
         {
-            let frame_stem = meta.frame_stem();
-            let save_path = dir.join(format!("{}.png", frame_stem));
-            if annotated_img.save(&save_path).is_err() {
+            let save_path = writer.save_path(dir, &meta.frame_stem());
+            if save_stage
+                .time(|| writer.save(annotated_img, &save_path))
+                .is_err()
+            {
                 tracing::error!(
                     "Failed to save annotated image to {:?}. skipping.",
                     save_path
                 );
+                save_stage.count_failed(1);
                 continue;
             }
         }
 
+        meta.timings.saved = Some(Instant::now());
+        save_stage.count(1);
+
+        // Append to the result file if configured
+        if let Some(sink) = sink.as_mut()
+            && let Err(e) = sink.write(&results, &meta)
+        {
+            tracing::error!("Failed to write results of {}: {}", meta.frame_name(), e);
+        }
+
         // Update return results vector if provided
         if let Some(vec) = return_results {
-            vec.push(InferResult {
-                result: results,
-                annotated: annotated_img,
-                meta,
-            });
+            meta.timings.collected = Some(Instant::now());
+            vec.push(InferResult::new(results, annotated_img, meta));
+        } else if let Some(annotated_img) = annotated_img {
+            frame_pool().recycle(annotated_img);
         }
+        recorder.stage("collect").count(1);
     }
+    recorder.add_remainder("load", loop_start.elapsed());
 
     if save {
         tracing::info!(
@@ -134,5 +180,12 @@ pub fn sequential_infer(
             save_dir.as_ref().unwrap()
         );
     }
-    Ok(())
+    if let Some(sink) = sink {
+        sink.finish()?;
+    }
+    // queued writes report their failures once done
+    let save_stage = recorder.stage("save");
+    let failed = save_stage.time(|| writer.flush());
+    save_stage.count_failed(failed.len() as u64);
+    Ok(recorder.snapshot())
 }
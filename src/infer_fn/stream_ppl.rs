@@ -0,0 +1,510 @@
+use image::DynamicImage;
+use std::collections::{HashMap, HashSet};
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::{Arc, Condvar, Mutex, MutexGuard};
+use std::thread::{self, JoinHandle};
+use std::time::{Duration, Instant};
+use ultralytics_inference as ul;
+
+use crate::annotate::annotate_frame;
+use crate::buffer_pool::frame_pool;
+use crate::error::{AppError, Result};
+use crate::predict::PredictArgs;
+use crate::source::{FrameTimings, SourceMeta};
+use crate::stats::{PipelineRecorder, PipelineStats, TimedSender, timed_channel};
+use crate::thread_budget::{Stage, ThreadBudget};
+use crate::writer::ImageWriter;
+
+use super::batch_utils::{AdaptiveBatch, get_batch_frame_names, recv_micro_batch};
+use super::{InferResult, Prediction};
+
+/// Completion state shared between the collect stage and callers
+struct Completion<T> {
+    /// Submitted tickets that have neither completed nor failed yet
+    pending: HashSet<u64>,
+    /// Finished results waiting to be taken, keyed by ticket
+    results: HashMap<u64, T>,
+    /// Tickets whose frame was dropped by one of the stages
+    failed: HashSet<u64>,
+    /// Set once all stage threads have exited
+    closed: bool,
+}
+
+struct Shared<T = InferResult> {
+    state: Mutex<Completion<T>>,
+    ready: Condvar,
+}
+
+impl<T> Default for Shared<T> {
+    fn default() -> Self {
+        Self {
+            state: Mutex::new(Completion {
+                pending: HashSet::new(),
+                results: HashMap::new(),
+                failed: HashSet::new(),
+                closed: false,
+            }),
+            ready: Condvar::new(),
+        }
+    }
+}
+
+impl<T> Shared<T> {
+    fn lock(&self) -> MutexGuard<'_, Completion<T>> {
+        self.state.lock().expect("Stream pipeline state poisoned")
+    }
+
+    fn update(&self, f: impl FnOnce(&mut Completion<T>)) {
+        f(&mut self.lock());
+        self.ready.notify_all();
+    }
+
+    /// Track `ticket` until it completes or fails
+    fn submit(&self, ticket: u64) {
+        self.lock().pending.insert(ticket);
+    }
+
+    fn complete(&self, ticket: u64, result: T) {
+        self.update(|state| {
+            state.pending.remove(&ticket);
+            state.results.insert(ticket, result);
+        });
+    }
+
+    fn fail(&self, ticket: u64) {
+        self.update(|state| {
+            state.pending.remove(&ticket);
+            state.failed.insert(ticket);
+        });
+    }
+
+    fn close(&self) {
+        self.update(|state| state.closed = true);
+    }
+
+    /// Take all finished results, sorted by ticket
+    fn take_results(&self) -> Vec<T> {
+        let mut results: Vec<(u64, T)> = self.lock().results.drain().collect();
+        results.sort_unstable_by_key(|&(ticket, _)| ticket);
+        results.into_iter().map(|(_, result)| result).collect()
+    }
+
+    /// Take all failed tickets, sorted
+    fn take_failed(&self) -> Vec<u64> {
+        let mut failed: Vec<u64> = self.lock().failed.drain().collect();
+        failed.sort_unstable();
+        failed
+    }
+
+    /// Block until `ticket` completes and take its result
+    fn wait(&self, ticket: u64) -> Result<T> {
+        let mut state = self.lock();
+        loop {
+            if let Some(result) = state.results.remove(&ticket) {
+                return Ok(result);
+            }
+            if state.failed.remove(&ticket) {
+                return Err(AppError::Inference(format!(
+                    "Frame of ticket {} failed",
+                    ticket
+                )));
+            }
+            // neither pending nor finished: taken by an earlier `wait` or `poll`
+            if !state.pending.contains(&ticket) {
+                return Err(AppError::Config(format!(
+                    "Result of ticket {} was already taken",
+                    ticket
+                )));
+            }
+            if state.closed {
+                return Err(AppError::Inference(format!(
+                    "Stream pipeline closed before ticket {} completed",
+                    ticket
+                )));
+            }
+            state = self
+                .ready
+                .wait(state)
+                .expect("Stream pipeline state poisoned");
+        }
+    }
+}
+
+/// Long-lived channel-based pipeline for continuous (streaming) inference.
+///
+/// Frames are pushed with [`StreamPipeline::submit`] and results are fetched with
+/// [`StreamPipeline::poll`] or [`StreamPipeline::wait`]. The stage threads (batch, infer, annotate,
+/// save, collect) and their bounded channels live as long as the pipeline, so neither thread
+/// spawning nor model loading is paid per call.
+///
+/// - Each submitted frame gets a ticket, which is also its `SourceMeta::frame_idx`.
+/// - `SourceMeta::total_frames` is 0 since the stream length is unknown.
+/// - Live per-stage stats are available via [`StreamPipeline::stats`]; the `submit` stage stands
+///   for the callers, its blocked-on-send time is the backpressure they saw.
+pub struct StreamPipeline {
+    submit_tx: Option<TimedSender<(DynamicImage, SourceMeta)>>,
+    next_ticket: AtomicU64,
+    shared: Arc<Shared>,
+    recorder: Arc<PipelineRecorder>,
+    handles: Vec<JoinHandle<()>>,
+    exporter: Option<(Arc<AtomicBool>, JoinHandle<()>)>,
+}
+
+impl StreamPipeline {
+    /// Spawn pipeline stages around an already loaded model, on the cores of `budget`.
+    pub fn new(model: ul::YOLOModel, args: &PredictArgs, budget: ThreadBudget) -> Self {
+        let mut model = model;
+        let annotate = args.annotate;
+        let annotate_cfg = args.annotate_cfg.clone();
+        let save_dir = args.save_dir.clone();
+        let channel_capacity = args.channel_capacity.unwrap_or(8);
+        let batch_size = args.batch.unwrap_or(1).max(1);
+        let max_wait = Duration::from_micros(args.max_wait_us.unwrap_or(1000));
+        let verbose = args.verbose;
+        // batch size adapted to failed batches
+        let mut batcher = AdaptiveBatch::from_args(args);
+
+        tracing::info!("Starting channel-based stream pipeline...");
+        tracing::info!("Max Batch Size: {}, Max Wait: {:?}", batch_size, max_wait);
+
+        if let Some(dir) = &save_dir {
+            if dir.is_dir() {
+                tracing::warn!("Clearing existing save directory: {:?}", dir);
+                std::fs::remove_dir_all(dir).expect("Failed to clear existing save directory");
+            }
+            std::fs::create_dir_all(dir).expect("Failed to create save directory");
+        }
+        let writer = ImageWriter::from_args(args, &budget).expect("Failed to create image writer");
+
+        let shared = Arc::new(Shared::default());
+        let budget = Arc::new(budget);
+
+        // Define data types for each pipeline stage
+        type SubmitStage = (DynamicImage, SourceMeta);
+        type BatchStage = (usize, Vec<DynamicImage>, Vec<SourceMeta>);
+        type InferStage = (usize, DynamicImage, Prediction, SourceMeta);
+        type AnnotateStage = (usize, Option<DynamicImage>, Prediction, SourceMeta);
+        type SaveStage = (usize, Option<DynamicImage>, Prediction, SourceMeta);
+
+        // Create instrumented channels for each stage with bounded capacity
+        let recorder = Arc::new(PipelineRecorder::new(&[
+            "submit", "batch", "infer", "annotate", "save", "collect",
+        ]));
+        let (submit_tx, submit_rx) =
+            timed_channel::<SubmitStage>(channel_capacity, &recorder, "submit", "batch");
+        let (batch_tx, batch_rx) =
+            timed_channel::<BatchStage>(channel_capacity, &recorder, "batch", "infer");
+        let (infer_tx, infer_rx) =
+            timed_channel::<InferStage>(channel_capacity, &recorder, "infer", "annotate");
+        let (annotate_tx, annotate_rx) =
+            timed_channel::<AnnotateStage>(channel_capacity, &recorder, "annotate", "save");
+        let (save_tx, save_rx) =
+            timed_channel::<SaveStage>(channel_capacity, &recorder, "save", "collect");
+
+        let mut handles = Vec::with_capacity(5);
+
+        // Stage 1: Micro-batching thread - fills a batch up to `batch_size` frames or until
+        // `max_wait` has passed since its first frame arrived
+        let batch_recorder = Arc::clone(&recorder);
+        let batch_budget = Arc::clone(&budget);
+        handles.push(thread::spawn(move || {
+            let _stage = batch_recorder.stage("batch").enter();
+            batch_budget.pin(Stage::Control);
+            let mut batch_idx = 0;
+            while let Some(batch) = recv_micro_batch(&submit_rx, batch_size, max_wait) {
+                let (batch_images, batch_metas): (Vec<DynamicImage>, Vec<SourceMeta>) =
+                    batch.into_iter().unzip();
+
+                if verbose {
+                    let batch_frame_names = get_batch_frame_names(&batch_metas);
+                    tracing::debug!("[Batching] batch {}: {:?}", batch_idx, batch_frame_names);
+                }
+
+                if batch_tx
+                    .send((batch_idx, batch_images, batch_metas))
+                    .is_err()
+                {
+                    break;
+                }
+                batch_idx += 1;
+            }
+        }));
+
+        // Stage 2: Model inference thread (owns the model)
+        let infer_shared = Arc::clone(&shared);
+        let infer_recorder = Arc::clone(&recorder);
+        let infer_budget = Arc::clone(&budget);
+        handles.push(thread::spawn(move || {
+            let _stage = infer_recorder.stage("infer").enter();
+            infer_budget.pin(Stage::Infer(0));
+
+            while let Ok((batch_idx, batch_images, batch_metas)) = batch_rx.recv() {
+                if verbose {
+                    let batch_frame_names = get_batch_frame_names(&batch_metas);
+                    tracing::debug!("[Inferring] batch {}: {:?}", batch_idx, batch_frame_names);
+                }
+
+                let batch_results: Vec<Option<Prediction>> = batcher.infer(
+                    &mut model,
+                    &batch_images,
+                    &batch_metas,
+                    Some(infer_recorder.stage("infer")),
+                    verbose,
+                );
+
+                let inferred = Some(Instant::now());
+                for ((image, result), mut meta) in batch_images
+                    .into_iter()
+                    .zip(batch_results.into_iter())
+                    .zip(batch_metas.into_iter())
+                {
+                    meta.timings.inferred = inferred;
+                    match result {
+                        Some(r) => {
+                            if infer_tx.send((batch_idx, image, r, meta)).is_err() {
+                                return;
+                            }
+                        }
+                        None => infer_shared.fail(meta.frame_idx as u64),
+                    }
+                }
+            }
+        }));
+
+        // Stage 3: Annotation thread
+        let annotate_shared = Arc::clone(&shared);
+        let annotate_recorder = Arc::clone(&recorder);
+        let annotate_budget = Arc::clone(&budget);
+        handles.push(thread::spawn(move || {
+            let _stage = annotate_recorder.stage("annotate").enter();
+            annotate_budget.pin(Stage::Annotate);
+            while let Ok((batch_idx, image, results, mut meta)) = infer_rx.recv() {
+                let annotated_img = if annotate {
+                    if verbose {
+                        tracing::debug!("[Annotating] batch {}: {}", batch_idx, &meta.frame_name());
+                    }
+
+                    match annotate_frame(image, &results, &annotate_cfg) {
+                        Ok(img) => Some(img),
+                        Err(e) => {
+                            tracing::error!(
+                                "Annotation failed for frame: {}, skipping. Error: {}",
+                                &meta.frame_name(),
+                                e
+                            );
+                            annotate_shared.fail(meta.frame_idx as u64);
+                            continue;
+                        }
+                    }
+                } else {
+                    // the input frame is no longer needed
+                    frame_pool().recycle(image);
+                    None
+                };
+
+                meta.timings.annotated = Some(Instant::now());
+                if annotate_tx
+                    .send((batch_idx, annotated_img, results, meta))
+                    .is_err()
+                {
+                    break;
+                }
+            }
+        }));
+
+        // Stage 4: Saving thread
+        let save_shared = Arc::clone(&shared);
+        let save_recorder = Arc::clone(&recorder);
+        let save_budget = Arc::clone(&budget);
+        handles.push(thread::spawn(move || {
+            let _stage = save_recorder.stage("save").enter();
+            save_budget.pin(Stage::Control);
+            while let Ok((batch_idx, annotated_img, results, mut meta)) = annotate_rx.recv() {
+                let annotated_img = match (&save_dir, annotated_img) {
+                    (Some(dir), Some(annotated_img)) => {
+                        if verbose {
+                            tracing::debug!("[Saving] batch {}: {}", batch_idx, &meta.frame_name());
+                        }
+
+                        // the frame completes (or fails) once its write is done, on the save
+                        // pool if there is one
+                        let save_path = writer.save_path(dir, &meta.frame_stem());
+                        let (shared, recorder) =
+                            (Arc::clone(&save_shared), Arc::clone(&save_recorder));
+                        let save_tx = save_tx.clone();
+                        writer.save_owned(annotated_img, &save_path, move |image, saved| {
+                            if saved.is_err() {
+                                recorder.stage("save").count_failed(1);
+                                shared.fail(meta.frame_idx as u64);
+                                frame_pool().recycle(image);
+                                return;
+                            }
+                            meta.timings.saved = Some(Instant::now());
+                            // the collect stage is only gone once the pipeline stops
+                            let _ = save_tx.send((batch_idx, Some(image), results, meta));
+                        });
+                        continue;
+                    }
+                    (_, annotated_img) => annotated_img,
+                };
+
+                meta.timings.saved = Some(Instant::now());
+                if save_tx
+                    .send((batch_idx, annotated_img, results, meta))
+                    .is_err()
+                {
+                    break;
+                }
+            }
+        }));
+
+        // Stage 5: Collect results thread
+        let collect_shared = Arc::clone(&shared);
+        let collect_recorder = Arc::clone(&recorder);
+        let collect_budget = Arc::clone(&budget);
+        handles.push(thread::spawn(move || {
+            let _stage = collect_recorder.stage("collect").enter();
+            collect_budget.pin(Stage::Control);
+            while let Ok((batch_idx, annotated_img, results, mut meta)) = save_rx.recv() {
+                meta.timings.collected = Some(Instant::now());
+                if verbose {
+                    tracing::debug!("[Collecting] batch {}: {}", batch_idx, &meta.frame_name());
+                }
+
+                let ticket = meta.frame_idx as u64;
+                collect_shared.complete(ticket, InferResult::new(results, annotated_img, meta));
+            }
+            // All upstream stages have exited
+            collect_shared.close();
+        }));
+
+        // Optional periodic stats export, stopped on close
+        let exporter = args.stats_export().map(|export| {
+            let done = Arc::new(AtomicBool::new(false));
+            let (export_done, export_recorder) = (Arc::clone(&done), Arc::clone(&recorder));
+            let handle = thread::spawn(move || export.run(&export_recorder, &export_done));
+            (done, handle)
+        });
+
+        Self {
+            submit_tx: Some(submit_tx),
+            next_ticket: AtomicU64::new(0),
+            shared,
+            recorder,
+            handles,
+            exporter,
+        }
+    }
+
+    /// Load the model from `args` and spawn pipeline stages.
+    pub fn from_args(args: &PredictArgs) -> Result<Self> {
+        let budget = ThreadBudget::from_args(args);
+        let model = crate::predict::load_model(args, &budget)?;
+        Ok(Self::new(model, args, budget))
+    }
+
+    /// Submit a frame to the pipeline and return its ticket.
+    ///
+    /// Blocks when the pipeline is saturated (bounded channels provide backpressure).
+    pub fn submit(&self, image: DynamicImage, tag: u64) -> Result<u64> {
+        let submit_tx = self
+            .submit_tx
+            .as_ref()
+            .ok_or_else(|| AppError::Config("Stream pipeline is closed".to_string()))?;
+
+        let ticket = self.next_ticket.fetch_add(1, Ordering::Relaxed);
+        let meta = SourceMeta {
+            frame_idx: ticket as usize,
+            total_frames: 0,
+            source_path: None,
+            tag: Some(tag),
+            timestamp: None,
+            timings: FrameTimings::start(),
+        };
+
+        // tracked before the frame can complete
+        self.shared.submit(ticket);
+        submit_tx.send((image, meta)).map_err(|_| {
+            self.shared.update(|state| {
+                state.pending.remove(&ticket);
+            });
+            AppError::Inference("Stream pipeline stopped unexpectedly".to_string())
+        })?;
+        Ok(ticket)
+    }
+
+    /// Live per-stage stats since the pipeline was started
+    pub fn stats(&self) -> PipelineStats {
+        self.recorder.snapshot()
+    }
+
+    /// Take all finished results (sorted by ticket) without blocking.
+    pub fn poll(&self) -> Vec<InferResult> {
+        self.shared.take_results()
+    }
+
+    /// Take all tickets whose frame failed (sorted) without blocking.
+    pub fn poll_failed(&self) -> Vec<u64> {
+        self.shared.take_failed()
+    }
+
+    /// Block until the result of `ticket` is ready and take it.
+    ///
+    /// # Errors
+    ///
+    /// Returns `AppError` if the ticket was never submitted, its result was already taken (by
+    /// `wait`, `poll` or `poll_failed`), its frame failed in one of the stages, or the pipeline
+    /// stopped before it completed.
+    pub fn wait(&self, ticket: u64) -> Result<InferResult> {
+        if ticket >= self.next_ticket.load(Ordering::Relaxed) {
+            return Err(AppError::Config(format!("Unknown ticket: {}", ticket)));
+        }
+        self.shared.wait(ticket)
+    }
+
+    /// Stop accepting frames, drain in-flight frames and join stage threads.
+    /// Results that are already finished can still be taken afterwards.
+    pub fn close(&mut self) {
+        // Dropping the sender lets every stage drain and exit in order
+        self.submit_tx.take();
+        for handle in self.handles.drain(..) {
+            if handle.join().is_err() {
+                tracing::error!("Stream pipeline stage thread panicked");
+            }
+        }
+        if let Some((done, handle)) = self.exporter.take() {
+            done.store(true, Ordering::Release);
+            if handle.join().is_err() {
+                tracing::error!("Stream pipeline stats exporter thread panicked");
+            }
+        }
+    }
+}
+
+impl Drop for StreamPipeline {
+    fn drop(&mut self) {
+        self.close();
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_wait_after_poll_reports_taken_ticket() {
+        let shared: Shared<&str> = Shared::default();
+        shared.submit(0);
+        shared.submit(1);
+        shared.complete(0, "frame 0");
+        assert_eq!(shared.take_results(), vec!["frame 0"]);
+
+        // the result was delivered by `poll`, `wait` must not block on it
+        let err = shared.wait(0).unwrap_err();
+        assert!(err.to_string().contains("already taken"), "{}", err);
+
+        shared.complete(1, "frame 1");
+        assert_eq!(shared.wait(1).unwrap(), "frame 1");
+        assert!(shared.wait(1).is_err());
+    }
+}
@@ -0,0 +1,321 @@
+use image::{DynamicImage, GenericImageView};
+use ndarray::Array2;
+use serde::Deserialize;
+use ultralytics_inference as ul;
+
+use crate::buffer_pool::frame_pool;
+use crate::result_cache::empty_results;
+use crate::source::SourceMeta;
+
+use super::batch_utils::AdaptiveBatch;
+
+/// Region of a frame in pixels
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Deserialize)]
+pub struct TileRect {
+    pub x: u32,
+    pub y: u32,
+    pub width: u32,
+    pub height: u32,
+}
+
+impl TileRect {
+    /// Part of the rect inside a `width x height` frame, `None` if it is outside
+    fn clip(self, width: u32, height: u32) -> Option<Self> {
+        let (x2, y2) = (
+            self.x.saturating_add(self.width).min(width),
+            self.y.saturating_add(self.height).min(height),
+        );
+        (self.x < x2 && self.y < y2).then(|| Self {
+            x: self.x,
+            y: self.y,
+            width: x2 - self.x,
+            height: y2 - self.y,
+        })
+    }
+}
+
+/// Tiled inference of frames much larger than the model input (see `PredictArgs::tile_size`).
+///
+/// Each frame (or each region of interest) is cut into overlapping `size x size` tiles, the last
+/// tile of a row or column aligned to the edge. Tiles of all frames of a batch are packed into
+/// full model batches; a tile is cropped into a pooled buffer only right before its batch runs
+/// and recycled after. Detections are shifted back to frame coordinates and tiles overlapping
+/// the same object are merged by a class-aware NMS over the whole frame.
+///
+/// Only boxes are stitched: masks, keypoints, oriented boxes and class scores of the tiles are
+/// dropped.
+#[derive(Debug, Clone, PartialEq)]
+pub struct Tiling {
+    /// Tile side in pixels
+    pub size: u32,
+    /// Overlap of neighbouring tiles in pixels
+    pub overlap: u32,
+    /// Regions to tile instead of the whole frame
+    pub rois: Vec<TileRect>,
+    /// IoU threshold of the cross-tile NMS
+    pub iou: f32,
+    /// Maximum number of detections per frame
+    pub max_det: usize,
+}
+
+impl Tiling {
+    /// Tiles covering a `width x height` frame
+    pub fn tiles(&self, width: u32, height: u32) -> Vec<TileRect> {
+        let full = TileRect {
+            x: 0,
+            y: 0,
+            width,
+            height,
+        };
+        let regions: Vec<TileRect> = if self.rois.is_empty() {
+            vec![full]
+        } else {
+            self.rois
+                .iter()
+                .filter_map(|roi| roi.clip(width, height))
+                .collect()
+        };
+
+        let mut tiles = Vec::new();
+        for region in regions {
+            for y in self.starts(region.y, region.height) {
+                for x in self.starts(region.x, region.width) {
+                    tiles.push(TileRect {
+                        x,
+                        y,
+                        width: self.size.min(region.width),
+                        height: self.size.min(region.height),
+                    });
+                }
+            }
+        }
+        tiles
+    }
+
+    /// Tile offsets along one axis of a region
+    fn starts(&self, offset: u32, len: u32) -> Vec<u32> {
+        let size = self.size.max(1);
+        if len <= size {
+            return vec![offset];
+        }
+        let step = size.saturating_sub(self.overlap).max(1);
+        let mut starts: Vec<u32> = (0..len - size).step_by(step as usize).collect();
+        starts.push(len - size);
+        starts.into_iter().map(|s| offset + s).collect()
+    }
+
+    /// Run inference on the tiles of `images`, in batches of the configured batch size, and
+    /// stitch the results of each frame. A frame with a failed tile has no result; a frame
+    /// without tiles (all regions of interest outside it) has a result without detections.
+    pub(super) fn infer(
+        &self,
+        batcher: &mut AdaptiveBatch,
+        model: &mut ul::YOLOModel,
+        images: &[DynamicImage],
+        metas: &[SourceMeta],
+        verbose: bool,
+    ) -> Vec<Option<ul::Results>> {
+        let tiles: Vec<(usize, TileRect)> = images
+            .iter()
+            .enumerate()
+            .flat_map(|(i, image)| {
+                let (w, h) = image.dimensions();
+                self.tiles(w, h).into_iter().map(move |tile| (i, tile))
+            })
+            .collect();
+        if verbose {
+            tracing::debug!(
+                "[Tiling] {} frames into {} tiles",
+                images.len(),
+                tiles.len()
+            );
+        }
+
+        let mut frames: Vec<StitchedFrame> =
+            (0..images.len()).map(|_| Default::default()).collect();
+        for chunk in tiles.chunks(batcher.max()) {
+            let crops: Vec<DynamicImage> = chunk
+                .iter()
+                .map(|&(i, t)| {
+                    let crop = frame_pool().crop_rgb8(&images[i], t.x, t.y, t.width, t.height);
+                    DynamicImage::ImageRgb8(crop)
+                })
+                .collect();
+            let crop_metas: Vec<SourceMeta> =
+                chunk.iter().map(|&(i, _)| metas[i].clone()).collect();
+
+            let results = batcher.infer_frames(model, &crops, &crop_metas, verbose);
+            for (&(i, tile), result) in chunk.iter().zip(results) {
+                frames[i].add(tile, result);
+            }
+            crops
+                .into_iter()
+                .for_each(|crop| frame_pool().recycle(crop));
+        }
+
+        // frames without tiles have no tile results to build on: they get a copy of another
+        // frame's results, or of a blank frame's, without detections
+        let template = frames
+            .iter()
+            .any(|frame| frame.base.is_none() && !frame.failed)
+            .then(|| {
+                frames
+                    .iter()
+                    .find_map(|frame| frame.base.clone().map(empty_results))
+                    .or_else(|| batcher.blank_results(model))
+            })
+            .flatten();
+
+        frames
+            .into_iter()
+            .zip(images)
+            .map(|(frame, image)| {
+                frame.finish(
+                    template.as_ref(),
+                    image.dimensions(),
+                    self.iou,
+                    self.max_det,
+                )
+            })
+            .collect()
+    }
+}
+
+/// Tile results of one frame, gathered until all its tiles ran
+#[derive(Default)]
+struct StitchedFrame {
+    /// Results of the first tile, holding class names and timings
+    base: Option<ul::Results>,
+    /// Boxes in frame coordinates, `x1, y1, x2, y2, conf, cls`
+    boxes: Vec<[f32; 6]>,
+    failed: bool,
+}
+
+impl StitchedFrame {
+    fn add(&mut self, tile: TileRect, result: Option<ul::Results>) {
+        let Some(result) = result else {
+            self.failed = true;
+            return;
+        };
+        if let Some(boxes) = result.boxes.as_ref().filter(|b| b.data.ncols() == 6) {
+            let (dx, dy) = (tile.x as f32, tile.y as f32);
+            for row in boxes.data.rows() {
+                self.boxes.push([
+                    row[0] + dx,
+                    row[1] + dy,
+                    row[2] + dx,
+                    row[3] + dy,
+                    row[4],
+                    row[5],
+                ]);
+            }
+        }
+        self.base.get_or_insert(result);
+    }
+
+    /// Stitched result in frame coordinates; frames without tiles start from `template`
+    fn finish(
+        mut self,
+        template: Option<&ul::Results>,
+        (width, height): (u32, u32),
+        iou: f32,
+        max_det: usize,
+    ) -> Option<ul::Results> {
+        if self.failed {
+            return None;
+        }
+        let mut result = self.base.take().or_else(|| template.cloned())?;
+        let keep = nms(&self.boxes, iou, max_det);
+        let data: Vec<f32> = keep.iter().flat_map(|&i| self.boxes[i]).collect();
+        let data = Array2::from_shape_vec((keep.len(), 6), data).expect("Boxes have 6 columns");
+        result.boxes = Some(ul::Boxes::new(data, (height, width)));
+        result.masks = None;
+        result.keypoints = None;
+        result.obb = None;
+        result.probs = None;
+        Some(result)
+    }
+}
+
+fn box_iou(a: &[f32; 6], b: &[f32; 6]) -> f32 {
+    let w = (a[2].min(b[2]) - a[0].max(b[0])).max(0.0);
+    let h = (a[3].min(b[3]) - a[1].max(b[1])).max(0.0);
+    let inter = w * h;
+    let union = (a[2] - a[0]) * (a[3] - a[1]) + (b[2] - b[0]) * (b[3] - b[1]) - inter;
+    if union > 0.0 { inter / union } else { 0.0 }
+}
+
+/// Class-aware greedy NMS; returns the indices of the kept boxes, best first
+fn nms(boxes: &[[f32; 6]], iou: f32, max_det: usize) -> Vec<usize> {
+    let mut order: Vec<usize> = (0..boxes.len()).collect();
+    order.sort_by(|&a, &b| boxes[b][4].total_cmp(&boxes[a][4]));
+
+    let mut keep: Vec<usize> = Vec::new();
+    for i in order {
+        if keep.len() >= max_det {
+            break;
+        }
+        let suppressed = keep
+            .iter()
+            .any(|&k| boxes[k][5] == boxes[i][5] && box_iou(&boxes[k], &boxes[i]) > iou);
+        if !suppressed {
+            keep.push(i);
+        }
+    }
+    keep
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_tiles_overlap_and_cover_frame() {
+        let tiling = Tiling {
+            size: 640,
+            overlap: 128,
+            rois: Vec::new(),
+            iou: 0.5,
+            max_det: 300,
+        };
+        // 1500 px: tiles at 0, 512 and the last one aligned to the edge
+        assert_eq!(tiling.starts(0, 1500), vec![0, 512, 860]);
+        assert_eq!(tiling.starts(10, 300), vec![10]);
+        assert_eq!(tiling.tiles(1500, 600).len(), 3);
+
+        let tiling = Tiling {
+            rois: vec![TileRect {
+                x: 1000,
+                y: 100,
+                width: 1000,
+                height: 400,
+            }],
+            ..tiling
+        };
+        // the ROI is clipped to the 1500 px wide frame
+        let tiles = tiling.tiles(1500, 600);
+        assert_eq!(
+            tiles,
+            vec![TileRect {
+                x: 1000,
+                y: 100,
+                width: 500,
+                height: 400,
+            }]
+        );
+    }
+
+    #[test]
+    fn test_nms_merges_boxes_across_tiles() {
+        let boxes = [
+            [0.0, 0.0, 10.0, 10.0, 0.6, 0.0],
+            // same object seen by the next tile, higher score
+            [1.0, 0.0, 10.0, 10.0, 0.9, 0.0],
+            // same place, other class
+            [0.0, 0.0, 10.0, 10.0, 0.5, 1.0],
+            [50.0, 50.0, 60.0, 60.0, 0.7, 0.0],
+        ];
+        assert_eq!(nms(&boxes, 0.5, 300), vec![1, 3, 2]);
+        assert_eq!(nms(&boxes, 0.5, 2), vec![1, 3]);
+    }
+}
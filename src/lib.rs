@@ -1,24 +1,44 @@
 mod annotate;
+mod bench;
+mod buffer_pool;
 mod error;
 mod ffi;
 mod infer_fn;
 mod logging;
+mod masks;
+mod model_meta;
 mod predict;
 mod progress_bar;
+mod result_cache;
+mod result_sink;
 mod source;
+mod stats;
+mod thread_budget;
 mod toml_utils;
+mod warmup;
+mod writer;
 
-pub use annotate::{AnnotateConfigs, annotate_image};
+pub use annotate::{AnnotateConfigs, annotate_frame, annotate_image, annotate_prediction};
+pub use bench::{BenchConfig, BenchRecord, bench_from_toml, records_to_csv, records_to_json,
+                run_benchmark, write_report};
+pub use buffer_pool::{BufferPool, frame_pool};
 pub use error::{AppError, Result};
-pub use infer_fn::{InferFn, InferResult, auto_infer};
+pub use infer_fn::{InferFn, InferResult, Prediction, StreamPipeline, TileRect, Tiling, auto_infer};
 pub use logging::init_logger;
-pub use progress_bar::progress_bar_style;
-pub use source::{BatchSourceLoader, Source, SourceLoader, SourceMeta, collect_images_from_dir,
-                 is_image_file};
+pub use masks::{MASK_THRESHOLD, RleMasks};
+pub use progress_bar::{progress_bar, progress_bar_style};
+pub use result_cache::ResultCache;
+pub use result_sink::{RESULT_FILE_MAGIC, RESULT_FILE_VERSION, ResultSink};
+pub use source::{BatchSourceLoader, DirImages, FrameTimings, ManifestImages, Source, SourceLoader,
+                 SourceMeta, collect_images_from_dir, is_image_file};
+pub use stats::{PipelineStats, StageStats, StatsFormat, write_stats};
+pub use thread_budget::{Stage, ThreadBudget};
 pub use toml_utils::parse_toml;
+pub use writer::{ImageEncoder, ImageWriter, SaveFailure, SaveFormat};
 
 // Core inference function
-pub use predict::{PredictArgs, run_online_prediction, run_prediction};
+pub use predict::{PredictArgs, Predictor, load_model, load_models, run_online_prediction,
+                  run_prediction, run_prediction_with_stats};
 
 // FFI
 #[allow(unused_imports)]
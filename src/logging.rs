@@ -1,8 +1,9 @@
+/// Initialize global logger. Safe to call multiple times (e.g. once per FFI call).
 pub fn init_logger() {
-    tracing_subscriber::fmt()
+    let _ = tracing_subscriber::fmt()
         .with_max_level(tracing::Level::DEBUG)
         .with_target(false)
         .with_file(true)
         .with_line_number(true)
-        .init();
+        .try_init();
 }
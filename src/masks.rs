@@ -0,0 +1,147 @@
+// -- imports
+use ultralytics_inference as ul;
+
+/// Mask probability threshold: values above it are foreground
+pub const MASK_THRESHOLD: f32 = 0.5;
+
+/// Binarized instance masks, run-length encoded.
+///
+/// Each mask is a list of run lengths over its `height x width` pixels in row-major order,
+/// alternating background and foreground and starting with background (the first run may be
+/// empty). Instead of 4 bytes per pixel and instance, a mask costs 8 bytes per row it crosses.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct RleMasks {
+    height: usize,
+    width: usize,
+    runs: Vec<u32>,
+    /// Start of the runs of each mask in `runs`, followed by `runs.len()`
+    starts: Vec<usize>,
+}
+
+impl RleMasks {
+    /// Empty set of `height x width` masks
+    pub fn new(height: usize, width: usize) -> Self {
+        Self {
+            height,
+            width,
+            runs: Vec::new(),
+            starts: vec![0],
+        }
+    }
+
+    /// Binarize and encode the dense masks of `result`, if it has any
+    pub fn from_results(result: &ul::Results) -> Option<Self> {
+        let masks = result.masks.as_ref()?;
+        let (_, height, width) = masks.data.dim();
+        let mut rle = Self::new(height, width);
+        for mask in masks.data.outer_iter() {
+            match mask.as_slice() {
+                Some(values) => rle.push(values.iter().copied()),
+                None => rle.push(mask.iter().copied()),
+            }
+        }
+        Some(rle)
+    }
+
+    /// Append a mask given as its `height * width` probabilities in row-major order
+    pub fn push(&mut self, values: impl IntoIterator<Item = f32>) {
+        let (mut foreground, mut run) = (false, 0u32);
+        for value in values {
+            if (value > MASK_THRESHOLD) != foreground {
+                self.runs.push(run);
+                foreground = !foreground;
+                run = 0;
+            }
+            run += 1;
+        }
+        self.runs.push(run);
+        self.starts.push(self.runs.len());
+    }
+
+    /// Append a mask given as its run lengths, see [`RleMasks::runs`]
+    pub fn push_runs(&mut self, runs: &[u32]) {
+        self.runs.extend_from_slice(runs);
+        self.starts.push(self.runs.len());
+    }
+
+    /// Number of masks
+    pub fn len(&self) -> usize {
+        self.starts.len() - 1
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    pub const fn height(&self) -> usize {
+        self.height
+    }
+
+    pub const fn width(&self) -> usize {
+        self.width
+    }
+
+    /// Run lengths of mask `index`, empty if there is no such mask
+    pub fn runs(&self, index: usize) -> &[u32] {
+        match self.starts.get(index..index + 2) {
+            Some(&[start, end]) => &self.runs[start..end],
+            _ => &[],
+        }
+    }
+
+    /// Foreground runs of mask `index` as `(offset, len)` in row-major pixel order
+    pub fn foreground(&self, index: usize) -> impl Iterator<Item = (usize, usize)> + '_ {
+        let mut offset = 0;
+        self.runs(index)
+            .iter()
+            .enumerate()
+            .filter_map(move |(i, &run)| {
+                let span = (offset, run as usize);
+                offset += run as usize;
+                (i % 2 == 1 && run > 0).then_some(span)
+            })
+    }
+
+    /// Decode mask `index` into `out` (`height * width` bytes, 1 for foreground); returns false
+    /// if there is no such mask or `out` has another size
+    pub fn decode_into(&self, index: usize, out: &mut [u8]) -> bool {
+        if index >= self.len() || out.len() != self.height * self.width {
+            return false;
+        }
+        out.fill(0);
+        for (offset, len) in self.foreground(index) {
+            let end = (offset + len).min(out.len());
+            out[offset.min(end)..end].fill(1);
+        }
+        true
+    }
+
+    /// Heap memory held by the encoded masks, in bytes
+    pub fn heap_bytes(&self) -> usize {
+        self.runs.capacity() * size_of::<u32>() + self.starts.capacity() * size_of::<usize>()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_rle_masks_round_trip() {
+        let mut rle = RleMasks::new(2, 4);
+        rle.push([0.0; 8]);
+        rle.push([0.9, 0.8, 0.1, 0.0, 0.0, 0.0, 0.7, 1.0]);
+        assert_eq!(rle.len(), 2);
+        assert_eq!(rle.runs(0), &[8]);
+        assert_eq!(rle.runs(1), &[0, 2, 4, 2]);
+        assert_eq!(rle.runs(2), &[] as &[u32]);
+
+        let spans: Vec<_> = rle.foreground(1).collect();
+        assert_eq!(spans, vec![(0, 2), (6, 2)]);
+
+        let mut out = [9u8; 8];
+        assert!(rle.decode_into(1, &mut out));
+        assert_eq!(out, [1, 1, 0, 0, 0, 0, 1, 1]);
+        assert!(!rle.decode_into(2, &mut out));
+    }
+}
@@ -0,0 +1,141 @@
+// -- imports
+use std::path::Path;
+
+use crate::error::Result;
+
+// -- protobuf
+
+/// Value of a protobuf field, only length-delimited payloads and varints are kept
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum FieldValue<'a> {
+    Varint(u64),
+    Bytes(&'a [u8]),
+    Fixed,
+}
+
+/// Minimal protobuf reader over the fields of one message. Iteration stops at the first
+/// malformed field.
+struct Fields<'a> {
+    buf: &'a [u8],
+}
+
+impl<'a> Fields<'a> {
+    const fn new(buf: &'a [u8]) -> Self {
+        Self { buf }
+    }
+
+    fn varint(&mut self) -> Option<u64> {
+        let mut value = 0u64;
+        for (i, &byte) in self.buf.iter().enumerate().take(10) {
+            value |= u64::from(byte & 0x7f) << (7 * i);
+            if byte & 0x80 == 0 {
+                self.buf = &self.buf[i + 1..];
+                return Some(value);
+            }
+        }
+        None
+    }
+
+    fn skip(&mut self, len: usize) -> Option<&'a [u8]> {
+        let (head, tail) = self.buf.split_at_checked(len)?;
+        self.buf = tail;
+        Some(head)
+    }
+}
+
+impl<'a> Iterator for Fields<'a> {
+    type Item = (u64, FieldValue<'a>);
+
+    fn next(&mut self) -> Option<Self::Item> {
+        if self.buf.is_empty() {
+            return None;
+        }
+        let key = self.varint()?;
+        let value = match key & 0x7 {
+            0 => FieldValue::Varint(self.varint()?),
+            1 => self.skip(8).map(|_| FieldValue::Fixed)?,
+            2 => {
+                let len = usize::try_from(self.varint()?).ok()?;
+                FieldValue::Bytes(self.skip(len)?)
+            }
+            5 => self.skip(4).map(|_| FieldValue::Fixed)?,
+            // groups are not used by ONNX
+            _ => return None,
+        };
+        Some((key >> 3, value))
+    }
+}
+
+/// Payload of the first length-delimited field `number` of `message`
+fn message_field(message: &[u8], number: u64) -> Option<&[u8]> {
+    Fields::new(message).find_map(|(n, value)| match value {
+        FieldValue::Bytes(bytes) if n == number => Some(bytes),
+        _ => None,
+    })
+}
+
+// -- onnx
+
+/// Static batch dimension of the first input of an ONNX model, `None` if it is dynamic
+///
+/// Follows `ModelProto.graph` (7) → `GraphProto.input` (11) → `ValueInfoProto.type` (2) →
+/// `TypeProto.tensor_type` (1) → `Tensor.shape` (2) → first `dim` (1) → `dim_value` (1); a
+/// symbolic `dim_param` means the batch size is dynamic.
+fn static_batch(model: &[u8]) -> Option<usize> {
+    let graph = message_field(model, 7)?;
+    let input = message_field(graph, 11)?;
+    let tensor_type = message_field(message_field(input, 2)?, 1)?;
+    let batch_dim = message_field(message_field(tensor_type, 2)?, 1)?;
+    Fields::new(batch_dim).find_map(|(n, value)| match value {
+        FieldValue::Varint(dim) if n == 1 && dim > 0 => usize::try_from(dim).ok(),
+        _ => None,
+    })
+}
+
+/// Static batch dimension of the input of the ONNX model at `path`, `None` if the model takes
+/// any batch size (or its input shape cannot be read)
+pub fn onnx_static_batch(path: &Path) -> Result<Option<usize>> {
+    let model = std::fs::read(path)?;
+    Ok(static_batch(&model))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// Length-delimited field `number` holding `payload`
+    fn field(number: u8, payload: &[u8]) -> Vec<u8> {
+        let mut bytes = vec![(number << 3) | 2, payload.len() as u8];
+        bytes.extend_from_slice(payload);
+        bytes
+    }
+
+    /// Model whose input has the first dimension `batch_dim` (an encoded `Dimension`)
+    fn model_with_batch_dim(batch_dim: &[u8]) -> Vec<u8> {
+        let shape = field(1, batch_dim);
+        let tensor_type = [vec![0x08, 0x01], field(2, &shape)].concat();
+        let value_info = [field(1, b"images"), field(2, &field(1, &tensor_type))].concat();
+        let graph = [field(2, b"main"), field(11, &value_info)].concat();
+        // ir_version, then the graph
+        [vec![0x08, 0x09], field(7, &graph)].concat()
+    }
+
+    #[test]
+    fn test_static_batch_of_onnx_input() {
+        // dim_value = 1
+        assert_eq!(static_batch(&model_with_batch_dim(&[0x08, 0x01])), Some(1));
+        // dim_value = 300 (multi-byte varint)
+        assert_eq!(
+            static_batch(&model_with_batch_dim(&[0x08, 0xac, 0x02])),
+            Some(300)
+        );
+        // dim_param = "batch"
+        assert_eq!(
+            static_batch(&model_with_batch_dim(&field(2, b"batch"))),
+            None
+        );
+        // truncated model
+        let model = model_with_batch_dim(&[0x08, 0x01]);
+        assert_eq!(static_batch(&model[..model.len() - 3]), None);
+    }
+}
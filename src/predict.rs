@@ -1,12 +1,19 @@
 use serde::Deserialize;
-use std::path::PathBuf;
-use std::time::Instant;
+use std::borrow::Cow;
+use std::path::{Path, PathBuf};
+use std::time::{Duration, Instant};
 use ultralytics_inference as ul;
 
 use crate::annotate::AnnotateConfigs;
 use crate::error::{AppError, Result};
-use crate::infer_fn::{InferFn, InferResult, auto_infer, deserialize_infer_fn};
-use crate::source::{Source, deserialize_source};
+use crate::infer_fn::{InferFn, InferResult, StreamPipeline, TileRect, Tiling, auto_infer,
+                      deserialize_infer_fn};
+use crate::source::{Source, VideoOptions, deserialize_source};
+use crate::stats::{PipelineStats, StatsExport, StatsFormat};
+use crate::thread_budget::{Stage, ThreadBudget};
+use crate::toml_utils::parse_toml;
+use crate::warmup::{configure_engine_cache, warmup_models};
+use crate::writer::SaveFormat;
 
 #[derive(Debug, Clone, Deserialize)]
 #[serde(default)]
@@ -30,6 +37,17 @@ pub struct PredictArgs {
     /// Inference image size
     pub imgsz: Option<usize>,
 
+    /// Cut frames into overlapping `tile_size` square tiles before inference, for frames much
+    /// larger than `imgsz`; detections are mapped back to the frame and merged by a cross-tile
+    /// NMS (see `Tiling`). Batch inference functions only; `batch` then counts tiles.
+    pub tile_size: Option<u32>,
+
+    /// Overlap of neighbouring tiles in pixels (default: a fifth of `tile_size`)
+    pub tile_overlap: Option<u32>,
+
+    /// Regions of interest tiled instead of the whole frame
+    pub rois: Vec<TileRect>,
+
     /// Use FP16 half-precision inference
     pub half: bool,
 
@@ -37,11 +55,36 @@ pub struct PredictArgs {
     pub batch: Option<usize>,
 
     /// Device to use (cpu, cuda:0, mps, coreml, directml:0, openvino, tensorrt:0, etc.)
+    ///
+    /// Accepts a single device, a comma-separated string or a TOML list
+    /// (e.g. `["cuda:0", "cuda:1"]`); one model replica is loaded per listed device.
+    #[serde(default, deserialize_with = "deserialize_device")]
     pub device: Option<String>,
 
+    /// Number of model replicas (defaults to the number of listed devices). Devices are assigned
+    /// to replicas round-robin. Only `BatchChannelPipeline` runs multiple replicas.
+    pub replicas: Option<usize>,
+
+    /// Number of blank batches run through every replica right after loading, so engine builds
+    /// and kernel autotuning happen before the first real request (default 0)
+    pub warmup_iters: Option<usize>,
+
+    /// Directory caching serialized TensorRT engines and the startup batchability probe, so
+    /// restarts skip both
+    pub engine_cache_dir: Option<PathBuf>,
+
     /// Directory to save results
     pub save_dir: Option<PathBuf>,
 
+    /// Encoding of saved images (`png`, `png_fast`, `jpeg` or `qoi`)
+    pub save_format: SaveFormat,
+
+    /// JPEG quality (1-100, default 90)
+    pub jpeg_quality: Option<u8>,
+
+    /// Number of threads encoding and writing saved images (unset: on the saving stage thread)
+    pub save_workers: Option<usize>,
+
     /// Inference function to use
     #[serde(default, deserialize_with = "deserialize_infer_fn")]
     pub infer_fn: InferFn,
@@ -52,9 +95,71 @@ pub struct PredictArgs {
     /// Annotate configurations
     pub annotate_cfg: AnnotateConfigs,
 
+    /// Number of annotation threads (`ChannelPipeline` and `BatchChannelPipeline`, default 1).
+    /// Output order does not depend on it.
+    pub annotate_workers: Option<usize>,
+
     /// Multi-thread channel capacity
     pub channel_capacity: Option<usize>,
 
+    /// Number of threads decoding image files in the load stage (`0` or unset: one per CPU,
+    /// `1`: decode on the load thread)
+    pub decode_workers: Option<usize>,
+
+    /// Total CPU cores shared by the pipeline stages and the ONNX Runtime pools (see
+    /// `ThreadBudget`); `decode_workers` and `annotate_workers` default to their share of it
+    pub cpu_threads: Option<usize>,
+
+    /// Pin the threads of every stage and the ONNX Runtime pools of every replica to their cores
+    /// of the `cpu_threads` budget (Linux, `affinity` feature)
+    pub pin_threads: bool,
+
+    /// Keep every `vid_stride`-th frame of video and stream sources (default 1: every frame)
+    pub vid_stride: Option<usize>,
+
+    /// ffmpeg hardware decoder of video and stream sources (`auto`, `cuda` for NVDEC, `vaapi`,
+    /// ...; `none` decodes on the CPU). Defaults to `auto`.
+    pub hwaccel: Option<String>,
+
+    /// Number of loaded items (batches for batch pipelines, frames otherwise) buffered ahead of
+    /// the inference stage. Defaults to `channel_capacity`.
+    pub prefetch: Option<usize>,
+
+    /// Max time (microseconds) to wait for a micro-batch to fill up (`DynamicBatchPipeline` and
+    /// stream pipeline)
+    pub max_wait_us: Option<u64>,
+
+    /// Periodically export per-stage pipeline stats in this format (`json` or `prometheus`)
+    pub stats_export: Option<StatsFormat>,
+
+    /// File the stats are exported to (defaults to `pipeline_stats.json` / `.prom` in the
+    /// working directory)
+    pub stats_path: Option<PathBuf>,
+
+    /// Stats export interval (milliseconds)
+    pub stats_interval_ms: Option<u64>,
+
+    /// Binarize and run-length encode masks right after inference, dropping the dense `[N, H, W]`
+    /// f32 tensors (see `RleMasks`); annotation, result files and the C++ accessors use the
+    /// encoded masks
+    pub compact_masks: bool,
+
+    /// Keep the results of up to `cache_size` frames in memory and skip inference of frames seen
+    /// before with the same model and settings (see `ResultCache`). Batch inference functions
+    /// only.
+    pub cache_size: Option<usize>,
+
+    /// Also keep cached results on disk in this directory, across runs
+    pub cache_dir: Option<PathBuf>,
+
+    /// Size cap of `cache_dir` in MiB (default 1024, 0: unbounded); the least recently used
+    /// entries beyond it are removed
+    pub cache_dir_mb: Option<u64>,
+
+    /// Append the results of every frame to this compact binary file as they are collected
+    /// (boxes, oriented boxes, keypoints, top classes and RLE masks, see `ResultSink`)
+    pub result_file: Option<PathBuf>,
+
     /// Whether to store and return inference results
     pub return_result: bool,
 
@@ -71,39 +176,192 @@ impl Default for PredictArgs {
             iou: 0.45,
             max_det: 300,
             imgsz: None,
+            tile_size: None,
+            tile_overlap: None,
+            rois: Vec::new(),
             half: false,
             batch: Some(4),
             device: None,
+            replicas: None,
+            warmup_iters: None,
+            engine_cache_dir: None,
             save_dir: None,
+            save_format: Default::default(),
+            jpeg_quality: None,
+            save_workers: None,
             infer_fn: Default::default(),
             annotate: false,
             annotate_cfg: Default::default(),
+            annotate_workers: None,
             channel_capacity: Some(8),
+            decode_workers: None,
+            cpu_threads: None,
+            pin_threads: false,
+            vid_stride: None,
+            hwaccel: None,
+            prefetch: None,
+            max_wait_us: Some(1000),
+            stats_export: None,
+            stats_path: None,
+            stats_interval_ms: Some(1000),
+            compact_masks: false,
+            cache_size: None,
+            cache_dir: None,
+            cache_dir_mb: Some(1024),
+            result_file: None,
             return_result: false,
             verbose: false,
         }
     }
 }
 
-impl TryFrom<&PredictArgs> for ul::InferenceConfig {
-    type Error = AppError;
+/// Custom deserializer accepting a device string or a list of device strings
+fn deserialize_device<'de, D>(deserializer: D) -> std::result::Result<Option<String>, D::Error>
+where
+    D: serde::Deserializer<'de>,
+{
+    #[derive(Deserialize)]
+    #[serde(untagged)]
+    enum DeviceValue {
+        One(String),
+        Many(Vec<String>),
+    }
 
-    fn try_from(args: &PredictArgs) -> std::result::Result<Self, Self::Error> {
-        let mut config = Self::new()
-            .with_confidence(args.conf)
-            .with_iou(args.iou)
-            .with_half(args.half)
-            .with_max_det(args.max_det)
-            .with_batch(args.batch.unwrap_or(1));
-
-        if let Some(sz) = args.imgsz {
+    Ok(match Option::<DeviceValue>::deserialize(deserializer)? {
+        Some(DeviceValue::One(device)) => Some(device),
+        Some(DeviceValue::Many(devices)) => Some(devices.join(",")),
+        None => None,
+    })
+}
+
+impl PredictArgs {
+    /// Device of every model replica, in replica order.
+    ///
+    /// Returns `replicas` entries (at least one); `None` means the default device.
+    pub fn devices(&self) -> Vec<Option<String>> {
+        let listed: Vec<&str> = self
+            .device
+            .as_deref()
+            .map(|d| {
+                d.split(',')
+                    .map(str::trim)
+                    .filter(|d| !d.is_empty())
+                    .collect()
+            })
+            .unwrap_or_default();
+        let replicas = self.replicas.unwrap_or(listed.len()).max(1);
+
+        if listed.is_empty() {
+            return vec![None; replicas];
+        }
+        (0..replicas)
+            .map(|i| Some(listed[i % listed.len()].to_string()))
+            .collect()
+    }
+
+    /// Devices of the replicas that are loaded: every entry of [`PredictArgs::devices`] for
+    /// `BatchChannelPipeline`, only the first one for the other inference functions, which run a
+    /// single replica
+    pub fn replica_devices(&self) -> Vec<Option<String>> {
+        let mut devices = self.devices();
+        if !matches!(self.infer_fn, InferFn::BatchChannelPipeline) {
+            devices.truncate(1);
+        }
+        devices
+    }
+
+    /// Depth of the load stage channel, see [`PredictArgs::prefetch`]
+    pub fn prefetch_depth(&self) -> usize {
+        self.prefetch.or(self.channel_capacity).unwrap_or(8).max(1)
+    }
+
+    /// Decoding options of video and stream sources
+    pub fn video_options(&self) -> VideoOptions {
+        let defaults = VideoOptions::default();
+        VideoOptions {
+            stride: self.vid_stride.unwrap_or(defaults.stride).max(1),
+            hwaccel: self.hwaccel.clone().unwrap_or(defaults.hwaccel),
+        }
+    }
+
+    /// Tiled inference settings, if `tile_size` is set
+    pub fn tiling(&self) -> Option<Tiling> {
+        let size = self.tile_size.filter(|&s| s > 0)?;
+        Some(Tiling {
+            size,
+            overlap: self.tile_overlap.unwrap_or(size / 5).min(size - 1),
+            rois: self.rois.clone(),
+            iou: self.iou,
+            max_det: self.max_det,
+        })
+    }
+
+    /// Whether `cache_size` or `cache_dir` enables the result cache
+    pub fn caches_results(&self) -> bool {
+        self.cache_size.is_some_and(|n| n > 0) || self.cache_dir.is_some()
+    }
+
+    /// Inference function of a run over `source`: `infer_fn`, or `Sequential` for a single
+    /// image unless it is tiled or cached, which needs a batch inference function
+    /// (`BatchSequential`)
+    pub fn infer_fn_for(&self, source: &Source) -> InferFn {
+        if !source.is_image() {
+            self.infer_fn.clone()
+        } else if self.tiling().is_some() || self.caches_results() {
+            InferFn::BatchSequential
+        } else {
+            InferFn::Sequential
+        }
+    }
+
+    /// Number of annotation threads, at least one (default: the share of `budget`, or 1)
+    pub fn annotate_workers(&self, budget: &ThreadBudget) -> usize {
+        self.annotate_workers
+            .or_else(|| budget.workers(Stage::Annotate))
+            .unwrap_or(1)
+            .max(1)
+    }
+
+    /// Number of decoding threads, see [`PredictArgs::decode_workers`] (default: the share of
+    /// `budget`, or one per CPU)
+    pub fn decode_workers(&self, budget: &ThreadBudget) -> Option<usize> {
+        self.decode_workers
+            .filter(|&n| n > 0)
+            .or_else(|| budget.workers(Stage::Decode))
+            .or(self.decode_workers)
+    }
+
+    /// Periodic stats export settings, if `stats_export` is set
+    pub fn stats_export(&self) -> Option<StatsExport> {
+        let format = self.stats_export?;
+        let path = self.stats_path.clone().unwrap_or_else(|| match format {
+            StatsFormat::Json => PathBuf::from("pipeline_stats.json"),
+            StatsFormat::Prometheus => PathBuf::from("pipeline_stats.prom"),
+        });
+        Some(StatsExport {
+            format,
+            path,
+            interval: Duration::from_millis(self.stats_interval_ms.unwrap_or(1000).max(1)),
+        })
+    }
+
+    /// Build the inference config for a single model replica running on `device`
+    pub fn inference_config(&self, device: Option<&str>) -> Result<ul::InferenceConfig> {
+        let mut config = ul::InferenceConfig::new()
+            .with_confidence(self.conf)
+            .with_iou(self.iou)
+            .with_half(self.half)
+            .with_max_det(self.max_det)
+            .with_batch(self.batch.unwrap_or(1));
+
+        if let Some(sz) = self.imgsz {
             config = config.with_imgsz(sz, sz);
         }
 
-        if let Some(ref device_str) = args.device {
+        if let Some(device_str) = device {
             let device: ul::Device = device_str
                 .parse()
-                .map_err(|_| AppError::InvalidDevice(device_str.clone()))?;
+                .map_err(|_| AppError::InvalidDevice(device_str.to_string()))?;
             config = config.with_device(device);
         }
 
@@ -111,24 +369,88 @@ impl TryFrom<&PredictArgs> for ul::InferenceConfig {
     }
 }
 
+impl TryFrom<&PredictArgs> for ul::InferenceConfig {
+    type Error = AppError;
+
+    /// Inference config of the first model replica
+    fn try_from(args: &PredictArgs) -> std::result::Result<Self, Self::Error> {
+        args.inference_config(args.devices()[0].as_deref())
+    }
+}
+
+/// Load YOLO model with the inference config derived from `args` (first device only) on the
+/// cores of `budget`, then warm it up (see [`warmup_models`])
+pub fn load_model(args: &PredictArgs, budget: &ThreadBudget) -> Result<ul::YOLOModel> {
+    if let Some(cache_dir) = &args.engine_cache_dir {
+        configure_engine_cache(cache_dir)?;
+    }
+    let config: ul::InferenceConfig = args.try_into()?;
+    budget.log();
+    let mut model = budget
+        .while_pinned(Stage::Infer(0), || {
+            ul::YOLOModel::load_with_config(&args.model, config)
+        })
+        .map_err(|e| AppError::ModelLoad(e.to_string()))?;
+    warmup_models(std::slice::from_mut(&mut model), args)?;
+    Ok(model)
+}
+
+/// Load one YOLO model replica per entry of [`PredictArgs::replica_devices`] on the cores of
+/// `budget`, then warm them up (see [`warmup_models`])
+pub fn load_models(args: &PredictArgs, budget: &ThreadBudget) -> Result<Vec<ul::YOLOModel>> {
+    let devices = args.replica_devices();
+    let requested = args.devices().len();
+    if requested > devices.len() {
+        tracing::warn!(
+            "{} model replicas requested, but only BatchChannelPipeline uses more than one; \
+             loading one",
+            requested
+        );
+    }
+
+    if let Some(cache_dir) = &args.engine_cache_dir {
+        configure_engine_cache(cache_dir)?;
+    }
+    // sessions are created on the cores of their replica, so their thread pools stay there
+    budget.log();
+    let mut models = devices
+        .iter()
+        .enumerate()
+        .map(|(i, device)| {
+            tracing::info!(
+                "Loading model replica on device: {}",
+                device.as_deref().unwrap_or("default")
+            );
+            let config = args.inference_config(device.as_deref())?;
+            budget
+                .while_pinned(Stage::Infer(i), || {
+                    ul::YOLOModel::load_with_config(&args.model, config)
+                })
+                .map_err(|e| AppError::ModelLoad(e.to_string()))
+        })
+        .collect::<Result<Vec<_>>>()?;
+    warmup_models(&mut models, args)?;
+    Ok(models)
+}
+
 /// Core prediction API
 ///
 /// Returns:
 /// - Optionally, a Vec of ('annotated image', 'source meta') if `return_annotated` is true
 pub fn run_prediction(args: &PredictArgs) -> Result<Option<Vec<InferResult>>> {
+    run_prediction_with_stats(args).map(|(results, _)| results)
+}
+
+/// Same as [`run_prediction`], also returning per-stage pipeline stats
+pub fn run_prediction_with_stats(
+    args: &PredictArgs,
+) -> Result<(Option<Vec<InferResult>>, PipelineStats)> {
     let start_time = Instant::now();
 
-    // Load model using TryFrom trait
-    let config: ul::InferenceConfig = args.try_into()?;
-    let mut model = ul::YOLOModel::load_with_config(&args.model, config)
-        .map_err(|e| AppError::ModelLoad(e.to_string()))?;
+    let budget = ThreadBudget::from_args(args);
+    let mut models = load_models(args, &budget)?;
 
-    // Select infer_fn: Sequential for single image, user choice for batch
-    let infer_fn = if args.source.is_image() {
-        InferFn::Sequential
-    } else {
-        args.infer_fn.clone()
-    };
+    let infer_fn = args.infer_fn_for(&args.source);
 
     // Perform inference
     let mut final_results = if args.return_result {
@@ -137,44 +459,56 @@ pub fn run_prediction(args: &PredictArgs) -> Result<Option<Vec<InferResult>>> {
         None
     };
 
-    auto_infer(
-        &mut model,
+    let stats = auto_infer(
+        &mut models,
         &args.source,
         &infer_fn,
         args,
+        &budget,
         &mut final_results,
     )?;
+    if args.verbose {
+        stats.log();
+    }
 
     // Log total duration
     let duration = start_time.elapsed();
     tracing::info!("Total prediction time: {:.3?}", duration);
 
-    Ok(final_results)
+    Ok((final_results, stats))
 }
 
 /// Online prediction - reuses an existing model for inference.
 /// Only supports `Source::Image` and `Source::ImageVec`.
-/// Uses `Sequential` for single image, `args.infer_fn` for batch.
-pub fn run_online_prediction(
+/// Uses `args.infer_fn`, or `Sequential` for a single image (see [`PredictArgs::infer_fn_for`]).
+/// Pass the source by value to move its images through the pipeline without copying them.
+pub fn run_online_prediction<'s>(
     model: &mut ul::YOLOModel,
-    source: &Source,
+    source: impl Into<Cow<'s, Source>>,
     args: &PredictArgs,
 ) -> Result<Option<Vec<InferResult>>> {
+    let budget = ThreadBudget::from_args(args);
+    online_predict(std::slice::from_mut(model), source.into(), args, &budget)
+        .map(|(results, _)| results)
+}
+
+/// Online prediction over one or more model replicas, see [`run_online_prediction`]
+fn online_predict(
+    models: &mut [ul::YOLOModel],
+    source: Cow<'_, Source>,
+    args: &PredictArgs,
+    budget: &ThreadBudget,
+) -> Result<(Option<Vec<InferResult>>, PipelineStats)> {
     let start_time = Instant::now();
 
     // Only accept in-memory images
-    if !matches!(source, Source::Image(_) | Source::ImageVec(_)) {
+    if !matches!(*source, Source::Image(_) | Source::ImageVec(_)) {
         return Err(AppError::Config(
             "Online prediction only supports Source::Image or Source::ImageVec".to_string(),
         ));
     }
 
-    // Select infer_fn: Sequential for single image, user choice for batch
-    let infer_fn = if source.is_image() {
-        InferFn::Sequential
-    } else {
-        args.infer_fn.clone()
-    };
+    let infer_fn = args.infer_fn_for(&source);
 
     // Perform inference
     let mut final_results = if args.return_result {
@@ -183,11 +517,140 @@ pub fn run_online_prediction(
         None
     };
 
-    auto_infer(model, source, &infer_fn, args, &mut final_results)?;
+    let stats = auto_infer(models, source, &infer_fn, args, budget, &mut final_results)?;
 
     // Log total duration
     let duration = start_time.elapsed();
     tracing::info!("Total prediction time: {:.3?}", duration);
 
-    Ok(final_results)
+    Ok((final_results, stats))
+}
+
+/// Persistent predictor - loads the model once and reuses it across calls.
+///
+/// Model loading (ONNX session creation, TensorRT engine build) usually costs far more than a
+/// single inference, so long-running callers should create one `Predictor` per process and call
+/// [`Predictor::predict`] for every incoming batch.
+pub struct Predictor {
+    models: Vec<ul::YOLOModel>,
+    args: PredictArgs,
+    /// CPU budget of the loaded replicas, reused by every call
+    budget: ThreadBudget,
+    last_stats: Option<PipelineStats>,
+}
+
+impl Predictor {
+    /// Create a predictor and load its model replicas.
+    pub fn new(args: PredictArgs) -> Result<Self> {
+        let budget = ThreadBudget::from_args(&args);
+        let models = load_models(&args, &budget)?;
+        Ok(Self {
+            models,
+            args,
+            budget,
+            last_stats: None,
+        })
+    }
+
+    /// Create a predictor from a TOML config file.
+    ///
+    /// # Arguments
+    ///
+    /// * `toml_path` - Path to the TOML config file
+    /// * `project_root` - Base directory for resolving relative paths
+    pub fn from_toml(toml_path: &Path, project_root: &Path) -> Result<Self> {
+        Self::new(parse_toml(toml_path, project_root)?)
+    }
+
+    /// Prediction arguments used by this predictor
+    pub const fn args(&self) -> &PredictArgs {
+        &self.args
+    }
+
+    /// Per-stage pipeline stats of the last successful [`Predictor::predict`] call
+    pub const fn last_stats(&self) -> Option<&PipelineStats> {
+        self.last_stats.as_ref()
+    }
+
+    /// Run online prediction on in-memory images with the loaded model.
+    /// See [`run_online_prediction`].
+    pub fn predict<'s>(
+        &mut self,
+        source: impl Into<Cow<'s, Source>>,
+    ) -> Result<Option<Vec<InferResult>>> {
+        let (results, stats) =
+            online_predict(&mut self.models, source.into(), &self.args, &self.budget)?;
+        self.last_stats = Some(stats);
+        Ok(results)
+    }
+
+    /// Turn this predictor into a long-lived [`StreamPipeline`], reusing the first loaded model.
+    pub fn into_stream(self) -> StreamPipeline {
+        let model = self
+            .models
+            .into_iter()
+            .next()
+            .expect("Predictor has no model");
+        StreamPipeline::new(model, &self.args, self.budget)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::source::BatchSourceLoader;
+    use image::DynamicImage;
+
+    #[test]
+    fn test_tiled_single_image_runs_batch_inference() {
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("inspection.png");
+        DynamicImage::new_rgb8(2000, 1500).save(&path).unwrap();
+        let mut args = PredictArgs {
+            source: Source::ImagePath(path),
+            ..Default::default()
+        };
+        assert!(matches!(
+            args.infer_fn_for(&args.source),
+            InferFn::Sequential
+        ));
+
+        args.tile_size = Some(640);
+        assert!(matches!(
+            args.infer_fn_for(&args.source),
+            InferFn::BatchSequential
+        ));
+        // the whole frame reaches the batch stage, which splits it into tiles
+        let (images, _) = BatchSourceLoader::new(&args.source, args.batch)
+            .unwrap()
+            .next()
+            .unwrap();
+        assert_eq!(images.len(), 1);
+        let (width, height) = (images[0].width(), images[0].height());
+        assert_eq!((width, height), (2000, 1500));
+        assert_eq!(args.tiling().unwrap().tiles(width, height).len(), 12);
+    }
+
+    #[test]
+    fn test_cached_single_image_runs_batch_inference() {
+        let mut args = PredictArgs {
+            cache_size: Some(0),
+            ..Default::default()
+        };
+        let source = Source::Image(DynamicImage::new_rgb8(4, 4));
+        assert!(matches!(args.infer_fn_for(&source), InferFn::Sequential));
+
+        // online services predict frame by frame
+        args.cache_size = Some(100);
+        assert!(matches!(
+            args.infer_fn_for(&source),
+            InferFn::BatchSequential
+        ));
+        args.cache_size = None;
+        args.cache_dir = Some(PathBuf::from("results/result_cache"));
+        assert!(matches!(
+            args.infer_fn_for(&source),
+            InferFn::BatchSequential
+        ));
+    }
 }
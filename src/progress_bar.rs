@@ -1,7 +1,22 @@
-use indicatif::ProgressStyle;
+use indicatif::{ProgressBar, ProgressStyle};
 
 /// Get a standardized progress bar style
 pub fn progress_bar_style() -> ProgressStyle {
     ProgressStyle::with_template("{msg}: {wide_bar:.cyan/blue} {pos}/{len} [{elapsed_precise}]")
         .unwrap()
 }
+
+/// Get a standardized spinner style, for sources of unknown length
+pub fn progress_spinner_style() -> ProgressStyle {
+    ProgressStyle::with_template("{spinner:.cyan} {msg}: {pos} [{elapsed_precise}] ({per_sec})")
+        .unwrap()
+}
+
+/// Progress bar over `total` items, or a spinner when the total is unknown
+pub fn progress_bar(total: Option<usize>) -> ProgressBar {
+    let pb = match total {
+        Some(total) => ProgressBar::new(total as u64).with_style(progress_bar_style()),
+        None => ProgressBar::no_length().with_style(progress_spinner_style()),
+    };
+    pb.with_message("Running inference")
+}
@@ -0,0 +1,475 @@
+//! Result cache of repeated frames (see `PredictArgs::cache_size` and `PredictArgs::cache_dir`).
+//!
+//! Frames are keyed by a hash of the model and result-affecting settings together with either
+//! the file path, size and modification time of still images, or a content hash of the decoded
+//! pixels (video and stream frames, in-memory images). Hits skip inference and go straight to
+//! the annotate and collect stages.
+//!
+//! Caches with the same settings and `cache_size` share one in-memory LRU across the pipelines
+//! of the process; each `cache_size` bounds its own LRU. The on-disk store keeps one result
+//! record (the `ResultSink` layout) per frame, up to `cache_dir_mb`: beyond it the entries with
+//! the oldest modification time, refreshed on every hit, are removed. Records only hold boxes and
+//! run-length encoded masks, so results with oriented boxes, keypoints or classification scores
+//! are cached in memory only, and masks restored from disk are always compact.
+
+// -- imports
+use image::{DynamicImage, GenericImageView, RgbImage};
+use ndarray::Array2;
+use std::collections::BTreeMap;
+use std::path::{Path, PathBuf};
+use std::sync::{Arc, Mutex};
+use std::time::{SystemTime, UNIX_EPOCH};
+use ultralytics_inference as ul;
+
+use crate::infer_fn::Prediction;
+use crate::predict::PredictArgs;
+use crate::result_sink::{RecordBuf, decode_boxes_and_masks};
+use crate::source::SourceMeta;
+
+// -- hashing
+
+const K1: u64 = 0x9E37_79B9_7F4A_7C15;
+const K2: u64 = 0xC2B2_AE3D_27D4_EB4F;
+
+const fn mix(h: u64, word: u64) -> u64 {
+    (h ^ word).wrapping_mul(K1).rotate_left(29).wrapping_mul(K2)
+}
+
+const fn avalanche(mut h: u64) -> u64 {
+    h ^= h >> 33;
+    h = h.wrapping_mul(0xFF51_AFD7_ED55_8CCD);
+    h ^= h >> 33;
+    h = h.wrapping_mul(0xC4CE_B9FE_1A85_EC53);
+    h ^ (h >> 33)
+}
+
+/// Fast non-cryptographic hash, stable across builds so disk keys stay valid.
+///
+/// Bytes are consumed 32 at a time over four independent lanes, which keeps hashing a decoded
+/// frame well below the cost of its inference.
+#[derive(Debug, Clone, Copy)]
+struct FrameHasher {
+    state: u64,
+}
+
+impl FrameHasher {
+    const fn new(seed: u64) -> Self {
+        Self { state: seed }
+    }
+
+    fn write(&mut self, bytes: &[u8]) {
+        let s = self.state;
+        let mut lanes = [s, s ^ K1, s ^ K2, s.rotate_left(32)];
+        let word = |b: &[u8]| u64::from_le_bytes(b.try_into().expect("8-byte word"));
+        let mut chunks = bytes.chunks_exact(32);
+        for chunk in &mut chunks {
+            for (lane, w) in lanes.iter_mut().zip(chunk.chunks_exact(8)) {
+                *lane = mix(*lane, word(w));
+            }
+        }
+        let mut tail = [0u8; 32];
+        tail[..chunks.remainder().len()].copy_from_slice(chunks.remainder());
+        for (lane, w) in lanes.iter_mut().zip(tail.chunks_exact(8)) {
+            *lane = mix(*lane, word(w));
+        }
+        self.state = avalanche(lanes.into_iter().fold(bytes.len() as u64, mix));
+    }
+
+    fn write_u64(&mut self, value: u64) {
+        self.write(&value.to_le_bytes());
+    }
+
+    const fn finish(&self) -> u64 {
+        self.state
+    }
+}
+
+/// Stable hash of `bytes` (see [`FrameHasher`]), for file names that must match across runs
+pub fn stable_hash(bytes: &[u8]) -> u64 {
+    let mut h = FrameHasher::new(K1);
+    h.write(bytes);
+    h.finish()
+}
+
+/// Size and modification time (ns since the epoch) of a file
+fn file_stamp(path: &Path) -> Option<(u64, u64)> {
+    let metadata = std::fs::metadata(path).ok()?;
+    let modified = metadata.modified().ok()?.duration_since(UNIX_EPOCH).ok()?;
+    Some((metadata.len(), modified.as_nanos() as u64))
+}
+
+// -- memory LRU
+
+/// Least recently used cache of predictions
+#[derive(Debug)]
+struct ResultLru {
+    entries: BTreeMap<u64, (u64, Prediction)>,
+    /// Keys by last use
+    order: BTreeMap<u64, u64>,
+    tick: u64,
+    capacity: usize,
+}
+
+impl ResultLru {
+    const fn new(capacity: usize) -> Self {
+        Self {
+            entries: BTreeMap::new(),
+            order: BTreeMap::new(),
+            tick: 0,
+            capacity,
+        }
+    }
+
+    fn get(&mut self, key: u64) -> Option<Prediction> {
+        let (used, prediction) = self.entries.get_mut(&key)?;
+        self.order.remove(used);
+        self.tick += 1;
+        *used = self.tick;
+        self.order.insert(self.tick, key);
+        Some(prediction.clone())
+    }
+
+    /// Insert an entry, evicting the least recently used ones beyond the capacity
+    fn put(&mut self, key: u64, prediction: Prediction) {
+        self.tick += 1;
+        if let Some((used, _)) = self.entries.insert(key, (self.tick, prediction)) {
+            self.order.remove(&used);
+        }
+        self.order.insert(self.tick, key);
+        while self.entries.len() > self.capacity {
+            let Some((_, oldest)) = self.order.pop_first() else {
+                break;
+            };
+            self.entries.remove(&oldest);
+        }
+    }
+}
+
+/// In-memory LRUs of the process by settings fingerprint and capacity; they live as long as
+/// the process, so repeated runs with the same settings hit the results of earlier ones
+static MEMORY: Mutex<BTreeMap<(u64, usize), Arc<Mutex<ResultLru>>>> = Mutex::new(BTreeMap::new());
+
+/// Shared LRU of the caches with `fingerprint` and `capacity`
+fn memory_lru(fingerprint: u64, capacity: usize) -> Arc<Mutex<ResultLru>> {
+    let mut lrus = MEMORY.lock().expect("Result cache lock poisoned");
+    Arc::clone(
+        lrus.entry((fingerprint, capacity))
+            .or_insert_with(|| Arc::new(Mutex::new(ResultLru::new(capacity)))),
+    )
+}
+
+// -- disk store
+
+/// Entries of the disk store are removed down to this share of its cap, so eviction scans
+/// stay rare
+const DISK_LOW_WATER: f64 = 0.9;
+
+/// Entries of the disk store in `dir`: modification time, size and path
+fn disk_entries(dir: &Path) -> Vec<(SystemTime, u64, PathBuf)> {
+    std::fs::read_dir(dir)
+        .into_iter()
+        .flatten()
+        .flatten()
+        .filter(|entry| entry.path().extension().is_some_and(|ext| ext == "rec"))
+        .filter_map(|entry| {
+            let metadata = entry.metadata().ok()?;
+            Some((metadata.modified().ok()?, metadata.len(), entry.path()))
+        })
+        .collect()
+}
+
+/// Remove the entries of `dir` with the oldest modification time until they fit in
+/// `DISK_LOW_WATER` of `cap` bytes; returns the bytes left
+fn evict_disk(dir: &Path, cap: u64) -> u64 {
+    let mut entries = disk_entries(dir);
+    let mut used: u64 = entries.iter().map(|(_, len, _)| len).sum();
+    if used <= cap {
+        return used;
+    }
+    entries.sort_unstable();
+    let target = (cap as f64 * DISK_LOW_WATER) as u64;
+    let mut removed = 0;
+    for (_, len, path) in entries {
+        if used <= target {
+            break;
+        }
+        // entries removed by another process count as removed
+        match std::fs::remove_file(&path) {
+            Err(e) if e.kind() != std::io::ErrorKind::NotFound => {
+                tracing::warn!("Failed to remove result cache entry {:?}: {}", path, e);
+                continue;
+            }
+            _ => {}
+        }
+        used -= len;
+        removed += 1;
+    }
+    tracing::debug!(
+        "Result cache {:?}: removed {} entries, {} bytes left",
+        dir,
+        removed,
+        used
+    );
+    used
+}
+
+// -- cache
+
+/// Result cache of one inference stage
+#[derive(Debug)]
+pub struct ResultCache {
+    /// Hash of the model file and the settings that change results
+    fingerprint: u64,
+    /// In-memory LRU, `None` if `cache_size` is 0
+    memory: Option<Arc<Mutex<ResultLru>>>,
+    dir: Option<PathBuf>,
+    /// Size cap of `dir` in bytes, 0 if unbounded
+    disk_cap: u64,
+    /// Bytes in `dir` as of the last scan, plus the entries written since
+    disk_used: u64,
+    /// Result without detections, holding class names, for results restored from disk
+    template: Option<ul::Results>,
+    record: RecordBuf,
+}
+
+impl ResultCache {
+    /// Cache configured by `cache_size` and `cache_dir`, if either is set
+    pub fn from_args(args: &PredictArgs) -> Option<Self> {
+        if !args.caches_results() {
+            return None;
+        }
+        let capacity = args.cache_size.unwrap_or(0);
+        if let Some(dir) = &args.cache_dir
+            && let Err(e) = std::fs::create_dir_all(dir)
+        {
+            tracing::error!(
+                "Failed to create result cache {:?}, cache disabled: {}",
+                dir,
+                e
+            );
+            return None;
+        }
+        let fingerprint = Self::fingerprint(args);
+        let disk_cap = args.cache_dir_mb.unwrap_or(0).saturating_mul(1 << 20);
+        let disk_used = match &args.cache_dir {
+            Some(dir) if disk_cap > 0 => evict_disk(dir, disk_cap),
+            _ => 0,
+        };
+        Some(Self {
+            fingerprint,
+            memory: (capacity > 0).then(|| memory_lru(fingerprint, capacity)),
+            dir: args.cache_dir.clone(),
+            disk_cap,
+            disk_used,
+            template: None,
+            record: RecordBuf::default(),
+        })
+    }
+
+    fn fingerprint(args: &PredictArgs) -> u64 {
+        let mut h = FrameHasher::new(K1);
+        h.write(args.model.as_os_str().as_encoded_bytes());
+        let (model_len, model_modified) = file_stamp(&args.model).unwrap_or_default();
+        h.write_u64(model_len);
+        h.write_u64(model_modified);
+        h.write_u64(args.conf.to_bits() as u64);
+        h.write_u64(args.iou.to_bits() as u64);
+        h.write_u64(args.max_det as u64);
+        h.write_u64(args.imgsz.map_or(u64::MAX, |s| s as u64));
+        h.write_u64(args.half as u64);
+        h.write_u64(args.compact_masks as u64);
+        if let Some(tiling) = args.tiling() {
+            h.write_u64(tiling.size as u64);
+            h.write_u64(tiling.overlap as u64);
+            for roi in &tiling.rois {
+                h.write_u64(((roi.x as u64) << 32) | roi.y as u64);
+                h.write_u64(((roi.width as u64) << 32) | roi.height as u64);
+            }
+        }
+        h.finish()
+    }
+
+    /// Cache key of a frame
+    pub fn key(&self, image: &DynamicImage, meta: &SourceMeta) -> u64 {
+        let mut h = FrameHasher::new(self.fingerprint);
+        // still image files: path, size and modification time
+        if meta.timestamp.is_none()
+            && let Some(path) = &meta.source_path
+            && let Some((len, modified)) = file_stamp(path)
+        {
+            h.write(path.as_os_str().as_encoded_bytes());
+            h.write_u64(len);
+            h.write_u64(modified);
+            return h.finish();
+        }
+        let (width, height) = image.dimensions();
+        h.write_u64(((width as u64) << 32) | height as u64);
+        let color = image.color();
+        h.write_u64(((color.bytes_per_pixel() as u64) << 8) | color.channel_count() as u64);
+        h.write(image.as_bytes());
+        h.finish()
+    }
+
+    fn disk_path(&self, key: u64) -> Option<PathBuf> {
+        self.dir
+            .as_ref()
+            .map(|dir| dir.join(format!("{:016x}.rec", key)))
+    }
+
+    /// Cached prediction of a `width x height` frame; `model` runs once on a blank frame if a
+    /// disk entry is found before any frame was inferred
+    pub fn get(
+        &mut self,
+        key: u64,
+        (width, height): (u32, u32),
+        model: &mut ul::YOLOModel,
+    ) -> Option<Prediction> {
+        if let Some(memory) = &self.memory
+            && let Some(prediction) = memory.lock().expect("Result cache lock poisoned").get(key)
+        {
+            return Some(prediction);
+        }
+
+        let path = self.disk_path(key)?;
+        let record = std::fs::read(&path).ok()?;
+        let Some((boxes, masks)) = decode_boxes_and_masks(&record) else {
+            tracing::warn!("Invalid result cache entry {:016x}, ignored", key);
+            return None;
+        };
+        let mut result = self.template(model)?;
+        let data = Array2::from_shape_vec((boxes.len() / 6, 6), boxes).ok()?;
+        result.boxes = Some(ul::Boxes::new(data, (height, width)));
+        let prediction = Prediction { result, masks };
+        // a hit counts as a use for eviction
+        if self.disk_cap > 0 {
+            let _ = std::fs::File::options()
+                .write(true)
+                .open(&path)
+                .and_then(|file| file.set_modified(SystemTime::now()));
+        }
+        if let Some(memory) = &self.memory {
+            memory
+                .lock()
+                .expect("Result cache lock poisoned")
+                .put(key, prediction.clone());
+        }
+        Some(prediction)
+    }
+
+    /// Store the prediction of an inferred frame
+    pub fn put(&mut self, key: u64, prediction: &Prediction) {
+        if self.template.is_none() {
+            self.template = Some(empty_results(prediction.result.clone()));
+        }
+        if let Some(memory) = &self.memory {
+            memory
+                .lock()
+                .expect("Result cache lock poisoned")
+                .put(key, prediction.clone());
+        }
+
+        let result = &prediction.result;
+        let storable = result.obb.is_none() && result.keypoints.is_none() && result.probs.is_none();
+        if let Some(path) = self.disk_path(key)
+            && storable
+        {
+            // write and rename, so concurrent readers never see a partial entry
+            let tmp = path.with_extension(format!("{}.tmp", std::process::id()));
+            let record = self.record.encode_prediction(prediction);
+            let len = record.len() as u64;
+            let written = std::fs::write(&tmp, record).and_then(|()| std::fs::rename(&tmp, &path));
+            if let Err(e) = written {
+                tracing::warn!("Failed to write result cache entry {:?}: {}", path, e);
+            } else if self.disk_cap > 0 {
+                self.disk_used += len;
+                if self.disk_used > self.disk_cap
+                    && let Some(dir) = &self.dir
+                {
+                    self.disk_used = evict_disk(dir, self.disk_cap);
+                }
+            }
+        }
+    }
+
+    /// Result without detections, taken from an inferred frame or a blank one
+    fn template(&mut self, model: &mut ul::YOLOModel) -> Option<ul::Results> {
+        if self.template.is_none() {
+            self.template = blank_results(model, "restore cached results");
+        }
+        self.template.clone()
+    }
+}
+
+/// Result without detections of a small blank frame, holding the class names and task of
+/// `model`; failures are logged as failing to `purpose`
+pub fn blank_results(model: &mut ul::YOLOModel, purpose: &str) -> Option<ul::Results> {
+    let blank = DynamicImage::ImageRgb8(RgbImage::new(32, 32));
+    match model.predict_image(&blank, "".to_string()) {
+        Ok(results) => results.into_iter().next().map(empty_results),
+        Err(e) => {
+            tracing::error!("Failed to {}: {}", purpose, e);
+            None
+        }
+    }
+}
+
+/// `result` with its detections removed
+pub fn empty_results(mut result: ul::Results) -> ul::Results {
+    result.boxes = None;
+    result.masks = None;
+    result.keypoints = None;
+    result.obb = None;
+    result.probs = None;
+    result
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_frame_hasher_is_stable_and_sensitive() {
+        let hash = |bytes: &[u8]| {
+            let mut h = FrameHasher::new(1);
+            h.write(bytes);
+            h.finish()
+        };
+        let frame: Vec<u8> = (0..100u8).collect();
+        assert_eq!(hash(&frame), hash(&frame));
+
+        let mut changed = frame.clone();
+        changed[97] ^= 1;
+        assert_ne!(hash(&frame), hash(&changed));
+        // trailing zeros are not ignored
+        assert_ne!(hash(&frame[..96]), hash(&[&frame[..96], &[0u8]].concat()));
+    }
+
+    #[test]
+    fn test_evict_disk_removes_oldest_entries() {
+        let dir = std::env::temp_dir().join(format!("result-cache-{}", std::process::id()));
+        std::fs::create_dir_all(&dir).unwrap();
+        let now = SystemTime::now();
+        for i in 0..4u64 {
+            let path = dir.join(format!("{:016x}.rec", i));
+            std::fs::write(&path, [0u8; 100]).unwrap();
+            let modified = now - std::time::Duration::from_secs(100 - i);
+            let file = std::fs::File::options().write(true).open(&path).unwrap();
+            file.set_modified(modified).unwrap();
+        }
+        std::fs::write(dir.join("other.tmp"), [0u8; 1000]).unwrap();
+
+        assert_eq!(evict_disk(&dir, 400), 400);
+        // down to 90% of the cap: the two oldest entries go
+        assert_eq!(evict_disk(&dir, 300), 200);
+        let mut left: Vec<_> = disk_entries(&dir).into_iter().map(|(_, _, p)| p).collect();
+        left.sort();
+        assert_eq!(
+            left,
+            [
+                dir.join(format!("{:016x}.rec", 2)),
+                dir.join(format!("{:016x}.rec", 3))
+            ]
+        );
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+}
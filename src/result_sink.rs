@@ -0,0 +1,339 @@
+//! Compact binary result file, written by the collect stage (see `PredictArgs::result_file`).
+//!
+//! All values are little-endian. The file starts with a 16-byte header (`u32` magic `YOLR`,
+//! `u32` version, 8 reserved bytes), followed by one record per frame. A record is a 64-byte
+//! header:
+//!
+//! | offset | type  | field                                              |
+//! |--------|-------|----------------------------------------------------|
+//! | 0      | `u32` | record size in bytes, header included (8-aligned)  |
+//! | 4      | `u32` | source path length in bytes                        |
+//! | 8      | `u64` | frame index                                        |
+//! | 16     | `u64` | tag (0 if none)                                    |
+//! | 24     | `i64` | timestamp in microseconds (-1 if none)             |
+//! | 32     | `u32` | boxes                                              |
+//! | 36     | `u32` | oriented boxes                                     |
+//! | 40     | `u32` | pose instances                                     |
+//! | 44     | `u32` | keypoints per pose instance                        |
+//! | 48     | `u32` | masks                                              |
+//! | 52     | `u32` | mask height                                        |
+//! | 56     | `u32` | mask width                                         |
+//! | 60     | `u32` | top classification scores                          |
+//!
+//! then, in order:
+//!
+//! - the UTF-8 source path, zero-padded to 4 bytes
+//! - boxes: `x1, y1, x2, y2, conf, cls` (`f32`)
+//! - oriented boxes: 4 corners `x, y`, then `conf, cls` (`f32`)
+//! - keypoints: `x, y, conf` (`f32`) per keypoint of each instance
+//! - classification scores: `cls` (`u32`), `score` (`f32`), best first
+//! - masks: per mask a `u32` run count, then the `u32` run lengths of the mask binarized at 0.5, in
+//!   row-major order, alternating background and foreground and starting with background
+//! - zero padding up to the record size
+//!
+//! cpp_headers/yolo_results_reader.h reads these files through a memory map.
+
+// -- imports
+use std::fs::File;
+use std::io::{BufWriter, Write};
+use std::path::{Path, PathBuf};
+
+use crate::error::Result;
+use crate::infer_fn::Prediction;
+use crate::masks::RleMasks;
+use crate::predict::PredictArgs;
+use crate::source::SourceMeta;
+
+// -- format
+
+/// File magic, `YOLR` in file byte order
+pub const RESULT_FILE_MAGIC: u32 = u32::from_le_bytes(*b"YOLR");
+
+/// Format version, bumped on layout changes
+pub const RESULT_FILE_VERSION: u32 = 1;
+
+/// Size of the record header, see the module docs
+const RECORD_HEADER_BYTES: usize = 64;
+
+/// Classification scores kept per record
+const TOP_K_PROBS: usize = 5;
+
+/// Record of one frame, built in a reused buffer
+#[derive(Debug, Default)]
+pub(crate) struct RecordBuf {
+    bytes: Vec<u8>,
+}
+
+impl RecordBuf {
+    /// Start a record with the header fields known before the body
+    fn begin(&mut self, meta: &SourceMeta, path: &str) {
+        self.bytes.clear();
+        self.bytes.resize(RECORD_HEADER_BYTES, 0);
+        self.set_u32(4, path.len() as u32);
+        self.set_u64(8, meta.frame_idx as u64);
+        self.set_u64(16, meta.tag.unwrap_or_default());
+        let timestamp_us = meta
+            .timestamp
+            .map_or(-1, |t| i64::try_from(t.as_micros()).unwrap_or(i64::MAX));
+        self.set_u64(24, timestamp_us as u64);
+
+        self.bytes.extend_from_slice(path.as_bytes());
+        self.pad_to(4);
+    }
+
+    fn set_u32(&mut self, offset: usize, value: u32) {
+        self.bytes[offset..offset + 4].copy_from_slice(&value.to_le_bytes());
+    }
+
+    fn set_u64(&mut self, offset: usize, value: u64) {
+        self.bytes[offset..offset + 8].copy_from_slice(&value.to_le_bytes());
+    }
+
+    fn u32(&mut self, value: u32) {
+        self.bytes.extend_from_slice(&value.to_le_bytes());
+    }
+
+    fn f32(&mut self, value: f32) {
+        self.bytes.extend_from_slice(&value.to_le_bytes());
+    }
+
+    fn pad_to(&mut self, align: usize) {
+        let len = self.bytes.len().next_multiple_of(align);
+        self.bytes.resize(len, 0);
+    }
+
+    /// Append run-length encoded masks
+    fn masks(&mut self, masks: &RleMasks) {
+        self.set_u32(48, masks.len() as u32);
+        self.set_u32(52, masks.height() as u32);
+        self.set_u32(56, masks.width() as u32);
+        for i in 0..masks.len() {
+            let runs = masks.runs(i);
+            self.u32(runs.len() as u32);
+            runs.iter().for_each(|&run| self.u32(run));
+        }
+    }
+
+    /// Pad the record and store its size; returns the encoded record
+    fn finish(&mut self) -> &[u8] {
+        self.pad_to(8);
+        self.set_u32(0, self.bytes.len() as u32);
+        &self.bytes
+    }
+
+    /// Encode the results of one frame
+    fn encode(&mut self, prediction: &Prediction, meta: &SourceMeta) -> &[u8] {
+        let path = meta
+            .source_path
+            .as_deref()
+            .map(|p| p.to_string_lossy())
+            .unwrap_or_default();
+        self.begin(meta, &path);
+        self.results(prediction);
+        self.finish()
+    }
+
+    /// Encode results without frame fields (no path, index, tag or timestamp)
+    pub(crate) fn encode_prediction(&mut self, prediction: &Prediction) -> &[u8] {
+        self.bytes.clear();
+        self.bytes.resize(RECORD_HEADER_BYTES, 0);
+        self.set_u64(24, -1i64 as u64);
+        self.results(prediction);
+        self.finish()
+    }
+
+    /// Append the body of a record
+    fn results(&mut self, prediction: &Prediction) {
+        let result = &prediction.result;
+        if let Some(boxes) = result.boxes.as_ref().filter(|b| b.data.ncols() == 6) {
+            self.set_u32(32, boxes.data.nrows() as u32);
+            boxes.data.iter().for_each(|&v| self.f32(v));
+        }
+
+        if let Some(obb) = result.obb.as_ref() {
+            let (corners, conf, cls) = (obb.xyxyxyxy(), obb.conf(), obb.cls());
+            self.set_u32(36, obb.len() as u32);
+            for i in 0..obb.len() {
+                for j in 0..4 {
+                    self.f32(corners[[i, j, 0]]);
+                    self.f32(corners[[i, j, 1]]);
+                }
+                self.f32(conf[i]);
+                self.f32(cls[i]);
+            }
+        }
+
+        if let Some(kpts) = result.keypoints.as_ref().filter(|k| k.data.shape()[2] == 3) {
+            self.set_u32(40, kpts.data.shape()[0] as u32);
+            self.set_u32(44, kpts.data.shape()[1] as u32);
+            kpts.data.iter().for_each(|&v| self.f32(v));
+        }
+
+        if let Some(probs) = result.probs.as_ref() {
+            let top = probs.top_k(TOP_K_PROBS);
+            self.set_u32(60, top.len() as u32);
+            for &cls in &top {
+                self.u32(cls as u32);
+                self.f32(probs.data[cls]);
+            }
+        }
+
+        match &prediction.masks {
+            Some(masks) => self.masks(masks),
+            None => {
+                if let Some(masks) = RleMasks::from_results(result) {
+                    self.masks(&masks);
+                }
+            }
+        }
+    }
+}
+
+/// Boxes (rows of `x1, y1, x2, y2, conf, cls`) and masks of an encoded record; `None` if the
+/// record is truncated or also holds oriented boxes, keypoints or classification scores
+pub(crate) fn decode_boxes_and_masks(record: &[u8]) -> Option<(Vec<f32>, Option<RleMasks>)> {
+    let u32_at = |offset: usize| {
+        let bytes = record.get(offset..offset + 4)?;
+        Some(u32::from_le_bytes(bytes.try_into().expect("4-byte slice")))
+    };
+    if record.len() < RECORD_HEADER_BYTES || u32_at(0)? as usize != record.len() {
+        return None;
+    }
+    if u32_at(36)? != 0 || u32_at(40)? != 0 || u32_at(60)? != 0 {
+        return None;
+    }
+
+    let mut offset = RECORD_HEADER_BYTES + (u32_at(4)? as usize).next_multiple_of(4);
+    let values = u32_at(32)? as usize * 6;
+    let boxes = (0..values)
+        .map(|i| u32_at(offset + 4 * i).map(f32::from_bits))
+        .collect::<Option<Vec<f32>>>()?;
+    offset += 4 * values;
+
+    let (count, height, width) = (u32_at(48)?, u32_at(52)?, u32_at(56)?);
+    if count == 0 && height == 0 && width == 0 {
+        return Some((boxes, None));
+    }
+    let mut masks = RleMasks::new(height as usize, width as usize);
+    for _ in 0..count {
+        let len = u32_at(offset)? as usize;
+        let runs = (0..len)
+            .map(|i| u32_at(offset + 4 * (i + 1)))
+            .collect::<Option<Vec<u32>>>()?;
+        masks.push_runs(&runs);
+        offset += 4 * (len + 1);
+    }
+    Some((boxes, Some(masks)))
+}
+
+// -- sink
+
+/// Streaming result sink of the collect stage.
+///
+/// Each frame is appended to the file as soon as it is collected, masks run-length encoded, so
+/// large offline runs neither keep their results in memory nor write one file per frame.
+#[derive(Debug)]
+pub struct ResultSink {
+    path: PathBuf,
+    file: BufWriter<File>,
+    record: RecordBuf,
+    records: u64,
+}
+
+impl ResultSink {
+    /// Create (or truncate) the result file at `path`
+    pub fn create(path: &Path) -> Result<Self> {
+        if let Some(dir) = path.parent()
+            && !dir.as_os_str().is_empty()
+        {
+            std::fs::create_dir_all(dir)?;
+        }
+        let mut file = BufWriter::with_capacity(1 << 20, File::create(path)?);
+        file.write_all(&RESULT_FILE_MAGIC.to_le_bytes())?;
+        file.write_all(&RESULT_FILE_VERSION.to_le_bytes())?;
+        file.write_all(&[0; 8])?;
+
+        Ok(Self {
+            path: path.to_path_buf(),
+            file,
+            record: RecordBuf::default(),
+            records: 0,
+        })
+    }
+
+    /// Sink configured by `result_file`, if set
+    pub fn from_args(args: &PredictArgs) -> Result<Option<Self>> {
+        args.result_file.as_deref().map(Self::create).transpose()
+    }
+
+    /// Append the results of one frame
+    pub fn write(&mut self, prediction: &Prediction, meta: &SourceMeta) -> Result<()> {
+        let record = self.record.encode(prediction, meta);
+        self.file.write_all(record)?;
+        self.records += 1;
+        Ok(())
+    }
+
+    /// Flush the file and log where the results went
+    pub fn finish(mut self) -> Result<()> {
+        self.file.flush()?;
+        tracing::info!("{} results written to {:?}", self.records, self.path);
+        Ok(())
+    }
+}
+
+impl Drop for ResultSink {
+    fn drop(&mut self) {
+        if let Err(e) = self.file.flush() {
+            tracing::error!("Failed to write results to {:?}: {}", self.path, e);
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::source::FrameTimings;
+    use std::time::Duration;
+
+    fn u32_at(bytes: &[u8], offset: usize) -> u32 {
+        u32::from_le_bytes(bytes[offset..offset + 4].try_into().unwrap())
+    }
+
+    #[test]
+    fn test_record_layout_and_mask_runs() {
+        let meta = SourceMeta {
+            frame_idx: 7,
+            total_frames: 0,
+            source_path: None,
+            tag: Some(42),
+            timestamp: Some(Duration::from_millis(1500)),
+            timings: FrameTimings::default(),
+        };
+        let mut record = RecordBuf::default();
+        record.begin(&meta, "a.jpg");
+        // 2 x 4 masks: all background, then a foreground run ending the mask
+        let mut masks = RleMasks::new(2, 4);
+        masks.push([0.0; 8]);
+        masks.push([0.0, 0.9, 0.8, 0.1, 0.0, 0.0, 0.7, 1.0]);
+        record.masks(&masks);
+        let bytes = record.finish();
+
+        assert_eq!(bytes.len() % 8, 0);
+        assert_eq!(u32_at(bytes, 0) as usize, bytes.len());
+        assert_eq!(u32_at(bytes, 4), 5);
+        assert_eq!(u32_at(bytes, 16), 42);
+        assert_eq!(u32_at(bytes, 24), 1_500_000);
+        assert_eq!(
+            (u32_at(bytes, 48), u32_at(bytes, 52), u32_at(bytes, 56)),
+            (2, 2, 4)
+        );
+        assert_eq!(&bytes[64..69], b"a.jpg");
+
+        let runs: Vec<u32> = (72..bytes.len())
+            .step_by(4)
+            .map(|o| u32_at(bytes, o))
+            .collect();
+        assert_eq!(&runs[..7], &[1, 8, 4, 1, 2, 3, 2]);
+    }
+}
@@ -1,25 +1,72 @@
 // -- submodules
 mod batch_loader;
+mod decode_pool;
+mod frame_iter;
 mod loader;
 mod source_utils;
+mod video;
 
 pub use batch_loader::BatchSourceLoader;
+pub use decode_pool::DecodePool;
+pub use frame_iter::{DirImages, ManifestImages};
 pub use loader::SourceLoader;
-pub use source_utils::{collect_images_from_dir, is_image_file};
+pub use source_utils::{collect_images_from_dir, is_image_file, is_video_file};
+pub use video::VideoOptions;
 
 // -- external imports
 use image::DynamicImage;
 use serde::Deserialize;
+use std::borrow::Cow;
 use std::path::PathBuf;
+use std::time::{Duration, Instant};
+
+/// Per-frame pipeline timestamps, stamped by the loaders and inference functions
+#[derive(Debug, Clone, Copy, Default)]
+pub struct FrameTimings {
+    /// Loading (decoding) started
+    pub started: Option<Instant>,
+    /// Frame loaded
+    pub loaded: Option<Instant>,
+    /// Model inference finished
+    pub inferred: Option<Instant>,
+    /// Annotation finished
+    pub annotated: Option<Instant>,
+    /// Saving finished
+    pub saved: Option<Instant>,
+    /// Result collected
+    pub collected: Option<Instant>,
+}
+
+impl FrameTimings {
+    /// Timings of a frame that starts loading now
+    pub fn start() -> Self {
+        Self {
+            started: Some(Instant::now()),
+            ..Default::default()
+        }
+    }
+
+    /// End-to-end latency from load start to collection, if both were stamped
+    pub fn latency(&self) -> Option<std::time::Duration> {
+        Some(self.collected?.duration_since(self.started?))
+    }
+}
 
 #[derive(Debug, Clone)]
 pub struct SourceMeta {
-    /// Current frame index (0-based).
+    /// Current frame index (0-based). For videos and streams, the index of the frame in the
+    /// stream, skipped frames included.
     pub frame_idx: usize,
     /// Total frames (1 for single images).
     pub total_frames: usize,
     /// Source path if available.
     pub source_path: Option<PathBuf>,
+    /// Caller-provided tag (e.g. for frames submitted to a `StreamPipeline`).
+    pub tag: Option<u64>,
+    /// Presentation time of video and stream frames.
+    pub timestamp: Option<Duration>,
+    /// Pipeline stage timestamps.
+    pub timings: FrameTimings,
 }
 
 impl SourceMeta {
@@ -61,6 +108,9 @@ pub enum Source {
     /// Path to directory containing multiple images
     Directory(PathBuf),
 
+    /// Path to a manifest file (`.txt`) listing one image path per line
+    Manifest(PathBuf),
+
     /// List of image paths
     ImagePathVec(Vec<PathBuf>),
 
@@ -69,6 +119,12 @@ pub enum Source {
 
     /// List of images in memory
     ImageVec(Vec<DynamicImage>),
+
+    /// Path to a video file, decoded by `ffmpeg`
+    Video(PathBuf),
+
+    /// URL of a network stream (`rtsp://`, `http://`, ...), decoded by `ffmpeg`
+    Stream(String),
 }
 
 impl std::fmt::Debug for Source {
@@ -77,9 +133,12 @@ impl std::fmt::Debug for Source {
             Source::None => write!(f, "None"),
             Source::ImagePath(p) => write!(f, "ImagePath({:?})", p),
             Source::Directory(p) => write!(f, "Directory({:?})", p),
+            Source::Manifest(p) => write!(f, "Manifest({:?})", p),
             Source::ImagePathVec(v) => write!(f, "ImagePathVec({} items)", v.len()),
             Source::Image(img) => write!(f, "Image({}x{})", img.width(), img.height()),
             Source::ImageVec(v) => write!(f, "ImageVec({} items)", v.len()),
+            Source::Video(p) => write!(f, "Video({:?})", p),
+            Source::Stream(url) => write!(f, "Stream({:?})", url),
         }
     }
 }
@@ -93,7 +152,12 @@ impl Source {
     pub fn is_batch(&self) -> bool {
         matches!(
             self,
-            Source::Directory(_) | Source::ImagePathVec(_) | Source::ImageVec(_)
+            Source::Directory(_)
+                | Source::Manifest(_)
+                | Source::ImagePathVec(_)
+                | Source::ImageVec(_)
+                | Source::Video(_)
+                | Source::Stream(_)
         )
     }
 
@@ -104,8 +168,19 @@ impl Source {
 
 impl From<PathBuf> for Source {
     fn from(path: PathBuf) -> Self {
-        if path.is_dir() {
+        if let Some(url) = path.to_str()
+            && url.contains("://")
+        {
+            Source::Stream(url.to_string())
+        } else if path.is_dir() {
             Source::Directory(path)
+        } else if path
+            .extension()
+            .is_some_and(|ext| ext.eq_ignore_ascii_case("txt"))
+        {
+            Source::Manifest(path)
+        } else if is_video_file(&path) {
+            Source::Video(path)
         } else {
             Source::ImagePath(path)
         }
@@ -142,6 +217,20 @@ impl From<Vec<DynamicImage>> for Source {
     }
 }
 
+/// Owned sources are handed to the loaders by value, so that in-memory images are moved
+impl From<Source> for Cow<'_, Source> {
+    fn from(source: Source) -> Self {
+        Cow::Owned(source)
+    }
+}
+
+/// Borrowed sources are read in place; in-memory images are copied as they are loaded
+impl<'a> From<&'a Source> for Cow<'a, Source> {
+    fn from(source: &'a Source) -> Self {
+        Cow::Borrowed(source)
+    }
+}
+
 impl Default for Source {
     fn default() -> Self {
         Source::None
@@ -149,7 +238,7 @@ impl Default for Source {
 }
 
 /// Custom deserializer for Source from toml
-/// Only supports PathBuf-based variants (ImagePath, Directory, ImagePathVec)
+/// Only supports path-based variants (ImagePath, Directory, Manifest, ImagePathVec, Video, Stream)
 /// Empty string results in Source::None
 pub fn deserialize_source<'de, D>(deserializer: D) -> Result<Source, D::Error>
 where
@@ -204,5 +293,26 @@ mod tests {
             Source::Directory(p) => assert_eq!(p, path),
             _ => panic!("Expected Directory"),
         }
+
+        // Test text file path becomes Manifest
+        let path = PathBuf::from("images.txt");
+        let source: Source = path.clone().into();
+        match source {
+            Source::Manifest(p) => assert_eq!(p, path),
+            _ => panic!("Expected Manifest"),
+        }
+
+        // Test video file path becomes Video, URL becomes Stream
+        let path = PathBuf::from("clip.MP4");
+        let source: Source = path.clone().into();
+        match source {
+            Source::Video(p) => assert_eq!(p, path),
+            _ => panic!("Expected Video"),
+        }
+        let source: Source = "rtsp://camera.local:554/live".into();
+        match source {
+            Source::Stream(url) => assert_eq!(url, "rtsp://camera.local:554/live"),
+            _ => panic!("Expected Stream"),
+        }
     }
 }
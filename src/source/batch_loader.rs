@@ -1,162 +1,115 @@
 use image::DynamicImage;
-use std::iter::ExactSizeIterator;
-use std::path::PathBuf;
+use std::borrow::Cow;
+use std::time::Instant;
 
 use crate::error::Result;
 
-use super::source_utils::{collect_images_from_dir, is_image_file};
-use super::{Source, SourceMeta};
-
-#[derive(Debug, Clone)]
-enum FrameData {
-    Path(PathBuf),
-    Image(DynamicImage),
-    None, // Padding for incomplete batches
-}
+use super::decode_pool::DecodePool;
+use super::frame_iter::{FrameIter, decode_frames};
+use super::video::VideoOptions;
+use super::{FrameTimings, Source, SourceMeta};
 
 #[derive(Debug)]
-pub struct BatchSourceLoader {
+pub struct BatchSourceLoader<'a> {
     current_idx: usize,
-    batches: Vec<Vec<FrameData>>,
-    len: usize,
+    frames: FrameIter<'a>,
     batch_size: usize,
-    total_frames: usize,
+    decode_pool: DecodePool,
 }
 
-impl BatchSourceLoader {
-    pub fn new(source: &Source, batch_size: Option<usize>) -> Result<Self> {
+impl<'a> BatchSourceLoader<'a> {
+    /// Loader over a borrowed (`&Source`) or owned (`Source`) source; in-memory images of an
+    /// owned source are moved through the loader instead of copied
+    pub fn new(source: impl Into<Cow<'a, Source>>, batch_size: Option<usize>) -> Result<Self> {
         let batch_size = match batch_size {
             Some(size) if size > 0 => size,
             _ => 1,
         };
 
-        let (batches, num_pads) = match source {
-            Source::None => {
-                return Err(crate::error::AppError::Config(
-                    "Source::None cannot be used with BatchSourceLoader".to_string(),
-                ));
-            }
-            Source::ImagePath(p) => {
-                if is_image_file(p) {
-                    (vec![vec![FrameData::Path(p.clone())]], 0)
-                } else {
-                    (vec![], 0)
-                }
-            }
-            Source::Directory(dir_path) => {
-                let frames_vec: Vec<FrameData> = collect_images_from_dir(dir_path)?
-                    .into_iter()
-                    .map(FrameData::Path)
-                    .collect();
-                Self::pad_and_chunk(frames_vec, batch_size)
-            }
-            Source::ImagePathVec(paths) => {
-                let frames_vec: Vec<FrameData> = paths
-                    .iter()
-                    .filter(|p| is_image_file(p))
-                    .cloned()
-                    .map(FrameData::Path)
-                    .collect();
-                Self::pad_and_chunk(frames_vec, batch_size)
-            }
-            Source::Image(img) => (vec![vec![FrameData::Image(img.clone())]], 0),
-            Source::ImageVec(imgs) => {
-                let frames_vec: Vec<FrameData> =
-                    imgs.iter().cloned().map(FrameData::Image).collect();
-                Self::pad_and_chunk(frames_vec, batch_size)
-            }
-        };
-        let len = batches.len();
-        let total_frames = len * batch_size - num_pads;
         Ok(Self {
             current_idx: 0,
-            batches,
-            len,
+            frames: FrameIter::new(source.into())?,
             batch_size,
-            total_frames,
+            decode_pool: DecodePool::default(),
         })
     }
 
-    fn pad_and_chunk(
-        frames_vec: Vec<FrameData>,
-        batch_size: usize,
-    ) -> (Vec<Vec<FrameData>>, usize) {
-        let mut frames_vec = frames_vec;
-        let mut num_pads = 0;
-        while frames_vec.len() % batch_size != 0 {
-            frames_vec.push(FrameData::None);
-            num_pads += 1;
+    /// Decode the frames of each batch in parallel on a pool of `workers` threads
+    /// (see [`DecodePool::new`]).
+    ///
+    /// The pool is only created for file-based sources.
+    pub fn with_decode_workers(mut self, workers: Option<usize>) -> Result<Self> {
+        if self.frames.is_file_based() {
+            self.decode_pool = DecodePool::new(workers)?;
+        }
+        Ok(self)
+    }
+
+    /// Same as `with_decode_workers`, with the pool threads pinned to `cpus` if set
+    pub fn with_decode_threads(
+        mut self,
+        workers: Option<usize>,
+        cpus: Option<Vec<usize>>,
+    ) -> Result<Self> {
+        if self.frames.is_file_based() {
+            self.decode_pool = DecodePool::pinned(workers, cpus)?;
         }
-        let chunks = frames_vec
-            .chunks(batch_size)
-            .map(|chunk| chunk.to_vec())
-            .collect();
-        (chunks, num_pads)
+        Ok(self)
     }
 
-    pub const fn len(&self) -> usize {
-        self.len
+    /// Decode video and stream sources with `options`; other sources ignore them
+    pub fn with_video_options(mut self, options: VideoOptions) -> Self {
+        self.frames.set_video_options(options);
+        self
     }
 
-    pub const fn total_frames(&self) -> usize {
-        self.total_frames
+    /// Number of batches, `None` for streamed sources (directories, manifests, videos)
+    pub fn len(&self) -> Option<usize> {
+        self.total_frames()
+            .map(|frames| frames.div_ceil(self.batch_size))
+    }
+
+    /// Number of frames, `None` for streamed sources (directories, manifests, videos)
+    pub const fn total_frames(&self) -> Option<usize> {
+        self.frames.len()
     }
 }
 
-impl Iterator for BatchSourceLoader {
+impl Iterator for BatchSourceLoader<'_> {
     type Item = (Vec<DynamicImage>, Vec<SourceMeta>);
 
     fn next(&mut self) -> Option<Self::Item> {
-        if self.current_idx >= self.len {
+        let batch_frames = self.frames.take_chunk(self.batch_size);
+        if batch_frames.is_empty() {
             return None;
         }
+        let batch_len = batch_frames.len();
+        let mut batch_images = Vec::with_capacity(batch_len);
+        let mut batch_metas = Vec::with_capacity(batch_len);
 
-        let batch_frames = &self.batches[self.current_idx];
-        let mut batch_images = Vec::with_capacity(self.batch_size);
-        let mut batch_metas = Vec::with_capacity(self.batch_size);
+        // decode all frames of the batch at once, then assemble them in order
+        let mut timings = FrameTimings::start();
+        let decoded = decode_frames(&self.decode_pool, batch_frames);
+        timings.loaded = Some(Instant::now());
 
-        for (i, frame_data) in batch_frames.iter().enumerate() {
-            match frame_data {
-                FrameData::Path(p) => {
-                    let img = match image::open(p) {
-                        Ok(img) => img,
-                        Err(e) => {
-                            eprintln!("Failed to open image {:?}: {}", p, e);
-                            continue;
-                        }
-                    };
-                    let meta = SourceMeta {
-                        frame_idx: self.current_idx * self.batch_size + i,
-                        total_frames: self.len * self.batch_size,
-                        source_path: Some(p.clone()),
-                    };
-                    batch_images.push(img);
-                    batch_metas.push(meta);
-                }
-                FrameData::Image(img) => {
-                    let meta = SourceMeta {
-                        frame_idx: self.current_idx * self.batch_size + i,
-                        total_frames: self.len * self.batch_size,
-                        source_path: None,
-                    };
-                    // batch_data.push((img.clone(), meta));
-                    batch_images.push(img.clone());
-                    batch_metas.push(meta);
-                }
-                FrameData::None => {
-                    // Skip padding frames
-                }
-            }
+        let total_frames = self.total_frames().unwrap_or(0);
+        for (i, frame) in decoded
+            .into_iter()
+            .enumerate()
+            .filter_map(|(i, d)| d.map(|d| (i, d)))
+        {
+            batch_images.push(frame.image);
+            batch_metas.push(SourceMeta {
+                frame_idx: frame.position.map_or(self.current_idx + i, |p| p.frame_idx),
+                total_frames,
+                source_path: frame.source_path,
+                tag: None,
+                timestamp: frame.position.map(|p| p.timestamp),
+                timings,
+            });
         }
 
-        self.current_idx += 1;
+        self.current_idx += batch_len;
         Some((batch_images, batch_metas))
     }
 }
-
-/// Implement ExactSizeIterator (to use indicatif's ProgressIterator)
-impl ExactSizeIterator for BatchSourceLoader {
-    fn len(&self) -> usize {
-        self.len
-    }
-}
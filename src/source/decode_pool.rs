@@ -0,0 +1,129 @@
+use image::{ColorType, DynamicImage, GrayAlphaImage, GrayImage, ImageDecoder, ImageReader,
+            ImageResult, RgbImage, RgbaImage};
+use rayon::ThreadPool;
+use rayon::prelude::*;
+use std::path::PathBuf;
+
+use crate::buffer_pool::frame_pool;
+use crate::error::{AppError, Result};
+use crate::thread_budget::pin_pool;
+
+/// Bounded thread pool used by the source loaders to decode frames in parallel
+#[derive(Debug, Default)]
+pub struct DecodePool {
+    /// `None` decodes on the calling (loader) thread
+    pool: Option<ThreadPool>,
+}
+
+impl DecodePool {
+    /// Create a decode pool with `workers` threads.
+    ///
+    /// - `None` or `Some(0)`: one thread per logical CPU
+    /// - `Some(1)`: no pool, frames are decoded on the calling thread
+    pub fn new(workers: Option<usize>) -> Result<Self> {
+        Self::pinned(workers, None)
+    }
+
+    /// Same as [`DecodePool::new`], with the pool threads pinned to `cpus` if set
+    pub fn pinned(workers: Option<usize>, cpus: Option<Vec<usize>>) -> Result<Self> {
+        if workers == Some(1) {
+            return Ok(Self::default());
+        }
+
+        let builder = rayon::ThreadPoolBuilder::new()
+            .num_threads(workers.unwrap_or(0))
+            .thread_name(|i| format!("yolo-decode-{}", i));
+        let pool = pin_pool(builder, cpus)
+            .build()
+            .map_err(|e| AppError::Config(format!("Failed to build decode pool: {}", e)))?;
+        Ok(Self { pool: Some(pool) })
+    }
+
+    /// Number of frames decoded concurrently
+    pub fn num_threads(&self) -> usize {
+        self.pool
+            .as_ref()
+            .map_or(1, ThreadPool::current_num_threads)
+    }
+
+    /// Map `f` over `items`, in parallel if a pool is available. Output keeps input order.
+    pub fn map<T, R, F>(&self, items: &[T], f: F) -> Vec<R>
+    where
+        T: Sync,
+        R: Send,
+        F: Fn(&T) -> R + Sync + Send,
+    {
+        match &self.pool {
+            Some(pool) => pool.install(|| items.par_iter().map(f).collect()),
+            None => items.iter().map(f).collect(),
+        }
+    }
+}
+
+/// Decode an image file into a recycled frame buffer (8-bit formats; others are decoded as by
+/// [`image::open`])
+fn decode_pooled(path: &PathBuf) -> ImageResult<DynamicImage> {
+    let decoder = ImageReader::open(path)?.into_decoder()?;
+    let (w, h) = decoder.dimensions();
+    let color = decoder.color_type();
+    if !matches!(
+        color,
+        ColorType::L8 | ColorType::La8 | ColorType::Rgb8 | ColorType::Rgba8
+    ) {
+        return DynamicImage::from_decoder(decoder);
+    }
+
+    let len = decoder.total_bytes() as usize;
+    let mut buffer = frame_pool().take(len);
+    buffer.resize(len, 0);
+    decoder.read_image(&mut buffer)?;
+
+    let invalid = "Decoder output has the size of its frame";
+    Ok(match color {
+        ColorType::L8 => {
+            DynamicImage::ImageLuma8(GrayImage::from_raw(w, h, buffer).expect(invalid))
+        }
+        ColorType::La8 => {
+            DynamicImage::ImageLumaA8(GrayAlphaImage::from_raw(w, h, buffer).expect(invalid))
+        }
+        ColorType::Rgb8 => {
+            DynamicImage::ImageRgb8(RgbImage::from_raw(w, h, buffer).expect(invalid))
+        }
+        _ => DynamicImage::ImageRgba8(RgbaImage::from_raw(w, h, buffer).expect(invalid)),
+    })
+}
+
+/// Decode an image file, logging and skipping it on failure
+pub fn open_image(path: &PathBuf) -> Option<DynamicImage> {
+    match decode_pooled(path) {
+        Ok(img) => Some(img),
+        Err(e) => {
+            tracing::error!("Failed to open image: {:?}. Error: {}", path, e);
+            None
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_decode_pool_map_keeps_order() {
+        let items: Vec<usize> = (0..64).collect();
+
+        let serial = DecodePool::new(Some(1)).unwrap();
+        assert_eq!(serial.num_threads(), 1);
+        assert_eq!(
+            serial.map(&items, |x| x * 2),
+            (0..64).map(|x| x * 2).collect::<Vec<_>>()
+        );
+
+        let pool = DecodePool::new(Some(4)).unwrap();
+        assert_eq!(pool.num_threads(), 4);
+        assert_eq!(
+            pool.map(&items, |x| x * 2),
+            (0..64).map(|x| x * 2).collect::<Vec<_>>()
+        );
+    }
+}
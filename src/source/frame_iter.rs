@@ -0,0 +1,358 @@
+use image::DynamicImage;
+use std::borrow::Cow;
+use std::fs::{File, ReadDir};
+use std::io::{BufRead, BufReader, Lines};
+use std::path::{Path, PathBuf};
+
+use crate::error::{AppError, Result};
+
+use super::Source;
+use super::decode_pool::{DecodePool, open_image};
+use super::source_utils::is_image_file;
+use super::video::{FramePosition, VideoFrames, VideoOptions};
+
+/// Frame of a source, before decoding
+#[derive(Debug, Clone)]
+pub(super) enum FrameData {
+    Path(PathBuf),
+    Image(DynamicImage),
+    /// Frame already decoded from a video, at its position in the stream
+    Video(DynamicImage, FramePosition),
+}
+
+/// Decoded frame of a source
+#[derive(Debug)]
+pub(super) struct DecodedFrame {
+    pub image: DynamicImage,
+    pub source_path: Option<PathBuf>,
+    /// Position of video frames in their stream
+    pub position: Option<FramePosition>,
+}
+
+impl DecodedFrame {
+    const fn new(image: DynamicImage, source_path: Option<PathBuf>) -> Self {
+        Self {
+            image,
+            source_path,
+            position: None,
+        }
+    }
+}
+
+/// Decode `frames` on `pool`, keeping their order. In-memory images are moved, not copied.
+///
+/// Frames that fail to decode are `None`.
+pub(super) fn decode_frames(
+    pool: &DecodePool,
+    frames: Vec<FrameData>,
+) -> Vec<Option<DecodedFrame>> {
+    let decoded = pool.map(&frames, |frame| match frame {
+        FrameData::Path(p) => open_image(p),
+        FrameData::Image(_) | FrameData::Video(..) => None,
+    });
+    frames
+        .into_iter()
+        .zip(decoded)
+        .map(|(frame, decoded)| match frame {
+            FrameData::Path(p) => decoded.map(|img| DecodedFrame::new(img, Some(p))),
+            FrameData::Image(img) => Some(DecodedFrame::new(img, None)),
+            FrameData::Video(img, position) => Some(DecodedFrame {
+                position: Some(position),
+                ..DecodedFrame::new(img, None)
+            }),
+        })
+        .collect()
+}
+
+/// Image files of a directory, streamed from `read_dir` as they are listed
+#[derive(Debug)]
+pub struct DirImages {
+    entries: ReadDir,
+}
+
+impl DirImages {
+    pub fn new(dir: &Path) -> Result<Self> {
+        let entries =
+            std::fs::read_dir(dir).map_err(|e| AppError::ImageCollection(e.to_string()))?;
+        Ok(Self { entries })
+    }
+}
+
+impl Iterator for DirImages {
+    type Item = PathBuf;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        for entry in self.entries.by_ref() {
+            let Ok(entry) = entry else {
+                continue;
+            };
+            let path = entry.path();
+            if !is_image_file(&path) {
+                continue;
+            }
+            // the entry type comes with the listing on most platforms; only symlinks need a stat
+            let is_file = match entry.file_type() {
+                Ok(t) if t.is_symlink() => path.is_file(),
+                Ok(t) => t.is_file(),
+                Err(_) => false,
+            };
+            if is_file {
+                return Some(path);
+            }
+        }
+        None
+    }
+}
+
+/// Image paths listed in a manifest file, streamed line by line.
+///
+/// One path per line; empty lines and lines starting with `#` are skipped. Relative paths are
+/// resolved against the manifest's directory.
+#[derive(Debug)]
+pub struct ManifestImages {
+    lines: Lines<BufReader<File>>,
+    base_dir: PathBuf,
+}
+
+impl ManifestImages {
+    pub fn new(manifest: &Path) -> Result<Self> {
+        let file = File::open(manifest).map_err(|e| {
+            AppError::ImageCollection(format!("Failed to open manifest {:?}: {}", manifest, e))
+        })?;
+        Ok(Self {
+            lines: BufReader::new(file).lines(),
+            base_dir: manifest.parent().map(Path::to_path_buf).unwrap_or_default(),
+        })
+    }
+}
+
+impl Iterator for ManifestImages {
+    type Item = PathBuf;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        for line in self.lines.by_ref() {
+            let line = match line {
+                Ok(line) => line,
+                Err(e) => {
+                    tracing::error!("Failed to read manifest line: {}", e);
+                    return None;
+                }
+            };
+            let line = line.trim();
+            if line.is_empty() || line.starts_with('#') {
+                continue;
+            }
+            let path = PathBuf::from(line);
+            let path = if path.is_absolute() {
+                path
+            } else {
+                self.base_dir.join(path)
+            };
+            if is_image_file(&path) {
+                return Some(path);
+            }
+        }
+        None
+    }
+}
+
+/// Boxed iterator over the frames of a source
+type Frames<'a> = Box<dyn Iterator<Item = FrameData> + Send + 'a>;
+
+/// Lazily iterated frames of a [`Source`].
+///
+/// Directories, manifests and videos are streamed, so the first frame is available right away
+/// however large the source is; their length is unknown until they are exhausted.
+pub(super) struct FrameIter<'a> {
+    frames: Frames<'a>,
+    /// Frames of video and stream sources, which take decoding options
+    video: Option<VideoFrames>,
+    len: Option<usize>,
+    file_based: bool,
+}
+
+impl std::fmt::Debug for FrameIter<'_> {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("FrameIter")
+            .field("len", &self.len)
+            .field("file_based", &self.file_based)
+            .field("video", &self.video)
+            .finish_non_exhaustive()
+    }
+}
+
+impl<'a> FrameIter<'a> {
+    /// Frames of `source`. In-memory images of an owned source are moved out of it; those of a
+    /// borrowed source are cloned one by one as they are loaded.
+    pub fn new(source: Cow<'a, Source>) -> Result<Self> {
+        let video = match &*source {
+            Source::Video(path) => Some(VideoFrames::open(path.to_string_lossy().into_owned())?),
+            Source::Stream(url) => Some(VideoFrames::open(url.clone())?),
+            _ => None,
+        };
+        if video.is_some() {
+            return Ok(Self {
+                frames: Box::new(std::iter::empty()),
+                video,
+                len: None,
+                file_based: false,
+            });
+        }
+
+        let (frames, len, file_based): (Frames<'a>, _, _) = match source {
+            Cow::Owned(Source::ImagePathVec(paths)) => {
+                let frames: Vec<FrameData> = paths
+                    .into_iter()
+                    .filter(|p| is_image_file(p))
+                    .map(FrameData::Path)
+                    .collect();
+                let len = frames.len();
+                (Box::new(frames.into_iter()), Some(len), true)
+            }
+            Cow::Borrowed(Source::ImagePathVec(paths)) => {
+                let len = paths.iter().filter(|p| is_image_file(p)).count();
+                let frames = paths
+                    .iter()
+                    .filter(|p| is_image_file(p))
+                    .map(|p| FrameData::Path(p.clone()));
+                (Box::new(frames), Some(len), true)
+            }
+            Cow::Owned(Source::Image(img)) => (
+                Box::new(std::iter::once(FrameData::Image(img))),
+                Some(1),
+                false,
+            ),
+            Cow::Borrowed(Source::Image(img)) => (
+                Box::new(std::iter::once_with(|| FrameData::Image(img.clone()))),
+                Some(1),
+                false,
+            ),
+            Cow::Owned(Source::ImageVec(imgs)) => {
+                let len = imgs.len();
+                (
+                    Box::new(imgs.into_iter().map(FrameData::Image)),
+                    Some(len),
+                    false,
+                )
+            }
+            Cow::Borrowed(Source::ImageVec(imgs)) => (
+                Box::new(imgs.iter().map(|img| FrameData::Image(img.clone()))),
+                Some(imgs.len()),
+                false,
+            ),
+            source => {
+                let (frames, len) = path_frames(&source)?;
+                (frames, len, true)
+            }
+        };
+        Ok(Self {
+            frames,
+            video: None,
+            len,
+            file_based,
+        })
+    }
+
+    /// Total number of frames, `None` for streamed sources
+    pub const fn len(&self) -> Option<usize> {
+        self.len
+    }
+
+    /// Whether frames are decoded from files
+    pub const fn is_file_based(&self) -> bool {
+        self.file_based
+    }
+
+    /// Set the decoding options of video and stream sources, before the first frame is taken
+    pub fn set_video_options(&mut self, options: VideoOptions) {
+        if let Some(video) = self.video.as_mut() {
+            video.set_options(options);
+        }
+    }
+
+    /// Take up to `n` frames
+    pub fn take_chunk(&mut self, n: usize) -> Vec<FrameData> {
+        match self.video.as_mut() {
+            Some(video) => video
+                .by_ref()
+                .take(n)
+                .map(|(img, position)| FrameData::Video(img, position))
+                .collect(),
+            None => self.frames.by_ref().take(n).collect(),
+        }
+    }
+}
+
+/// Frames of the single-path sources, which do not borrow from `source`
+fn path_frames(source: &Source) -> Result<(Frames<'static>, Option<usize>)> {
+    match source {
+        Source::None => Err(AppError::Config(
+            "Source::None cannot be used with a source loader".to_string(),
+        )),
+        Source::ImagePath(path) => {
+            let frames: Vec<FrameData> = if is_image_file(path) {
+                vec![FrameData::Path(path.clone())]
+            } else {
+                vec![]
+            };
+            let len = frames.len();
+            Ok((Box::new(frames.into_iter()), Some(len)))
+        }
+        Source::Directory(dir) => Ok((Box::new(DirImages::new(dir)?.map(FrameData::Path)), None)),
+        Source::Manifest(manifest) => Ok((
+            Box::new(ManifestImages::new(manifest)?.map(FrameData::Path)),
+            None,
+        )),
+        Source::ImagePathVec(_)
+        | Source::Image(_)
+        | Source::ImageVec(_)
+        | Source::Video(_)
+        | Source::Stream(_) => {
+            unreachable!("path lists, in-memory images and videos are handled by FrameIter::new")
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_manifest_images_resolve_relative_paths() {
+        let dir = tempfile::tempdir().unwrap();
+        let manifest = dir.path().join("list.txt");
+        std::fs::write(&manifest, "# comment\na.jpg\n\n/abs/b.png\nnotes.md\n").unwrap();
+
+        let paths: Vec<PathBuf> = ManifestImages::new(&manifest).unwrap().collect();
+        assert_eq!(
+            paths,
+            vec![dir.path().join("a.jpg"), PathBuf::from("/abs/b.png")]
+        );
+    }
+
+    #[test]
+    fn test_owned_images_are_moved() {
+        let images = vec![DynamicImage::new_rgb8(4, 4), DynamicImage::new_rgb8(8, 8)];
+        let ptrs: Vec<*const u8> = images.iter().map(|img| img.as_bytes().as_ptr()).collect();
+
+        let mut frames = FrameIter::new(Cow::Owned(Source::ImageVec(images))).unwrap();
+        assert_eq!(frames.len(), Some(2));
+        let decoded = decode_frames(&DecodePool::default(), frames.take_chunk(4));
+        let moved: Vec<*const u8> = decoded
+            .iter()
+            .map(|d| d.as_ref().unwrap().image.as_bytes().as_ptr())
+            .collect();
+        assert_eq!(moved, ptrs);
+    }
+
+    #[test]
+    fn test_dir_images_skips_non_images_and_dirs() {
+        let dir = tempfile::tempdir().unwrap();
+        std::fs::write(dir.path().join("a.jpg"), b"").unwrap();
+        std::fs::write(dir.path().join("b.txt"), b"").unwrap();
+        std::fs::create_dir(dir.path().join("c.png")).unwrap();
+
+        let paths: Vec<PathBuf> = DirImages::new(dir.path()).unwrap().collect();
+        assert_eq!(paths, vec![dir.path().join("a.jpg")]);
+    }
+}
@@ -1,103 +1,118 @@
 use image::DynamicImage;
-use std::iter::ExactSizeIterator;
-use std::path::PathBuf;
+use std::borrow::Cow;
+use std::collections::VecDeque;
+use std::time::Instant;
 
 use crate::error::Result;
 
-use super::source_utils::{collect_images_from_dir, is_image_file};
-use super::{Source, SourceMeta};
-
-#[derive(Debug, Clone)]
-enum FrameData {
-    Path(PathBuf),
-    Image(DynamicImage),
-}
+use super::decode_pool::DecodePool;
+use super::frame_iter::{FrameIter, decode_frames};
+use super::video::VideoOptions;
+use super::{FrameTimings, Source, SourceMeta};
 
 #[derive(Debug)]
-pub struct SourceLoader {
+pub struct SourceLoader<'a> {
     current_idx: usize,
-    frames: Vec<FrameData>,
-    len: usize,
+    frames: FrameIter<'a>,
+    decode_pool: DecodePool,
+    /// Frames decoded ahead of the consumer
+    decoded: VecDeque<(DynamicImage, SourceMeta)>,
+    exhausted: bool,
 }
 
-impl SourceLoader {
-    pub fn new(source: &Source) -> Result<Self> {
-        let frames = match source {
-            Source::None => {
-                return Err(crate::error::AppError::Config(
-                    "Source::None cannot be used with SourceLoader".to_string(),
-                ));
-            }
-            Source::ImagePath(path) => {
-                if is_image_file(path) {
-                    vec![FrameData::Path(path.clone())]
-                } else {
-                    vec![]
-                }
-            }
-            Source::Directory(dir_path) => collect_images_from_dir(dir_path)?
-                .into_iter()
-                .map(FrameData::Path)
-                .collect(),
-            Source::ImagePathVec(paths) => paths
-                .iter()
-                .filter(|p| is_image_file(p))
-                .cloned()
-                .map(FrameData::Path)
-                .collect(),
-            Source::Image(img) => vec![FrameData::Image(img.clone())],
-            Source::ImageVec(imgs) => imgs.iter().cloned().map(FrameData::Image).collect(),
-        };
-        let len = frames.len();
-
+impl<'a> SourceLoader<'a> {
+    /// Loader over a borrowed (`&Source`) or owned (`Source`) source; in-memory images of an
+    /// owned source are moved through the loader instead of copied
+    pub fn new(source: impl Into<Cow<'a, Source>>) -> Result<Self> {
         Ok(Self {
             current_idx: 0,
-            frames,
-            len,
+            frames: FrameIter::new(source.into())?,
+            decode_pool: DecodePool::default(),
+            decoded: VecDeque::new(),
+            exhausted: false,
         })
     }
 
-    pub const fn len(&self) -> usize {
-        self.len
+    /// Decode upcoming frames on a pool of `workers` threads (see [`DecodePool::new`]).
+    ///
+    /// The pool is only created for file-based sources.
+    pub fn with_decode_workers(mut self, workers: Option<usize>) -> Result<Self> {
+        if self.frames.is_file_based() {
+            self.decode_pool = DecodePool::new(workers)?;
+        }
+        Ok(self)
+    }
+
+    /// Same as `with_decode_workers`, with the pool threads pinned to `cpus` if set
+    pub fn with_decode_threads(
+        mut self,
+        workers: Option<usize>,
+        cpus: Option<Vec<usize>>,
+    ) -> Result<Self> {
+        if self.frames.is_file_based() {
+            self.decode_pool = DecodePool::pinned(workers, cpus)?;
+        }
+        Ok(self)
+    }
+
+    /// Decode video and stream sources with `options`; other sources ignore them
+    pub fn with_video_options(mut self, options: VideoOptions) -> Self {
+        self.frames.set_video_options(options);
+        self
+    }
+
+    /// Total number of frames, `None` for streamed sources (directories, manifests, videos)
+    pub const fn len(&self) -> Option<usize> {
+        self.frames.len()
+    }
+
+    /// Decode the next chunk of frames (one per decode thread) into `self.decoded`
+    fn decode_ahead(&mut self) {
+        let chunk = self.frames.take_chunk(self.decode_pool.num_threads());
+        if chunk.is_empty() {
+            self.exhausted = true;
+            return;
+        }
+        let mut timings = FrameTimings::start();
+
+        let chunk_len = chunk.len();
+        let images = decode_frames(&self.decode_pool, chunk);
+        timings.loaded = Some(Instant::now());
+
+        let total_frames = self.len().unwrap_or(0);
+        for (i, decoded) in images.into_iter().enumerate() {
+            if let Some(frame) = decoded {
+                let meta = SourceMeta {
+                    frame_idx: frame.position.map_or(self.current_idx + i, |p| p.frame_idx),
+                    total_frames,
+                    source_path: frame.source_path,
+                    tag: None,
+                    timestamp: frame.position.map(|p| p.timestamp),
+                    timings,
+                };
+                self.decoded.push_back((frame.image, meta));
+            }
+        }
+        self.current_idx += chunk_len;
     }
 }
 
-impl Iterator for SourceLoader {
+impl Iterator for SourceLoader<'_> {
     type Item = (DynamicImage, SourceMeta);
 
     /// Get the next image and its metadata (in lazy loading manner)
     fn next(&mut self) -> Option<Self::Item> {
-        if self.current_idx >= self.len {
-            return None;
+        // skip over chunks where every frame failed to decode
+        while self.decoded.is_empty() && !self.exhausted {
+            self.decode_ahead();
         }
-
-        let frame_data = &self.frames[self.current_idx];
-        let (image, source_path) = match frame_data {
-            FrameData::Path(p) => match image::open(p) {
-                Ok(img) => (img, Some(p.clone())),
-                Err(e) => {
-                    tracing::error!("Failed to open image: {:?}. Error: {}", p, e);
-                    self.current_idx += 1;
-                    return self.next();
-                }
-            },
-            FrameData::Image(img) => (img.clone(), None),
-        };
-
-        let meta = SourceMeta {
-            frame_idx: self.current_idx,
-            total_frames: self.len,
-            source_path,
-        };
-
-        self.current_idx += 1;
-        Some((image, meta))
+        self.decoded.pop_front()
     }
-}
 
-/// Implement ExactSizeIterator (to use indicatif's ProgressIterator)
-impl ExactSizeIterator for SourceLoader {
-    fn len(&self) -> usize {
-        self.len
+    fn size_hint(&self) -> (usize, Option<usize>) {
+        let remaining = self
+            .len()
+            .map(|len| len - self.current_idx + self.decoded.len());
+        (self.decoded.len(), remaining)
     }
 }
@@ -1,25 +1,35 @@
-use crate::error::{AppError, Result};
+use crate::error::Result;
 use std::path::PathBuf;
 
+use super::frame_iter::DirImages;
+
+/// Supported image extensions, lowercase
+const IMAGE_EXTENSIONS: [&str; 8] = ["jpg", "jpeg", "png", "bmp", "gif", "webp", "tiff", "tif"];
+
+/// Supported video extensions, lowercase
+const VIDEO_EXTENSIONS: [&str; 8] = ["mp4", "mkv", "avi", "mov", "webm", "m4v", "ts", "flv"];
+
 pub fn is_image_file(path: &PathBuf) -> bool {
-    path.extension().is_some_and(|ext| {
-        let ext = ext.to_string_lossy().to_lowercase();
-        matches!(
-            ext.as_str(),
-            "jpg" | "jpeg" | "png" | "bmp" | "gif" | "webp" | "tiff" | "tif"
-        )
-    })
+    path.extension()
+        .and_then(|ext| ext.to_str())
+        .is_some_and(|ext| {
+            IMAGE_EXTENSIONS
+                .iter()
+                .any(|known| ext.eq_ignore_ascii_case(known))
+        })
+}
+
+pub fn is_video_file(path: &PathBuf) -> bool {
+    path.extension()
+        .and_then(|ext| ext.to_str())
+        .is_some_and(|ext| {
+            VIDEO_EXTENSIONS
+                .iter()
+                .any(|known| ext.eq_ignore_ascii_case(known))
+        })
 }
 
+/// Collect all image files of `dir`; prefer iterating [`DirImages`] for large directories
 pub fn collect_images_from_dir(dir: &PathBuf) -> Result<Vec<PathBuf>> {
-    let mut image_paths = vec![];
-    for entry in std::fs::read_dir(dir).map_err(|e| AppError::ImageCollection(e.to_string()))? {
-        if let Ok(entry) = entry {
-            let path = entry.path();
-            if path.is_file() && is_image_file(&path) {
-                image_paths.push(path);
-            }
-        }
-    }
-    Ok(image_paths)
+    Ok(DirImages::new(dir)?.collect())
 }
@@ -0,0 +1,390 @@
+use image::{DynamicImage, RgbImage};
+use std::io::{BufRead, BufReader, ErrorKind, Read};
+use std::process::{Child, ChildStderr, ChildStdout, Command, Stdio};
+use std::sync::mpsc::{self, Receiver, Sender};
+use std::thread::JoinHandle;
+use std::time::Duration;
+
+use crate::buffer_pool::frame_pool;
+use crate::error::{AppError, Result};
+
+/// Decoding options of video and stream sources
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct VideoOptions {
+    /// Keep every `stride`-th frame of the stream (`1`: every frame)
+    pub stride: usize,
+    /// ffmpeg hardware decoder (`auto`, `cuda` for NVDEC, `vaapi`, ...); `none` decodes on the CPU
+    pub hwaccel: String,
+}
+
+impl Default for VideoOptions {
+    fn default() -> Self {
+        Self {
+            stride: 1,
+            hwaccel: "auto".to_string(),
+        }
+    }
+}
+
+/// Position of a decoded frame in its video
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub(super) struct FramePosition {
+    /// Index of the frame in the stream, skipped frames included
+    pub frame_idx: usize,
+    /// Presentation time reported by the decoder; from the frame index and the average frame
+    /// rate for frames without one
+    pub timestamp: Duration,
+}
+
+/// Stream properties read by `ffprobe`
+#[derive(Debug, Clone, Copy, PartialEq)]
+struct VideoInfo {
+    width: u32,
+    height: u32,
+    /// Average frame rate, `0` if unknown
+    fps: f64,
+}
+
+impl VideoInfo {
+    /// Parse the `key=value` lines of `ffprobe -show_entries stream=width,height,avg_frame_rate`
+    fn parse(output: &str) -> Option<Self> {
+        let (mut width, mut height, mut fps) = (None, None, 0.0);
+        for (key, value) in output
+            .lines()
+            .filter_map(|line| line.trim().split_once('='))
+        {
+            match key {
+                "width" => width = value.parse().ok(),
+                "height" => height = value.parse().ok(),
+                "avg_frame_rate" => {
+                    // a fraction such as `30000/1001`, `0/0` when unknown
+                    let (num, den) = value.split_once('/').unwrap_or((value, "1"));
+                    fps = match (num.parse::<f64>(), den.parse::<f64>()) {
+                        (Ok(num), Ok(den)) if den > 0.0 => num / den,
+                        _ => 0.0,
+                    };
+                }
+                _ => {}
+            }
+        }
+        Some(Self {
+            width: width.filter(|&w| w > 0)?,
+            height: height.filter(|&h| h > 0)?,
+            fps,
+        })
+    }
+
+    /// Probe the first video stream of `input`
+    fn probe(input: &str) -> Result<Self> {
+        let output = Command::new("ffprobe")
+            .args(["-v", "error", "-select_streams", "v:0"])
+            .args(["-show_entries", "stream=width,height,avg_frame_rate"])
+            .args(["-of", "default=noprint_wrappers=1"])
+            .arg(input)
+            .stderr(Stdio::inherit())
+            .output()
+            .map_err(|e| {
+                AppError::ImageLoad(format!("Failed to run ffprobe on {}: {}", input, e))
+            })?;
+        if !output.status.success() {
+            return Err(AppError::ImageLoad(format!(
+                "ffprobe failed on {} ({})",
+                input, output.status
+            )));
+        }
+        Self::parse(&String::from_utf8_lossy(&output.stdout))
+            .ok_or_else(|| AppError::ImageLoad(format!("No video stream in {}", input)))
+    }
+}
+
+/// Presentation time of a frame from an ffmpeg `showinfo` log line, `None` for other lines
+/// (`Some(None)` for frames without a timestamp)
+fn parse_pts_time(line: &str) -> Option<Option<Duration>> {
+    if !line.contains("Parsed_showinfo") {
+        return None;
+    }
+    let (_, rest) = line.split_once(" pts_time:")?;
+    let value = rest.split_whitespace().next().unwrap_or_default();
+    Some(
+        value
+            .parse::<f64>()
+            .ok()
+            .filter(|secs| secs.is_finite() && *secs >= 0.0)
+            .map(Duration::from_secs_f64),
+    )
+}
+
+/// Read the ffmpeg log on stderr: frame timestamps of `showinfo` go to `pts`, warnings and
+/// errors to the log
+fn read_decoder_log(input: String, stderr: ChildStderr, pts: Sender<Option<Duration>>) {
+    for line in BufReader::new(stderr).lines() {
+        let Ok(line) = line else { break };
+        if let Some(timestamp) = parse_pts_time(&line) {
+            // the receiver is gone once the source is dropped
+            let _ = pts.send(timestamp);
+        } else if line.contains("[warning]") {
+            tracing::warn!("ffmpeg ({}): {}", input, line);
+        } else if ["[error]", "[fatal]", "[panic]"]
+            .iter()
+            .any(|level| line.contains(level))
+        {
+            tracing::error!("ffmpeg ({}): {}", input, line);
+        }
+    }
+}
+
+/// Running `ffmpeg` child: frames on stdout, their timestamps parsed from its log on stderr
+#[derive(Debug)]
+struct Decoder {
+    child: Child,
+    stdout: ChildStdout,
+    pts: Receiver<Option<Duration>>,
+    log: JoinHandle<()>,
+}
+
+impl Decoder {
+    /// Close the pipes and wait for the process (and its log reader) to exit
+    fn stop(self, kill: bool) -> std::io::Result<std::process::ExitStatus> {
+        let Self {
+            mut child,
+            stdout,
+            log,
+            ..
+        } = self;
+        drop(stdout);
+        if kill {
+            let _ = child.kill();
+        }
+        let status = child.wait();
+        let _ = log.join();
+        status
+    }
+}
+
+/// Frames of a video file or network stream, decoded by an `ffmpeg` child process.
+///
+/// The stream is probed when the source is opened, so a missing `ffmpeg` or an unreadable input
+/// fails right away; decoding starts with the first frame taken, with the options set by then.
+/// ffmpeg picks the hardware decoder (`-hwaccel`), drops skipped frames before their RGB
+/// conversion and scales every frame to the probed size, so a stream changing its resolution
+/// keeps the frame size; raw RGB frames are then read from its stdout into pooled buffers.
+/// Frame timestamps are the presentation times logged by ffmpeg's `showinfo` filter.
+#[derive(Debug)]
+pub(super) struct VideoFrames {
+    input: String,
+    info: VideoInfo,
+    options: VideoOptions,
+    decoder: Option<Decoder>,
+    /// Frames read so far
+    read: usize,
+    exhausted: bool,
+}
+
+impl VideoFrames {
+    pub fn open(input: String) -> Result<Self> {
+        let info = VideoInfo::probe(&input)?;
+        tracing::info!(
+            "Video source {}: {}x{} at {:.2} fps",
+            input,
+            info.width,
+            info.height,
+            info.fps
+        );
+        Ok(Self {
+            input,
+            info,
+            options: VideoOptions::default(),
+            decoder: None,
+            read: 0,
+            exhausted: false,
+        })
+    }
+
+    /// Set the decoding options; ignored once decoding has started
+    pub fn set_options(&mut self, options: VideoOptions) {
+        if self.decoder.is_none() && self.read == 0 {
+            self.options = options;
+        }
+    }
+
+    fn stride(&self) -> usize {
+        self.options.stride.max(1)
+    }
+
+    /// `ffmpeg` command line decoding `self.input` to raw RGB frames of the probed size on
+    /// stdout, logging their timestamps (`showinfo`) and errors on stderr
+    fn command(&self) -> Command {
+        let mut cmd = Command::new("ffmpeg");
+        // `level` tags each log line, so warnings and errors can be told from `showinfo`
+        cmd.args([
+            "-hide_banner",
+            "-loglevel",
+            "level+info",
+            "-nostats",
+            "-nostdin",
+        ]);
+        if !self.options.hwaccel.eq_ignore_ascii_case("none") {
+            cmd.args(["-hwaccel", self.options.hwaccel.as_str()]);
+        }
+        if self.input.starts_with("rtsp://") {
+            cmd.args(["-rtsp_transport", "tcp"]);
+        }
+        cmd.arg("-i").arg(&self.input);
+        let mut filters = Vec::new();
+        let stride = self.stride();
+        if stride > 1 {
+            filters.push(format!("select=not(mod(n\\,{}))", stride));
+        }
+        filters.push(format!("scale={}:{}", self.info.width, self.info.height));
+        filters.push("showinfo".to_string());
+        cmd.args(["-vf", &filters.join(",")]);
+        // one output frame per decoded frame, with its own timestamp
+        cmd.args(["-fps_mode", "passthrough"]);
+        cmd.args(["-an", "-f", "rawvideo", "-pix_fmt", "rgb24", "pipe:1"]);
+        cmd
+    }
+
+    fn spawn(&mut self) -> Result<()> {
+        let mut child = self
+            .command()
+            .stdin(Stdio::null())
+            .stdout(Stdio::piped())
+            .stderr(Stdio::piped())
+            .spawn()
+            .map_err(|e| {
+                AppError::ImageLoad(format!("Failed to run ffmpeg on {}: {}", self.input, e))
+            })?;
+        let stdout = child.stdout.take().expect("ffmpeg stdout is piped");
+        let stderr = child.stderr.take().expect("ffmpeg stderr is piped");
+        let (pts_tx, pts) = mpsc::channel();
+        let input = self.input.clone();
+        let log = std::thread::Builder::new()
+            .name("video-log".to_string())
+            .spawn(move || read_decoder_log(input, stderr, pts_tx))?;
+        self.decoder = Some(Decoder {
+            child,
+            stdout,
+            pts,
+            log,
+        });
+        Ok(())
+    }
+
+    /// Read the next raw frame and its presentation time (if ffmpeg logged one), `None` at the
+    /// end of the stream
+    fn read_frame(&mut self) -> Option<(RgbImage, Option<Duration>)> {
+        let (w, h) = (self.info.width, self.info.height);
+        let len = w as usize * h as usize * 3;
+        let decoder = self.decoder.as_mut()?;
+        let mut buffer = frame_pool().take(len);
+        buffer.resize(len, 0);
+        match decoder.stdout.read_exact(&mut buffer) {
+            Ok(()) => {
+                // `showinfo` logs a frame before it is written, so its line is already sent (or
+                // the log has ended)
+                let pts = decoder.pts.recv().ok().flatten();
+                let frame =
+                    RgbImage::from_raw(w, h, buffer).expect("Frame buffer has the frame size");
+                Some((frame, pts))
+            }
+            Err(e) => {
+                if e.kind() != ErrorKind::UnexpectedEof {
+                    tracing::error!("Failed to read frames of {}: {}", self.input, e);
+                }
+                frame_pool().give(buffer);
+                None
+            }
+        }
+    }
+
+    /// Wait for the decoder to exit, logging a failure
+    fn finish(&mut self) {
+        self.exhausted = true;
+        if let Some(decoder) = self.decoder.take() {
+            match decoder.stop(false) {
+                Ok(status) if !status.success() => {
+                    tracing::error!("ffmpeg failed on {} ({})", self.input, status)
+                }
+                Err(e) => tracing::error!("Failed to wait for ffmpeg on {}: {}", self.input, e),
+                Ok(_) => {}
+            }
+        }
+    }
+}
+
+impl Iterator for VideoFrames {
+    type Item = (DynamicImage, FramePosition);
+
+    fn next(&mut self) -> Option<Self::Item> {
+        if self.exhausted {
+            return None;
+        }
+        if self.decoder.is_none()
+            && let Err(e) = self.spawn()
+        {
+            tracing::error!("{}", e);
+            self.exhausted = true;
+            return None;
+        }
+        let Some((frame, pts)) = self.read_frame() else {
+            self.finish();
+            return None;
+        };
+
+        let frame_idx = self.read * self.stride();
+        self.read += 1;
+        let timestamp = pts.unwrap_or_else(|| {
+            if self.info.fps > 0.0 {
+                Duration::from_secs_f64(frame_idx as f64 / self.info.fps)
+            } else {
+                Duration::ZERO
+            }
+        });
+        let position = FramePosition {
+            frame_idx,
+            timestamp,
+        };
+        Some((DynamicImage::ImageRgb8(frame), position))
+    }
+}
+
+impl Drop for VideoFrames {
+    /// Stop a decoder that is still running, e.g. when a live stream is abandoned
+    fn drop(&mut self) {
+        if let Some(decoder) = self.decoder.take() {
+            let _ = decoder.stop(true);
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_video_info_from_ffprobe_output() {
+        let info = VideoInfo::parse("width=1920\nheight=1080\navg_frame_rate=30000/1001\n");
+        let info = info.unwrap();
+        assert_eq!((info.width, info.height), (1920, 1080));
+        assert!((info.fps - 29.97).abs() < 0.01);
+
+        // unknown frame rate, e.g. some live streams
+        let info = VideoInfo::parse("avg_frame_rate=0/0\nwidth=640\nheight=480").unwrap();
+        assert_eq!(info.fps, 0.0);
+
+        // no video stream
+        assert_eq!(VideoInfo::parse(""), None);
+    }
+
+    #[test]
+    fn test_pts_time_from_showinfo_line() {
+        let line = "[Parsed_showinfo_2 @ 0x5581c0] [info] n:   3 pts:  12012 pts_time:0.133467 \
+                    duration:   3003 duration_time:0.0333667 fmt:yuv420p";
+        let pts = parse_pts_time(line).unwrap().unwrap();
+        assert!((pts.as_secs_f64() - 0.133467).abs() < 1e-9);
+
+        let line = "[Parsed_showinfo_0 @ 0x5581c0] [info] n:   0 pts:NOPTS pts_time:NOPTS ";
+        assert_eq!(parse_pts_time(line), Some(None));
+        assert_eq!(parse_pts_time("[h264 @ 0x55] [error] corrupt frame"), None);
+    }
+}
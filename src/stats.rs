@@ -0,0 +1,607 @@
+// -- imports
+use serde::{Deserialize, Serialize};
+use std::fmt::Write as _;
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicBool, AtomicI64, AtomicU64, AtomicUsize, Ordering};
+use std::sync::mpsc::{self, Receiver, RecvError, RecvTimeoutError, SendError, SyncSender};
+use std::sync::{Arc, Mutex};
+use std::thread::{Scope, ScopedJoinHandle};
+use std::time::{Duration, Instant};
+
+use crate::error::Result;
+
+// -- recorder
+
+/// Stage names of the five-stage pipelines
+pub const PIPELINE_STAGES: [&str; 5] = ["load", "infer", "annotate", "save", "collect"];
+
+/// Lock-free counters of a pipeline stage (all its threads) and of its input queue
+#[derive(Debug)]
+pub struct StageRecorder {
+    name: &'static str,
+    threads: AtomicUsize,
+    wall_ns: AtomicU64,
+    send_blocked_ns: AtomicU64,
+    recv_blocked_ns: AtomicU64,
+    items_in: AtomicU64,
+    items_out: AtomicU64,
+    queue_capacity: AtomicUsize,
+    queue_depth: AtomicI64,
+    queue_max_depth: AtomicI64,
+    queue_depth_sum: AtomicU64,
+    cache_hits: AtomicU64,
+    cache_misses: AtomicU64,
+    failed: AtomicU64,
+}
+
+fn nanos(duration: Duration) -> u64 {
+    duration.as_nanos().min(u64::MAX as u128) as u64
+}
+
+impl StageRecorder {
+    fn new(name: &'static str) -> Self {
+        Self {
+            name,
+            threads: AtomicUsize::new(0),
+            wall_ns: AtomicU64::new(0),
+            send_blocked_ns: AtomicU64::new(0),
+            recv_blocked_ns: AtomicU64::new(0),
+            items_in: AtomicU64::new(0),
+            items_out: AtomicU64::new(0),
+            queue_capacity: AtomicUsize::new(0),
+            queue_depth: AtomicI64::new(0),
+            queue_max_depth: AtomicI64::new(0),
+            queue_depth_sum: AtomicU64::new(0),
+            cache_hits: AtomicU64::new(0),
+            cache_misses: AtomicU64::new(0),
+            failed: AtomicU64::new(0),
+        }
+    }
+
+    /// Enter the body of one stage thread; its wall time is accounted to this stage until the
+    /// returned guard is dropped.
+    ///
+    /// Busy time is the wall time not spent blocked in [`TimedSender::send`] or
+    /// [`TimedReceiver::recv`].
+    pub fn enter(&self) -> StageGuard<'_> {
+        self.threads.fetch_add(1, Ordering::Relaxed);
+        StageGuard {
+            stage: self,
+            start: Instant::now(),
+        }
+    }
+
+    /// Account work done outside a dedicated thread (sequential inference functions)
+    pub fn time<R>(&self, f: impl FnOnce() -> R) -> R {
+        self.threads.fetch_max(1, Ordering::Relaxed);
+        let start = Instant::now();
+        let result = f();
+        self.wall_ns
+            .fetch_add(nanos(start.elapsed()), Ordering::Relaxed);
+        result
+    }
+
+    /// Account an item processed without a queue (sequential inference functions)
+    pub fn count(&self, items: u64) {
+        self.items_in.fetch_add(items, Ordering::Relaxed);
+        self.items_out.fetch_add(items, Ordering::Relaxed);
+    }
+
+    /// Account result cache lookups of the stage (see `ResultCache`)
+    pub fn count_cache(&self, hits: u64, misses: u64) {
+        self.cache_hits.fetch_add(hits, Ordering::Relaxed);
+        self.cache_misses.fetch_add(misses, Ordering::Relaxed);
+    }
+
+    /// Account items the stage failed on (e.g. images that could not be saved)
+    pub fn count_failed(&self, items: u64) {
+        self.failed.fetch_add(items, Ordering::Relaxed);
+    }
+
+    /// Account time spent waiting for input outside [`TimedReceiver::recv`] (e.g. on a lock
+    /// around a shared receiver)
+    pub fn add_recv_blocked(&self, duration: Duration) {
+        self.recv_blocked_ns
+            .fetch_add(nanos(duration), Ordering::Relaxed);
+    }
+
+    fn snapshot(&self) -> StageStats {
+        let ms = |ns: &AtomicU64| ns.load(Ordering::Relaxed) as f64 / 1e6;
+        let wall_ms = ms(&self.wall_ns);
+        let send_blocked_ms = ms(&self.send_blocked_ns);
+        let recv_blocked_ms = ms(&self.recv_blocked_ns);
+        let items_in = self.items_in.load(Ordering::Relaxed);
+        let depth_sum = self.queue_depth_sum.load(Ordering::Relaxed);
+
+        StageStats {
+            name: self.name.to_string(),
+            threads: self.threads.load(Ordering::Relaxed),
+            items_in,
+            items_out: self.items_out.load(Ordering::Relaxed),
+            busy_ms: (wall_ms - send_blocked_ms - recv_blocked_ms).max(0.0),
+            send_blocked_ms,
+            recv_blocked_ms,
+            queue_capacity: self.queue_capacity.load(Ordering::Relaxed),
+            queue_depth: self.queue_depth.load(Ordering::Relaxed).max(0) as usize,
+            queue_max_depth: self.queue_max_depth.load(Ordering::Relaxed).max(0) as usize,
+            queue_mean_depth: if items_in > 0 {
+                depth_sum as f64 / items_in as f64
+            } else {
+                0.0
+            },
+            cache_hits: self.cache_hits.load(Ordering::Relaxed),
+            cache_misses: self.cache_misses.load(Ordering::Relaxed),
+            failed: self.failed.load(Ordering::Relaxed),
+        }
+    }
+}
+
+/// Accounts the wall time of a stage thread on drop, see [`StageRecorder::enter`]
+#[derive(Debug)]
+pub struct StageGuard<'a> {
+    stage: &'a StageRecorder,
+    start: Instant,
+}
+
+impl Drop for StageGuard<'_> {
+    fn drop(&mut self) {
+        self.stage
+            .wall_ns
+            .fetch_add(nanos(self.start.elapsed()), Ordering::Relaxed);
+    }
+}
+
+/// Collects [`StageRecorder`]s of one pipeline run
+#[derive(Debug)]
+pub struct PipelineRecorder {
+    started: Instant,
+    stages: Vec<StageRecorder>,
+}
+
+impl PipelineRecorder {
+    pub fn new(stage_names: &[&'static str]) -> Self {
+        Self {
+            started: Instant::now(),
+            stages: stage_names.iter().map(|n| StageRecorder::new(n)).collect(),
+        }
+    }
+
+    /// Recorder of the stage called `name`
+    ///
+    /// # Panics
+    ///
+    /// Panics if the pipeline has no such stage.
+    pub fn stage(&self, name: &str) -> &StageRecorder {
+        &self.stages[self.stage_index(name)]
+    }
+
+    fn stage_index(&self, name: &str) -> usize {
+        self.stages
+            .iter()
+            .position(|s| s.name == name)
+            .unwrap_or_else(|| panic!("Unknown pipeline stage: {}", name))
+    }
+
+    /// Account the part of `wall` not yet accounted to any stage to stage `name`
+    ///
+    /// Used by sequential inference functions, where loading happens in the loop header and is
+    /// not timed directly.
+    pub fn add_remainder(&self, name: &str, wall: Duration) {
+        let accounted: u64 = self
+            .stages
+            .iter()
+            .map(|s| s.wall_ns.load(Ordering::Relaxed))
+            .sum();
+        let stage = self.stage(name);
+        stage.threads.fetch_max(1, Ordering::Relaxed);
+        stage
+            .wall_ns
+            .fetch_add(nanos(wall).saturating_sub(accounted), Ordering::Relaxed);
+    }
+
+    /// Current counters of all stages
+    pub fn snapshot(&self) -> PipelineStats {
+        PipelineStats {
+            wall_ms: self.started.elapsed().as_secs_f64() * 1e3,
+            stages: self.stages.iter().map(StageRecorder::snapshot).collect(),
+        }
+    }
+}
+
+// -- instrumented channels
+
+/// `SyncSender` recording blocked-on-send time of the sending stage and the depth of the
+/// receiving stage's input queue
+#[derive(Debug)]
+pub struct TimedSender<T> {
+    tx: SyncSender<T>,
+    recorder: Arc<PipelineRecorder>,
+    from: usize,
+    to: usize,
+}
+
+impl<T> Clone for TimedSender<T> {
+    fn clone(&self) -> Self {
+        Self {
+            tx: self.tx.clone(),
+            recorder: Arc::clone(&self.recorder),
+            from: self.from,
+            to: self.to,
+        }
+    }
+}
+
+impl<T> TimedSender<T> {
+    pub fn send(&self, item: T) -> std::result::Result<(), SendError<T>> {
+        let (from, to) = (
+            &self.recorder.stages[self.from],
+            &self.recorder.stages[self.to],
+        );
+
+        // count the item as queued before sending so the receiver never sees a negative depth
+        let depth = to.queue_depth.fetch_add(1, Ordering::Relaxed) + 1;
+        to.queue_max_depth.fetch_max(depth, Ordering::Relaxed);
+
+        let start = Instant::now();
+        let result = self.tx.send(item);
+        from.send_blocked_ns
+            .fetch_add(nanos(start.elapsed()), Ordering::Relaxed);
+
+        if result.is_ok() {
+            from.items_out.fetch_add(1, Ordering::Relaxed);
+        } else {
+            to.queue_depth.fetch_sub(1, Ordering::Relaxed);
+        }
+        result
+    }
+}
+
+/// `Receiver` recording blocked-on-recv time and input queue depth of the receiving stage
+#[derive(Debug)]
+pub struct TimedReceiver<T> {
+    rx: Receiver<T>,
+    recorder: Arc<PipelineRecorder>,
+    to: usize,
+}
+
+impl<T> TimedReceiver<T> {
+    pub fn recv(&self) -> std::result::Result<T, RecvError> {
+        let start = Instant::now();
+        let result = self.rx.recv();
+        self.on_recv(start, result.is_ok());
+        result
+    }
+
+    pub fn recv_timeout(&self, timeout: Duration) -> std::result::Result<T, RecvTimeoutError> {
+        let start = Instant::now();
+        let result = self.rx.recv_timeout(timeout);
+        self.on_recv(start, result.is_ok());
+        result
+    }
+
+    fn on_recv(&self, start: Instant, received: bool) {
+        let to = &self.recorder.stages[self.to];
+        to.add_recv_blocked(start.elapsed());
+        if received {
+            let depth = to.queue_depth.fetch_sub(1, Ordering::Relaxed);
+            to.queue_depth_sum
+                .fetch_add(depth.max(0) as u64, Ordering::Relaxed);
+            to.items_in.fetch_add(1, Ordering::Relaxed);
+        }
+    }
+}
+
+/// [`TimedReceiver`] shared by the worker threads of one stage.
+///
+/// The lock is only held while waiting for the next item; time spent waiting for the lock counts
+/// as blocked-on-recv.
+#[derive(Debug)]
+pub struct SharedReceiver<T> {
+    rx: Mutex<TimedReceiver<T>>,
+}
+
+impl<T> SharedReceiver<T> {
+    pub fn new(rx: TimedReceiver<T>) -> Self {
+        Self { rx: Mutex::new(rx) }
+    }
+
+    pub fn recv(&self) -> std::result::Result<T, RecvError> {
+        let start = Instant::now();
+        let rx = self.rx.lock().expect("Shared receiver lock poisoned");
+        rx.recorder.stages[rx.to].add_recv_blocked(start.elapsed());
+        rx.recv()
+    }
+}
+
+/// Bounded channel from stage `from` to stage `to` of `recorder`
+///
+/// # Panics
+///
+/// Panics if the pipeline has no such stages.
+pub fn timed_channel<T>(
+    capacity: usize,
+    recorder: &Arc<PipelineRecorder>,
+    from: &str,
+    to: &str,
+) -> (TimedSender<T>, TimedReceiver<T>) {
+    let (from, to) = (recorder.stage_index(from), recorder.stage_index(to));
+    recorder.stages[to]
+        .queue_capacity
+        .store(capacity, Ordering::Relaxed);
+
+    let (tx, rx) = mpsc::sync_channel(capacity);
+    let sender = TimedSender {
+        tx,
+        recorder: Arc::clone(recorder),
+        from,
+        to,
+    };
+    let receiver = TimedReceiver {
+        rx,
+        recorder: Arc::clone(recorder),
+        to,
+    };
+    (sender, receiver)
+}
+
+// -- stats
+
+/// Counters of one pipeline stage.
+///
+/// Times are summed over all threads of the stage, so `busy_ms` can exceed the pipeline wall
+/// time for multi-threaded stages. Queue fields describe the stage's input queue.
+#[derive(Debug, Clone, Default, Serialize)]
+pub struct StageStats {
+    pub name: String,
+    pub threads: usize,
+    pub items_in: u64,
+    pub items_out: u64,
+    pub busy_ms: f64,
+    pub send_blocked_ms: f64,
+    pub recv_blocked_ms: f64,
+    pub queue_capacity: usize,
+    pub queue_depth: usize,
+    pub queue_max_depth: usize,
+    /// Mean queue depth seen by the stage when taking an item
+    pub queue_mean_depth: f64,
+    /// Result cache lookups of the inference stage (0 without a cache)
+    pub cache_hits: u64,
+    pub cache_misses: u64,
+    /// Items the stage failed on, e.g. annotated images that could not be saved
+    pub failed: u64,
+}
+
+/// Per-stage counters of a pipeline run
+#[derive(Debug, Clone, Default, Serialize)]
+pub struct PipelineStats {
+    pub wall_ms: f64,
+    pub stages: Vec<StageStats>,
+}
+
+impl PipelineStats {
+    /// Stage with the largest busy time per thread, i.e. the throughput bottleneck
+    pub fn bottleneck(&self) -> Option<&StageStats> {
+        self.stages.iter().filter(|s| s.threads > 0).max_by(|a, b| {
+            let per_thread = |s: &StageStats| s.busy_ms / s.threads as f64;
+            per_thread(a).total_cmp(&per_thread(b))
+        })
+    }
+
+    pub fn to_json(&self) -> String {
+        serde_json::to_string_pretty(self).expect("Pipeline stats are serializable")
+    }
+
+    /// Render in Prometheus text exposition format
+    pub fn to_prometheus(&self) -> String {
+        let mut out = String::new();
+        let _ = writeln!(out, "# TYPE yolo_pipeline_wall_ms gauge");
+        let _ = writeln!(out, "yolo_pipeline_wall_ms {:.3}", self.wall_ms);
+
+        let metrics: [(&str, &str, fn(&StageStats) -> f64); 13] = [
+            ("threads", "gauge", |s| s.threads as f64),
+            ("items_in_total", "counter", |s| s.items_in as f64),
+            ("items_out_total", "counter", |s| s.items_out as f64),
+            ("busy_ms_total", "counter", |s| s.busy_ms),
+            ("send_blocked_ms_total", "counter", |s| s.send_blocked_ms),
+            ("recv_blocked_ms_total", "counter", |s| s.recv_blocked_ms),
+            ("queue_capacity", "gauge", |s| s.queue_capacity as f64),
+            ("queue_depth", "gauge", |s| s.queue_depth as f64),
+            ("queue_max_depth", "gauge", |s| s.queue_max_depth as f64),
+            ("queue_mean_depth", "gauge", |s| s.queue_mean_depth),
+            ("cache_hits_total", "counter", |s| s.cache_hits as f64),
+            ("cache_misses_total", "counter", |s| s.cache_misses as f64),
+            ("failed_total", "counter", |s| s.failed as f64),
+        ];
+        for (metric, kind, value) in metrics {
+            let _ = writeln!(out, "# TYPE yolo_stage_{} {}", metric, kind);
+            for stage in &self.stages {
+                let _ = writeln!(
+                    out,
+                    "yolo_stage_{}{{stage=\"{}\"}} {}",
+                    metric,
+                    stage.name,
+                    value(stage)
+                );
+            }
+        }
+        out
+    }
+
+    /// Log one line per stage
+    pub fn log(&self) {
+        tracing::info!("Pipeline stats ({:.1} ms wall):", self.wall_ms);
+        for s in &self.stages {
+            tracing::info!(
+                "  {:<9} threads {:>2} | items {:>6} | busy {:>10.1} ms | send-blocked {:>10.1} ms | recv-blocked {:>10.1} ms | queue {}/{} (max {}, mean {:.1})",
+                s.name,
+                s.threads,
+                s.items_in.max(s.items_out),
+                s.busy_ms,
+                s.send_blocked_ms,
+                s.recv_blocked_ms,
+                s.queue_depth,
+                s.queue_capacity,
+                s.queue_max_depth,
+                s.queue_mean_depth,
+            );
+            let lookups = s.cache_hits + s.cache_misses;
+            if lookups > 0 {
+                tracing::info!(
+                    "  {:<9} cache hits {} / {} ({:.1}%)",
+                    "",
+                    s.cache_hits,
+                    lookups,
+                    s.cache_hits as f64 * 100.0 / lookups as f64
+                );
+            }
+            if s.failed > 0 {
+                tracing::info!("  {:<9} failed {}", "", s.failed);
+            }
+        }
+        if let Some(b) = self.bottleneck() {
+            tracing::info!("  bottleneck: {}", b.name);
+        }
+    }
+}
+
+// -- export
+
+/// Format of periodic stats export
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Deserialize)]
+#[serde(rename_all = "lowercase")]
+pub enum StatsFormat {
+    Json,
+    Prometheus,
+}
+
+/// Write a stats snapshot to `path` (via a temporary file, so readers never see partial output)
+pub fn write_stats(stats: &PipelineStats, format: StatsFormat, path: &Path) -> Result<()> {
+    let content = match format {
+        StatsFormat::Json => stats.to_json(),
+        StatsFormat::Prometheus => stats.to_prometheus(),
+    };
+    if let Some(parent) = path.parent() {
+        std::fs::create_dir_all(parent)?;
+    }
+    let tmp_path = path.with_extension("tmp");
+    std::fs::write(&tmp_path, content)?;
+    std::fs::rename(&tmp_path, path)?;
+    Ok(())
+}
+
+/// Spawn a scoped thread running [`StatsExport::run`], if export is configured
+pub fn spawn_exporter<'scope, 'env>(
+    s: &'scope Scope<'scope, 'env>,
+    export: Option<StatsExport>,
+    recorder: &'env PipelineRecorder,
+    done: &'env AtomicBool,
+) -> Option<ScopedJoinHandle<'scope, ()>> {
+    export.map(|export| s.spawn(move || export.run(recorder, done)))
+}
+
+/// Sets the `done` flag of a stats exporter when dropped, so the exporter also stops (and its
+/// scope can return) while a panicking stage unwinds the pipeline
+pub struct DoneOnDrop<'a>(pub &'a AtomicBool);
+
+impl Drop for DoneOnDrop<'_> {
+    fn drop(&mut self) {
+        self.0.store(true, Ordering::Release);
+    }
+}
+
+/// Periodic stats export settings
+#[derive(Debug, Clone)]
+pub struct StatsExport {
+    pub format: StatsFormat,
+    pub path: PathBuf,
+    pub interval: Duration,
+}
+
+impl StatsExport {
+    /// Export `recorder` snapshots every `interval` until `done` is set, then once more.
+    pub fn run(&self, recorder: &PipelineRecorder, done: &AtomicBool) {
+        let step = self.interval.min(Duration::from_millis(50));
+        let mut last = Instant::now();
+        while !done.load(Ordering::Acquire) {
+            std::thread::sleep(step);
+            if last.elapsed() >= self.interval {
+                self.export(recorder);
+                last = Instant::now();
+            }
+        }
+        self.export(recorder);
+    }
+
+    fn export(&self, recorder: &PipelineRecorder) {
+        if let Err(e) = write_stats(&recorder.snapshot(), self.format, &self.path) {
+            tracing::error!("Failed to export pipeline stats to {:?}: {}", self.path, e);
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_timed_channel_counts_items_and_queue_depth() {
+        let recorder = Arc::new(PipelineRecorder::new(&PIPELINE_STAGES));
+        let (tx, rx) = timed_channel::<usize>(4, &recorder, "load", "infer");
+        let (load, infer) = (recorder.stage("load"), recorder.stage("infer"));
+
+        {
+            let _stage = load.enter();
+            for i in 0..3 {
+                tx.send(i).unwrap();
+            }
+        }
+        drop(tx);
+        {
+            let _stage = infer.enter();
+            while rx.recv().is_ok() {}
+        }
+
+        let stats = recorder.snapshot();
+        let (load, infer) = (&stats.stages[0], &stats.stages[1]);
+        assert_eq!(load.items_out, 3);
+        assert_eq!(infer.items_in, 3);
+        assert_eq!(infer.queue_capacity, 4);
+        assert_eq!(infer.queue_max_depth, 3);
+        assert_eq!(infer.queue_depth, 0);
+        // depths seen when receiving: 3, 2, 1
+        assert_eq!(infer.queue_mean_depth, 2.0);
+        assert_eq!(infer.threads, 1);
+    }
+
+    #[test]
+    fn test_exporter_stops_when_a_stage_panics() {
+        let recorder = PipelineRecorder::new(&PIPELINE_STAGES);
+        let done = AtomicBool::new(false);
+        let dir = tempfile::tempdir().unwrap();
+        let export = StatsExport {
+            format: StatsFormat::Json,
+            path: dir.path().join("stats.json"),
+            interval: Duration::from_millis(10),
+        };
+
+        let unwound = std::panic::catch_unwind(std::panic::AssertUnwindSafe(|| {
+            std::thread::scope(|s| {
+                let _exporter = spawn_exporter(s, Some(export), &recorder, &done);
+                let _stop_exporter = DoneOnDrop(&done);
+                panic!("stage panicked");
+            })
+        }));
+        assert!(unwound.is_err());
+        assert!(done.load(Ordering::Acquire));
+    }
+
+    #[test]
+    fn test_prometheus_export_has_stage_labels() {
+        let recorder = PipelineRecorder::new(&PIPELINE_STAGES);
+        recorder.stage("annotate").count(2);
+        let text = recorder.snapshot().to_prometheus();
+
+        assert!(text.contains("yolo_stage_items_in_total{stage=\"annotate\"} 2"));
+        assert!(text.contains("# TYPE yolo_stage_busy_ms_total counter"));
+    }
+}
@@ -0,0 +1,369 @@
+//! CPU thread budget shared by the pipeline stages and ONNX Runtime (see
+//! `PredictArgs::cpu_threads` and `PredictArgs::pin_threads`).
+//!
+//! The budget is split into disjoint core sets: one per inference replica, then the decode,
+//! annotation and save pools, then a control core for the load, batching, reorder, save and
+//! collect threads. Cores are taken NUMA node by node; with several nodes, replica `i` gets its
+//! cores from node `i % nodes`, so each replica and the memory it touches stay on one socket.
+//!
+//! ONNX Runtime sizes and spawns its intra-op (and, in parallel execution mode, inter-op) pools
+//! itself when a session is created; `ultralytics-inference` exposes no thread settings.
+//! With pinning, sessions are created on a thread pinned to the cores of their replica, and
+//! the pool threads inherit that affinity. Pinning needs Linux and the `affinity` feature.
+
+// -- imports
+use rayon::ThreadPoolBuilder;
+use std::collections::VecDeque;
+
+use crate::predict::PredictArgs;
+
+/// Pipeline stage owning a core set of the budget
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Stage {
+    /// Inference threads and ONNX Runtime pools of a model replica
+    Infer(usize),
+    Decode,
+    Annotate,
+    /// Encoding pool of `save_workers`
+    Save,
+    /// Load, batching, reorder, save and collect threads
+    Control,
+}
+
+/// Cores requested per stage, before placement
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+struct Shares {
+    /// Inference replicas
+    replicas: usize,
+    /// Inference runs on the CPU, so it gets most of the budget
+    cpu_infer: bool,
+    annotating: bool,
+    decode: Option<usize>,
+    annotate: Option<usize>,
+    save: Option<usize>,
+}
+
+/// Split of a CPU budget between pipeline stages.
+///
+/// The default budget is empty: stages keep their own thread counts and nothing is pinned.
+#[derive(Debug, Clone, Default, PartialEq, Eq)]
+pub struct ThreadBudget {
+    infer: Vec<Vec<usize>>,
+    decode: Vec<usize>,
+    annotate: Vec<usize>,
+    save: Vec<usize>,
+    control: Vec<usize>,
+    pin: bool,
+    /// `pin_threads` is set but not supported by this build
+    pin_unsupported: bool,
+}
+
+impl ThreadBudget {
+    /// Budget configured by `cpu_threads`, empty if it is unset.
+    ///
+    /// Computed once per run and passed to its model loading and pipeline stages.
+    pub fn from_args(args: &PredictArgs) -> Self {
+        let Some(total) = args.cpu_threads.filter(|&n| n > 0) else {
+            if args.pin_threads {
+                tracing::warn!("pin_threads needs a cpu_threads budget, threads not pinned");
+            }
+            return Self::default();
+        };
+        let devices = args.replica_devices();
+        let shares = Shares {
+            replicas: devices.len(),
+            cpu_infer: devices
+                .iter()
+                .all(|d| d.as_deref().is_none_or(|d| d.starts_with("cpu"))),
+            annotating: args.annotate,
+            decode: args.decode_workers.filter(|&n| n > 0),
+            annotate: args.annotate_workers.filter(|&n| n > 0),
+            save: args.save_workers.filter(|&n| n > 0),
+        };
+        let mut budget = Self::plan(&numa_nodes(), total, shares);
+        budget.pin = args.pin_threads && affinity::supported();
+        budget.pin_unsupported = args.pin_threads && !affinity::supported();
+        budget
+    }
+
+    /// Place the stages of `shares` on the first `total` cores of `nodes`
+    fn plan(nodes: &[Vec<usize>], total: usize, shares: Shares) -> Self {
+        let mut left = total.min(nodes.iter().map(Vec::len).sum()).max(1);
+        let mut free: Vec<VecDeque<usize>> = nodes
+            .iter()
+            .map(|node| {
+                let take = node.len().min(left);
+                left -= take;
+                node[..take].iter().copied().collect()
+            })
+            .filter(|node: &VecDeque<usize>| !node.is_empty())
+            .collect();
+        let cores: Vec<usize> = free.iter().flatten().copied().collect();
+        let n = cores.len();
+
+        // core counts; stages share cores once the budget runs out
+        let control = 1;
+        let auto = |cpu_share: usize, gpu_share: usize| {
+            if shares.cpu_infer {
+                n / cpu_share
+            } else {
+                n / gpu_share
+            }
+        };
+        let decode = shares.decode.unwrap_or(auto(8, 4)).max(1);
+        let annotate = if shares.annotating {
+            shares.annotate.unwrap_or(auto(16, 8)).max(1)
+        } else {
+            0
+        };
+        let save = shares.save.unwrap_or(0);
+        let replicas = shares.replicas.max(1);
+        let infer = n
+            .saturating_sub(control + decode + annotate + save)
+            .max(replicas);
+
+        let mut wrap = cores.iter().copied().cycle();
+        let mut take = |from: &mut [VecDeque<usize>], count: usize, first: usize| {
+            (0..count)
+                .map(|_| {
+                    (0..from.len())
+                        .find_map(|i| from[(first + i) % from.len()].pop_front())
+                        .or_else(|| wrap.next())
+                        .expect("Budget has at least one core")
+                })
+                .collect::<Vec<usize>>()
+        };
+
+        let infer = (0..replicas)
+            .map(|i| {
+                let (count, node) = (
+                    infer / replicas + usize::from(i < infer % replicas),
+                    i % free.len(),
+                );
+                take(&mut free, count, node)
+            })
+            .collect();
+        Self {
+            infer,
+            decode: take(&mut free, decode, 0),
+            annotate: take(&mut free, annotate, 0),
+            save: take(&mut free, save, 0),
+            control: take(&mut free, control, 0),
+            pin: false,
+            pin_unsupported: false,
+        }
+    }
+
+    /// Whether `cpu_threads` is set
+    pub fn is_set(&self) -> bool {
+        !self.infer.is_empty()
+    }
+
+    /// Cores of `stage`, empty without a budget
+    pub fn cpus(&self, stage: Stage) -> &[usize] {
+        match stage {
+            Stage::Infer(i) if !self.infer.is_empty() => &self.infer[i % self.infer.len()],
+            Stage::Infer(_) => &[],
+            Stage::Decode => &self.decode,
+            Stage::Annotate => &self.annotate,
+            Stage::Save => &self.save,
+            Stage::Control => &self.control,
+        }
+    }
+
+    /// Threads of a stage pool sized by the budget, `None` without a budget
+    pub fn workers(&self, stage: Stage) -> Option<usize> {
+        self.is_set()
+            .then(|| self.cpus(stage).len())
+            .filter(|&n| n > 0)
+    }
+
+    /// Cores to pin the threads of `stage` to, `None` if pinning is off
+    pub fn pinned(&self, stage: Stage) -> Option<Vec<usize>> {
+        self.pin.then(|| self.cpus(stage).to_vec())
+    }
+
+    /// Pin the calling thread to the cores of `stage`, if pinning is on
+    pub fn pin(&self, stage: Stage) {
+        if let Some(cpus) = self.pinned(stage) {
+            pin_current_thread(&cpus);
+        }
+    }
+
+    /// Run `f` on the calling thread pinned to the cores of `stage`, then restore its affinity.
+    /// Threads spawned by `f`, such as the pools of an ONNX Runtime session, keep the cores.
+    pub fn while_pinned<R>(&self, stage: Stage, f: impl FnOnce() -> R) -> R {
+        let previous = self.pin.then(affinity::get).flatten();
+        self.pin(stage);
+        let result = f();
+        if let Some(previous) = previous {
+            pin_current_thread(&previous);
+        }
+        result
+    }
+
+    /// Log the core sets of the stages
+    pub fn log(&self) {
+        if !self.is_set() {
+            return;
+        }
+        if self.pin_unsupported {
+            tracing::warn!(
+                "pin_threads needs Linux and the `affinity` feature, threads not pinned"
+            );
+        }
+        tracing::info!(
+            "Thread budget{}: infer {:?}, decode {:?}, annotate {:?}, save {:?}, control {:?}",
+            if self.pin { " (pinned)" } else { "" },
+            self.infer,
+            self.decode,
+            self.annotate,
+            self.save,
+            self.control
+        );
+    }
+}
+
+/// Pin the calling thread to `cpus`; failures are logged
+pub fn pin_current_thread(cpus: &[usize]) {
+    if !cpus.is_empty() && !affinity::set(cpus) {
+        tracing::warn!("Failed to pin thread to cores {:?}", cpus);
+    }
+}
+
+/// Pin the threads of a rayon pool to `cpus` as they start
+pub fn pin_pool(builder: ThreadPoolBuilder, cpus: Option<Vec<usize>>) -> ThreadPoolBuilder {
+    match cpus {
+        Some(cpus) if !cpus.is_empty() => builder.start_handler(move |_| pin_current_thread(&cpus)),
+        _ => builder,
+    }
+}
+
+/// Usable cores grouped by NUMA node, in node order
+fn numa_nodes() -> Vec<Vec<usize>> {
+    let allowed = affinity::get().unwrap_or_else(|| {
+        let n = std::thread::available_parallelism().map_or(1, |n| n.get());
+        (0..n).collect()
+    });
+
+    let mut nodes: Vec<(usize, Vec<usize>)> = std::fs::read_dir("/sys/devices/system/node")
+        .into_iter()
+        .flatten()
+        .flatten()
+        .filter_map(|entry| {
+            let name = entry.file_name();
+            let id = name.to_str()?.strip_prefix("node")?.parse().ok()?;
+            let list = std::fs::read_to_string(entry.path().join("cpulist")).ok()?;
+            let cpus: Vec<usize> = parse_cpu_list(&list)
+                .into_iter()
+                .filter(|c| allowed.contains(c))
+                .collect();
+            (!cpus.is_empty()).then_some((id, cpus))
+        })
+        .collect();
+    nodes.sort_unstable();
+
+    if nodes.is_empty() {
+        vec![allowed]
+    } else {
+        nodes.into_iter().map(|(_, cpus)| cpus).collect()
+    }
+}
+
+/// Parse a kernel CPU list such as `0-7,16-23`
+fn parse_cpu_list(list: &str) -> Vec<usize> {
+    list.trim()
+        .split(',')
+        .filter_map(|range| match range.split_once('-') {
+            Some((a, b)) => Some(a.parse().ok()?..=b.parse().ok()?),
+            None => range.parse().ok().map(|c| c..=c),
+        })
+        .flatten()
+        .collect()
+}
+
+#[cfg(all(target_os = "linux", feature = "affinity"))]
+mod affinity {
+    use std::mem::{size_of, zeroed};
+
+    pub const fn supported() -> bool {
+        true
+    }
+
+    /// Cores the calling thread may run on
+    pub fn get() -> Option<Vec<usize>> {
+        // SAFETY: `set` is a plain bit set owned by this frame
+        unsafe {
+            let mut set: libc::cpu_set_t = zeroed();
+            if libc::sched_getaffinity(0, size_of::<libc::cpu_set_t>(), &mut set) != 0 {
+                return None;
+            }
+            Some(
+                (0..libc::CPU_SETSIZE as usize)
+                    .filter(|&cpu| libc::CPU_ISSET(cpu, &set))
+                    .collect(),
+            )
+        }
+    }
+
+    /// Restrict the calling thread to `cpus`
+    pub fn set(cpus: &[usize]) -> bool {
+        // SAFETY: `set` is a plain bit set owned by this frame; cores beyond its size are skipped
+        unsafe {
+            let mut set: libc::cpu_set_t = zeroed();
+            libc::CPU_ZERO(&mut set);
+            for &cpu in cpus.iter().filter(|&&c| c < libc::CPU_SETSIZE as usize) {
+                libc::CPU_SET(cpu, &mut set);
+            }
+            libc::sched_setaffinity(0, size_of::<libc::cpu_set_t>(), &set) == 0
+        }
+    }
+}
+
+#[cfg(not(all(target_os = "linux", feature = "affinity")))]
+mod affinity {
+    pub const fn supported() -> bool {
+        false
+    }
+
+    pub fn get() -> Option<Vec<usize>> {
+        None
+    }
+
+    pub fn set(_cpus: &[usize]) -> bool {
+        false
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_plan_keeps_replicas_on_their_numa_node() {
+        assert_eq!(parse_cpu_list("0-3,8\n"), vec![0, 1, 2, 3, 8]);
+
+        let nodes = [(0..8).collect(), (8..16).collect()];
+        let shares = Shares {
+            replicas: 2,
+            cpu_infer: true,
+            annotating: true,
+            decode: None,
+            annotate: None,
+            save: None,
+        };
+        let budget = ThreadBudget::plan(&nodes, 16, shares);
+        assert_eq!(budget.cpus(Stage::Infer(0)), &[0, 1, 2, 3, 4, 5]);
+        assert_eq!(budget.cpus(Stage::Infer(1)), &[8, 9, 10, 11, 12, 13]);
+        assert_eq!(budget.cpus(Stage::Decode), &[6, 7]);
+        assert_eq!(budget.cpus(Stage::Annotate), &[14]);
+        assert_eq!(budget.cpus(Stage::Control), &[15]);
+        assert_eq!(budget.workers(Stage::Save), None);
+
+        // a budget smaller than the stages shares cores
+        let budget = ThreadBudget::plan(&nodes, 2, shares);
+        assert_eq!(budget.cpus(Stage::Infer(0)), &[0]);
+        assert_eq!(budget.cpus(Stage::Infer(1)), &[1]);
+        assert_eq!(budget.cpus(Stage::Decode), &[0]);
+    }
+}
@@ -68,6 +68,8 @@ impl TomlConfig {
             Source::None => Source::None,
             Source::ImagePath(p) if !p.is_absolute() => Source::ImagePath(project_root.join(p)),
             Source::Directory(p) if !p.is_absolute() => Source::Directory(project_root.join(p)),
+            Source::Manifest(p) if !p.is_absolute() => Source::Manifest(project_root.join(p)),
+            Source::Video(p) if !p.is_absolute() => Source::Video(project_root.join(p)),
             _ => self.predict.source.clone(),
         };
 
@@ -77,6 +79,34 @@ impl TomlConfig {
                 *save_dir = project_root.join(save_dir.as_path());
             }
         }
+
+        // Resolve engine_cache_dir
+        if let Some(ref mut cache_dir) = self.predict.engine_cache_dir {
+            if !cache_dir.is_absolute() {
+                *cache_dir = project_root.join(cache_dir.as_path());
+            }
+        }
+
+        // Resolve cache_dir
+        if let Some(ref mut cache_dir) = self.predict.cache_dir {
+            if !cache_dir.is_absolute() {
+                *cache_dir = project_root.join(cache_dir.as_path());
+            }
+        }
+
+        // Resolve result_file
+        if let Some(ref mut result_file) = self.predict.result_file {
+            if !result_file.is_absolute() {
+                *result_file = project_root.join(result_file.as_path());
+            }
+        }
+
+        // Resolve stats_path
+        if let Some(ref mut stats_path) = self.predict.stats_path {
+            if !stats_path.is_absolute() {
+                *stats_path = project_root.join(stats_path.as_path());
+            }
+        }
     }
 }
 
@@ -170,6 +200,57 @@ show_box = true
         assert!(args.annotate_cfg.show_box);
     }
 
+    #[test]
+    fn test_parse_toml_dynamic_batch_pipeline() {
+        let temp_dir = TempDir::new().unwrap();
+        let toml_path = temp_dir.path().join("config.toml");
+        let toml_content = r#"
+[predict]
+model = "test.onnx"
+batch = 16
+infer_fn = "DynamicBatchPipeline"
+max_wait_us = 500
+"#;
+        fs::write(&toml_path, toml_content).unwrap();
+
+        let args = parse_toml(&toml_path, temp_dir.path()).unwrap();
+
+        assert!(matches!(
+            args.infer_fn,
+            crate::InferFn::DynamicBatchPipeline
+        ));
+        assert_eq!(args.batch, Some(16));
+        assert_eq!(args.max_wait_us, Some(500));
+    }
+
+    #[test]
+    fn test_parse_toml_device_list_and_replicas() {
+        let temp_dir = TempDir::new().unwrap();
+        let toml_path = temp_dir.path().join("config.toml");
+        let toml_content = r#"
+[predict]
+model = "test.onnx"
+device = ["cuda:0", "cuda:1"]
+replicas = 3
+"#;
+        fs::write(&toml_path, toml_content).unwrap();
+
+        let args = parse_toml(&toml_path, temp_dir.path()).unwrap();
+
+        assert_eq!(args.device.as_deref(), Some("cuda:0,cuda:1"));
+        assert_eq!(
+            args.devices(),
+            vec![
+                Some("cuda:0".to_string()),
+                Some("cuda:1".to_string()),
+                Some("cuda:0".to_string())
+            ]
+        );
+
+        let args = crate::PredictArgs::default();
+        assert_eq!(args.devices(), vec![None]);
+    }
+
     #[test]
     fn test_from_toml_invalid_path() {
         let invalid_path = PathBuf::from("/nonexistent/config.toml");
@@ -0,0 +1,361 @@
+// -- imports
+use image::DynamicImage;
+use serde::{Deserialize, Serialize};
+use std::collections::{BTreeMap, BTreeSet};
+use std::path::{Path, PathBuf};
+use std::sync::{Mutex, OnceLock};
+use std::time::{Instant, UNIX_EPOCH};
+use ultralytics_inference as ul;
+
+use crate::error::{AppError, Result};
+use crate::model_meta::onnx_static_batch;
+use crate::predict::PredictArgs;
+use crate::result_cache::stable_hash;
+
+/// Warmup frame side when `imgsz` is unset
+const DEFAULT_WARMUP_SIZE: u32 = 640;
+
+// -- batchability
+
+/// Models found to reject batched input by the startup probe
+static UNBATCHABLE: Mutex<BTreeSet<PathBuf>> = Mutex::new(BTreeSet::new());
+
+/// Batch size to start from for models whose full warmup batch failed for another reason (e.g.
+/// out of memory); the adaptive batch size grows back from there
+static START_BATCH: Mutex<BTreeMap<PathBuf, usize>> = Mutex::new(BTreeMap::new());
+
+/// Static batch dimension of each model read so far (`None`: dynamic)
+static STATIC_BATCH: Mutex<BTreeMap<PathBuf, Option<usize>>> = Mutex::new(BTreeMap::new());
+
+/// Static batch dimension of the input of `model`, read once per process
+fn static_batch(model: &Path) -> Option<usize> {
+    let mut static_batch = STATIC_BATCH.lock().expect("Batchability lock poisoned");
+    *static_batch.entry(model.to_path_buf()).or_insert_with(|| {
+        onnx_static_batch(model).unwrap_or_else(|e| {
+            tracing::debug!("Failed to read the input shape of {:?}: {}", model, e);
+            None
+        })
+    })
+}
+
+/// Whether `model` is known to reject batched input: its input has a static batch dimension
+/// of 1, or the startup probe failed
+pub fn is_unbatchable(model: &Path) -> bool {
+    static_batch(model) == Some(1)
+        || UNBATCHABLE
+            .lock()
+            .expect("Batchability lock poisoned")
+            .contains(model)
+}
+
+/// Largest batch `model` takes when `batch` frames are configured per batch
+pub fn max_batch_size(model: &Path, batch: usize) -> usize {
+    if is_unbatchable(model) {
+        return 1;
+    }
+    static_batch(model)
+        .map_or(batch, |limit| batch.min(limit))
+        .max(1)
+}
+
+/// Remember that `model` rejects batched input, for later pipelines of this process
+pub fn mark_unbatchable(model: &Path) {
+    UNBATCHABLE
+        .lock()
+        .expect("Batchability lock poisoned")
+        .insert(model.to_path_buf());
+}
+
+/// Batch size the inference stages of `model` start from, at most `max`
+pub fn start_batch_size(model: &Path, max: usize) -> usize {
+    START_BATCH
+        .lock()
+        .expect("Batchability lock poisoned")
+        .get(model)
+        .map_or(max, |&start| start.min(max))
+        .max(1)
+}
+
+/// Start later pipelines of `model` with batches of `start` frames
+fn set_start_batch_size(model: &Path, start: usize) {
+    START_BATCH
+        .lock()
+        .expect("Batchability lock poisoned")
+        .insert(model.to_path_buf(), start);
+}
+
+/// Whether an inference error means the input shape was rejected, as opposed to failures that
+/// may pass with a smaller batch or later (e.g. out of memory)
+fn is_shape_error(message: &str) -> bool {
+    let message = message.to_lowercase();
+    message.contains("dimension") || message.contains("shape")
+}
+
+/// Batchability probe result, cached next to the TensorRT engines.
+///
+/// The probe is only reused for the same model file (size and modification time) and the same
+/// `batch`, `imgsz` and `half` settings.
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+struct BatchProbe {
+    model_len: u64,
+    model_modified: u64,
+    batch: usize,
+    imgsz: Option<usize>,
+    half: bool,
+    /// `false` only if the model rejected the shape of a batched input
+    batchable: bool,
+    /// Largest batch that passed the probe
+    start_batch: usize,
+}
+
+impl BatchProbe {
+    /// Probe key of the model and settings of `args`, with an unknown result
+    fn key(args: &PredictArgs) -> Result<Self> {
+        let metadata = std::fs::metadata(&args.model)?;
+        let model_modified = metadata
+            .modified()?
+            .duration_since(UNIX_EPOCH)
+            .map_or(0, |d| d.as_secs());
+        Ok(Self {
+            model_len: metadata.len(),
+            model_modified,
+            batch: args.batch.unwrap_or(1),
+            imgsz: args.imgsz,
+            half: args.half,
+            batchable: true,
+            start_batch: args.batch.unwrap_or(1).max(1),
+        })
+    }
+
+    /// Cache file of `model` in `cache_dir`, keyed by its stem and canonical path (models of
+    /// the same name in different directories get their own probe)
+    fn path(cache_dir: &Path, model: &Path) -> PathBuf {
+        let stem = model.file_stem().unwrap_or_default().to_string_lossy();
+        let canonical = model.canonicalize().unwrap_or_else(|_| model.to_path_buf());
+        let hash = stable_hash(canonical.as_os_str().as_encoded_bytes());
+        cache_dir.join(format!("{}-{:016x}.probe.json", stem, hash))
+    }
+
+    /// Cached probe result matching `key`, if any
+    fn load(cache_dir: &Path, model: &Path, key: &Self) -> Option<Self> {
+        let content = std::fs::read_to_string(Self::path(cache_dir, model)).ok()?;
+        let cached: Self = serde_json::from_str(&content).ok()?;
+        let fresh = Self {
+            batchable: cached.batchable,
+            start_batch: cached.start_batch,
+            ..key.clone()
+        };
+        (cached == fresh).then_some(cached)
+    }
+
+    /// Store this probe result in `cache_dir`
+    fn save(&self, cache_dir: &Path, model: &Path) -> Result<()> {
+        let content = serde_json::to_string_pretty(self)
+            .map_err(|e| AppError::Config(format!("Failed to serialize batch probe: {}", e)))?;
+        std::fs::write(Self::path(cache_dir, model), content)?;
+        Ok(())
+    }
+}
+
+// -- engine cache
+
+/// Engine cache directory of this process, set by the first [`configure_engine_cache`]
+static ENGINE_CACHE: OnceLock<PathBuf> = OnceLock::new();
+
+/// Point the TensorRT execution provider at `cache_dir` for serialized engines and timing
+/// caches, so only the first run builds them. Variables already set in the environment are
+/// left as they are.
+///
+/// The execution provider only reads these variables from the environment, so they are set
+/// once per process, by the first call (before the first model session is created); later
+/// calls asking for another directory keep the first one and warn.
+pub fn configure_engine_cache(cache_dir: &Path) -> Result<()> {
+    std::fs::create_dir_all(cache_dir)?;
+    let cache_dir = cache_dir.canonicalize()?;
+    let configured = ENGINE_CACHE.get_or_init(|| {
+        let cache_path = cache_dir.to_string_lossy().into_owned();
+        for (key, value) in [
+            ("ORT_TENSORRT_ENGINE_CACHE_ENABLE", "1"),
+            ("ORT_TENSORRT_TIMING_CACHE_ENABLE", "1"),
+            ("ORT_TENSORRT_CACHE_PATH", cache_path.as_str()),
+        ] {
+            if std::env::var_os(key).is_none() {
+                // SAFETY: runs once per process (inside `get_or_init`), at the first model
+                // load: no ONNX Runtime session or pipeline thread of this crate exists yet
+                // that could read the environment concurrently. Embedding applications must
+                // load their first model before starting threads that touch the environment.
+                unsafe { std::env::set_var(key, value) };
+            }
+        }
+        tracing::info!("TensorRT engine cache: {:?}", cache_dir);
+        cache_dir.clone()
+    });
+    if *configured != cache_dir {
+        tracing::warn!(
+            "TensorRT engine cache is already set to {:?} for this process, ignoring {:?}",
+            configured,
+            cache_dir
+        );
+    }
+    Ok(())
+}
+
+// -- warmup
+
+/// Startup phase of freshly loaded model replicas.
+///
+/// Runs `warmup_iters` batches of blank `batch` x `imgsz` frames through every replica, so
+/// engine builds and kernel autotuning happen before the first real request. The first batch
+/// also probes whether the model accepts batched input (unless its input shape already tells,
+/// see [`is_unbatchable`]); with `engine_cache_dir` set the probe
+/// runs even without warmup iterations, and its result is cached there for later runs.
+///
+/// Only a rejected input shape marks the model unbatchable. Other failures of the probe batch
+/// halve it until it passes, and the inference stages start from that size (see
+/// [`start_batch_size`]).
+pub fn warmup_models(models: &mut [ul::YOLOModel], args: &PredictArgs) -> Result<()> {
+    let iters = args.warmup_iters.unwrap_or(0);
+    let cache_dir = args.engine_cache_dir.as_deref();
+    if iters == 0 && cache_dir.is_none() {
+        return Ok(());
+    }
+
+    let key = BatchProbe::key(args)?;
+    let cached = cache_dir.and_then(|dir| BatchProbe::load(dir, &args.model, &key));
+    let mut batchable = if is_unbatchable(&args.model) {
+        Some(false)
+    } else {
+        cached.as_ref().map(|probe| probe.batchable)
+    };
+    let probe_cached = batchable.is_some();
+    if batchable == Some(false) {
+        mark_unbatchable(&args.model);
+    }
+    // a static batch dimension caps the probe batch, see `max_batch_size`
+    let mut limit = cached
+        .map_or(key.start_batch, |probe| probe.start_batch)
+        .clamp(1, max_batch_size(&args.model, key.start_batch));
+
+    let size = args.imgsz.map_or(DEFAULT_WARMUP_SIZE, |sz| sz as u32);
+    let images = vec![DynamicImage::new_rgb8(size, size); key.batch.max(1)];
+    let pseudo_paths = vec!["".to_string(); images.len()];
+
+    for (replica_idx, model) in models.iter_mut().enumerate() {
+        let runs = if batchable.is_none() {
+            iters.max(1)
+        } else {
+            iters
+        };
+        let start = Instant::now();
+        'runs: for _ in 0..runs {
+            while batchable != Some(false) {
+                match model.predict_batch(&images[..limit], &pseudo_paths[..limit]) {
+                    Ok(_) => {
+                        batchable = Some(true);
+                        continue 'runs;
+                    }
+                    Err(e) if is_shape_error(&e.to_string()) => {
+                        tracing::warn!(
+                            "Model does not accept batched input, using per-image inference"
+                        );
+                        tracing::debug!("> Error details: {:?}", e);
+                        batchable = Some(false);
+                        mark_unbatchable(&args.model);
+                    }
+                    Err(e) if limit > 1 => {
+                        limit /= 2;
+                        tracing::warn!("Warmup batch failed, starting with batches of {}", limit);
+                        tracing::debug!("> Error details: {:?}", e);
+                    }
+                    Err(e) => {
+                        return Err(AppError::Inference(format!(
+                            "Warmup inference failed: {}",
+                            e
+                        )));
+                    }
+                }
+            }
+            model
+                .predict_image(&images[0], "".to_string())
+                .map_err(|e| AppError::Inference(format!("Warmup inference failed: {}", e)))?;
+        }
+        if runs > 0 {
+            tracing::info!(
+                "Warmed up replica {} with {} batches in {:.3?}",
+                replica_idx,
+                runs,
+                start.elapsed()
+            );
+        }
+    }
+
+    if limit < key.start_batch {
+        set_start_batch_size(&args.model, limit);
+    }
+    if let (Some(dir), Some(batchable), false) = (cache_dir, batchable, probe_cached) {
+        let probe = BatchProbe {
+            batchable,
+            start_batch: limit,
+            ..key
+        };
+        if let Err(e) = probe.save(dir, &args.model) {
+            tracing::warn!("Failed to cache batch probe in {:?}: {}", dir, e);
+        }
+    }
+    Ok(())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_batch_probe_cache_matches_model_and_settings() {
+        let dir = tempfile::tempdir().unwrap();
+        let model = dir.path().join("model.onnx");
+        std::fs::write(&model, b"onnx").unwrap();
+        let mut args = PredictArgs {
+            model: model.clone(),
+            batch: Some(8),
+            ..Default::default()
+        };
+
+        let key = BatchProbe::key(&args).unwrap();
+        assert_eq!(BatchProbe::load(dir.path(), &model, &key), None);
+        let probe = BatchProbe {
+            batchable: false,
+            ..key
+        };
+        probe.save(dir.path(), &model).unwrap();
+        let key = BatchProbe::key(&args).unwrap();
+        let cached = BatchProbe::load(dir.path(), &model, &key).unwrap();
+        assert!(!cached.batchable);
+
+        // another batch size invalidates the cached probe
+        args.batch = Some(4);
+        let key = BatchProbe::key(&args).unwrap();
+        assert_eq!(BatchProbe::load(dir.path(), &model, &key), None);
+
+        // a model of the same name elsewhere has its own probe
+        let other = dir.path().join("other").join("model.onnx");
+        assert_ne!(
+            BatchProbe::path(dir.path(), &model),
+            BatchProbe::path(dir.path(), &other)
+        );
+    }
+
+    #[test]
+    fn test_only_shape_errors_mark_unbatchable() {
+        assert!(is_shape_error(
+            "Got invalid dimensions for input: images for the following indices \
+             index: 0 Got: 8 Expected: 1"
+        ));
+        assert!(!is_shape_error("CUDA failure 2: out of memory"));
+
+        let model = Path::new("start_batch_test.onnx");
+        assert_eq!(start_batch_size(model, 8), 8);
+        set_start_batch_size(model, 2);
+        assert_eq!(start_batch_size(model, 8), 2);
+        assert_eq!(start_batch_size(model, 1), 1);
+    }
+}
@@ -0,0 +1,348 @@
+// -- imports
+use image::DynamicImage;
+use image::codecs::jpeg::JpegEncoder;
+use image::codecs::png::{CompressionType, FilterType, PngEncoder};
+use image::codecs::qoi::QoiEncoder;
+use rayon::ThreadPool;
+use serde::Deserialize;
+use std::path::{Path, PathBuf};
+use std::sync::mpsc::{self, Receiver, Sender};
+use std::sync::{Arc, Condvar, Mutex};
+
+use crate::buffer_pool::frame_pool;
+use crate::error::{AppError, Result};
+use crate::predict::PredictArgs;
+use crate::thread_budget::{Stage, ThreadBudget, pin_pool};
+
+// -- encoding
+
+/// Output encoding of saved annotated images
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default, Deserialize)]
+#[serde(rename_all = "snake_case")]
+pub enum SaveFormat {
+    /// PNG with default compression (smallest files, slowest)
+    #[default]
+    Png,
+    /// PNG with fast compression (several times faster, somewhat larger files)
+    PngFast,
+    /// JPEG with `jpeg_quality` (lossy, alpha is dropped)
+    Jpeg,
+    /// QOI (lossless, fastest, largest files)
+    Qoi,
+}
+
+impl SaveFormat {
+    /// File extension, without dot
+    pub const fn extension(self) -> &'static str {
+        match self {
+            SaveFormat::Png | SaveFormat::PngFast => "png",
+            SaveFormat::Jpeg => "jpg",
+            SaveFormat::Qoi => "qoi",
+        }
+    }
+}
+
+/// Encodes images in a [`SaveFormat`] and writes each one with a single buffered write
+#[derive(Debug, Clone, Copy)]
+pub struct ImageEncoder {
+    pub format: SaveFormat,
+    pub jpeg_quality: u8,
+}
+
+impl Default for ImageEncoder {
+    fn default() -> Self {
+        Self {
+            format: SaveFormat::default(),
+            jpeg_quality: 90,
+        }
+    }
+}
+
+impl ImageEncoder {
+    /// Encode `image` into memory
+    pub fn encode(&self, image: &DynamicImage) -> Result<Vec<u8>> {
+        let mut buffer = Vec::new();
+        let encoded = match self.format {
+            SaveFormat::Png => image.write_with_encoder(PngEncoder::new(&mut buffer)),
+            SaveFormat::PngFast => image.write_with_encoder(PngEncoder::new_with_quality(
+                &mut buffer,
+                CompressionType::Fast,
+                FilterType::Sub,
+            )),
+            SaveFormat::Jpeg => {
+                let encoder = JpegEncoder::new_with_quality(&mut buffer, self.jpeg_quality);
+                match image {
+                    DynamicImage::ImageRgb8(_) | DynamicImage::ImageLuma8(_) => {
+                        image.write_with_encoder(encoder)
+                    }
+                    // JPEG has no alpha channel
+                    _ => DynamicImage::ImageRgb8(image.to_rgb8()).write_with_encoder(encoder),
+                }
+            }
+            SaveFormat::Qoi => image.write_with_encoder(QoiEncoder::new(&mut buffer)),
+        };
+        encoded.map_err(|e| AppError::ImageSave(e.to_string()))?;
+        Ok(buffer)
+    }
+
+    /// Encode `image` and write it to `path`
+    pub fn write(&self, image: &DynamicImage, path: &Path) -> Result<()> {
+        let buffer = self.encode(image)?;
+        std::fs::write(path, buffer)?;
+        Ok(())
+    }
+}
+
+// -- writer
+
+/// In-flight writes of a [`ImageWriter`] pool
+#[derive(Debug, Default)]
+struct InFlight {
+    count: Mutex<usize>,
+    changed: Condvar,
+}
+
+/// Queued write that failed, reported back by the pool
+#[derive(Debug)]
+pub struct SaveFailure {
+    pub path: PathBuf,
+    pub error: AppError,
+}
+
+/// Result writer of the saving stage.
+///
+/// Without workers, images are encoded and written on the calling thread. With `save_workers`
+/// set, encoding and writing run on a pool and [`ImageWriter::save`] only blocks while
+/// `2 * workers` writes are in flight; failed queued writes are reported back through a
+/// channel, taken by [`ImageWriter::take_failures`] and [`ImageWriter::flush`], which also
+/// waits for all of them.
+#[derive(Debug)]
+pub struct ImageWriter {
+    encoder: ImageEncoder,
+    pool: Option<ThreadPool>,
+    max_in_flight: usize,
+    in_flight: Arc<InFlight>,
+    failures_tx: Sender<SaveFailure>,
+    failures: Mutex<Receiver<SaveFailure>>,
+}
+
+impl ImageWriter {
+    /// Create a writer encoding with `encoder` on `workers` pool threads (`None`: no pool)
+    pub fn new(encoder: ImageEncoder, workers: Option<usize>) -> Result<Self> {
+        Self::pinned(encoder, workers, None)
+    }
+
+    /// Same as [`ImageWriter::new`], with the pool threads pinned to `cpus` if set
+    pub fn pinned(
+        encoder: ImageEncoder,
+        workers: Option<usize>,
+        cpus: Option<Vec<usize>>,
+    ) -> Result<Self> {
+        let pool =
+            match workers {
+                Some(workers) if workers > 0 => {
+                    let builder = rayon::ThreadPoolBuilder::new()
+                        .num_threads(workers)
+                        .thread_name(|i| format!("yolo-save-{}", i));
+                    Some(pin_pool(builder, cpus).build().map_err(|e| {
+                        AppError::Config(format!("Failed to build save pool: {}", e))
+                    })?)
+                }
+                _ => None,
+            };
+        let max_in_flight = pool.as_ref().map_or(1, |p| 2 * p.current_num_threads());
+        let (failures_tx, failures) = mpsc::channel();
+
+        Ok(Self {
+            encoder,
+            pool,
+            max_in_flight,
+            in_flight: Arc::default(),
+            failures_tx,
+            failures: Mutex::new(failures),
+        })
+    }
+
+    /// Writer configured by `save_format`, `jpeg_quality` and `save_workers`, pinned to the save
+    /// cores of `budget`
+    pub fn from_args(args: &PredictArgs, budget: &ThreadBudget) -> Result<Self> {
+        let encoder = ImageEncoder {
+            format: args.save_format,
+            jpeg_quality: args.jpeg_quality.unwrap_or(90).clamp(1, 100),
+        };
+        let cpus = budget.pinned(Stage::Save);
+        Self::pinned(encoder, args.save_workers, cpus)
+    }
+
+    /// Save path of the frame `stem` in `dir`
+    pub fn save_path(&self, dir: &Path, stem: &str) -> PathBuf {
+        dir.join(format!("{}.{}", stem, self.encoder.format.extension()))
+    }
+
+    /// Save `image` to `path`.
+    ///
+    /// With a pool the image is copied (into a recycled frame buffer) and queued; failures of
+    /// queued writes are logged and reported by [`ImageWriter::take_failures`] and
+    /// [`ImageWriter::flush`] instead of being returned here.
+    pub fn save(&self, image: &DynamicImage, path: &Path) -> Result<()> {
+        if self.pool.is_none() {
+            return self.encoder.write(image, path);
+        }
+        let failures = self.failures_tx.clone();
+        self.save_owned(frame_pool().copy(image), path, move |image, saved| {
+            if let Err(failure) = saved {
+                // the writer is only gone once every queued write is done
+                let _ = failures.send(failure);
+            }
+            frame_pool().recycle(image);
+        });
+        Ok(())
+    }
+
+    /// Save `image` to `path`, then hand the image and the result of its write to `done`.
+    ///
+    /// Without a pool the image is written and `done` runs on the calling thread; with a pool
+    /// both run on a pool thread, without copying the image. Failed writes are logged.
+    pub fn save_owned(
+        &self,
+        image: DynamicImage,
+        path: &Path,
+        done: impl FnOnce(DynamicImage, std::result::Result<(), SaveFailure>) + Send + 'static,
+    ) {
+        let encoder = self.encoder;
+        let write = move |image: DynamicImage, path: PathBuf| {
+            let saved = encoder.write(&image, &path).map_err(|error| {
+                tracing::error!("Failed to save annotated image to {:?}: {}", path, error);
+                SaveFailure { path, error }
+            });
+            done(image, saved);
+        };
+        let Some(pool) = &self.pool else {
+            write(image, path.to_path_buf());
+            return;
+        };
+
+        // backpressure: wait for a free slot
+        {
+            let mut count = self
+                .in_flight
+                .count
+                .lock()
+                .expect("Save queue lock poisoned");
+            while *count >= self.max_in_flight {
+                count = self
+                    .in_flight
+                    .changed
+                    .wait(count)
+                    .expect("Save queue lock poisoned");
+            }
+            *count += 1;
+        }
+
+        let (path, in_flight) = (path.to_path_buf(), Arc::clone(&self.in_flight));
+        pool.spawn(move || {
+            write(image, path);
+            let mut count = in_flight.count.lock().expect("Save queue lock poisoned");
+            *count -= 1;
+            in_flight.changed.notify_all();
+        });
+    }
+
+    /// Failed queued writes reported since the last call, without waiting for the writes still
+    /// in flight
+    pub fn take_failures(&self) -> Vec<SaveFailure> {
+        self.failures
+            .lock()
+            .expect("Save failures lock poisoned")
+            .try_iter()
+            .collect()
+    }
+
+    /// Wait until all queued writes are done; returns the queued writes that failed since the
+    /// last [`ImageWriter::take_failures`] or flush.
+    pub fn flush(&self) -> Vec<SaveFailure> {
+        let mut count = self
+            .in_flight
+            .count
+            .lock()
+            .expect("Save queue lock poisoned");
+        while *count > 0 {
+            count = self
+                .in_flight
+                .changed
+                .wait(count)
+                .expect("Save queue lock poisoned");
+        }
+        drop(count);
+        self.take_failures()
+    }
+}
+
+impl Drop for ImageWriter {
+    fn drop(&mut self) {
+        let failed = self.flush().len();
+        if failed > 0 {
+            tracing::error!("{} annotated images failed to save", failed);
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use image::{Rgba, RgbaImage};
+
+    #[test]
+    fn test_writer_pool_saves_every_format() {
+        let dir = tempfile::tempdir().unwrap();
+        let image = DynamicImage::ImageRgba8(RgbaImage::from_pixel(16, 8, Rgba([10, 20, 30, 255])));
+
+        for format in [
+            SaveFormat::Png,
+            SaveFormat::PngFast,
+            SaveFormat::Jpeg,
+            SaveFormat::Qoi,
+        ] {
+            let encoder = ImageEncoder {
+                format,
+                ..Default::default()
+            };
+            let writer = ImageWriter::new(encoder, Some(2)).unwrap();
+            let paths: Vec<PathBuf> = (0..4)
+                .map(|i| writer.save_path(dir.path(), &format!("frame_{}", i)))
+                .collect();
+            for path in &paths {
+                writer.save(&image, path).unwrap();
+            }
+            assert!(writer.flush().is_empty());
+
+            for path in &paths {
+                let decoded = image::open(path).unwrap();
+                assert_eq!((decoded.width(), decoded.height()), (16, 8));
+            }
+        }
+    }
+
+    #[test]
+    fn test_writer_pool_reports_failed_writes() {
+        let dir = tempfile::tempdir().unwrap();
+        let image = DynamicImage::ImageRgba8(RgbaImage::new(4, 4));
+        let writer = ImageWriter::new(ImageEncoder::default(), Some(2)).unwrap();
+
+        let missing = dir.path().join("missing").join("frame.png");
+        writer.save(&image, &missing).unwrap();
+        writer.save(&image, &dir.path().join("frame.png")).unwrap();
+
+        let failed = writer.flush();
+        assert_eq!(failed.len(), 1);
+        assert_eq!(failed[0].path, missing);
+        assert!(writer.flush().is_empty());
+
+        // owned saves report the result of each write to their callback
+        let (done_tx, done_rx) = std::sync::mpsc::channel();
+        writer.save_owned(image, &missing, move |_, saved| {
+            done_tx.send(saved.is_ok()).unwrap();
+        });
+        assert!(!done_rx.recv().unwrap());
+    }
+}